@@ -36,6 +36,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "util/script.h"
 #include "util/precomp.h"
 #include "util/struct.h"
+#include "util/schedule.h"
+#include "util/regress.h"
 #include "navigation/aasfile.h"
 #include "ai_public.h"
 #include "navigation/aas.h"
@@ -148,6 +150,8 @@ static int Export_BotLibSetup( void )
 	if (errnum != BLERR_NOERROR) return errnum;
 	errnum = BotSetupMoveAI();		//be_ai_move.c
 	if (errnum != BLERR_NOERROR) return errnum;
+	BotSetupSchedule();				//schedule.c
+	BotSetupRegress();				//regress.c
 
 	botlibsetup = qtrue;
 	botlibglobals.botlibsetup = qtrue;
@@ -174,6 +178,8 @@ static int Export_BotLibShutdown(void)
 	BotShutdownWeaponAI();		//be_ai_weap.c
 	BotShutdownWeights();		//be_ai_weight.c
 	BotShutdownCharacters();	//be_ai_char.c
+	BotShutdownSchedule();		//schedule.c
+	BotShutdownRegress();		//regress.c
 	//shut down AAS
 	AAS_Shutdown();
 	//shut down bot elementary actions
@@ -182,6 +188,8 @@ static int Export_BotLibShutdown(void)
 	LibVarDeAllocAll();
 	//remove all global defines from the pre compiler
 	PC_RemoveAllGlobalDefines();
+	//free the pre compiler source cache
+	PC_ShutdownSourceCache();
 
 	//dump all allocated memory
 //	DumpMemory();
@@ -232,6 +240,8 @@ static int Export_BotLibVarGet( const char *var_name, char *value, int size )
 static int Export_BotLibStartFrame(float time)
 {
 	if (!BotLibSetup("BotStartFrame")) return BLERR_LIBRARYNOTSETUP;
+	BotScheduleStartFrame(time);
+	BotRegressStartFrame(time);
 	return AAS_StartFrame(time);
 } //end of the function Export_BotLibStartFrame
 //===========================================================================
@@ -647,6 +657,7 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	// be_aas_entity.c
 	//--------------------------------------------
 	aas->AAS_EntityInfo = AAS_EntityInfo;
+	aas->AAS_EntitiesInRadius = AAS_EntitiesInRadius;
 	//--------------------------------------------
 	// be_aas_main.c
 	//--------------------------------------------
@@ -677,9 +688,9 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	//--------------------------------------------
 	// be_aas_route.c
 	//--------------------------------------------
-	aas->AAS_AreaTravelTimeToGoalArea = AAS_AreaTravelTimeToGoalArea;
+	aas->AAS_AreaTravelTimeToGoalArea = Regress_AAS_AreaTravelTimeToGoalArea;
 	aas->AAS_EnableRoutingArea = AAS_EnableRoutingArea;
-	aas->AAS_PredictRoute = AAS_PredictRoute;
+	aas->AAS_PredictRoute = Regress_AAS_PredictRoute;
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -688,7 +699,7 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	// be_aas_move.c
 	//--------------------------------------------
 	aas->AAS_Swimming = AAS_Swimming;
-	aas->AAS_PredictClientMovement = AAS_PredictClientMovement;
+	aas->AAS_PredictClientMovement = Regress_AAS_PredictClientMovement;
 }
 
   
@@ -781,8 +792,8 @@ static void Init_AI_Export( ai_export_t *ai ) {
 	ai->BotGoalName = BotGoalName;
 	ai->BotGetTopGoal = BotGetTopGoal;
 	ai->BotGetSecondGoal = BotGetSecondGoal;
-	ai->BotChooseLTGItem = BotChooseLTGItem;
-	ai->BotChooseNBGItem = BotChooseNBGItem;
+	ai->BotChooseLTGItem = Regress_BotChooseLTGItem;
+	ai->BotChooseNBGItem = Regress_BotChooseNBGItem;
 	ai->BotTouchingGoal = BotTouchingGoal;
 	ai->BotItemGoalInVisButNotVisible = BotItemGoalInVisButNotVisible;
 	ai->BotGetLevelItemGoal = BotGetLevelItemGoal;
@@ -803,7 +814,7 @@ static void Init_AI_Export( ai_export_t *ai ) {
 	// be_ai_move.h
 	//-----------------------------------
 	ai->BotResetMoveState = BotResetMoveState;
-	ai->BotMoveToGoal = BotMoveToGoal;
+	ai->BotMoveToGoal = Regress_BotMoveToGoal;
 	ai->BotMoveInDirection = BotMoveInDirection;
 	ai->BotResetAvoidReach = BotResetAvoidReach;
 	ai->BotResetLastAvoidReach = BotResetLastAvoidReach;
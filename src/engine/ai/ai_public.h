@@ -213,6 +213,7 @@ typedef struct aas_export_s
 	// be_aas_entity.c
 	//-----------------------------------
 	void		(*AAS_EntityInfo)(int entnum, struct aas_entityinfo_s *info);
+	int			(*AAS_EntitiesInRadius)(vec3_t origin, float radius, int type, int *entities, int maxentities);
 	//-----------------------------------
 	// be_aas_main.c
 	//-----------------------------------
@@ -300,7 +300,7 @@ static bot_character_t *BotLoadCharacterFromFile(const char *charfile, int skill
 	foundcharacter = qfalse;
 	//a bot character is parsed in two phases
 	PC_SetBaseFolder(BOTFILESBASEFOLDER);
-	source = LoadSourceFile(charfile);
+	source = LoadSourceFileCached(charfile);
 	if (!source)
 	{
 		botimport.Print(PRT_ERROR, "couldn't load %s\n", charfile);
@@ -38,6 +38,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../util/struct.h"
 #include "../util/utils.h"
 #include "../util/log.h"
+#include "../util/schedule.h"
 #include "../navigation/aasfile.h"
 #include "../ai_public.h"
 #include "../navigation/aas.h"
@@ -112,6 +113,7 @@ typedef struct bot_synonym_s
 {
 	char *string;
 	float weight;
+	int pattern;						//pattern in the synonym automaton
 	struct bot_synonym_s *next;
 } bot_synonym_t;
 //list with synonyms
@@ -127,6 +129,7 @@ typedef struct bot_synonymlist_s
 typedef struct bot_matchstring_s
 {
 	char *string;
+	int pattern;						//pattern in the match automaton
 	struct bot_matchstring_s *next;
 } bot_matchstring_t;
 
@@ -145,9 +148,52 @@ typedef struct bot_matchtemplate_s
 	int type;
 	int subtype;
 	bot_matchpiece_t *first;
+	int *required;						//groups of patterns of which one must be present, see BotCompileMatchTemplates
 	struct bot_matchtemplate_s *next;
 } bot_matchtemplate_t;
 
+//node of the match string automaton
+typedef struct bot_matchnode_s
+{
+	int child;							//first child node
+	int sibling;						//next node with the same parent
+	int fail;							//longest proper suffix that is also in the trie
+	int output;							//pattern ending at this node or -1
+	int outputlink;						//next node on the fail chain with an output or 0
+	unsigned char c;					//lower case character leading to this node
+} bot_matchnode_t;
+
+//occurrence of a pattern in the string being matched
+typedef struct bot_matchoccurrence_s
+{
+	int offset;							//start of the occurrence
+	int next;							//next occurrence of the same pattern or -1
+} bot_matchoccurrence_t;
+
+#define MAX_MATCHOCCURRENCES		4096
+
+//strings compiled into a single Aho-Corasick automaton, used for the match
+//templates and the synonyms
+typedef struct bot_matchautomaton_s
+{
+	bot_matchnode_t *nodes;
+	int numnodes;
+	int numpatterns;
+	int *patternlength;
+	//deterministic transitions over the characters used in the patterns
+	byte charclass[256];
+	int numclasses;
+	int *transitions;
+	int *required;
+	//occurrences found by the last scan, valid when generation[p] equals curgeneration
+	int *firstoccurrence;
+	int *lastoccurrence;
+	int *generation;
+	int curgeneration;
+	bot_matchoccurrence_t occurrences[MAX_MATCHOCCURRENCES];
+	int numoccurrences;
+} bot_matchautomaton_t;
+
 //reply chat key
 typedef struct bot_replychatkey_s
 {
@@ -204,8 +250,12 @@ static bot_consolemessage_t *consolemessageheap = NULL;
 static bot_consolemessage_t *freeconsolemessages = NULL;
 //list with match strings
 static bot_matchtemplate_t *matchtemplates = NULL;
+//match strings of all the templates compiled into an automaton
+static bot_matchautomaton_t *matchautomaton = NULL;
 //list with synonyms
 static bot_synonymlist_t *synonyms = NULL;
+//strings of all the synonyms compiled into an automaton
+static bot_matchautomaton_t *synonymautomaton = NULL;
 //list with random strings
 static bot_randomlist_t *randomstrings = NULL;
 //reply chats
@@ -544,20 +594,22 @@ static const char *StringContainsWord( const char *str1, const char *str2 )
 	return NULL;
 } //end of the function StringContainsWord
 //===========================================================================
+// returns the number of replacements made
 //
 // Parameter:				-
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-static void StringReplaceWords( char *string, int size, const char *synonym, const char *replacement )
+static int StringReplaceWords( char *string, int size, const char *synonym, const char *replacement )
 {
 	char *str;
 	const char *str2, *endp;
-	int replen, synlen;
+	int replen, synlen, numreplaced;
 
 	synlen = (int) strlen( synonym );
 	replen = (int) strlen( replacement );
 	endp = string + size;
+	numreplaced = 0;
 
 	//find the synonym in the string
 	str = (char *) StringContainsWord( string, synonym );
@@ -580,12 +632,216 @@ static void StringReplaceWords( char *string, int size, const char *synonym, con
 			memmove( str + replen, str + synlen, strlen( str + synlen ) + 1 );
 			//append the synonym replacement
 			Com_Memcpy( str, replacement, replen );
+			numreplaced++;
 		}
 
 		//find the next synonym in the string
 		str = (char *) StringContainsWord( str + replen, synonym );
 	} //end if
+	return numreplaced;
 } //end of the function StringReplaceWords
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotFreeMatchAutomaton(bot_matchautomaton_t *ma)
+{
+	if (!ma) return;
+	FreeMemory(ma->nodes);
+	FreeMemory(ma->patternlength);
+	if (ma->transitions) FreeMemory(ma->transitions);
+	if (ma->required) FreeMemory(ma->required);
+	FreeMemory(ma);
+} //end of the function BotFreeMatchAutomaton
+//===========================================================================
+// returns the child of the node reached with the given character or 0
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotMatchNodeChild(const bot_matchautomaton_t *ma, int node, unsigned char c)
+{
+	int n;
+
+	for (n = ma->nodes[node].child; n; n = ma->nodes[n].sibling)
+	{
+		if (ma->nodes[n].c == c) return n;
+	} //end for
+	return 0;
+} //end of the function BotMatchNodeChild
+//===========================================================================
+// allocates an empty automaton for at most the given number of
+// characters and patterns
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static bot_matchautomaton_t *BotAllocMatchAutomaton(int maxnodes, int maxpatterns)
+{
+	bot_matchautomaton_t *ma;
+
+	ma = (bot_matchautomaton_t *) GetClearedMemory(sizeof(bot_matchautomaton_t));
+	ma->nodes = (bot_matchnode_t *) GetClearedMemory(maxnodes * sizeof(bot_matchnode_t));
+	ma->patternlength = (int *) GetClearedMemory(maxpatterns * 4 * sizeof(int));
+	ma->firstoccurrence = ma->patternlength + maxpatterns;
+	ma->lastoccurrence = ma->firstoccurrence + maxpatterns;
+	ma->generation = ma->lastoccurrence + maxpatterns;
+	ma->numnodes = 1;
+	ma->nodes[0].output = -1;
+	return ma;
+} //end of the function BotAllocMatchAutomaton
+//===========================================================================
+// inserts the string into the trie, equal strings share a pattern
+// returns the pattern or -1 for an empty string
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotAddMatchPattern(bot_matchautomaton_t *ma, const char *string)
+{
+	bot_matchnode_t *node;
+	const char *ptr;
+	int n, next;
+
+	if (!*string) return -1;
+	n = 0;
+	for (ptr = string; *ptr; ptr++)
+	{
+		next = BotMatchNodeChild(ma, n, locase[(byte) *ptr]);
+		if (!next)
+		{
+			next = ma->numnodes++;
+			node = &ma->nodes[next];
+			node->c = locase[(byte) *ptr];
+			node->output = -1;
+			node->sibling = ma->nodes[n].child;
+			ma->nodes[n].child = next;
+		} //end if
+		n = next;
+	} //end for
+	if (ma->nodes[n].output < 0)
+	{
+		ma->nodes[n].output = ma->numpatterns;
+		ma->patternlength[ma->numpatterns] = strlen(string);
+		ma->numpatterns++;
+	} //end if
+	return ma->nodes[n].output;
+} //end of the function BotAddMatchPattern
+//===========================================================================
+// sets up the character classes, fail links and transitions after
+// all the patterns have been added
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotFinishMatchAutomaton(bot_matchautomaton_t *ma)
+{
+	int n, next, state, head, tail, *queue;
+
+	//characters not used in any pattern all share class 0
+	ma->numclasses = 1;
+	for (n = 1; n < ma->numnodes; n++)
+	{
+		if (!ma->charclass[ma->nodes[n].c])
+		{
+			ma->charclass[ma->nodes[n].c] = ma->numclasses++;
+		} //end if
+	} //end for
+	ma->transitions = (int *) GetClearedMemory(ma->numnodes * ma->numclasses * sizeof(int));
+	//breadth first setup of the fail and output links and the transitions,
+	//missing transitions are those of the fail state which is always closer to the root
+	queue = (int *) GetMemory(ma->numnodes * sizeof(int));
+	head = tail = 0;
+	queue[tail++] = 0;
+	while(head < tail)
+	{
+		state = queue[head++];
+		if (state)
+		{
+			Com_Memcpy(&ma->transitions[state * ma->numclasses], &ma->transitions[ma->nodes[state].fail * ma->numclasses],
+							ma->numclasses * sizeof(int));
+		} //end if
+		for (n = ma->nodes[state].child; n; n = ma->nodes[n].sibling)
+		{
+			if (state) ma->nodes[n].fail = ma->transitions[ma->nodes[state].fail * ma->numclasses + ma->charclass[ma->nodes[n].c]];
+			else ma->nodes[n].fail = 0;
+			next = ma->nodes[n].fail;
+			ma->nodes[n].outputlink = (ma->nodes[next].output >= 0) ? next : ma->nodes[next].outputlink;
+			ma->transitions[state * ma->numclasses + ma->charclass[ma->nodes[n].c]] = n;
+			queue[tail++] = n;
+		} //end for
+	} //end while
+	FreeMemory(queue);
+} //end of the function BotFinishMatchAutomaton
+//===========================================================================
+// finds all occurrences of all the patterns in the string in a single pass
+// returns qfalse if there are too many occurrences to store
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotScanMatchAutomaton(bot_matchautomaton_t *ma, const char *string)
+{
+	int i, state, n, p;
+	bot_matchoccurrence_t *occ;
+
+	ma->curgeneration++;
+	ma->numoccurrences = 0;
+	state = 0;
+	for (i = 0; string[i]; i++)
+	{
+		state = ma->transitions[state * ma->numclasses + ma->charclass[locase[(byte) string[i]]]];
+		//report all the patterns ending here
+		n = (ma->nodes[state].output >= 0) ? state : ma->nodes[state].outputlink;
+		for (; n; n = ma->nodes[n].outputlink)
+		{
+			if (ma->numoccurrences >= MAX_MATCHOCCURRENCES) return qfalse;
+			p = ma->nodes[n].output;
+			occ = &ma->occurrences[ma->numoccurrences];
+			occ->offset = i - ma->patternlength[p] + 1;
+			occ->next = -1;
+			//occurrences of a pattern are found in increasing order
+			if (ma->generation[p] != ma->curgeneration)
+			{
+				ma->generation[p] = ma->curgeneration;
+				ma->firstoccurrence[p] = ma->numoccurrences;
+			} //end if
+			else
+			{
+				ma->occurrences[ma->lastoccurrence[p]].next = ma->numoccurrences;
+			} //end else
+			ma->lastoccurrence[p] = ma->numoccurrences;
+			ma->numoccurrences++;
+		} //end for
+	} //end for
+	return qtrue;
+} //end of the function BotScanMatchAutomaton
+//===========================================================================
+// returns the first occurrence of the pattern at or after the offset
+// in the last scanned string, -1 if there is none
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotMatchOccurrence(const bot_matchautomaton_t *ma, int pattern, int offset)
+{
+	int i;
+
+	if (ma->generation[pattern] != ma->curgeneration) return -1;
+	for (i = ma->firstoccurrence[pattern]; i >= 0; i = ma->occurrences[i].next)
+	{
+		if (ma->occurrences[i].offset >= offset) return ma->occurrences[i].offset;
+	} //end for
+	return -1;
+} //end of the function BotMatchOccurrence
 #if 0
 //===========================================================================
 //
@@ -640,7 +896,7 @@ static bot_synonymlist_t *BotLoadSynonyms( const char *filename )
 		if (pass && size) ptr = (char *) GetClearedHunkMemory(size);
 		//
 		PC_SetBaseFolder(BOTFILESBASEFOLDER);
-		source = LoadSourceFile(filename);
+		source = LoadSourceFileCached(filename);
 		if (!source)
 		{
 			botimport.Print(PRT_ERROR, "couldn't load %s\n", filename);
@@ -782,6 +1038,71 @@ static bot_synonymlist_t *BotLoadSynonyms( const char *filename )
 	return synlist;
 } //end of the function BotLoadSynonyms
 //===========================================================================
+// compiles the strings of all the synonyms into a single automaton so
+// a string is scanned only once to find the synonyms that can occur in it
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static bot_matchautomaton_t *BotCompileSynonyms(bot_synonymlist_t *synlist)
+{
+	bot_matchautomaton_t *ma;
+	bot_synonymlist_t *syn;
+	bot_synonym_t *synonym;
+	int maxnodes, maxpatterns;
+
+	maxnodes = 1;
+	maxpatterns = 0;
+	for (syn = synlist; syn; syn = syn->next)
+	{
+		for (synonym = syn->firstsynonym; synonym; synonym = synonym->next)
+		{
+			maxnodes += strlen(synonym->string);
+			maxpatterns++;
+		} //end for
+	} //end for
+	if (!maxpatterns) return NULL;
+	//
+	ma = BotAllocMatchAutomaton(maxnodes, maxpatterns);
+	for (syn = synlist; syn; syn = syn->next)
+	{
+		for (synonym = syn->firstsynonym; synonym; synonym = synonym->next)
+		{
+			synonym->pattern = BotAddMatchPattern(ma, synonym->string);
+		} //end for
+	} //end for
+	BotFinishMatchAutomaton(ma);
+	//
+	botimport.Print(PRT_MESSAGE, "compiled %d synonyms into %d states\n", ma->numpatterns, ma->numnodes);
+	return ma;
+} //end of the function BotCompileSynonyms
+//===========================================================================
+// finds the synonyms occurring in the string, returns qfalse if every
+// synonym has to be tried
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static qboolean BotScanSynonyms(const char *string)
+{
+	if (!synonymautomaton) return qfalse;
+	return BotScanMatchAutomaton(synonymautomaton, string);
+} //end of the function BotScanSynonyms
+//===========================================================================
+// returns qtrue if the synonym occurred in the last scanned string
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static qboolean BotSynonymInString(const bot_synonym_t *synonym)
+{
+	if (synonym->pattern < 0) return qfalse;
+	return synonymautomaton->generation[synonym->pattern] == synonymautomaton->curgeneration;
+} //end of the function BotSynonymInString
+//===========================================================================
 // replace all the synonyms in the string
 //
 // Parameter:				-
@@ -792,6 +1113,11 @@ void BotReplaceSynonyms( char *string, int size, unsigned long int context )
 {
 	const bot_synonymlist_t *syn;
 	const bot_synonym_t *synonym;
+	qboolean scanned;
+
+	//skip the synonyms that don't occur in the string, replacements are
+	//still done in the same order so the result is identical
+	scanned = BotScanSynonyms( string );
 
 	for ( syn = synonyms; syn; syn = syn->next )
 	{
@@ -800,7 +1126,10 @@ void BotReplaceSynonyms( char *string, int size, unsigned long int context )
 
 		for ( synonym = syn->firstsynonym->next; synonym; synonym = synonym->next )
 		{
-			StringReplaceWords( string, size, synonym->string, syn->firstsynonym->string );
+			if ( scanned && !BotSynonymInString( synonym ) )
+				continue;
+			if ( StringReplaceWords( string, size, synonym->string, syn->firstsynonym->string ) )
+				scanned = BotScanSynonyms( string );
 		} //end for
 	} //end for
 } //end of the function BotReplaceSynonyms
@@ -815,13 +1144,17 @@ static void BotReplaceWeightedSynonyms( char *string, int size, unsigned long in
 	bot_synonymlist_t *syn;
 	bot_synonym_t *synonym, *replacement;
 	float weight, curweight;
+	qboolean scanned;
+
+	scanned = BotScanSynonyms( string );
 
 	for ( syn = synonyms; syn; syn = syn->next )
 	{
 		if ( ( syn->context & context ) == 0 )
 			continue;
 
-		//choose a weighted random replacement synonym
+		//choose a weighted random replacement synonym, always done
+		//for every list so the random sequence doesn't change
 		weight = random() * syn->totalweight;
 		if ( !weight )
 			continue;
@@ -841,7 +1174,10 @@ static void BotReplaceWeightedSynonyms( char *string, int size, unsigned long in
 		{
 			if ( synonym == replacement )
 				continue;
-			StringReplaceWords( string, size, synonym->string, replacement->string );
+			if ( scanned && !BotSynonymInString( synonym ) )
+				continue;
+			if ( StringReplaceWords( string, size, synonym->string, replacement->string ) )
+				scanned = BotScanSynonyms( string );
 		} //end for
 	} //end for
 } //end of the function BotReplaceWeightedSynonyms
@@ -857,9 +1193,11 @@ static void BotReplaceReplySynonyms( char *string, int size, unsigned long int c
 	const char *str2, *endp;
 	bot_synonymlist_t *syn;
 	bot_synonym_t *synonym;
-	int replen;
+	int replen, offset;
+	qboolean scanned;
 
 	endp = string + size;
+	scanned = BotScanSynonyms( string );
 
 	for ( str1 = string; *str1 != '\0'; )
 	{
@@ -868,6 +1206,7 @@ static void BotReplaceReplySynonyms( char *string, int size, unsigned long int c
 			str1++;
 		if ( *str1 == '\0' )
 			break;
+		offset = str1 - string;
 
 		for ( syn = synonyms; syn; syn = syn->next )
 		{
@@ -876,6 +1215,11 @@ static void BotReplaceReplySynonyms( char *string, int size, unsigned long int c
 
 			for ( synonym = syn->firstsynonym->next; synonym; synonym = synonym->next )
 			{
+				//empty synonyms have no pattern and never match
+				if ( synonym->pattern < 0 )
+					continue;
+				if ( scanned && BotMatchOccurrence( synonymautomaton, synonym->pattern, offset ) != offset )
+					continue;
 				//if the synonym is not at the front of the string continue
 				str2 = StringContainsWord( str1, synonym->string );
 				if ( !str2 || str2 != str1 )
@@ -894,6 +1238,7 @@ static void BotReplaceReplySynonyms( char *string, int size, unsigned long int c
 				memmove( str1 + replen, str1 + strlen( synonym->string ), strlen( str1 + strlen( synonym->string ) ) + 1 );
 				//append the synonym replacement
 				Com_Memcpy( str1, replacement, replen );
+				scanned = BotScanSynonyms( string );
 				break;
 			}
 
@@ -1040,7 +1385,7 @@ static bot_randomlist_t *BotLoadRandomStrings( const char *filename )
 		if (pass && size) ptr = (char *) GetClearedHunkMemory(size);
 		//
 		PC_SetBaseFolder(BOTFILESBASEFOLDER);
-		source = LoadSourceFile(filename);
+		source = LoadSourceFileCached(filename);
 		if (!source)
 		{
 			botimport.Print(PRT_ERROR, "couldn't load %s\n", filename);
@@ -1344,7 +1689,7 @@ static bot_matchtemplate_t *BotLoadMatchTemplates( const char *matchfile )
 	unsigned long int context;
 
 	PC_SetBaseFolder(BOTFILESBASEFOLDER);
-	source = LoadSourceFile(matchfile);
+	source = LoadSourceFileCached(matchfile);
 	if (!source)
 	{
 		botimport.Print(PRT_ERROR, "couldn't load %s\n", matchfile);
@@ -1430,6 +1775,84 @@ static bot_matchtemplate_t *BotLoadMatchTemplates( const char *matchfile )
 	return matches;
 } //end of the function BotLoadMatchTemplates
 //===========================================================================
+// compiles the strings of all the match templates into a single
+// Aho-Corasick automaton so a message is scanned only once for all
+// the templates
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static bot_matchautomaton_t *BotCompileMatchTemplates(bot_matchtemplate_t *matches)
+{
+	bot_matchautomaton_t *ma;
+	bot_matchtemplate_t *mt;
+	bot_matchpiece_t *mp;
+	bot_matchstring_t *ms;
+	int maxnodes, maxpatterns, numtemplates, len, head;
+
+	//count the worst case number of nodes and patterns
+	maxnodes = 1;
+	maxpatterns = 0;
+	numtemplates = 0;
+	for (mt = matches; mt; mt = mt->next)
+	{
+		numtemplates++;
+		for (mp = mt->first; mp; mp = mp->next)
+		{
+			if (mp->type != MT_STRING) continue;
+			for (ms = mp->firststring; ms; ms = ms->next)
+			{
+				maxnodes += strlen(ms->string);
+				maxpatterns++;
+			} //end for
+		} //end for
+	} //end for
+	if (!maxpatterns) return NULL;
+	//
+	ma = BotAllocMatchAutomaton(maxnodes, maxpatterns);
+	for (mt = matches; mt; mt = mt->next)
+	{
+		for (mp = mt->first; mp; mp = mp->next)
+		{
+			if (mp->type != MT_STRING) continue;
+			for (ms = mp->firststring; ms; ms = ms->next)
+			{
+				ms->pattern = BotAddMatchPattern(ma, ms->string);
+			} //end for
+		} //end for
+	} //end for
+	BotFinishMatchAutomaton(ma);
+	//for every template store the groups of patterns of which at least one
+	//must be present in the string: [count, pattern, pattern, ..., count, ..., 0]
+	ma->required = (int *) GetClearedMemory((maxpatterns * 2 + numtemplates) * sizeof(int));
+	len = 0;
+	for (mt = matches; mt; mt = mt->next)
+	{
+		mt->required = &ma->required[len];
+		for (mp = mt->first; mp; mp = mp->next)
+		{
+			if (mp->type != MT_STRING) continue;
+			for (ms = mp->firststring; ms; ms = ms->next)
+			{
+				if (ms->pattern < 0) break;
+			} //end for
+			//a piece with an empty string always matches
+			if (ms) continue;
+			head = len++;
+			for (ms = mp->firststring; ms; ms = ms->next)
+			{
+				ma->required[len++] = ms->pattern;
+			} //end for
+			ma->required[head] = len - head - 1;
+		} //end for
+		ma->required[len++] = 0;
+	} //end for
+	//
+	botimport.Print(PRT_MESSAGE, "compiled %d match strings into %d states\n", ma->numpatterns, ma->numnodes);
+	return ma;
+} //end of the function BotCompileMatchTemplates
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -1512,18 +1935,79 @@ static int StringsMatch(bot_matchpiece_t *pieces, bot_match_t *match)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-int BotFindMatch(const char *str, bot_match_t *match, unsigned long int context)
+static int StringsMatchCompiled(const bot_matchautomaton_t *ma, bot_matchpiece_t *pieces, bot_match_t *match)
+{
+	int lastvariable, offset, newoffset, index, length;
+	bot_matchpiece_t *mp;
+	bot_matchstring_t *ms;
+
+	//same as StringsMatch but the string is never scanned again,
+	//string pieces are looked up in the occurrences of the last scan
+	length = strlen(match->string);
+	lastvariable = -1;
+	offset = 0;
+	for (mp = pieces; mp; mp = mp->next)
+	{
+		if (mp->type == MT_STRING)
+		{
+			newoffset = -1;
+			for (ms = mp->firststring; ms; ms = ms->next)
+			{
+				if (ms->pattern < 0)
+				{
+					newoffset = offset;
+					break;
+				} //end if
+				index = BotMatchOccurrence(ma, ms->pattern, offset);
+				if (index >= 0)
+				{
+					newoffset = index;
+					if (lastvariable >= 0)
+					{
+						match->variables[lastvariable].length = newoffset - match->variables[lastvariable].offset;
+						lastvariable = -1;
+						break;
+					} //end if
+					else if (index == offset)
+					{
+						break;
+					} //end else
+					newoffset = -1;
+				} //end if
+			} //end for
+			if (newoffset < 0) return qfalse;
+			offset = newoffset + (ms->pattern < 0 ? 0 : ma->patternlength[ms->pattern]);
+		} //end if
+		else if (mp->type == MT_VARIABLE)
+		{
+			match->variables[mp->variable].offset = offset;
+			lastvariable = mp->variable;
+		} //end else if
+	} //end for
+	//if a match was found
+	if (lastvariable >= 0 || offset == length)
+	{
+		//if the last piece was a variable string
+		if (lastvariable >= 0)
+		{
+			match->variables[lastvariable].length =
+				strlen(&match->string[ (int) match->variables[lastvariable].offset]);
+		} //end if
+		return qtrue;
+	} //end if
+	return qfalse;
+} //end of the function StringsMatchCompiled
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotFindMatchLinear(bot_match_t *match, unsigned long int context)
 {
 	int i;
 	bot_matchtemplate_t *ms;
 
-	Q_strncpyz( match->string, str, sizeof( match->string ) );
-	//remove any trailing enters
-	while(strlen(match->string) &&
-			match->string[strlen(match->string)-1] == '\n')
-	{
-		match->string[strlen(match->string)-1] = '\0';
-	} //end while
 	//compare the string with all the match strings
 	for (ms = matchtemplates; ms; ms = ms->next)
 	{
@@ -1539,6 +2023,79 @@ int BotFindMatch(const char *str, bot_match_t *match, unsigned long int context)
 		} //end if
 	} //end for
 	return qfalse;
+} //end of the function BotFindMatchLinear
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotFindMatchCompiled(bot_match_t *match, unsigned long int context)
+{
+	int i, *required;
+	bot_matchtemplate_t *ms;
+
+	//one pass over the string for the strings of all templates
+	if (!BotScanMatchAutomaton(matchautomaton, match->string))
+	{
+		return BotFindMatchLinear(match, context);
+	} //end if
+	//
+	for (ms = matchtemplates; ms; ms = ms->next)
+	{
+		if (!(ms->context & context)) continue;
+		//skip templates with a string piece that is not present at all
+		for (required = ms->required; *required; required += *required + 1)
+		{
+			for (i = 1; i <= *required; i++)
+			{
+				if (matchautomaton->generation[required[i]] == matchautomaton->curgeneration) break;
+			} //end for
+			if (i > *required) break;
+		} //end for
+		if (*required) continue;
+		//reset the match variable offsets
+		for (i = 0; i < MAX_MATCHVARIABLES; i++) match->variables[i].offset = -1;
+		//
+		if (StringsMatchCompiled(matchautomaton, ms->first, match))
+		{
+			match->type = ms->type;
+			match->subtype = ms->subtype;
+			return qtrue;
+		} //end if
+	} //end for
+	return qfalse;
+} //end of the function BotFindMatchCompiled
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotPrepareMatchString(const char *str, bot_match_t *match)
+{
+	Q_strncpyz( match->string, str, sizeof( match->string ) );
+	//remove any trailing enters
+	while(strlen(match->string) &&
+			match->string[strlen(match->string)-1] == '\n')
+	{
+		match->string[strlen(match->string)-1] = '\0';
+	} //end while
+} //end of the function BotPrepareMatchString
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int BotFindMatch(const char *str, bot_match_t *match, unsigned long int context)
+{
+	BotPrepareMatchString(str, match);
+	if (matchautomaton)
+	{
+		return BotFindMatchCompiled(match, context);
+	} //end if
+	return BotFindMatchLinear(match, context);
 } //end of the function BotFindMatch
 //===========================================================================
 //
@@ -1919,7 +2476,7 @@ static bot_replychat_t *BotLoadReplyChat( const char *filename )
 	bot_replychatkey_t *key;
 
 	PC_SetBaseFolder(BOTFILESBASEFOLDER);
-	source = LoadSourceFile(filename);
+	source = LoadSourceFileCached(filename);
 	if (!source)
 	{
 		botimport.Print(PRT_ERROR, "couldn't load %s\n", filename);
@@ -2120,7 +2677,7 @@ static bot_chat_t *BotLoadInitialChat(const char *chatfile, const char *chatname
 		if (pass && size) ptr = (char *) GetClearedMemory(size);
 		//load the source file
 		PC_SetBaseFolder(BOTFILESBASEFOLDER);
-		source = LoadSourceFile(chatfile);
+		source = LoadSourceFileCached(chatfile);
 		if (!source)
 		{
 			botimport.Print(PRT_ERROR, "couldn't load %s\n", chatfile);
@@ -2747,6 +3304,8 @@ int BotReplyChat(int chatstate, const char *message, int mcontext, int vcontext,
 
 	cs = BotChatStateFromHandle(chatstate);
 	if (!cs) return qfalse;
+	//the message is gone once this returns so replies are never deferred
+	BotScheduleWork(BOTTASK_REPLYCHAT, 1);
 	Com_Memset( &match, 0, sizeof( match ) );
 	Q_strncpyz( match.string, message, sizeof( match.string ) );
 	bestpriority = -1;
@@ -2908,8 +3467,10 @@ int BotReplyChat(int chatstate, const char *message, int mcontext, int vcontext,
 			bestchatmessage->time = AAS_Time() + CHATMESSAGE_RECENTTIME;
 			BotConstructChatMessage(cs, bestchatmessage->chatmessage, mcontext, &bestmatch, vcontext, qtrue);
 		}
+		BotScheduleTaskDone(BOTTASK_REPLYCHAT);
 		return qtrue;
 	}
+	BotScheduleTaskDone(BOTTASK_REPLYCHAT);
 	return qfalse;
 } //end of the function BotReplyChat
 //===========================================================================
@@ -3088,6 +3649,181 @@ void BotFreeChatState(int handle)
 	botchatstates[handle] = NULL;
 } //end of the function BotFreeChatState
 //===========================================================================
+// loads the lines of a benchmark file as consecutive zero terminated strings
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+#define MATCHBENCHMARK_PASSES		100
+
+static char *BotLoadBenchmarkLines(const char *filename, int *numlines)
+{
+	fileHandle_t fp;
+	int length;
+	char *buffer, *ptr, *line;
+
+	*numlines = 0;
+	length = botimport.FS_FOpenFile(filename, &fp, FS_READ);
+	if (!fp)
+	{
+		botimport.Print(PRT_ERROR, "couldn't load %s\n", filename);
+		return NULL;
+	} //end if
+	buffer = (char *) GetClearedMemory(length + 1);
+	botimport.FS_Read(buffer, length, fp);
+	botimport.FS_FCloseFile(fp);
+	for (line = buffer; *line; line = ptr)
+	{
+		for (ptr = line; *ptr && *ptr != '\n'; ptr++) ;
+		if (*ptr) *ptr++ = '\0';
+		(*numlines)++;
+	} //end for
+	return buffer;
+} //end of the function BotLoadBenchmarkLines
+//===========================================================================
+// matches every line against all the match templates with both the
+// linear and the compiled matcher, verifies the results are identical
+// and prints the time taken by each
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotBenchmarkMatchTemplates(const char *buffer, int numlines)
+{
+	int mismatches, pass, i, j, res1, res2, starttime, lineartime, compiledtime;
+	const char *line;
+	bot_match_t match1, match2;
+
+	if (!matchautomaton) return;
+	//verify the compiled matcher gives the same results for every line
+	mismatches = 0;
+	for (line = buffer, i = 0; i < numlines; i++, line += strlen(line) + 1)
+	{
+		BotPrepareMatchString(line, &match1);
+		BotPrepareMatchString(line, &match2);
+		res1 = BotFindMatchLinear(&match1, ~0UL);
+		res2 = BotFindMatchCompiled(&match2, ~0UL);
+		if (res1 != res2 || (res1 && (match1.type != match2.type || match1.subtype != match2.subtype)))
+		{
+			mismatches++;
+			continue;
+		} //end if
+		if (!res1) continue;
+		for (j = 0; j < MAX_MATCHVARIABLES; j++)
+		{
+			if (match1.variables[j].offset != match2.variables[j].offset ||
+				(match1.variables[j].offset >= 0 && match1.variables[j].length != match2.variables[j].length))
+			{
+				mismatches++;
+				break;
+			} //end if
+		} //end for
+	} //end for
+	//time both matchers over all the lines
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < MATCHBENCHMARK_PASSES; pass++)
+	{
+		for (line = buffer, i = 0; i < numlines; i++, line += strlen(line) + 1)
+		{
+			BotPrepareMatchString(line, &match1);
+			BotFindMatchLinear(&match1, ~0UL);
+		} //end for
+	} //end for
+	lineartime = Sys_MilliSeconds() - starttime;
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < MATCHBENCHMARK_PASSES; pass++)
+	{
+		for (line = buffer, i = 0; i < numlines; i++, line += strlen(line) + 1)
+		{
+			BotPrepareMatchString(line, &match2);
+			BotFindMatchCompiled(&match2, ~0UL);
+		} //end for
+	} //end for
+	compiledtime = Sys_MilliSeconds() - starttime;
+	//
+	botimport.Print(PRT_MESSAGE, "match benchmark: %d lines x %d, linear %d msec, compiled %d msec, %d mismatches\n",
+						numlines, MATCHBENCHMARK_PASSES, lineartime, compiledtime, mismatches);
+} //end of the function BotBenchmarkMatchTemplates
+//===========================================================================
+// replaces the synonyms in every line with each of the replace functions,
+// the random seed is reset to the line number before every replacement
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotBenchmarkSynonymsPass(const char *buffer, int numlines, qboolean verify, char *results)
+{
+	char string[MAX_MESSAGE_SIZE];
+	const char *line;
+	int i, j;
+
+	for (line = buffer, i = 0; i < numlines; i++, line += strlen(line) + 1)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			Q_strncpyz(string, line, sizeof(string));
+			srand(i);
+			if (j == 0) BotReplaceSynonyms(string, sizeof(string), ~0UL);
+			else if (j == 1) BotReplaceWeightedSynonyms(string, sizeof(string), ~0UL);
+			else BotReplaceReplySynonyms(string, sizeof(string), ~0UL);
+			if (verify) Q_strncpyz(&results[(i * 3 + j) * MAX_MESSAGE_SIZE], string, MAX_MESSAGE_SIZE);
+		} //end for
+	} //end for
+} //end of the function BotBenchmarkSynonymsPass
+//===========================================================================
+// replaces the synonyms in every line with and without the synonym
+// automaton, verifies the results are identical and prints the time
+// taken by each
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotBenchmarkSynonyms(const char *buffer, int numlines)
+{
+	int mismatches, pass, i, starttime, lineartime, indexedtime;
+	char *linear, *indexed;
+	bot_matchautomaton_t *ma;
+
+	if (!synonymautomaton) return;
+	linear = (char *) GetMemory(numlines * 3 * MAX_MESSAGE_SIZE);
+	indexed = (char *) GetMemory(numlines * 3 * MAX_MESSAGE_SIZE);
+	ma = synonymautomaton;
+	//verify the indexed replacements give the same results for every line
+	synonymautomaton = NULL;
+	BotBenchmarkSynonymsPass(buffer, numlines, qtrue, linear);
+	synonymautomaton = ma;
+	BotBenchmarkSynonymsPass(buffer, numlines, qtrue, indexed);
+	mismatches = 0;
+	for (i = 0; i < numlines * 3; i++)
+	{
+		if (strcmp(&linear[i * MAX_MESSAGE_SIZE], &indexed[i * MAX_MESSAGE_SIZE])) mismatches++;
+	} //end for
+	FreeMemory(linear);
+	FreeMemory(indexed);
+	//time both over all the lines
+	synonymautomaton = NULL;
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < MATCHBENCHMARK_PASSES; pass++)
+	{
+		BotBenchmarkSynonymsPass(buffer, numlines, qfalse, NULL);
+	} //end for
+	lineartime = Sys_MilliSeconds() - starttime;
+	synonymautomaton = ma;
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < MATCHBENCHMARK_PASSES; pass++)
+	{
+		BotBenchmarkSynonymsPass(buffer, numlines, qfalse, NULL);
+	} //end for
+	indexedtime = Sys_MilliSeconds() - starttime;
+	//
+	botimport.Print(PRT_MESSAGE, "synonym benchmark: %d lines x %d, linear %d msec, indexed %d msec, %d mismatches\n",
+						numlines, MATCHBENCHMARK_PASSES, lineartime, indexedtime, mismatches);
+} //end of the function BotBenchmarkSynonyms
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -3103,10 +3839,27 @@ int BotSetupChatAI(void)
 
 	file = LibVarString("synfile", "syn.c");
 	synonyms = BotLoadSynonyms(file);
+	synonymautomaton = BotCompileSynonyms(synonyms);
 	file = LibVarString("rndfile", "rnd.c");
 	randomstrings = BotLoadRandomStrings(file);
 	file = LibVarString("matchfile", "match.c");
 	matchtemplates = BotLoadMatchTemplates(file);
+	matchautomaton = BotCompileMatchTemplates(matchtemplates);
+	//
+	file = LibVarString("bot_matchbenchmark", "");
+	if (*file)
+	{
+		char *buffer;
+		int numlines;
+
+		buffer = BotLoadBenchmarkLines(file, &numlines);
+		if (buffer)
+		{
+			BotBenchmarkMatchTemplates(buffer, numlines);
+			BotBenchmarkSynonyms(buffer, numlines);
+			FreeMemory(buffer);
+		} //end if
+	} //end if
 	//
 	if (!LibVarValue("nochat", "0"))
 	{
@@ -3151,10 +3904,14 @@ void BotShutdownChatAI(void)
 	} //end for
 	if (consolemessageheap) FreeMemory(consolemessageheap);
 	consolemessageheap = NULL;
+	if (matchautomaton) BotFreeMatchAutomaton(matchautomaton);
+	matchautomaton = NULL;
 	if (matchtemplates) BotFreeMatchTemplates(matchtemplates);
 	matchtemplates = NULL;
 	if (randomstrings) FreeMemory(randomstrings);
 	randomstrings = NULL;
+	if (synonymautomaton) BotFreeMatchAutomaton(synonymautomaton);
+	synonymautomaton = NULL;
 	if (synonyms) FreeMemory(synonyms);
 	synonyms = NULL;
 	if (replychats) BotFreeReplyChat(replychats);
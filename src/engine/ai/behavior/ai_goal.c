@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *****************************************************************************/
 
 #include "../../common/q_shared.h"
+#include "../../core/qcommon.h"
 #include "../util/utils.h"
 #include "../util/libvar.h"
 #include "../util/memory.h"
@@ -37,6 +38,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../util/script.h"
 #include "../util/precomp.h"
 #include "../util/struct.h"
+#include "../util/schedule.h"
 #include "../navigation/aasfile.h"
 #include "../ai_public.h"
 #include "../navigation/aas.h"
@@ -59,6 +61,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define AVOID_DROPPED_TIME		10
 //
 #define TRAVELTIME_SCALE		0.01
+//travel time lower bounds above this could overflow the 16 bit route travel times
+#define MAX_BOUNDEDTRAVELTIME	0x8000
+//maximum number of inventory indices the item weights are cached for
+#define MAX_WEIGHTINVENTORY		256
+//maximum number of item entities gathered around the level items without an entity
+#define MAX_NEARBYITEMENTITIES	256
 //item flags
 #define IFL_NOTFREE				1		//not in free for all
 #define IFL_NOTTEAM				2		//not in team play
@@ -160,6 +168,13 @@ typedef struct itemconfig_s
 	iteminfo_t *iteminfo;
 } itemconfig_t;
 
+//goal item ordered on the best weight it can have
+typedef struct goalitemorder_s
+{
+	float weight;						//weight with the travel time lower bound
+	int index;							//index in the goal items
+} goalitemorder_t;
+
 //goal state
 typedef struct bot_goalstate_s
 {
@@ -174,6 +189,20 @@ typedef struct bot_goalstate_s
 	//
 	int avoidgoals[MAX_AVOIDGOALS];				//goals to avoid
 	float avoidgoaltimes[MAX_AVOIDGOALS];		//times to avoid the goals
+	//
+	int itemgeneration;							//goal items the item cache was built for
+	int maxitems;								//size of the item cache arrays
+	float *itemweights;							//weight of every goal item
+	int *itemtimes;								//travel time lower bound of every goal item, -1 if not known
+	goalitemorder_t *itemorder;					//goal items sorted on their best possible weight
+	qboolean itemweightsvalid;					//true if the item weights are up to date
+	float itemdroppedweight;					//dropped item weight the weights were calculated with
+	int numweightinventory;						//number of inventory indices the weights use, -1 if too many
+	int weightinventory[MAX_WEIGHTINVENTORY];	//inventory indices the weights use
+	int weightinventoryvalues[MAX_WEIGHTINVENTORY];	//inventory the weights were calculated with
+	int itemtimesareanum;						//area the travel time lower bounds are from
+	int itemtimestravelflags;					//travel flags used for the travel time lower bounds
+	int itemtimesrouting;						//routing generation of the travel time lower bounds
 } bot_goalstate_t;
 
 static bot_goalstate_t *botgoalstates[MAX_CLIENTS + 1]; // FIXME: init?
@@ -192,6 +221,19 @@ static campspot_t *campspots = NULL;
 static int g_gametype = 0;
 //additional dropped item weight
 static libvar_t *droppedweight = NULL;
+//level items the bots can go for in this game type, shared by all goal states
+static levelitem_t **goalitems = NULL;
+static int numgoalitems = 0;
+static int maxgoalitems = 0;
+static int goalitemsgeneration = -1;
+//changes whenever a level item is added, removed, moved or linked to an entity
+static int levelitemsgeneration = 0;
+//0 = check all the items, 1 = incremental goal selection, 2 = incremental and verify
+static libvar_t *goalcache = NULL;
+static int goalcachechecks = 0;
+static int goalcachemismatches = 0;
+static int64_t goalcachelineartime = 0;
+static int64_t goalcachecachedtime = 0;
 
 //========================================================================
 //
@@ -214,6 +256,57 @@ bot_goalstate_t *BotGoalStateFromHandle(int handle)
 	return botgoalstates[handle];
 } //end of the function BotGoalStateFromHandle
 //===========================================================================
+static void BotFreeGoalItemCache(bot_goalstate_t *gs)
+{
+	if (gs->itemweights) FreeMemory(gs->itemweights);
+	if (gs->itemtimes) FreeMemory(gs->itemtimes);
+	if (gs->itemorder) FreeMemory(gs->itemorder);
+	gs->itemweights = NULL;
+	gs->itemtimes = NULL;
+	gs->itemorder = NULL;
+	gs->maxitems = 0;
+	gs->itemgeneration = -1;
+	gs->itemweightsvalid = qfalse;
+} //end of the function BotFreeGoalItemCache
+//===========================================================================
+static void BotWeightInventory_r(bot_goalstate_t *gs, const fuzzyseperator_t *fs)
+{
+	int i;
+
+	for (; fs && gs->numweightinventory >= 0; fs = fs->next)
+	{
+		for (i = 0; i < gs->numweightinventory; i++)
+		{
+			if (gs->weightinventory[i] == fs->index) break;
+		} //end for
+		if (i >= gs->numweightinventory)
+		{
+			if (gs->numweightinventory >= MAX_WEIGHTINVENTORY)
+			{
+				gs->numweightinventory = -1;
+				return;
+			} //end if
+			gs->weightinventory[gs->numweightinventory++] = fs->index;
+		} //end if
+		if (fs->child) BotWeightInventory_r(gs, fs->child);
+	} //end for
+} //end of the function BotWeightInventory_r
+//===========================================================================
+static void BotItemWeightsChanged(bot_goalstate_t *gs)
+{
+	int i;
+
+	gs->numweightinventory = 0;
+	if (gs->itemweightconfig)
+	{
+		for (i = 0; i < gs->itemweightconfig->numweights; i++)
+		{
+			BotWeightInventory_r(gs, gs->itemweightconfig->weights[i].firstseperator);
+		} //end for
+	} //end if
+	gs->itemweightsvalid = qfalse;
+} //end of the function BotItemWeightsChanged
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -221,7 +314,8 @@ bot_goalstate_t *BotGoalStateFromHandle(int handle)
 //===========================================================================
 void BotInterbreedGoalFuzzyLogic(int parent1, int parent2, int child)
 {
-	const bot_goalstate_t *p1, *p2, *c;
+	const bot_goalstate_t *p1, *p2;
+	bot_goalstate_t *c;
 
 	p1 = BotGoalStateFromHandle(parent1);
 	p2 = BotGoalStateFromHandle(parent2);
@@ -232,6 +326,7 @@ void BotInterbreedGoalFuzzyLogic(int parent1, int parent2, int child)
 
 	InterbreedWeightConfigs(p1->itemweightconfig, p2->itemweightconfig,
 									c->itemweightconfig);
+	BotItemWeightsChanged(c);
 } //end of the function BotInterbreedingGoalFuzzyLogic
 //===========================================================================
 //
@@ -262,6 +357,7 @@ void BotMutateGoalFuzzyLogic(int goalstate, float range)
 
 	if ( !gs ) return;
 	EvolveWeightConfig(gs->itemweightconfig);
+	BotItemWeightsChanged(gs);
 } //end of the function BotMutateGoalFuzzyLogic
 //===========================================================================
 //
@@ -288,7 +384,7 @@ static itemconfig_t *LoadItemConfig( const char *filename )
 
 	Q_strncpyz( path, filename, sizeof( path ) );
 	PC_SetBaseFolder(BOTFILESBASEFOLDER);
-	source = LoadSourceFile( path );
+	source = LoadSourceFileCached( path );
 	if( !source ) {
 		botimport.Print( PRT_ERROR, "couldn't load %s\n", path );
 		return NULL;
@@ -434,6 +530,7 @@ static void AddLevelItemToList(levelitem_t *li)
 	li->prev = NULL;
 	li->next = levelitems;
 	levelitems = li;
+	levelitemsgeneration++;
 } //end of the function AddLevelItemToList
 //===========================================================================
 //
@@ -446,6 +543,7 @@ static void RemoveLevelItemFromList(levelitem_t *li)
 	if (li->prev) li->prev->next = li->next;
 	else levelitems = li->next;
 	if (li->next) li->next->prev = li->prev;
+	levelitemsgeneration++;
 } //end of the function RemoveLevelItemFromList
 //===========================================================================
 //
@@ -556,6 +654,7 @@ void BotInitLevelItems(void)
 	InitLevelItemHeap();
 	levelitems = NULL;
 	numlevelitems = 0;
+	levelitemsgeneration++;
 	//
 	ic = itemconfig;
 	if (!ic) return;
@@ -1019,7 +1118,8 @@ static void BotFindEntityForLevelItem(levelitem_t *li)
 
 void BotUpdateEntityItems(void)
 {
-	int ent, i, modelindex;
+	int ent, i, modelindex, numnearby, allnearby;
+	int nearby[MAX_NEARBYITEMENTITIES];
 	vec3_t dir;
 	levelitem_t *li, *nextli;
 	aas_entityinfo_t entinfo;
@@ -1043,10 +1143,25 @@ void BotUpdateEntityItems(void)
 	//find new entity items
 	ic = itemconfig;
 	if (!itemconfig) return;
+	//gather the item entities that are close enough to be linked to a level item
+	//without an entity, slightly further out than the link distance
+	numnearby = 0;
+	allnearby = qfalse;
+	for (li = levelitems; li; li = li->next)
+	{
+		if (li->entitynum) continue;
+		numnearby += AAS_EntitiesInRadius(li->origin, 32, ET_ITEM, nearby + numnearby,
+											MAX_NEARBYITEMENTITIES - numnearby);
+		//if there might be more then every entity is tried
+		if (numnearby >= MAX_NEARBYITEMENTITIES)
+		{
+			allnearby = qtrue;
+			break;
+		} //end if
+	} //end for
 	//
-	for (ent = AAS_NextEntity(0); ent; ent = AAS_NextEntity(ent))
+	for (ent = AAS_NextEntityOfType(0, ET_ITEM); ent; ent = AAS_NextEntityOfType(ent, ET_ITEM))
 	{
-		if (AAS_EntityType(ent) != ET_ITEM) continue;
 		//get the model index of the entity
 		modelindex = AAS_EntityModelindex(ent);
 		//
@@ -1086,14 +1201,22 @@ void BotUpdateEntityItems(void)
 						li->goalareanum = AAS_BestReachableArea(li->origin,
 										ic->iteminfo[li->iteminfo].mins, ic->iteminfo[li->iteminfo].maxs,
 										li->goalorigin);
+						levelitemsgeneration++;
 					} //end if
 					break;
 				} //end else
 			} //end if
 		} //end for
 		if (li) continue;
+		//only an entity gathered above can be linked to a level item
+		li = NULL;
+		if (allnearby) li = levelitems;
+		for (i = 0; i < numnearby && !li; i++)
+		{
+			if (nearby[i] == ent) li = levelitems;
+		} //end for
 		//try to link the entity to a level item
-		for (li = levelitems; li; li = li->next)
+		for (; li; li = li->next)
 		{
 			//if this level item is already linked
 			if (li->entitynum) continue;
@@ -1116,6 +1239,7 @@ void BotUpdateEntityItems(void)
 				{
 					//found an entity for this level item
 					li->entitynum = ent;
+					levelitemsgeneration++;
 					//if the origin is different
 					if (entinfo.origin[0] != li->origin[0] ||
 						entinfo.origin[1] != li->origin[1] ||
@@ -1286,96 +1410,98 @@ int BotGetSecondGoal(int goalstate, bot_goal_t *goal)
 	return qtrue;
 } //end of the function BotGetSecondGoal
 //===========================================================================
-// pops a new long term goal on the goal stack in the goalstate
+// returns qtrue if bots can go for the level item in this game type
 //
 // Parameter:				-
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
+static qboolean BotGoalItemAvailable(const levelitem_t *li)
 {
-	int areanum, t, weightnum;
-	float weight, bestweight, avoidtime;
-	iteminfo_t *iteminfo;
-	itemconfig_t *ic;
-	levelitem_t *li, *bestitem;
-	bot_goal_t goal;
-	bot_goalstate_t *gs;
-
-	gs = BotGoalStateFromHandle(goalstate);
-	if (!gs)
-		return qfalse;
-	if (!gs->itemweightconfig)
+	if (g_gametype == GT_SINGLE_PLAYER) {
+		if (li->flags & IFL_NOTSINGLE)
+			return qfalse;
+	}
+	else if (g_gametype >= GT_TEAM) {
+		if (li->flags & IFL_NOTTEAM)
+			return qfalse;
+	}
+	else {
+		if (li->flags & IFL_NOTFREE)
+			return qfalse;
+	}
+	if (li->flags & IFL_NOTBOT)
 		return qfalse;
-	//get the area the bot is in
-	areanum = BotReachabilityArea(origin, gs->client);
-	//if the bot is in solid or if the area the bot is in has no reachability links
-	if (!areanum || !AAS_AreaReachability(areanum))
-	{
-		//use the last valid area the bot was in
-		areanum = gs->lastreachabilityarea;
-	} //end if
-	//remember the last area with reachabilities the bot was in
-	gs->lastreachabilityarea = areanum;
-	//if still in solid
-	if (!areanum)
+	//if the item is not in a possible goal area
+	if (!li->goalareanum)
 		return qfalse;
-	//the item configuration
-	ic = itemconfig;
-	if (!itemconfig)
+	//FIXME: is this a good thing? added this for items that never spawned into the game (f.i. CTF flags in obelisk)
+	if (!li->entitynum && !(li->flags & IFL_ROAM))
 		return qfalse;
+	return qtrue;
+} //end of the function BotGoalItemAvailable
+//===========================================================================
+// returns the weight of the level item without the travel time
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static float BotGoalItemWeight(const bot_goalstate_t *gs, const levelitem_t *li, int *inventory)
+{
+	int weightnum;
+	float weight;
+
+	//get the fuzzy weight function for this item
+	weightnum = gs->itemweightindex[itemconfig->iteminfo[li->iteminfo].number];
+	if (weightnum < 0)
+		return 0;
+#ifdef UNDECIDEDFUZZY
+	weight = FuzzyWeightUndecided(inventory, gs->itemweightconfig, weightnum);
+#else
+	weight = FuzzyWeight(inventory, gs->itemweightconfig, weightnum);
+#endif //UNDECIDEDFUZZY
+#ifdef DROPPEDWEIGHT
+	//HACK: to make dropped items more attractive
+	if (li->timeout)
+		weight += droppedweight->value;
+#endif //DROPPEDWEIGHT
+	//use weight scale for item_botroam
+	if (li->flags & IFL_ROAM) weight *= li->weight;
+	return weight;
+} //end of the function BotGoalItemWeight
+//===========================================================================
+// finds the best level item to go for by checking every item
+//
+// Parameter:				ltg			: long term goal to get back to or NULL
+//								ltg_time	: travel time towards the long term goal
+//								maxtime		: maximum travel time towards the item, -1 for no maximum
+// Returns:					the best item or NULL
+// Changes Globals:		-
+//===========================================================================
+static levelitem_t *BotFindGoalItemLinear(const bot_goalstate_t *gs, int goalstate, int areanum, vec3_t origin,
+							int *inventory, int travelflags, const bot_goal_t *ltg, int ltg_time, float maxtime)
+{
+	int t;
+	float weight, bestweight, avoidtime;
+	levelitem_t *li, *bestitem;
+
 	//best weight and item so far
 	bestweight = 0;
 	bestitem = NULL;
-	Com_Memset(&goal, 0, sizeof(bot_goal_t));
 	//go through the items in the level
 	for (li = levelitems; li; li = li->next)
 	{
-		if (g_gametype == GT_SINGLE_PLAYER) {
-			if (li->flags & IFL_NOTSINGLE)
-				continue;
-		}
-		else if (g_gametype >= GT_TEAM) {
-			if (li->flags & IFL_NOTTEAM)
-				continue;
-		}
-		else {
-			if (li->flags & IFL_NOTFREE)
-				continue;
-		}
-		if (li->flags & IFL_NOTBOT)
-			continue;
-		//if the item is not in a possible goal area
-		if (!li->goalareanum)
-			continue;
-		//FIXME: is this a good thing? added this for items that never spawned into the game (f.i. CTF flags in obelisk)
-		if (!li->entitynum && !(li->flags & IFL_ROAM))
-			continue;
-		//get the fuzzy weight function for this item
-		iteminfo = &ic->iteminfo[li->iteminfo];
-		weightnum = gs->itemweightindex[iteminfo->number];
-		if (weightnum < 0)
+		if (!BotGoalItemAvailable(li))
 			continue;
-
-#ifdef UNDECIDEDFUZZY
-		weight = FuzzyWeightUndecided(inventory, gs->itemweightconfig, weightnum);
-#else
-		weight = FuzzyWeight(inventory, gs->itemweightconfig, weightnum);
-#endif //UNDECIDEDFUZZY
-#ifdef DROPPEDWEIGHT
-		//HACK: to make dropped items more attractive
-		if (li->timeout)
-			weight += droppedweight->value;
-#endif //DROPPEDWEIGHT
-		//use weight scale for item_botroam
-		if (li->flags & IFL_ROAM) weight *= li->weight;
+		weight = BotGoalItemWeight(gs, li, inventory);
 		//
 		if (weight > 0)
 		{
 			//get the travel time towards the goal area
 			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
 			//if the goal is reachable
-			if (t > 0)
+			if (t > 0 && (maxtime < 0 || t < maxtime))
 			{
 				//if this item won't respawn before we get there
 				avoidtime = BotAvoidGoalTime(goalstate, li->number);
@@ -1385,13 +1511,317 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 				weight /= (float) t * TRAVELTIME_SCALE;
 				//
 				if (weight > bestweight)
+				{
+					t = 0;
+					if (ltg && !li->timeout)
+					{
+						//get the travel time from the goal to the long term goal
+						t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
+					} //end if
+					//if the travel back is possible and doesn't take too long
+					if (t <= ltg_time)
+					{
+						bestweight = weight;
+						bestitem = li;
+					} //end if
+				} //end if
+			} //end if
+		} //end if
+	} //end for
+	return bestitem;
+} //end of the function BotFindGoalItemLinear
+//===========================================================================
+// updates the list with level items bots can go for, the list is shared
+// by all the goal states and in the same order as the level items
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotUpdateGoalItems(void)
+{
+	levelitem_t *li;
+	int num;
+
+	if (goalitemsgeneration == levelitemsgeneration)
+		return;
+	num = 0;
+	for (li = levelitems; li; li = li->next) num++;
+	if (num > maxgoalitems)
+	{
+		if (goalitems) FreeMemory(goalitems);
+		maxgoalitems = num;
+		goalitems = (levelitem_t **) GetMemory(maxgoalitems * sizeof(levelitem_t *));
+	} //end if
+	numgoalitems = 0;
+	for (li = levelitems; li; li = li->next)
+	{
+		if (BotGoalItemAvailable(li))
+			goalitems[numgoalitems++] = li;
+	} //end for
+	goalitemsgeneration = levelitemsgeneration;
+} //end of the function BotUpdateGoalItems
+//===========================================================================
+// recalculates the item weights if the inventory they depend on changed
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotUpdateGoalItemWeights(bot_goalstate_t *gs, int *inventory)
+{
+	int i;
+
+	//undecided weights are random and are always recalculated
+#ifndef UNDECIDEDFUZZY
+	if (gs->itemweightsvalid && gs->numweightinventory >= 0 &&
+		gs->itemdroppedweight == droppedweight->value)
+	{
+		for (i = 0; i < gs->numweightinventory; i++)
+		{
+			if (inventory[gs->weightinventory[i]] != gs->weightinventoryvalues[i]) break;
+		} //end for
+		if (i >= gs->numweightinventory)
+			return;
+	} //end if
+#endif //UNDECIDEDFUZZY
+	for (i = 0; i < gs->numweightinventory; i++)
+	{
+		gs->weightinventoryvalues[i] = inventory[gs->weightinventory[i]];
+	} //end for
+	for (i = 0; i < numgoalitems; i++)
+	{
+		gs->itemweights[i] = BotGoalItemWeight(gs, goalitems[i], inventory);
+	} //end for
+	gs->itemdroppedweight = droppedweight->value;
+	gs->itemweightsvalid = qtrue;
+} //end of the function BotUpdateGoalItemWeights
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int BotGoalItemOrderCompare(const void *arg1, const void *arg2)
+{
+	const goalitemorder_t *o1 = (const goalitemorder_t *) arg1;
+	const goalitemorder_t *o2 = (const goalitemorder_t *) arg2;
+
+	if (o1->weight > o2->weight) return -1;
+	if (o1->weight < o2->weight) return 1;
+	return o1->index - o2->index;
+} //end of the function BotGoalItemOrderCompare
+//===========================================================================
+// finds the same item as BotFindGoalItemLinear but only calculates the
+// travel time from the bot origin for items that can still be the best
+//
+// The item weights are cached until the inventory they depend on changes.
+// The travel times from the bot area without the travel time within that
+// area are cached until the bot changes area and are a lower bound of the
+// travel times from the bot origin. The items are checked in order of the
+// best weight they can have so the search stops as soon as none of the
+// remaining items can beat the best one. Ties go to the item first in the
+// level item list just like with the linear search.
+//
+// Parameter:				-
+// Returns:					the best item or NULL
+// Changes Globals:		-
+//===========================================================================
+static levelitem_t *BotFindGoalItemCached(bot_goalstate_t *gs, int goalstate, int areanum, vec3_t origin,
+							int *inventory, int travelflags, const bot_goal_t *ltg, int ltg_time, float maxtime)
+{
+	int i, n, t, numorder, bestindex;
+	float weight, bestweight, avoidtime;
+	levelitem_t *li, *bestitem;
+	goalitemorder_t *order;
+
+	BotUpdateGoalItems();
+	//if the goal items changed
+	if (gs->itemgeneration != levelitemsgeneration)
+	{
+		if (numgoalitems > gs->maxitems)
+		{
+			BotFreeGoalItemCache(gs);
+			gs->maxitems = numgoalitems;
+			gs->itemweights = (float *) GetMemory(gs->maxitems * sizeof(float));
+			gs->itemtimes = (int *) GetMemory(gs->maxitems * sizeof(int));
+			gs->itemorder = (goalitemorder_t *) GetMemory(gs->maxitems * sizeof(goalitemorder_t));
+		} //end if
+		gs->itemgeneration = levelitemsgeneration;
+		gs->itemweightsvalid = qfalse;
+		gs->itemtimesareanum = 0;
+	} //end if
+	BotUpdateGoalItemWeights(gs, inventory);
+	//if the travel time lower bounds are no longer valid
+	if (gs->itemtimesareanum != areanum || gs->itemtimestravelflags != travelflags ||
+		gs->itemtimesrouting != AAS_RoutingGeneration())
+	{
+		for (i = 0; i < numgoalitems; i++) gs->itemtimes[i] = -1;
+		gs->itemtimesareanum = areanum;
+		gs->itemtimestravelflags = travelflags;
+		gs->itemtimesrouting = AAS_RoutingGeneration();
+	} //end if
+	//sort the items on the best weight they can have
+	numorder = 0;
+	for (i = 0; i < numgoalitems; i++)
+	{
+		if (gs->itemweights[i] <= 0)
+			continue;
+		if (gs->itemtimes[i] < 0)
+		{
+			gs->itemtimes[i] = AAS_AreaTravelTimeToGoalArea(areanum, NULL, goalitems[i]->goalareanum, travelflags);
+		} //end if
+		//if the goal is not reachable
+		if (gs->itemtimes[i] <= 0)
+			continue;
+		order = &gs->itemorder[numorder++];
+		order->index = i;
+		//every travel time is at least 1
+		t = gs->itemtimes[i] < MAX_BOUNDEDTRAVELTIME ? gs->itemtimes[i] : 1;
+		weight = gs->itemweights[i];
+		weight /= (float) t * TRAVELTIME_SCALE;
+		order->weight = weight;
+	} //end for
+	qsort(gs->itemorder, numorder, sizeof(goalitemorder_t), BotGoalItemOrderCompare);
+	//best weight and item so far
+	bestweight = 0;
+	bestitem = NULL;
+	bestindex = numgoalitems;
+	for (n = 0; n < numorder; n++)
+	{
+		order = &gs->itemorder[n];
+		//if none of the remaining items can beat the best item
+		if (bestitem && (order->weight < bestweight ||
+			(order->weight == bestweight && order->index > bestindex)))
+			break;
+		i = order->index;
+		li = goalitems[i];
+		//get the travel time towards the goal area
+		t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
+		//if the goal is reachable
+		if (t > 0 && (maxtime < 0 || t < maxtime))
+		{
+			//if this item won't respawn before we get there
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			if (avoidtime - t * 0.009 > 0)
+				continue;
+			//
+			weight = gs->itemweights[i];
+			weight /= (float) t * TRAVELTIME_SCALE;
+			//
+			if (weight > bestweight || (bestitem && weight == bestweight && i < bestindex))
+			{
+				t = 0;
+				if (ltg && !li->timeout)
+				{
+					//get the travel time from the goal to the long term goal
+					t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
+				} //end if
+				//if the travel back is possible and doesn't take too long
+				if (t <= ltg_time)
 				{
 					bestweight = weight;
 					bestitem = li;
+					bestindex = i;
 				} //end if
 			} //end if
 		} //end if
 	} //end for
+	return bestitem;
+} //end of the function BotFindGoalItemCached
+//===========================================================================
+// finds the best level item to go for, with bot_goalcache 2 the incremental
+// search is verified against the linear search
+//
+// Parameter:				-
+// Returns:					the best item or NULL
+// Changes Globals:		-
+//===========================================================================
+static levelitem_t *BotFindGoalItem(bot_goalstate_t *gs, int goalstate, int areanum, vec3_t origin,
+							int *inventory, int travelflags, const bot_goal_t *ltg, int ltg_time, float maxtime)
+{
+	levelitem_t *linearitem, *cacheditem;
+	int64_t starttime;
+	int seed;
+
+	if (goalcache->value <= 0)
+	{
+		return BotFindGoalItemLinear(gs, goalstate, areanum, origin, inventory, travelflags, ltg, ltg_time, maxtime);
+	} //end if
+	if (goalcache->value >= 2)
+	{
+		//both searches get the same undecided fuzzy weights
+		seed = rand();
+		srand(seed);
+		starttime = Sys_Microseconds();
+		linearitem = BotFindGoalItemLinear(gs, goalstate, areanum, origin, inventory, travelflags, ltg, ltg_time, maxtime);
+		goalcachelineartime += Sys_Microseconds() - starttime;
+		srand(seed);
+		starttime = Sys_Microseconds();
+		cacheditem = BotFindGoalItemCached(gs, goalstate, areanum, origin, inventory, travelflags, ltg, ltg_time, maxtime);
+		goalcachecachedtime += Sys_Microseconds() - starttime;
+		if (cacheditem != linearitem)
+		{
+			goalcachemismatches++;
+		} //end if
+		if (++goalcachechecks >= 1000)
+		{
+			botimport.Print(PRT_MESSAGE, "goal cache: %d goals, %d mismatches, linear %d usec, cached %d usec\n",
+							goalcachechecks, goalcachemismatches, (int) goalcachelineartime, (int) goalcachecachedtime);
+			goalcachechecks = 0;
+			goalcachemismatches = 0;
+			goalcachelineartime = 0;
+			goalcachecachedtime = 0;
+		} //end if
+		return linearitem;
+	} //end if
+	return BotFindGoalItemCached(gs, goalstate, areanum, origin, inventory, travelflags, ltg, ltg_time, maxtime);
+} //end of the function BotFindGoalItem
+//===========================================================================
+// pops a new long term goal on the goal stack in the goalstate
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
+{
+	int areanum;
+	float avoidtime;
+	iteminfo_t *iteminfo;
+	itemconfig_t *ic;
+	levelitem_t *bestitem;
+	bot_goal_t goal;
+	bot_goalstate_t *gs;
+
+	gs = BotGoalStateFromHandle(goalstate);
+	if (!gs)
+		return qfalse;
+	if (!gs->itemweightconfig)
+		return qfalse;
+	//get the area the bot is in
+	areanum = BotReachabilityArea(origin, gs->client);
+	//if the bot is in solid or if the area the bot is in has no reachability links
+	if (!areanum || !AAS_AreaReachability(areanum))
+	{
+		//use the last valid area the bot was in
+		areanum = gs->lastreachabilityarea;
+	} //end if
+	//remember the last area with reachabilities the bot was in
+	gs->lastreachabilityarea = areanum;
+	//if still in solid
+	if (!areanum)
+		return qfalse;
+	//the item configuration
+	ic = itemconfig;
+	if (!itemconfig)
+		return qfalse;
+	//find the best item to go for
+	Com_Memset(&goal, 0, sizeof(bot_goal_t));
+	//the caller reads qfalse as no goal at all so this is never deferred
+	BotScheduleWork(BOTTASK_LTG, 1);
+	bestitem = BotFindGoalItem(gs, goalstate, areanum, origin, inventory, travelflags, NULL, 0, -1);
+	BotScheduleTaskDone(BOTTASK_LTG);
 	//if no goal item found
 	if (!bestitem)
 	{
@@ -1462,11 +1892,11 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelflags,
 														bot_goal_t *ltg, float maxtime)
 {
-	int areanum, t, weightnum, ltg_time;
-	float weight, bestweight, avoidtime;
+	int areanum, ltg_time;
+	float avoidtime;
 	iteminfo_t *iteminfo;
 	itemconfig_t *ic;
-	levelitem_t *li, *bestitem;
+	levelitem_t *bestitem;
 	bot_goal_t goal;
 	bot_goalstate_t *gs;
 
@@ -1495,84 +1925,13 @@ int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	ic = itemconfig;
 	if (!itemconfig)
 		return qfalse;
-	//best weight and item so far
-	bestweight = 0;
-	bestitem = NULL;
+	//find the best item to go for
 	Com_Memset(&goal, 0, sizeof(bot_goal_t));
-	//go through the items in the level
-	for (li = levelitems; li; li = li->next)
-	{
-		if (g_gametype == GT_SINGLE_PLAYER) {
-			if (li->flags & IFL_NOTSINGLE)
-				continue;
-		}
-		else if (g_gametype >= GT_TEAM) {
-			if (li->flags & IFL_NOTTEAM)
-				continue;
-		}
-		else {
-			if (li->flags & IFL_NOTFREE)
-				continue;
-		}
-		if (li->flags & IFL_NOTBOT)
-			continue;
-		//if the item is in a possible goal area
-		if (!li->goalareanum)
-			continue;
-		//FIXME: is this a good thing? added this for items that never spawned into the game (f.i. CTF flags in obelisk)
-		if (!li->entitynum && !(li->flags & IFL_ROAM))
-			continue;
-		//get the fuzzy weight function for this item
-		iteminfo = &ic->iteminfo[li->iteminfo];
-		weightnum = gs->itemweightindex[iteminfo->number];
-		if (weightnum < 0)
-			continue;
-		//
-#ifdef UNDECIDEDFUZZY
-		weight = FuzzyWeightUndecided(inventory, gs->itemweightconfig, weightnum);
-#else
-		weight = FuzzyWeight(inventory, gs->itemweightconfig, weightnum);
-#endif //UNDECIDEDFUZZY
-#ifdef DROPPEDWEIGHT
-		//HACK: to make dropped items more attractive
-		if (li->timeout)
-			weight += droppedweight->value;
-#endif //DROPPEDWEIGHT
-		//use weight scale for item_botroam
-		if (li->flags & IFL_ROAM) weight *= li->weight;
-		//
-		if (weight > 0)
-		{
-			//get the travel time towards the goal area
-			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
-			//if the goal is reachable
-			if (t > 0 && t < maxtime)
-			{
-				//if this item won't respawn before we get there
-				avoidtime = BotAvoidGoalTime(goalstate, li->number);
-				if (avoidtime - t * 0.009 > 0)
-					continue;
-				//
-				weight /= (float) t * TRAVELTIME_SCALE;
-				//
-				if (weight > bestweight)
-				{
-					t = 0;
-					if (ltg && !li->timeout)
-					{
-						//get the travel time from the goal to the long term goal
-						t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
-					} //end if
-					//if the travel back is possible and doesn't take too long
-					if (t <= ltg_time)
-					{
-						bestweight = weight;
-						bestitem = li;
-					} //end if
-				} //end if
-			} //end if
-		} //end if
-	} //end for
+	//without budget left the bot keeps going for its long term goal
+	if (!BotScheduleTask(BOTTASK_NBG, goalstate))
+		return qfalse;
+	bestitem = BotFindGoalItem(gs, goalstate, areanum, origin, inventory, travelflags, ltg, ltg_time, maxtime);
+	BotScheduleTaskDone(BOTTASK_NBG);
 	//if no goal item found
 	if (!bestitem)
 		return qfalse;
@@ -1715,6 +2074,7 @@ int BotLoadItemWeights(int goalstate, const char *filename)
 	if (!itemconfig) return BLERR_CANNOTLOADITEMWEIGHTS;
 	//create the item weight index
 	gs->itemweightindex = ItemWeightIndex(gs->itemweightconfig, itemconfig);
+	BotItemWeightsChanged(gs);
 	//everything went ok
 	return BLERR_NOERROR;
 } //end of the function BotLoadItemWeights
@@ -1732,6 +2092,7 @@ void BotFreeItemWeights(int goalstate)
 	if (!gs) return;
 	if (gs->itemweightconfig) FreeWeightConfig(gs->itemweightconfig);
 	if (gs->itemweightindex) FreeMemory(gs->itemweightindex);
+	BotFreeGoalItemCache(gs);
 } //end of the function BotFreeItemWeights
 //===========================================================================
 //
@@ -1749,6 +2110,7 @@ int BotAllocGoalState(int client)
 		{
 			botgoalstates[i] = GetClearedMemory(sizeof(bot_goalstate_t));
 			botgoalstates[i]->client = client;
+			botgoalstates[i]->itemgeneration = -1;
 			return i;
 		} //end if
 	} //end for
@@ -1799,6 +2161,7 @@ int BotSetupGoalAI(void)
 	} //end if
 	//
 	droppedweight = LibVar("droppedweight", "1000");
+	goalcache = LibVar("bot_goalcache", "1");
 	//everything went ok
 	return BLERR_NOERROR;
 } //end of the function BotSetupGoalAI
@@ -1819,6 +2182,11 @@ void BotShutdownGoalAI(void)
 	freelevelitems = NULL;
 	levelitems = NULL;
 	numlevelitems = 0;
+	if (goalitems) FreeMemory(goalitems);
+	goalitems = NULL;
+	numgoalitems = 0;
+	maxgoalitems = 0;
+	goalitemsgeneration = -1;
 
 	BotFreeInfoEntities();
 
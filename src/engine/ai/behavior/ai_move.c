@@ -2503,15 +2503,13 @@ static int GrappleState(bot_movestate_t *ms, aas_reachability_t *reach)
 		return 2;
 	//check for a visible grapple missile entity
 	//or visible grapple entity
-	for (i = AAS_NextEntity(0); i; i = AAS_NextEntity(i))
+	for (i = AAS_NextEntityOfType(0, (int) entitytypemissile->value); i;
+			i = AAS_NextEntityOfType(i, (int) entitytypemissile->value))
 	{
-		if (AAS_EntityType(i) == (int) entitytypemissile->value)
+		AAS_EntityInfo(i, &entinfo);
+		if (entinfo.weapon == (int) weapindex_grapple->value)
 		{
-			AAS_EntityInfo(i, &entinfo);
-			if (entinfo.weapon == (int) weapindex_grapple->value)
-			{
-				return 1;
-			} //end if
+			return 1;
 		} //end if
 	} //end for
 	//no valid grapple at all
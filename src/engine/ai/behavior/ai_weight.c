@@ -46,6 +46,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define MAX_INVENTORYVALUE			999999
 #define EVALUATERECURSIVELY
+#define EVALUATEFLATTENED
 
 #define MAX_WEIGHT_FILES			128
 static weightconfig_t	*weightFileList[MAX_WEIGHT_FILES];
@@ -138,6 +139,7 @@ static void FreeWeightConfig2(weightconfig_t *config)
 		FreeFuzzySeperators_r(config->weights[i].firstseperator);
 		if (config->weights[i].name) FreeMemory(config->weights[i].name);
 	} //end for
+	if (config->flat) FreeMemory(config->flat);
 	FreeMemory(config);
 } //end of the function FreeWeightConfig2
 //===========================================================================
@@ -282,6 +284,101 @@ static fuzzyseperator_t *ReadFuzzySeperators_r(source_t *source)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+static void CountFuzzySeperators_r(fuzzyseperator_t *fs, int *numswitches, int *numcases)
+{
+	(*numswitches)++;
+	for (; fs; fs = fs->next)
+	{
+		(*numcases)++;
+		if (fs->child) CountFuzzySeperators_r(fs->child, numswitches, numcases);
+	} //end for
+} //end of the function CountFuzzySeperators_r
+//===========================================================================
+// stores the separator list as a switch with consecutive cases and
+// returns the switch number
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int FlattenFuzzySeperators_r(fuzzyweights_t *fw, fuzzyseperator_t *firstfs)
+{
+	fuzzyswitch_t *sw;
+	fuzzyseperator_t *fs;
+	int s, c;
+
+	s = fw->numswitches++;
+	sw = &fw->switches[s];
+	sw->index = firstfs->index;
+	sw->firstcase = fw->numcases;
+	sw->numcases = 0;
+	for (fs = firstfs; fs; fs = fs->next) sw->numcases++;
+	fw->numcases += sw->numcases;
+	//the cases of the switch are stored before those of the child switches
+	for (fs = firstfs, c = sw->firstcase; fs; fs = fs->next, c++)
+	{
+		fw->values[c] = fs->value;
+		fw->weight[c] = fs->weight;
+		fw->minweight[c] = fs->minweight;
+		fw->maxweight[c] = fs->maxweight;
+		if (fs->child) fw->child[c] = FlattenFuzzySeperators_r(fw, fs->child);
+		else fw->child[c] = -1;
+	} //end for
+	return s;
+} //end of the function FlattenFuzzySeperators_r
+//===========================================================================
+// (re)builds the flattened weights, must be called whenever the
+// separators of the weight configuration change
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void FlattenWeightConfig(weightconfig_t *config)
+{
+	fuzzyweights_t *fw;
+	int i, numswitches, numcases;
+	char *ptr;
+
+	if (config->flat) FreeMemory(config->flat);
+	config->flat = NULL;
+	//
+	numswitches = 0;
+	numcases = 0;
+	for (i = 0; i < config->numweights; i++)
+	{
+		if (!config->weights[i].firstseperator) return;
+		CountFuzzySeperators_r(config->weights[i].firstseperator, &numswitches, &numcases);
+	} //end for
+	//everything is stored in a single block
+	ptr = (char *) GetClearedMemory(sizeof(fuzzyweights_t) + numswitches * sizeof(fuzzyswitch_t) +
+										numcases * (2 * sizeof(int) + 3 * sizeof(float)));
+	fw = (fuzzyweights_t *) ptr;
+	ptr += sizeof(fuzzyweights_t);
+	fw->switches = (fuzzyswitch_t *) ptr;
+	ptr += numswitches * sizeof(fuzzyswitch_t);
+	fw->values = (int *) ptr;
+	ptr += numcases * sizeof(int);
+	fw->child = (int *) ptr;
+	ptr += numcases * sizeof(int);
+	fw->weight = (float *) ptr;
+	ptr += numcases * sizeof(float);
+	fw->minweight = (float *) ptr;
+	ptr += numcases * sizeof(float);
+	fw->maxweight = (float *) ptr;
+	//
+	for (i = 0; i < config->numweights; i++)
+	{
+		fw->rootswitch[i] = FlattenFuzzySeperators_r(fw, config->weights[i].firstseperator);
+	} //end for
+	config->flat = fw;
+} //end of the function FlattenWeightConfig
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 weightconfig_t *ReadWeightConfig(const char *filename)
 {
 	int newindent, avail = 0, n;
@@ -324,7 +421,7 @@ weightconfig_t *ReadWeightConfig(const char *filename)
 	} //end if
 
 	PC_SetBaseFolder(BOTFILESBASEFOLDER);
-	source = LoadSourceFile(filename);
+	source = LoadSourceFileCached(filename);
 	if (!source)
 	{
 		botimport.Print(PRT_ERROR, "couldn't load %s\n", filename);
@@ -425,8 +522,10 @@ weightconfig_t *ReadWeightConfig(const char *filename)
 	} //end while
 	//free the source at the end of a pass
 	FreeSource(source);
+	FlattenWeightConfig(config);
 	//if the file was located in a pak file
 	botimport.Print(PRT_MESSAGE, "loaded %s\n", filename);
+	if (LibVarGetValue("bot_weightbenchmark")) BenchmarkWeightConfig(config);
 #ifdef DEBUG
 	if (botDeveloper)
 	{
@@ -648,6 +747,87 @@ static float FuzzyWeightUndecided_r(int *inventory, fuzzyseperator_t *fs)
 	return fs->weight;
 } //end of the function FuzzyWeightUndecided_r
 //===========================================================================
+// evaluates the flattened switch the same way FuzzyWeight_r evaluates the
+// separator list: the first case with a breakpoint above the inventory
+// value is interpolated with the case before it
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static float FuzzyWeightFlat_r(const int *inventory, const fuzzyweights_t *fw, int s)
+{
+	const fuzzyswitch_t *sw;
+	const int *values;
+	int inv, i, c;
+	float scale, w1, w2;
+
+	sw = &fw->switches[s];
+	inv = inventory[sw->index];
+	values = &fw->values[sw->firstcase];
+	for (i = 0; i < sw->numcases; i++)
+	{
+		if (inv < values[i]) break;
+	} //end for
+	//past all the breakpoints
+	if (i >= sw->numcases) return fw->weight[sw->firstcase + sw->numcases - 1];
+	c = sw->firstcase + i;
+	//below the first breakpoint or can't interpolate with the default case
+	if (i == 0 || values[i] == MAX_INVENTORYVALUE)
+	{
+		if (fw->child[c] >= 0) return FuzzyWeightFlat_r(inventory, fw, fw->child[c]);
+		return fw->weight[c];
+	} //end if
+	//first weight
+	if (fw->child[c-1] >= 0) w1 = FuzzyWeightFlat_r(inventory, fw, fw->child[c-1]);
+	else w1 = fw->weight[c-1];
+	//second weight
+	if (fw->child[c] >= 0) w2 = FuzzyWeightFlat_r(inventory, fw, fw->child[c]);
+	else w2 = fw->weight[c];
+	//scale between the two weights
+	scale = (float) (inv - values[i-1]) / (values[i] - values[i-1]);
+	return (1 - scale) * w1 + scale * w2;
+} //end of the function FuzzyWeightFlat_r
+//===========================================================================
+// same as FuzzyWeightUndecided_r, random numbers are drawn in the same order
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static float FuzzyWeightUndecidedFlat_r(const int *inventory, const fuzzyweights_t *fw, int s)
+{
+	const fuzzyswitch_t *sw;
+	const int *values;
+	int inv, i, c;
+	float scale, w1, w2;
+
+	sw = &fw->switches[s];
+	inv = inventory[sw->index];
+	values = &fw->values[sw->firstcase];
+	for (i = 0; i < sw->numcases; i++)
+	{
+		if (inv < values[i]) break;
+	} //end for
+	if (i >= sw->numcases) return fw->weight[sw->firstcase + sw->numcases - 1];
+	c = sw->firstcase + i;
+	if (i == 0)
+	{
+		if (fw->child[c] >= 0) return FuzzyWeightUndecidedFlat_r(inventory, fw, fw->child[c]);
+		return fw->minweight[c] + random() * (fw->maxweight[c] - fw->minweight[c]);
+	} //end if
+	//first weight, also drawn when the second is the default case
+	if (fw->child[c-1] >= 0) w1 = FuzzyWeightUndecidedFlat_r(inventory, fw, fw->child[c-1]);
+	else w1 = fw->minweight[c-1] + random() * (fw->maxweight[c-1] - fw->minweight[c-1]);
+	//second weight
+	if (fw->child[c] >= 0) w2 = FuzzyWeightFlat_r(inventory, fw, fw->child[c]);
+	else w2 = fw->minweight[c] + random() * (fw->maxweight[c] - fw->minweight[c]);
+	if (values[i] == MAX_INVENTORYVALUE) return w2;
+	//scale between the two weights
+	scale = (float) (inv - values[i-1]) / (values[i] - values[i-1]);
+	return (1 - scale) * w1 + scale * w2;
+} //end of the function FuzzyWeightUndecidedFlat_r
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -655,6 +835,9 @@ static float FuzzyWeightUndecided_r(int *inventory, fuzzyseperator_t *fs)
 //===========================================================================
 float FuzzyWeight(int *inventory, weightconfig_t *wc, int weightnum)
 {
+#ifdef EVALUATEFLATTENED
+	if (wc->flat) return FuzzyWeightFlat_r(inventory, wc->flat, wc->flat->rootswitch[weightnum]);
+#endif //EVALUATEFLATTENED
 #ifdef EVALUATERECURSIVELY
 	return FuzzyWeight_r(inventory, wc->weights[weightnum].firstseperator);
 #else
@@ -686,6 +869,9 @@ float FuzzyWeight(int *inventory, weightconfig_t *wc, int weightnum)
 //===========================================================================
 float FuzzyWeightUndecided(int *inventory, weightconfig_t *wc, int weightnum)
 {
+#ifdef EVALUATEFLATTENED
+	if (wc->flat) return FuzzyWeightUndecidedFlat_r(inventory, wc->flat, wc->flat->rootswitch[weightnum]);
+#endif //EVALUATEFLATTENED
 #ifdef EVALUATERECURSIVELY
 	return FuzzyWeightUndecided_r(inventory, wc->weights[weightnum].firstseperator);
 #else
@@ -710,6 +896,146 @@ float FuzzyWeightUndecided(int *inventory, weightconfig_t *wc, int weightnum)
 #endif
 } //end of the function FuzzyWeightUndecided
 //===========================================================================
+// stores the fuzzy weight of every weight number in the list, negative
+// weight numbers get a zero weight
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void FuzzyWeights(int *inventory, weightconfig_t *wc, const int *weightnums, float *weights, int numweights)
+{
+	const fuzzyweights_t *fw;
+	int i;
+
+	fw = wc->flat;
+	for (i = 0; i < numweights; i++)
+	{
+		if (weightnums[i] < 0) weights[i] = 0;
+		else if (fw) weights[i] = FuzzyWeightFlat_r(inventory, fw, fw->rootswitch[weightnums[i]]);
+		else weights[i] = FuzzyWeight(inventory, wc, weightnums[i]);
+	} //end for
+} //end of the function FuzzyWeights
+//===========================================================================
+// the weights are evaluated in list order so the random numbers drawn
+// are the same as when calling FuzzyWeightUndecided for every weight
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void FuzzyWeightsUndecided(int *inventory, weightconfig_t *wc, const int *weightnums, float *weights, int numweights)
+{
+	const fuzzyweights_t *fw;
+	int i;
+
+	fw = wc->flat;
+	for (i = 0; i < numweights; i++)
+	{
+		if (weightnums[i] < 0) weights[i] = 0;
+		else if (fw) weights[i] = FuzzyWeightUndecidedFlat_r(inventory, fw, fw->rootswitch[weightnums[i]]);
+		else weights[i] = FuzzyWeightUndecided(inventory, wc, weightnums[i]);
+	} //end for
+} //end of the function FuzzyWeightsUndecided
+//===========================================================================
+// evaluates every weight for random inventories with both the recursive
+// and the flattened evaluator, verifies the results are the same and
+// prints the time taken by each
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+#define WEIGHTBENCHMARK_INVENTORIES		256
+#define WEIGHTBENCHMARK_PASSES			100
+#define WEIGHTBENCHMARK_EPSILON			0.001f
+
+void BenchmarkWeightConfig(weightconfig_t *config)
+{
+	int i, n, pass, maxindex, maxvalue, mismatches, starttime, recursivetime, flattime, batchtime;
+	int *inventories, *inventory, weightnums[MAX_WEIGHTS];
+	float w1, w2, weights[MAX_WEIGHTS];
+	fuzzyweights_t *fw;
+
+	fw = config->flat;
+	if (!fw || !config->numweights) return;
+	//random inventories around the breakpoints of the cases
+	maxindex = 0;
+	maxvalue = 1;
+	for (i = 0; i < fw->numswitches; i++)
+	{
+		if (fw->switches[i].index > maxindex) maxindex = fw->switches[i].index;
+	} //end for
+	for (i = 0; i < fw->numcases; i++)
+	{
+		if (fw->values[i] != MAX_INVENTORYVALUE && fw->values[i] > maxvalue) maxvalue = fw->values[i];
+	} //end for
+	inventories = (int *) GetMemory(WEIGHTBENCHMARK_INVENTORIES * (maxindex + 1) * sizeof(int));
+	for (i = 0; i < WEIGHTBENCHMARK_INVENTORIES * (maxindex + 1); i++)
+	{
+		inventories[i] = rand() % (maxvalue + maxvalue / 4 + 2);
+	} //end for
+	for (i = 0; i < config->numweights; i++) weightnums[i] = i;
+	//verify the flattened weights
+	mismatches = 0;
+	for (n = 0; n < WEIGHTBENCHMARK_INVENTORIES; n++)
+	{
+		inventory = &inventories[n * (maxindex + 1)];
+		for (i = 0; i < config->numweights; i++)
+		{
+			w1 = FuzzyWeight_r(inventory, config->weights[i].firstseperator);
+			w2 = FuzzyWeightFlat_r(inventory, fw, fw->rootswitch[i]);
+			if (fabs(w1 - w2) > WEIGHTBENCHMARK_EPSILON * (1 + fabs(w1))) mismatches++;
+			srand(n * MAX_WEIGHTS + i);
+			w1 = FuzzyWeightUndecided_r(inventory, config->weights[i].firstseperator);
+			srand(n * MAX_WEIGHTS + i);
+			w2 = FuzzyWeightUndecidedFlat_r(inventory, fw, fw->rootswitch[i]);
+			if (fabs(w1 - w2) > WEIGHTBENCHMARK_EPSILON * (1 + fabs(w1))) mismatches++;
+		} //end for
+	} //end for
+	//time the recursive, flattened and batch evaluation
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < WEIGHTBENCHMARK_PASSES; pass++)
+	{
+		for (n = 0; n < WEIGHTBENCHMARK_INVENTORIES; n++)
+		{
+			inventory = &inventories[n * (maxindex + 1)];
+			for (i = 0; i < config->numweights; i++)
+			{
+				weights[i] = FuzzyWeight_r(inventory, config->weights[i].firstseperator);
+			} //end for
+		} //end for
+	} //end for
+	recursivetime = Sys_MilliSeconds() - starttime;
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < WEIGHTBENCHMARK_PASSES; pass++)
+	{
+		for (n = 0; n < WEIGHTBENCHMARK_INVENTORIES; n++)
+		{
+			inventory = &inventories[n * (maxindex + 1)];
+			for (i = 0; i < config->numweights; i++)
+			{
+				weights[i] = FuzzyWeight(inventory, config, i);
+			} //end for
+		} //end for
+	} //end for
+	flattime = Sys_MilliSeconds() - starttime;
+	starttime = Sys_MilliSeconds();
+	for (pass = 0; pass < WEIGHTBENCHMARK_PASSES; pass++)
+	{
+		for (n = 0; n < WEIGHTBENCHMARK_INVENTORIES; n++)
+		{
+			FuzzyWeights(&inventories[n * (maxindex + 1)], config, weightnums, weights, config->numweights);
+		} //end for
+	} //end for
+	batchtime = Sys_MilliSeconds() - starttime;
+	FreeMemory(inventories);
+	//
+	botimport.Print(PRT_MESSAGE, "%s: %d weights, %d switches, %d cases, %d inventories: recursive %d msec, "
+						"flattened %d msec, batch %d msec, %d mismatches\n", config->filename, config->numweights,
+						fw->numswitches, fw->numcases, WEIGHTBENCHMARK_INVENTORIES * WEIGHTBENCHMARK_PASSES, recursivetime, flattime, batchtime, mismatches);
+} //end of the function BenchmarkWeightConfig
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -746,6 +1072,7 @@ void EvolveWeightConfig(weightconfig_t *config)
 	{
 		EvolveFuzzySeperator_r(config->weights[i].firstseperator);
 	} //end for
+	FlattenWeightConfig(config);
 } //end of the function EvolveWeightConfig
 //===========================================================================
 //
@@ -789,6 +1116,7 @@ void ScaleWeight(weightconfig_t *config, char *name, float scale)
 			break;
 		} //end if
 	} //end for
+	FlattenWeightConfig(config);
 } //end of the function ScaleWeight
 //===========================================================================
 //
@@ -831,6 +1159,7 @@ void ScaleFuzzyBalanceRange(weightconfig_t *config, float scale)
 	{
 		ScaleFuzzySeperatorBalanceRange_r(config->weights[i].firstseperator, scale);
 	} //end for
+	FlattenWeightConfig(config);
 } //end of the function ScaleFuzzyBalanceRange
 //===========================================================================
 //
@@ -902,6 +1231,7 @@ void InterbreedWeightConfigs(weightconfig_t *config1, weightconfig_t *config2,
 									config2->weights[i].firstseperator,
 									configout->weights[i].firstseperator);
 	} //end for
+	FlattenWeightConfig(configout);
 } //end of the function InterbreedWeightConfigs
 //===========================================================================
 //
@@ -52,11 +52,34 @@ typedef struct weight_s
 	struct fuzzyseperator_s *firstseperator;
 } weight_t;
 
+//switch of the flattened fuzzy weights
+typedef struct fuzzyswitch_s
+{
+	int index;							//inventory index
+	int firstcase;						//first case in the case arrays
+	int numcases;						//number of cases including the default
+} fuzzyswitch_t;
+
+//fuzzy weights flattened into arrays, the cases of a switch are consecutive
+typedef struct fuzzyweights_s
+{
+	int numswitches;
+	fuzzyswitch_t *switches;
+	int numcases;
+	int *values;						//case breakpoints
+	int *child;							//child switch of a case or -1
+	float *weight;
+	float *minweight;
+	float *maxweight;
+	int rootswitch[MAX_WEIGHTS];		//first switch of every weight
+} fuzzyweights_t;
+
 //weight configuration
 typedef struct weightconfig_s
 {
 	int numweights;
 	weight_t weights[MAX_WEIGHTS];
+	fuzzyweights_t *flat;				//flattened copy of the weights used for evaluation
 	char		filename[MAX_QPATH];
 } weightconfig_t;
 
@@ -71,6 +94,11 @@ int FindFuzzyWeight(const weightconfig_t *wc, const char *name);
 //returns the fuzzy weight for the given inventory and weight
 float FuzzyWeight(int *inventory, weightconfig_t *wc, int weightnum);
 float FuzzyWeightUndecided(int *inventory, weightconfig_t *wc, int weightnum);
+//stores the fuzzy weights of all the given weight numbers for the same inventory
+void FuzzyWeights(int *inventory, weightconfig_t *wc, const int *weightnums, float *weights, int numweights);
+void FuzzyWeightsUndecided(int *inventory, weightconfig_t *wc, const int *weightnums, float *weights, int numweights);
+//verifies and times the flattened weights against the recursive evaluation
+void BenchmarkWeightConfig(weightconfig_t *config);
 //scales the weight with the given name
 void ScaleWeight(weightconfig_t *config, char *name, float scale);
 //scale the balance range
@@ -188,6 +188,24 @@ typedef struct aas_clientmove_s
 	int frames;				//number of frames predicted ahead
 } aas_clientmove_t;
 
+//parameters of a movement prediction
+typedef struct aas_predictmove_s
+{
+	int entnum;							//entity to ignore
+	vec3_t origin;						//origin to start with
+	int presencetype;					//presence type to start with
+	int onground;						//true if starting on the ground
+	vec3_t velocity;					//velocity to start with
+	vec3_t cmdmove;						//client command movement
+	int cmdframes;						//number of frames cmdmove is valid
+	int maxframes;						//maximum number of predicted frames
+	float frametime;					//duration of one predicted frame
+	int stopevent;						//events that stop the prediction
+	int stopareanum;					//area for SE_ENTERAREA and SE_HITGROUNDAREA
+	vec3_t mins, maxs;					//bounding box for SE_HITBOUNDINGBOX
+	int visualize;						//show the predicted movement
+} aas_predictmove_t;
+
 // alternate route goals
 #define ALTROUTEGOAL_ALL				1
 #define ALTROUTEGOAL_CLUSTERPORTALS		2
@@ -80,8 +80,16 @@ typedef struct aas_entity_s
 	aas_link_t *areas;
 	//links into the BSP leaves
 	bsp_link_t *leaves;
+	//cell of the entity index the entity is stored in, -1 if none
+	int cell;
+	int cellx, celly;
+	int nextincell, previncell;
 } aas_entity_t;
 
+#define AAS_MAX_INDEXEDENTITYTYPES	32		//entity types with their own set in the entity index
+#define AAS_ENTITYCELLS				1024	//number of hashed cells in the entity index, power of two
+#define AAS_ENTITYCELL_SIZE			256		//size of an entity index cell in units
+
 typedef struct aas_settings_s
 {
 	vec3_t phys_gravitydirection;
@@ -222,6 +230,13 @@ typedef struct aas_s
 	//nodes of the bsp tree
 	int numnodes;
 	aas_node_t *nodes;
+	//grid with the deepest node that holds each cell on one side of all its parents
+	int *pointgrid;
+	int pointgridsize[3];
+	float pointgridcellsize;
+	vec3_t pointgridmins;
+	int *nodeparents;							//parent of every node, -1 if the tree is shared
+	int *nodedepths;							//depth of every node in the tree
 	//cluster portals
 	int numportals;
 	aas_portal_t *portals;
@@ -243,6 +258,12 @@ typedef struct aas_s
 	int maxentities;
 	int maxclients;
 	aas_entity_t *entities;
+	//entity index
+	int entitybitwords;							//number of words in each entity set
+	unsigned int *validentities;				//entities updated this frame
+	unsigned int *linkedentities;				//entities linked into areas or BSP leaves
+	unsigned int *entitytypes[AAS_MAX_INDEXEDENTITYTYPES];	//entities with each type
+	int entitycells[AAS_ENTITYCELLS];			//first entity in each cell, -1 if none
 	//index to retrieve travel flag for a travel type
 	int travelflagfortype[MAX_TRAVELTYPES];
 	//travel flags for each area based on contents
@@ -54,6 +54,182 @@ enum {
 	ET_MOVER
 };
 
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_AddEntityToSet(unsigned int *set, int entnum)
+{
+	set[entnum >> 5] |= 1u << (entnum & 31);
+} //end of the function AAS_AddEntityToSet
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RemoveEntityFromSet(unsigned int *set, int entnum)
+{
+	set[entnum >> 5] &= ~(1u << (entnum & 31));
+} //end of the function AAS_RemoveEntityFromSet
+//===========================================================================
+// returns the first entity from start on that is in both sets, the second
+// set is optional
+//
+// Parameter:				-
+// Returns:					entity number or -1 if there is none
+// Changes Globals:		-
+//===========================================================================
+static int AAS_FirstEntityInSets(const unsigned int *set1, const unsigned int *set2, int start)
+{
+	int word, entnum;
+	unsigned int bits;
+
+	if (start < 0) start = 0;
+	if (start >= aasworld.maxentities) return -1;
+	word = start >> 5;
+	bits = set1[word] & (~0u << (start & 31));
+	if (set2) bits &= set2[word];
+	while (!bits)
+	{
+		if (++word >= aasworld.entitybitwords) return -1;
+		bits = set1[word];
+		if (set2) bits &= set2[word];
+	} //end while
+	entnum = word << 5;
+	while (!(bits & 0xff))
+	{
+		bits >>= 8;
+		entnum += 8;
+	} //end while
+	while (!(bits & 1))
+	{
+		bits >>= 1;
+		entnum++;
+	} //end while
+	return entnum;
+} //end of the function AAS_FirstEntityInSets
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RemoveEntityFromCell(aas_entity_t *ent)
+{
+	if (ent->cell < 0) return;
+	if (ent->previncell >= 0) aasworld.entities[ent->previncell].nextincell = ent->nextincell;
+	else aasworld.entitycells[ent->cell] = ent->nextincell;
+	if (ent->nextincell >= 0) aasworld.entities[ent->nextincell].previncell = ent->previncell;
+	ent->cell = -1;
+} //end of the function AAS_RemoveEntityFromCell
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_EntityCellNum(int x, int y)
+{
+	return (int) (((unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u) & (AAS_ENTITYCELLS - 1));
+} //end of the function AAS_EntityCellNum
+//===========================================================================
+// stores the entity in the cell its origin is in
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_IndexEntityOrigin(aas_entity_t *ent)
+{
+	int entnum;
+
+	AAS_RemoveEntityFromCell(ent);
+	entnum = ent - aasworld.entities;
+	ent->cellx = (int) floor(ent->i.origin[0] / AAS_ENTITYCELL_SIZE);
+	ent->celly = (int) floor(ent->i.origin[1] / AAS_ENTITYCELL_SIZE);
+	ent->cell = AAS_EntityCellNum(ent->cellx, ent->celly);
+	ent->previncell = -1;
+	ent->nextincell = aasworld.entitycells[ent->cell];
+	if (ent->nextincell >= 0) aasworld.entities[ent->nextincell].previncell = entnum;
+	aasworld.entitycells[ent->cell] = entnum;
+} //end of the function AAS_IndexEntityOrigin
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_IndexEntityType(aas_entity_t *ent, int type)
+{
+	int entnum;
+
+	entnum = ent - aasworld.entities;
+	if (ent->i.type >= 0 && ent->i.type < AAS_MAX_INDEXEDENTITYTYPES)
+	{
+		AAS_RemoveEntityFromSet(aasworld.entitytypes[ent->i.type], entnum);
+	} //end if
+	if (type >= 0 && type < AAS_MAX_INDEXEDENTITYTYPES)
+	{
+		AAS_AddEntityToSet(aasworld.entitytypes[type], entnum);
+	} //end if
+} //end of the function AAS_IndexEntityType
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeEntityIndex(void)
+{
+	int i;
+
+	if (aasworld.validentities) FreeMemory(aasworld.validentities);
+	aasworld.validentities = NULL;
+	aasworld.linkedentities = NULL;
+	for (i = 0; i < AAS_MAX_INDEXEDENTITYTYPES; i++)
+	{
+		aasworld.entitytypes[i] = NULL;
+	} //end for
+	aasworld.entitybitwords = 0;
+} //end of the function AAS_FreeEntityIndex
+//===========================================================================
+// sets up the entity sets and cells for a freshly cleared entity table
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitEntityIndex(void)
+{
+	int i, words;
+	unsigned int *sets;
+
+	AAS_FreeEntityIndex();
+	words = (aasworld.maxentities + 31) >> 5;
+	sets = (unsigned int *) GetClearedHunkMemory((2 + AAS_MAX_INDEXEDENTITYTYPES) * words * sizeof(unsigned int));
+	aasworld.entitybitwords = words;
+	aasworld.validentities = sets;
+	aasworld.linkedentities = sets + words;
+	for (i = 0; i < AAS_MAX_INDEXEDENTITYTYPES; i++)
+	{
+		aasworld.entitytypes[i] = sets + (2 + i) * words;
+	} //end for
+	for (i = 0; i < AAS_ENTITYCELLS; i++)
+	{
+		aasworld.entitycells[i] = -1;
+	} //end for
+	for (i = 0; i < aasworld.maxentities; i++)
+	{
+		aasworld.entities[i].i.valid = qfalse;
+		aasworld.entities[i].i.number = i;
+		aasworld.entities[i].cell = -1;
+		AAS_AddEntityToSet(aasworld.entitytypes[aasworld.entities[i].i.type], i);
+	} //end for
+} //end of the function AAS_InitEntityIndex
+
 //===========================================================================
 //
 // Parameter:				-
@@ -83,10 +259,12 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 		ent->areas = NULL;
 		//
 		ent->leaves = NULL;
+		AAS_RemoveEntityFromSet(aasworld.linkedentities, entnum);
 		return BLERR_NOERROR;
 	}
 
 	ent->i.update_time = AAS_Time() - ent->i.ltime;
+	if (ent->i.type != state->type) AAS_IndexEntityType(ent, state->type);
 	ent->i.type = state->type;
 	ent->i.flags = state->flags;
 	ent->i.ltime = AAS_Time();
@@ -107,6 +285,7 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 	ent->i.number = entnum;
 	//updated so set valid flag
 	ent->i.valid = qtrue;
+	AAS_AddEntityToSet(aasworld.validentities, entnum);
 	//link everything the first frame
 	if (aasworld.numframes == 1) relink = qtrue;
 	else relink = qfalse;
@@ -141,6 +320,8 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 		VectorCopy(state->origin, ent->i.origin);
 		relink = qtrue;
 	} //end if
+	//the entity index only changes when the entity moved
+	if (relink || ent->cell < 0) AAS_IndexEntityOrigin(ent);
 	//if the entity should be relinked
 	if (relink)
 	{
@@ -158,6 +339,7 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 			AAS_UnlinkFromBSPLeaves(ent->leaves);
 			//link the entity to the world BSP tree
 			ent->leaves = AAS_BSPLinkEntity(absmins, absmaxs, entnum, 0);
+			AAS_AddEntityToSet(aasworld.linkedentities, entnum);
 		} //end if
 	} //end if
 	return BLERR_NOERROR;
@@ -265,16 +447,15 @@ int AAS_OriginOfMoverWithModelNum(int modelnum, vec3_t origin)
 	int i;
 	aas_entity_t *ent;
 
-	for (i = 0; i < aasworld.maxentities; i++)
+	//valid or not, only movers are visited
+	for (i = AAS_FirstEntityInSets(aasworld.entitytypes[ET_MOVER], NULL, 0); i >= 0;
+			i = AAS_FirstEntityInSets(aasworld.entitytypes[ET_MOVER], NULL, i + 1))
 	{
 		ent = &aasworld.entities[i];
-		if (ent->i.type == ET_MOVER)
+		if (ent->i.modelindex == modelnum)
 		{
-			if (ent->i.modelindex == modelnum)
-			{
-				VectorCopy(ent->i.origin, origin);
-				return qtrue;
-			} //end if
+			VectorCopy(ent->i.origin, origin);
+			return qtrue;
 		} //end if
 	} //end for
 	return qfalse;
@@ -335,6 +516,10 @@ void AAS_ResetEntityLinks(void)
 		aasworld.entities[i].areas = NULL;
 		aasworld.entities[i].leaves = NULL;
 	} //end for
+	if (aasworld.linkedentities)
+	{
+		Com_Memset(aasworld.linkedentities, 0, aasworld.entitybitwords * sizeof(unsigned int));
+	} //end if
 } //end of the function AAS_ResetEntityLinks
 //===========================================================================
 //
@@ -345,11 +530,14 @@ void AAS_ResetEntityLinks(void)
 void AAS_InvalidateEntities(void)
 {
 	int i;
-	for (i = 0; i < aasworld.maxentities; i++)
+
+	//only the entities updated last frame are valid
+	for (i = AAS_FirstEntityInSets(aasworld.validentities, NULL, 0); i >= 0;
+			i = AAS_FirstEntityInSets(aasworld.validentities, NULL, i + 1))
 	{
 		aasworld.entities[i].i.valid = qfalse;
-		aasworld.entities[i].i.number = i;
 	} //end for
+	Com_Memset(aasworld.validentities, 0, aasworld.entitybitwords * sizeof(unsigned int));
 } //end of the function AAS_InvalidateEntities
 //===========================================================================
 //
@@ -362,7 +550,9 @@ void AAS_UnlinkInvalidEntities(void)
 	int i;
 	aas_entity_t *ent;
 
-	for (i = 0; i < aasworld.maxentities; i++)
+	//entities that aren't linked anywhere are skipped
+	for (i = AAS_FirstEntityInSets(aasworld.linkedentities, NULL, 0); i >= 0;
+			i = AAS_FirstEntityInSets(aasworld.linkedentities, NULL, i + 1))
 	{
 		ent = &aasworld.entities[i];
 		if (!ent->i.valid)
@@ -371,6 +561,7 @@ void AAS_UnlinkInvalidEntities(void)
 			ent->areas = NULL;
 			AAS_UnlinkFromBSPLeaves( ent->leaves );
 			ent->leaves = NULL;
+			AAS_RemoveEntityFromSet(aasworld.linkedentities, i);
 		} //end for
 	} //end for
 } //end of the function AAS_UnlinkInvalidEntities
@@ -435,9 +626,97 @@ int AAS_NextEntity(int entnum)
 	if (!aasworld.loaded) return 0;
 
 	if (entnum < 0) entnum = -1;
-	while(++entnum < aasworld.maxentities)
-	{
-		if (aasworld.entities[entnum].i.valid) return entnum;
-	} //end while
-	return 0;
+	entnum = AAS_FirstEntityInSets(aasworld.validentities, NULL, entnum + 1);
+	if (entnum < 0) return 0;
+	return entnum;
 } //end of the function AAS_NextEntity
+//===========================================================================
+// returns the next valid entity with the given type
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_NextEntityOfType(int entnum, int type)
+{
+	if (!aasworld.loaded) return 0;
+	//AAS_EntityType reports type 0 for all entities before initialization
+	if (!aasworld.initialized && type) return 0;
+
+	if (type < 0 || type >= AAS_MAX_INDEXEDENTITYTYPES)
+	{
+		for (entnum = AAS_NextEntity(entnum); entnum; entnum = AAS_NextEntity(entnum))
+		{
+			if (aasworld.entities[entnum].i.type == type) return entnum;
+		} //end for
+		return 0;
+	} //end if
+	if (entnum < 0) entnum = -1;
+	entnum = AAS_FirstEntityInSets(aasworld.validentities, aasworld.entitytypes[type], entnum + 1);
+	if (entnum < 0) return 0;
+	return entnum;
+} //end of the function AAS_NextEntityOfType
+//===========================================================================
+// stores the valid entities of the given type (-1 for any type) with their
+// origin within the radius, in increasing entity number
+//
+// Parameter:			-
+// Returns:				number of entities stored
+// Changes Globals:		-
+//===========================================================================
+int AAS_EntitiesInRadius(vec3_t origin, float radius, int type, int *entities, int maxentities)
+{
+	int x, y, minx, miny, maxx, maxy, entnum, numentities, i;
+	float radiussqr;
+	aas_entity_t *ent;
+	vec3_t dir;
+
+	if (!aasworld.loaded || maxentities <= 0 || radius < 0) return 0;
+
+	radiussqr = radius * radius;
+	numentities = 0;
+	//with a large radius the valid entities are tested one by one
+	if (radius > 16 * AAS_ENTITYCELL_SIZE)
+	{
+		for (entnum = AAS_FirstEntityInSets(aasworld.validentities, NULL, 0); entnum >= 0;
+				entnum = AAS_FirstEntityInSets(aasworld.validentities, NULL, entnum + 1))
+		{
+			ent = &aasworld.entities[entnum];
+			if (type >= 0 && ent->i.type != type) continue;
+			VectorSubtract(ent->i.origin, origin, dir);
+			if (DotProduct(dir, dir) > radiussqr) continue;
+			entities[numentities++] = entnum;
+			if (numentities >= maxentities) break;
+		} //end for
+		return numentities;
+	} //end if
+	minx = (int) floor((origin[0] - radius) / AAS_ENTITYCELL_SIZE);
+	miny = (int) floor((origin[1] - radius) / AAS_ENTITYCELL_SIZE);
+	maxx = (int) floor((origin[0] + radius) / AAS_ENTITYCELL_SIZE);
+	maxy = (int) floor((origin[1] + radius) / AAS_ENTITYCELL_SIZE);
+	for (x = minx; x <= maxx; x++)
+	{
+		for (y = miny; y <= maxy; y++)
+		{
+			for (entnum = aasworld.entitycells[AAS_EntityCellNum(x, y)]; entnum >= 0; entnum = ent->nextincell)
+			{
+				ent = &aasworld.entities[entnum];
+				//other cells hashed into the same cell are visited separately
+				if (ent->cellx != x || ent->celly != y) continue;
+				if (!ent->i.valid) continue;
+				if (type >= 0 && ent->i.type != type) continue;
+				VectorSubtract(ent->i.origin, origin, dir);
+				if (DotProduct(dir, dir) > radiussqr) continue;
+				//keep the lowest entity numbers sorted
+				if (numentities >= maxentities && entnum > entities[maxentities - 1]) continue;
+				if (numentities < maxentities) numentities++;
+				for (i = numentities - 1; i > 0 && entities[i - 1] > entnum; i--)
+				{
+					entities[i] = entities[i - 1];
+				} //end for
+				entities[i] = entnum;
+			} //end for
+		} //end for
+	} //end for
+	return numentities;
+} //end of the function AAS_EntitiesInRadius
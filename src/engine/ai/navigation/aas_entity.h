@@ -36,6 +36,10 @@ void AAS_InvalidateEntities(void);
 void AAS_UnlinkInvalidEntities(void);
 //resets the entity AAS and BSP links (sets areas and leaves pointers to NULL)
 void AAS_ResetEntityLinks(void);
+//sets up the entity index for the entity table
+void AAS_InitEntityIndex(void);
+//frees the entity index
+void AAS_FreeEntityIndex(void);
 //updates an entity
 int AAS_UpdateEntity(int ent, bot_entitystate_t *state);
 //gives the entity data used for collision detection
@@ -59,6 +63,10 @@ int AAS_BestReachableEntityArea(int entnum);
 void AAS_EntityInfo(int entnum, aas_entityinfo_t *info);
 //returns the next entity
 int AAS_NextEntity(int entnum);
+//returns the next entity with the given type
+int AAS_NextEntityOfType(int entnum, int type);
+//returns the entities with the given type (-1 = any) within the radius
+int AAS_EntitiesInRadius(vec3_t origin, float radius, int type, int *entities, int maxentities);
 #if 0
 //returns the origin of the entity
 void AAS_EntityOrigin(int entnum, vec3_t origin);
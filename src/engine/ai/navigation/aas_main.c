@@ -276,6 +276,8 @@ int AAS_LoadMap(const char *mapname)
 	AAS_InitAASLinkHeap();
 	//initialize the AAS linked entities for the new map
 	AAS_InitAASLinkedEntities();
+	//initialize the point to area lookup grid for the new map
+	AAS_InitPointGrid();
 	//initialize reachability for the new map
 	AAS_InitReachability();
 	//initialize the alternative routing
@@ -299,8 +301,8 @@ int AAS_Setup(void)
 	//allocate memory for the entities
 	if (aasworld.entities) FreeMemory(aasworld.entities);
 	aasworld.entities = (aas_entity_t *) GetClearedHunkMemory(aasworld.maxentities * sizeof(aas_entity_t));
-	//invalidate all the entities
-	AAS_InvalidateEntities();
+	//invalidate all the entities and set up the entity index
+	AAS_InitEntityIndex();
 	//force some recalculations
 	//LibVarSet("forceclustering", "1");			//force clustering calculation
 	//LibVarSet("forcereachability", "1");		//force reachability calculation
@@ -327,6 +329,7 @@ void AAS_Shutdown(void)
 	//free the aas data
 	AAS_DumpAASData();
 	//free the entities
+	AAS_FreeEntityIndex();
 	if (aasworld.entities) FreeMemory(aasworld.entities);
 	//clear the aasworld structure
 	Com_Memset(&aasworld, 0, sizeof(aas_t));
@@ -47,6 +47,23 @@ aas_settings_t aassettings;
 
 //#define AAS_MOVE_DEBUG
 
+//movement prediction in progress
+typedef struct aas_predictstate_s
+{
+	const aas_predictmove_t *predict;	//what to predict
+	aas_clientmove_t *move;				//prediction result
+	vec3_t org;							//current origin
+	vec3_t frame_test_vel;				//velocity to test for the current frame
+	float frametime;					//duration of one predicted frame
+	int presencetype;					//current presence type
+	int onground;						//true if on the ground
+	int swimming;						//true if swimming at the start of the frame
+	int jump_frame;						//frame the jump started or -1
+	int frame;							//current frame
+	qboolean finished;					//true if the prediction finished
+	int result;							//true if the prediction didn't get stuck
+} aas_predictstate_t;
+
 //===========================================================================
 //
 // Parameter:			-
@@ -475,507 +492,534 @@ static qboolean AAS_ClipToBBox( aas_trace_t *trace, const vec3_t start, const ve
 	return qfalse;
 } //end of the function AAS_ClipToBBox
 //===========================================================================
-// predicts the movement
+// stores the result of a finished movement prediction
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_FinishPrediction(aas_predictstate_t *ps, const vec3_t endpos, int endarea,
+									const aas_trace_t *trace, int stopevent, int endcontents)
+{
+	aas_clientmove_t *move;
+
+	move = ps->move;
+	VectorCopy(endpos, move->endpos);
+	move->endarea = endarea;
+	VectorScale(ps->frame_test_vel, 1/ps->frametime, move->velocity);
+	if (trace) move->trace = *trace;
+	move->stopevent = stopevent;
+	move->presencetype = ps->presencetype;
+	move->endcontents = endcontents;
+	move->time = ps->frame * ps->frametime;
+	move->frames = ps->frame;
+	ps->finished = qtrue;
+	ps->result = qtrue;
+} //end of the function AAS_FinishPrediction
+//===========================================================================
+// starts a movement prediction
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_StartPrediction(aas_predictstate_t *ps, aas_clientmove_t *move, const aas_predictmove_t *predict)
+{
+	ps->predict = predict;
+	ps->move = move;
+	ps->frametime = predict->frametime;
+	if (ps->frametime <= 0) ps->frametime = 0.1f;
+	ps->presencetype = predict->presencetype;
+	ps->onground = predict->onground;
+	//
+	Com_Memset( move, 0, sizeof( *move ) );
+	//start at the current origin
+	VectorCopy(predict->origin, ps->org);
+	ps->org[2] += 0.25;
+	//velocity to test for the first frame
+	VectorScale(predict->velocity, ps->frametime, ps->frame_test_vel);
+	//
+	ps->jump_frame = -1;
+	ps->frame = 0;
+	ps->swimming = qfalse;
+	ps->finished = qfalse;
+	ps->result = qfalse;
+	//nothing to predict
+	if (predict->maxframes <= 0)
+	{
+		AAS_FinishPrediction(ps, ps->org, AAS_PointAreaNum(ps->org), NULL, SE_NONE, 0);
+	} //end if
+} //end of the function AAS_StartPrediction
+//===========================================================================
+// predicts one frame of the movement, ps->swimming should be set to
+// whether or not swimming at the current origin
 // assumes regular bounding box sizes
 // NOTE: out of water jumping is not included
 // NOTE: grappling hook is not included
 //
-// Parameter:			origin			: origin to start with
-//						presencetype	: presence type to start with
-//						velocity		: velocity to start with
-//						cmdmove			: client command movement
-//						cmdframes		: number of frame cmdmove is valid
-//						maxframes		: maximum number of predicted frames
-//						frametime		: duration of one predicted frame
-//						stopevent		: events that stop the prediction
-//						stopareanum		: stop as soon as entered this area
-// Returns:				aas_clientmove_t
+// Parameter:			ps				: prediction in progress
+// Returns:				qtrue if the prediction finished
 // Changes Globals:		-
 //===========================================================================
-static int AAS_ClientMovementPrediction( aas_clientmove_t *move,
-								int entnum, const vec3_t origin,
-								int presencetype, int onground,
-								const vec3_t velocity, const vec3_t cmdmove,
-								int cmdframes,
-								int maxframes, float frametime,
-								int stopevent, int stopareanum,
-								const vec3_t mins, const vec3_t maxs, int visualize )
+static qboolean AAS_PredictionFrame(aas_predictstate_t *ps)
 {
-	float phys_friction, phys_stopspeed, phys_gravity, phys_waterfriction;
-	float phys_watergravity;
-	float phys_walkaccelerate, phys_airaccelerate, phys_swimaccelerate;
-	float phys_maxwalkvelocity, phys_maxcrouchvelocity, phys_maxswimvelocity;
-	float phys_maxstep, phys_maxsteepness, phys_jumpvel, friction;
+	const aas_predictmove_t *predict;
+	float frametime, friction, jumpvel;
 	float gravity, delta, maxvel, wishspeed, accelerate;
 	//float velchange, newvel;
 	//int ax;
-	int n, i, j, pc, step, swimming, crouch, event, jump_frame, areanum;
+	int n, i, j, pc, step, crouch, event, areanum, stopevent;
 	int areas[20], numareas;
 	vec3_t points[20];
-	vec3_t org, end, feet, start, stepend, lastorg, wishdir;
-	vec3_t frame_test_vel, old_frame_test_vel, left_test_vel;
+	vec3_t end, feet, start, stepend, lastorg, wishdir;
+	vec3_t old_frame_test_vel, left_test_vel;
 	vec3_t up = {0, 0, 1};
 	aas_plane_t *plane, *plane2;
 	aas_trace_t trace, steptrace;
-	
-	if (frametime <= 0) frametime = 0.1f;
-	//
-	phys_friction = aassettings.phys_friction;
-	phys_stopspeed = aassettings.phys_stopspeed;
-	phys_gravity = aassettings.phys_gravity;
-	phys_waterfriction = aassettings.phys_waterfriction;
-	phys_watergravity = aassettings.phys_watergravity;
-	phys_maxwalkvelocity = aassettings.phys_maxwalkvelocity;// * frametime;
-	phys_maxcrouchvelocity = aassettings.phys_maxcrouchvelocity;// * frametime;
-	phys_maxswimvelocity = aassettings.phys_maxswimvelocity;// * frametime;
-	phys_walkaccelerate = aassettings.phys_walkaccelerate;
-	phys_airaccelerate = aassettings.phys_airaccelerate;
-	phys_swimaccelerate = aassettings.phys_swimaccelerate;
-	phys_maxstep = aassettings.phys_maxstep;
-	phys_maxsteepness = aassettings.phys_maxsteepness;
-	phys_jumpvel = aassettings.phys_jumpvel * frametime;
-	//
-	Com_Memset( move, 0, sizeof( *move ) );
-	Com_Memset( &trace, 0, sizeof( trace ) );
-	//start at the current origin
-	VectorCopy(origin, org);
-	org[2] += 0.25;
-	//velocity to test for the first frame
-	VectorScale(velocity, frametime, frame_test_vel);
-	//
-	jump_frame = -1;
-	//predict a maximum of 'maxframes' ahead
-	for (n = 0; n < maxframes; n++)
+
+	predict = ps->predict;
+	frametime = ps->frametime;
+	stopevent = predict->stopevent;
+	n = ps->frame;
+	//get gravity depending on swimming or not
+	gravity = ps->swimming ? aassettings.phys_watergravity : aassettings.phys_gravity;
+	//apply gravity at the START of the frame
+	ps->frame_test_vel[2] = ps->frame_test_vel[2] - (gravity * 0.1 * frametime);
+	//if on the ground or swimming
+	if (ps->onground || ps->swimming)
 	{
-		swimming = AAS_Swimming(org);
-		//get gravity depending on swimming or not
-		gravity = swimming ? phys_watergravity : phys_gravity;
-		//apply gravity at the START of the frame
-		frame_test_vel[2] = frame_test_vel[2] - (gravity * 0.1 * frametime);
-		//if on the ground or swimming
-		if (onground || swimming)
-		{
-			friction = swimming ? phys_waterfriction : phys_friction;
-			//apply friction
-			VectorScale(frame_test_vel, 1/frametime, frame_test_vel);
-			AAS_ApplyFriction(frame_test_vel, friction, phys_stopspeed, frametime);
-			VectorScale(frame_test_vel, frametime, frame_test_vel);
-		} //end if
-		crouch = qfalse;
-		//apply command movement
-		if (n < cmdframes)
+		friction = ps->swimming ? aassettings.phys_waterfriction : aassettings.phys_friction;
+		//apply friction
+		VectorScale(ps->frame_test_vel, 1/frametime, ps->frame_test_vel);
+		AAS_ApplyFriction(ps->frame_test_vel, friction, aassettings.phys_stopspeed, frametime);
+		VectorScale(ps->frame_test_vel, frametime, ps->frame_test_vel);
+	} //end if
+	crouch = qfalse;
+	//apply command movement
+	if (n < predict->cmdframes)
+	{
+		//ax = 0;
+		maxvel = aassettings.phys_maxwalkvelocity;
+		accelerate = aassettings.phys_airaccelerate;
+		VectorCopy(predict->cmdmove, wishdir);
+		if (ps->onground)
 		{
-			//ax = 0;
-			maxvel = phys_maxwalkvelocity;
-			accelerate = phys_airaccelerate;
-			VectorCopy(cmdmove, wishdir);
-			if (onground)
+			if (predict->cmdmove[2] < -300)
 			{
-				if (cmdmove[2] < -300)
-				{
-					crouch = qtrue;
-					maxvel = phys_maxcrouchvelocity;
-				} //end if
-				//if not swimming and upmove is positive then jump
-				if (!swimming && cmdmove[2] > 1)
-				{
-					//jump velocity minus the gravity for one frame + 5 for safety
-					frame_test_vel[2] = phys_jumpvel - (gravity * 0.1 * frametime) + 5;
-					jump_frame = n;
-					//jumping so air accelerate
-					accelerate = phys_airaccelerate;
-				} //end if
-				else
-				{
-					accelerate = phys_walkaccelerate;
-				} //end else
-				//ax = 2;
+				crouch = qtrue;
+				maxvel = aassettings.phys_maxcrouchvelocity;
 			} //end if
-			if (swimming)
+			//if not swimming and upmove is positive then jump
+			if (!ps->swimming && predict->cmdmove[2] > 1)
 			{
-				maxvel = phys_maxswimvelocity;
-				accelerate = phys_swimaccelerate;
-				//ax = 3;
+				//jump velocity minus the gravity for one frame + 5 for safety
+				jumpvel = aassettings.phys_jumpvel * frametime;
+				ps->frame_test_vel[2] = jumpvel - (gravity * 0.1 * frametime) + 5;
+				ps->jump_frame = n;
+				//jumping so air accelerate
+				accelerate = aassettings.phys_airaccelerate;
 			} //end if
 			else
 			{
-				wishdir[2] = 0;
+				accelerate = aassettings.phys_walkaccelerate;
 			} //end else
-			//
-			wishspeed = VectorNormalize(wishdir);
-			if (wishspeed > maxvel) wishspeed = maxvel;
-			VectorScale(frame_test_vel, 1/frametime, frame_test_vel);
-			AAS_Accelerate(frame_test_vel, frametime, wishdir, wishspeed, accelerate);
-			VectorScale(frame_test_vel, frametime, frame_test_vel);
-			/*
-			for (i = 0; i < ax; i++)
-			{
-				velchange = (cmdmove[i] * frametime) - frame_test_vel[i];
-				if (velchange > phys_maxacceleration) velchange = phys_maxacceleration;
-				else if (velchange < -phys_maxacceleration) velchange = -phys_maxacceleration;
-				newvel = frame_test_vel[i] + velchange;
-				//
-				if (frame_test_vel[i] <= maxvel && newvel > maxvel) frame_test_vel[i] = maxvel;
-				else if (frame_test_vel[i] >= -maxvel && newvel < -maxvel) frame_test_vel[i] = -maxvel;
-				else frame_test_vel[i] = newvel;
-			} //end for
-			*/
+			//ax = 2;
 		} //end if
-		if (crouch)
+		if (ps->swimming)
 		{
-			presencetype = PRESENCE_CROUCH;
+			maxvel = aassettings.phys_maxswimvelocity;
+			accelerate = aassettings.phys_swimaccelerate;
+			//ax = 3;
 		} //end if
-		else if (presencetype == PRESENCE_CROUCH)
+		else
 		{
-			if (AAS_PointPresenceType(org) & PRESENCE_NORMAL)
-			{
-				presencetype = PRESENCE_NORMAL;
-			} //end if
+			wishdir[2] = 0;
 		} //end else
-		//save the current origin
-		VectorCopy(org, lastorg);
-		//move linear during one frame
-		VectorCopy(frame_test_vel, left_test_vel);
-		j = 0;
-		do
+		//
+		wishspeed = VectorNormalize(wishdir);
+		if (wishspeed > maxvel) wishspeed = maxvel;
+		VectorScale(ps->frame_test_vel, 1/frametime, ps->frame_test_vel);
+		AAS_Accelerate(ps->frame_test_vel, frametime, wishdir, wishspeed, accelerate);
+		VectorScale(ps->frame_test_vel, frametime, ps->frame_test_vel);
+		/*
+		for (i = 0; i < ax; i++)
 		{
-			VectorAdd(org, left_test_vel, end);
-			//trace a bounding box
-			trace = AAS_TraceClientBBox(org, end, presencetype, entnum);
+			velchange = (cmdmove[i] * frametime) - frame_test_vel[i];
+			if (velchange > phys_maxacceleration) velchange = phys_maxacceleration;
+			else if (velchange < -phys_maxacceleration) velchange = -phys_maxacceleration;
+			newvel = frame_test_vel[i] + velchange;
 			//
+			if (frame_test_vel[i] <= maxvel && newvel > maxvel) frame_test_vel[i] = maxvel;
+			else if (frame_test_vel[i] >= -maxvel && newvel < -maxvel) frame_test_vel[i] = -maxvel;
+			else frame_test_vel[i] = newvel;
+		} //end for
+		*/
+	} //end if
+	if (crouch)
+	{
+		ps->presencetype = PRESENCE_CROUCH;
+	} //end if
+	else if (ps->presencetype == PRESENCE_CROUCH)
+	{
+		if (AAS_PointPresenceType(ps->org) & PRESENCE_NORMAL)
+		{
+			ps->presencetype = PRESENCE_NORMAL;
+		} //end if
+	} //end else
+	//save the current origin
+	VectorCopy(ps->org, lastorg);
+	//move linear during one frame
+	VectorCopy(ps->frame_test_vel, left_test_vel);
+	j = 0;
+	do
+	{
+		VectorAdd(ps->org, left_test_vel, end);
+		//trace a bounding box
+		trace = AAS_TraceClientBBox(ps->org, end, ps->presencetype, predict->entnum);
+		//
 //#ifdef AAS_MOVE_DEBUG
-			if (visualize)
-			{
-				if (trace.startsolid) botimport.Print(PRT_MESSAGE, "PredictMovement: start solid\n");
-				AAS_DebugLine(org, trace.endpos, LINECOLOR_RED);
-			} //end if
+		if (predict->visualize)
+		{
+			if (trace.startsolid) botimport.Print(PRT_MESSAGE, "PredictMovement: start solid\n");
+			AAS_DebugLine(ps->org, trace.endpos, LINECOLOR_RED);
+		} //end if
 //#endif //AAS_MOVE_DEBUG
-			//
-			if (stopevent & (SE_ENTERAREA|SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER|SE_TOUCHCLUSTERPORTAL))
+		//
+		if (stopevent & (SE_ENTERAREA|SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER|SE_TOUCHCLUSTERPORTAL))
+		{
+			numareas = AAS_TraceAreas(ps->org, trace.endpos, areas, points, 20);
+			for (i = 0; i < numareas; i++)
 			{
-				numareas = AAS_TraceAreas(org, trace.endpos, areas, points, 20);
-				for (i = 0; i < numareas; i++)
+				if (stopevent & SE_ENTERAREA)
 				{
-					if (stopevent & SE_ENTERAREA)
+					if (areas[i] == predict->stopareanum)
 					{
-						if (areas[i] == stopareanum)
-						{
-							VectorCopy(points[i], move->endpos);
-							VectorScale(frame_test_vel, 1/frametime, move->velocity);
-							move->endarea = areas[i];
-							move->trace = trace;
-							move->stopevent = SE_ENTERAREA;
-							move->presencetype = presencetype;
-							move->endcontents = 0;
-							move->time = n * frametime;
-							move->frames = n;
-							return qtrue;
-						} //end if
+						AAS_FinishPrediction(ps, points[i], areas[i], &trace, SE_ENTERAREA, 0);
+						return qtrue;
 					} //end if
-					//NOTE: if not the first frame
-					if ((stopevent & SE_TOUCHJUMPPAD) && n)
+				} //end if
+				//NOTE: if not the first frame
+				if ((stopevent & SE_TOUCHJUMPPAD) && n)
+				{
+					if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_JUMPPAD)
 					{
-						if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_JUMPPAD)
-						{
-							VectorCopy(points[i], move->endpos);
-							VectorScale(frame_test_vel, 1/frametime, move->velocity);
-							move->endarea = areas[i];
-							move->trace = trace;
-							move->stopevent = SE_TOUCHJUMPPAD;
-							move->presencetype = presencetype;
-							move->endcontents = 0;
-							move->time = n * frametime;
-							move->frames = n;
-							return qtrue;
-						} //end if
+						AAS_FinishPrediction(ps, points[i], areas[i], &trace, SE_TOUCHJUMPPAD, 0);
+						return qtrue;
 					} //end if
-					if (stopevent & SE_TOUCHTELEPORTER)
+				} //end if
+				if (stopevent & SE_TOUCHTELEPORTER)
+				{
+					if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_TELEPORTER)
 					{
-						if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_TELEPORTER)
-						{
-							VectorCopy(points[i], move->endpos);
-							move->endarea = areas[i];
-							VectorScale(frame_test_vel, 1/frametime, move->velocity);
-							move->trace = trace;
-							move->stopevent = SE_TOUCHTELEPORTER;
-							move->presencetype = presencetype;
-							move->endcontents = 0;
-							move->time = n * frametime;
-							move->frames = n;
-							return qtrue;
-						} //end if
+						AAS_FinishPrediction(ps, points[i], areas[i], &trace, SE_TOUCHTELEPORTER, 0);
+						return qtrue;
 					} //end if
-					if (stopevent & SE_TOUCHCLUSTERPORTAL)
+				} //end if
+				if (stopevent & SE_TOUCHCLUSTERPORTAL)
+				{
+					if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_CLUSTERPORTAL)
 					{
-						if (aasworld.areasettings[areas[i]].contents & AREACONTENTS_CLUSTERPORTAL)
-						{
-							VectorCopy(points[i], move->endpos);
-							move->endarea = areas[i];
-							VectorScale(frame_test_vel, 1/frametime, move->velocity);
-							move->trace = trace;
-							move->stopevent = SE_TOUCHCLUSTERPORTAL;
-							move->presencetype = presencetype;
-							move->endcontents = 0;
-							move->time = n * frametime;
-							move->frames = n;
-							return qtrue;
-						} //end if
+						AAS_FinishPrediction(ps, points[i], areas[i], &trace, SE_TOUCHCLUSTERPORTAL, 0);
+						return qtrue;
 					} //end if
-				} //end for
+				} //end if
+			} //end for
+		} //end if
+		//
+		if (stopevent & SE_HITBOUNDINGBOX)
+		{
+			if (AAS_ClipToBBox(&trace, ps->org, trace.endpos, ps->presencetype, predict->mins, predict->maxs))
+			{
+				AAS_FinishPrediction(ps, trace.endpos, AAS_PointAreaNum(trace.endpos), &trace, SE_HITBOUNDINGBOX, 0);
+				return qtrue;
 			} //end if
+		} //end if
+		//move the entity to the trace end point
+		VectorCopy(trace.endpos, ps->org);
+		//if there was a collision
+		if (trace.fraction < 1.0)
+		{
+			//get the plane the bounding box collided with
+			plane = AAS_PlaneFromNum(trace.planenum);
 			//
-			if (stopevent & SE_HITBOUNDINGBOX)
+			if (stopevent & SE_HITGROUNDAREA)
 			{
-				if (AAS_ClipToBBox(&trace, org, trace.endpos, presencetype, mins, maxs))
+				if (DotProduct(plane->normal, up) > aassettings.phys_maxsteepness)
 				{
-					VectorCopy(trace.endpos, move->endpos);
-					move->endarea = AAS_PointAreaNum(move->endpos);
-					VectorScale(frame_test_vel, 1/frametime, move->velocity);
-					move->trace = trace;
-					move->stopevent = SE_HITBOUNDINGBOX;
-					move->presencetype = presencetype;
-					move->endcontents = 0;
-					move->time = n * frametime;
-					move->frames = n;
-					return qtrue;
+					VectorCopy(ps->org, start);
+					start[2] += 0.5;
+					if (AAS_PointAreaNum(start) == predict->stopareanum)
+					{
+						AAS_FinishPrediction(ps, start, predict->stopareanum, &trace, SE_HITGROUNDAREA, 0);
+						return qtrue;
+					} //end if
 				} //end if
 			} //end if
-			//move the entity to the trace end point
-			VectorCopy(trace.endpos, org);
-			//if there was a collision
-			if (trace.fraction < 1.0)
+			//assume there's no step
+			step = qfalse;
+			//if it is a vertical plane and the bot didn't jump recently
+			if (plane->normal[2] == 0 && (ps->jump_frame < 0 || n - ps->jump_frame > 2))
 			{
-				//get the plane the bounding box collided with
-				plane = AAS_PlaneFromNum(trace.planenum);
+				//check for a step
+				VectorMA(ps->org, -0.25, plane->normal, start);
+				VectorCopy(start, stepend);
+				start[2] += aassettings.phys_maxstep;
+				steptrace = AAS_TraceClientBBox(start, stepend, ps->presencetype, predict->entnum);
 				//
-				if (stopevent & SE_HITGROUNDAREA)
+				if (!steptrace.startsolid)
 				{
-					if (DotProduct(plane->normal, up) > phys_maxsteepness)
+					plane2 = AAS_PlaneFromNum(steptrace.planenum);
+					if (DotProduct(plane2->normal, up) > aassettings.phys_maxsteepness)
 					{
-						VectorCopy(org, start);
-						start[2] += 0.5;
-						if (AAS_PointAreaNum(start) == stopareanum)
-						{
-							VectorCopy(start, move->endpos);
-							move->endarea = stopareanum;
-							VectorScale(frame_test_vel, 1/frametime, move->velocity);
-							move->trace = trace;
-							move->stopevent = SE_HITGROUNDAREA;
-							move->presencetype = presencetype;
-							move->endcontents = 0;
-							move->time = n * frametime;
-							move->frames = n;
-							return qtrue;
-						} //end if
-					} //end if
-				} //end if
-				//assume there's no step
-				step = qfalse;
-				//if it is a vertical plane and the bot didn't jump recently
-				if (plane->normal[2] == 0 && (jump_frame < 0 || n - jump_frame > 2))
-				{
-					//check for a step
-					VectorMA(org, -0.25, plane->normal, start);
-					VectorCopy(start, stepend);
-					start[2] += phys_maxstep;
-					steptrace = AAS_TraceClientBBox(start, stepend, presencetype, entnum);
-					//
-					if (!steptrace.startsolid)
-					{
-						plane2 = AAS_PlaneFromNum(steptrace.planenum);
-						if (DotProduct(plane2->normal, up) > phys_maxsteepness)
-						{
-							VectorSubtract(end, steptrace.endpos, left_test_vel);
-							left_test_vel[2] = 0;
-							frame_test_vel[2] = 0;
+						VectorSubtract(end, steptrace.endpos, left_test_vel);
+						left_test_vel[2] = 0;
+						ps->frame_test_vel[2] = 0;
 //#ifdef AAS_MOVE_DEBUG
-							if (visualize)
+						if (predict->visualize)
+						{
+							if (steptrace.endpos[2] - ps->org[2] > 0.125)
 							{
-								if (steptrace.endpos[2] - org[2] > 0.125)
-								{
-									VectorCopy(org, start);
-									start[2] = steptrace.endpos[2];
-									AAS_DebugLine(org, start, LINECOLOR_BLUE);
-								} //end if
+								VectorCopy(ps->org, start);
+								start[2] = steptrace.endpos[2];
+								AAS_DebugLine(ps->org, start, LINECOLOR_BLUE);
 							} //end if
-//#endif //AAS_MOVE_DEBUG
-							org[2] = steptrace.endpos[2];
-							step = qtrue;
 						} //end if
+//#endif //AAS_MOVE_DEBUG
+						ps->org[2] = steptrace.endpos[2];
+						step = qtrue;
 					} //end if
 				} //end if
-				//
-				if (!step)
+			} //end if
+			//
+			if (!step)
+			{
+				//velocity left to test for this frame is the projection
+				//of the current test velocity into the hit plane 
+				VectorMA(left_test_vel, -DotProduct(left_test_vel, plane->normal),
+									plane->normal, left_test_vel);
+				//store the old velocity for landing check
+				VectorCopy(ps->frame_test_vel, old_frame_test_vel);
+				//test velocity for the next frame is the projection
+				//of the velocity of the current frame into the hit plane 
+				VectorMA(ps->frame_test_vel, -DotProduct(ps->frame_test_vel, plane->normal),
+									plane->normal, ps->frame_test_vel);
+				//check for a landing on an almost horizontal floor
+				if (DotProduct(plane->normal, up) > aassettings.phys_maxsteepness)
+				{
+					ps->onground = qtrue;
+				} //end if
+				if (stopevent & SE_HITGROUNDDAMAGE)
 				{
-					//velocity left to test for this frame is the projection
-					//of the current test velocity into the hit plane 
-					VectorMA(left_test_vel, -DotProduct(left_test_vel, plane->normal),
-										plane->normal, left_test_vel);
-					//store the old velocity for landing check
-					VectorCopy(frame_test_vel, old_frame_test_vel);
-					//test velocity for the next frame is the projection
-					//of the velocity of the current frame into the hit plane 
-					VectorMA(frame_test_vel, -DotProduct(frame_test_vel, plane->normal),
-										plane->normal, frame_test_vel);
-					//check for a landing on an almost horizontal floor
-					if (DotProduct(plane->normal, up) > phys_maxsteepness)
+					delta = 0;
+					if (old_frame_test_vel[2] < 0 &&
+							ps->frame_test_vel[2] > old_frame_test_vel[2] &&
+							!ps->onground)
 					{
-						onground = qtrue;
+						delta = old_frame_test_vel[2];
 					} //end if
-					if (stopevent & SE_HITGROUNDDAMAGE)
+					else if (ps->onground)
 					{
-						delta = 0;
-						if (old_frame_test_vel[2] < 0 &&
-								frame_test_vel[2] > old_frame_test_vel[2] &&
-								!onground)
-						{
-							delta = old_frame_test_vel[2];
-						} //end if
-						else if (onground)
-						{
-							delta = frame_test_vel[2] - old_frame_test_vel[2];
-						} //end else
-						if (delta)
+						delta = ps->frame_test_vel[2] - old_frame_test_vel[2];
+					} //end else
+					if (delta)
+					{
+						delta = delta * 10;
+						delta = delta * delta * 0.0001;
+						if (ps->swimming) delta = 0;
+						// never take falling damage if completely underwater
+						/*
+						if (ent->waterlevel == 3) return;
+						if (ent->waterlevel == 2) delta *= 0.25;
+						if (ent->waterlevel == 1) delta *= 0.5;
+						*/
+						if (delta > 40)
 						{
-							delta = delta * 10;
-							delta = delta * delta * 0.0001;
-							if (swimming) delta = 0;
-							// never take falling damage if completely underwater
-							/*
-							if (ent->waterlevel == 3) return;
-							if (ent->waterlevel == 2) delta *= 0.25;
-							if (ent->waterlevel == 1) delta *= 0.5;
-							*/
-							if (delta > 40)
-							{
-								VectorCopy(org, move->endpos);
-								move->endarea = AAS_PointAreaNum(org);
-								VectorCopy(frame_test_vel, move->velocity);
-								move->trace = trace;
-								move->stopevent = SE_HITGROUNDDAMAGE;
-								move->presencetype = presencetype;
-								move->endcontents = 0;
-								move->time = n * frametime;
-								move->frames = n;
-								return qtrue;
-							} //end if
+							//NOTE: the velocity is stored without scaling
+							AAS_FinishPrediction(ps, ps->org, AAS_PointAreaNum(ps->org), &trace, SE_HITGROUNDDAMAGE, 0);
+							VectorCopy(ps->frame_test_vel, ps->move->velocity);
+							return qtrue;
 						} //end if
 					} //end if
 				} //end if
 			} //end if
-			//extra check to prevent endless loop
-			if (++j > 20) return qfalse;
-		//while there is a plane hit
-		} while(trace.fraction < 1.0);
-		//if going down
-		if (frame_test_vel[2] <= 10)
+		} //end if
+		//extra check to prevent endless loop
+		if (++j > 20)
 		{
-			//check for a liquid at the feet of the bot
-			VectorCopy(org, feet);
-			feet[2] -= 22;
-			pc = AAS_PointContents(feet);
-			//get event from pc
-			event = SE_NONE;
-			if (pc & CONTENTS_LAVA) event |= SE_ENTERLAVA;
-			if (pc & CONTENTS_SLIME) event |= SE_ENTERSLIME;
-			if (pc & CONTENTS_WATER) event |= SE_ENTERWATER;
-			//
-			areanum = AAS_PointAreaNum(org);
-			if (aasworld.areasettings[areanum].contents & AREACONTENTS_LAVA)
-				event |= SE_ENTERLAVA;
-			if (aasworld.areasettings[areanum].contents & AREACONTENTS_SLIME)
-				event |= SE_ENTERSLIME;
-			if (aasworld.areasettings[areanum].contents & AREACONTENTS_WATER)
-				event |= SE_ENTERWATER;
-			//if in lava or slime
-			if (event & stopevent)
-			{
-				VectorCopy(org, move->endpos);
-				move->endarea = areanum;
-				VectorScale(frame_test_vel, 1/frametime, move->velocity);
-				move->stopevent = event & stopevent;
-				move->presencetype = presencetype;
-				move->endcontents = pc;
-				move->time = n * frametime;
-				move->frames = n;
-				return qtrue;
-			} //end if
+			ps->finished = qtrue;
+			return qtrue;
 		} //end if
+	//while there is a plane hit
+	} while(trace.fraction < 1.0);
+	//if going down
+	if (ps->frame_test_vel[2] <= 10)
+	{
+		//check for a liquid at the feet of the bot
+		VectorCopy(ps->org, feet);
+		feet[2] -= 22;
+		pc = AAS_PointContents(feet);
+		//get event from pc
+		event = SE_NONE;
+		if (pc & CONTENTS_LAVA) event |= SE_ENTERLAVA;
+		if (pc & CONTENTS_SLIME) event |= SE_ENTERSLIME;
+		if (pc & CONTENTS_WATER) event |= SE_ENTERWATER;
 		//
-		onground = AAS_OnGround(org, presencetype, entnum);
-		//if onground and on the ground for at least one whole frame
-		if (onground)
+		areanum = AAS_PointAreaNum(ps->org);
+		if (aasworld.areasettings[areanum].contents & AREACONTENTS_LAVA)
+			event |= SE_ENTERLAVA;
+		if (aasworld.areasettings[areanum].contents & AREACONTENTS_SLIME)
+			event |= SE_ENTERSLIME;
+		if (aasworld.areasettings[areanum].contents & AREACONTENTS_WATER)
+			event |= SE_ENTERWATER;
+		//if in lava or slime
+		if (event & stopevent)
 		{
-			if (stopevent & SE_HITGROUND)
-			{
-				VectorCopy(org, move->endpos);
-				move->endarea = AAS_PointAreaNum(org);
-				VectorScale(frame_test_vel, 1/frametime, move->velocity);
-				move->trace = trace;
-				move->stopevent = SE_HITGROUND;
-				move->presencetype = presencetype;
-				move->endcontents = 0;
-				move->time = n * frametime;
-				move->frames = n;
-				return qtrue;
-			} //end if
+			AAS_FinishPrediction(ps, ps->org, areanum, NULL, event & stopevent, pc);
+			return qtrue;
 		} //end if
-		else if (stopevent & SE_LEAVEGROUND)
+	} //end if
+	//
+	ps->onground = AAS_OnGround(ps->org, ps->presencetype, predict->entnum);
+	//if onground and on the ground for at least one whole frame
+	if (ps->onground)
+	{
+		if (stopevent & SE_HITGROUND)
 		{
-			VectorCopy(org, move->endpos);
-			move->endarea = AAS_PointAreaNum(org);
-			VectorScale(frame_test_vel, 1/frametime, move->velocity);
-			move->trace = trace;
-			move->stopevent = SE_LEAVEGROUND;
-			move->presencetype = presencetype;
-			move->endcontents = 0;
-			move->time = n * frametime;
-			move->frames = n;
+			AAS_FinishPrediction(ps, ps->org, AAS_PointAreaNum(ps->org), &trace, SE_HITGROUND, 0);
 			return qtrue;
-		} //end else if
-		else if (stopevent & SE_GAP)
-		{
-			aas_trace_t gaptrace;
+		} //end if
+	} //end if
+	else if (stopevent & SE_LEAVEGROUND)
+	{
+		AAS_FinishPrediction(ps, ps->org, AAS_PointAreaNum(ps->org), &trace, SE_LEAVEGROUND, 0);
+		return qtrue;
+	} //end else if
+	else if (stopevent & SE_GAP)
+	{
+		aas_trace_t gaptrace;
 
-			VectorCopy(org, start);
-			VectorCopy(start, end);
-			end[2] -= 48 + aassettings.phys_maxbarrier;
-			gaptrace = AAS_TraceClientBBox(start, end, PRESENCE_CROUCH, -1);
-			//if solid is found the bot cannot walk any further and will not fall into a gap
-			if (!gaptrace.startsolid)
+		VectorCopy(ps->org, start);
+		VectorCopy(start, end);
+		end[2] -= 48 + aassettings.phys_maxbarrier;
+		gaptrace = AAS_TraceClientBBox(start, end, PRESENCE_CROUCH, -1);
+		//if solid is found the bot cannot walk any further and will not fall into a gap
+		if (!gaptrace.startsolid)
+		{
+			//if it is a gap (lower than one step height)
+			if (gaptrace.endpos[2] < ps->org[2] - aassettings.phys_maxstep - 1)
 			{
-				//if it is a gap (lower than one step height)
-				if (gaptrace.endpos[2] < org[2] - aassettings.phys_maxstep - 1)
+				if (!(AAS_PointContents(end) & CONTENTS_WATER))
 				{
-					if (!(AAS_PointContents(end) & CONTENTS_WATER))
-					{
-						VectorCopy(lastorg, move->endpos);
-						move->endarea = AAS_PointAreaNum(lastorg);
-						VectorScale(frame_test_vel, 1/frametime, move->velocity);
-						move->trace = trace;
-						move->stopevent = SE_GAP;
-						move->presencetype = presencetype;
-						move->endcontents = 0;
-						move->time = n * frametime;
-						move->frames = n;
-						return qtrue;
-					} //end if
+					AAS_FinishPrediction(ps, lastorg, AAS_PointAreaNum(lastorg), &trace, SE_GAP, 0);
+					return qtrue;
 				} //end if
 			} //end if
-		} //end else if
-	} //end for
-	//
-	VectorCopy(org, move->endpos);
-	move->endarea = AAS_PointAreaNum(org);
-	VectorScale(frame_test_vel, 1/frametime, move->velocity);
-	move->stopevent = SE_NONE;
-	move->presencetype = presencetype;
-	move->endcontents = 0;
-	move->time = n * frametime;
-	move->frames = n;
+		} //end if
+	} //end else if
 	//
-	return qtrue;
-} //end of the function AAS_ClientMovementPrediction
+	ps->frame++;
+	if (ps->frame >= predict->maxframes)
+	{
+		AAS_FinishPrediction(ps, ps->org, AAS_PointAreaNum(ps->org), NULL, SE_NONE, 0);
+		return qtrue;
+	} //end if
+	return qfalse;
+} //end of the function AAS_PredictionFrame
+//===========================================================================
+// predicts a batch of independent movements
+//
+// The movements are predicted frame by frame side by side. Movements that
+// are at the same origin at the start of a frame share the swimming test.
+// Every movement is predicted exactly as if it was predicted on its own.
+//
+// Parameter:			moves			: the prediction results
+//						predict			: what to predict for every movement
+//						numpredict		: number of movements
+// Returns:				number of movements predicted without getting stuck
+// Changes Globals:		-
+//===========================================================================
+int AAS_PredictClientMovements(aas_clientmove_t *moves, const aas_predictmove_t *predict, int numpredict)
+{
+	aas_predictstate_t states[MAX_PREDICTMOVES];
+	aas_predictstate_t *active[MAX_PREDICTMOVES];
+	aas_predictstate_t *ps;
+	int i, j, first, num, numactive, numpredicted;
+
+	numpredicted = 0;
+	for (first = 0; first < numpredict; first += MAX_PREDICTMOVES)
+	{
+		num = numpredict - first;
+		if (num > MAX_PREDICTMOVES) num = MAX_PREDICTMOVES;
+		numactive = 0;
+		for (i = 0; i < num; i++)
+		{
+			AAS_StartPrediction(&states[i], &moves[first + i], &predict[first + i]);
+			if (!states[i].finished) active[numactive++] = &states[i];
+		} //end for
+		while(numactive > 0)
+		{
+			//test for swimming once for every origin
+			for (i = 0; i < numactive; i++)
+			{
+				ps = active[i];
+				for (j = 0; j < i; j++)
+				{
+					if (VectorCompare(active[j]->org, ps->org)) break;
+				} //end for
+				if (j < i) ps->swimming = active[j]->swimming;
+				else ps->swimming = AAS_Swimming(ps->org);
+			} //end for
+			//predict one frame for every movement still in progress
+			for (i = 0; i < numactive; i++)
+			{
+				if (AAS_PredictionFrame(active[i]))
+				{
+					active[i] = NULL;
+				} //end if
+			} //end for
+			for (i = j = 0; i < numactive; i++)
+			{
+				if (active[i]) active[j++] = active[i];
+			} //end for
+			numactive = j;
+		} //end while
+		for (i = 0; i < num; i++)
+		{
+			if (states[i].result) numpredicted++;
+		} //end for
+	} //end for
+	return numpredicted;
+} //end of the function AAS_PredictClientMovements
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_SetPredictMove(aas_predictmove_t *predict,
+						int entnum, const vec3_t origin,
+						int presencetype, int onground,
+						const vec3_t velocity, const vec3_t cmdmove,
+						int cmdframes,
+						int maxframes, float frametime,
+						int stopevent, int stopareanum,
+						const vec3_t mins, const vec3_t maxs, int visualize)
+{
+	predict->entnum = entnum;
+	VectorCopy(origin, predict->origin);
+	predict->presencetype = presencetype;
+	predict->onground = onground;
+	VectorCopy(velocity, predict->velocity);
+	VectorCopy(cmdmove, predict->cmdmove);
+	predict->cmdframes = cmdframes;
+	predict->maxframes = maxframes;
+	predict->frametime = frametime;
+	predict->stopevent = stopevent;
+	predict->stopareanum = stopareanum;
+	VectorCopy(mins, predict->mins);
+	VectorCopy(maxs, predict->maxs);
+	predict->visualize = visualize;
+} //end of the function AAS_SetPredictMove
 //===========================================================================
 //
 // Parameter:			-
@@ -992,10 +1036,13 @@ int AAS_PredictClientMovement(struct aas_clientmove_s *move,
 {
 	const vec3_t mins = { -4, -4, -4 };
 	const vec3_t maxs = { 4, 4, 4 };
-	return AAS_ClientMovementPrediction(move, entnum, origin, presencetype, onground,
-										velocity, cmdmove, cmdframes, maxframes,
-										frametime, stopevent, stopareanum,
-										mins, maxs, visualize);
+	aas_predictmove_t predict;
+
+	AAS_SetPredictMove(&predict, entnum, origin, presencetype, onground,
+						velocity, cmdmove, cmdframes, maxframes,
+						frametime, stopevent, stopareanum,
+						mins, maxs, visualize);
+	return AAS_PredictClientMovements(move, &predict, 1);
 } //end of the function AAS_PredictClientMovement
 //===========================================================================
 //
@@ -1011,10 +1058,13 @@ int AAS_ClientMovementHitBBox(struct aas_clientmove_s *move,
 								int maxframes, float frametime,
 								const vec3_t mins, const vec3_t maxs, int visualize)
 {
-	return AAS_ClientMovementPrediction(move, entnum, origin, presencetype, onground,
-										velocity, cmdmove, cmdframes, maxframes,
-										frametime, SE_HITBOUNDINGBOX, 0,
-										mins, maxs, visualize);
+	aas_predictmove_t predict;
+
+	AAS_SetPredictMove(&predict, entnum, origin, presencetype, onground,
+						velocity, cmdmove, cmdframes, maxframes,
+						frametime, SE_HITBOUNDINGBOX, 0,
+						mins, maxs, visualize);
+	return AAS_PredictClientMovements(move, &predict, 1);
 } //end of the function AAS_ClientMovementHitBBox
 #if 0
 //===========================================================================
@@ -33,6 +33,20 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 extern aas_settings_t aassettings;
 #endif //AASINTERN
 
+//maximum number of movements predicted side by side
+#define MAX_PREDICTMOVES		16
+
+//fills in a movement prediction request
+void AAS_SetPredictMove(struct aas_predictmove_s *predict,
+						int entnum, const vec3_t origin,
+						int presencetype, int onground,
+						const vec3_t velocity, const vec3_t cmdmove,
+						int cmdframes,
+						int maxframes, float frametime,
+						int stopevent, int stopareanum,
+						const vec3_t mins, const vec3_t maxs, int visualize);
+//predicts a batch of independent movements
+int AAS_PredictClientMovements(struct aas_clientmove_s *moves, const struct aas_predictmove_s *predict, int numpredict);
 //movement prediction
 int AAS_PredictClientMovement(struct aas_clientmove_s *move,
 							int entnum, const vec3_t origin,
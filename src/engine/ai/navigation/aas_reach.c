@@ -3499,7 +3499,8 @@ static void AAS_Reachability_FuncBobbing(void)
 //===========================================================================
 static void AAS_Reachability_JumpPad(void)
 {
-	int face2num, i, ret, area2num, visualize, ent, bot_visualizejumppads;
+	int face2num, i, k, ret, area2num, visualize, ent, bot_visualizejumppads;
+	int numpredict;
 	//int modelnum, ent2;
 	//float dist, time, height, gravity, forward;
 	float speed, zvel;
@@ -3509,8 +3510,10 @@ static void AAS_Reachability_JumpPad(void)
 	aas_lreachability_t *lreach;
 	vec3_t areastart, facecenter, dir, cmdmove;
 	vec3_t velocity, absmins, absmaxs;
+	vec3_t facecenters[MAX_PREDICTMOVES];
 	//vec3_t origin, ent2origin, angles, teststart;
-	aas_clientmove_t move;
+	aas_clientmove_t move, moves[MAX_PREDICTMOVES];
+	aas_predictmove_t predict[MAX_PREDICTMOVES];
 	//aas_trace_t trace;
 	aas_link_t *areas, *link;
 	//char target[MAX_EPAIRKEY], targetname[MAX_EPAIRKEY], model[MAX_EPAIRKEY];
@@ -3705,81 +3708,95 @@ static void AAS_Reachability_JumpPad(void)
 			if (link) continue;
 			//
 			area2 = &aasworld.areas[area2num];
-			for (i = 0; i < area2->numfaces; i++)
+			//predict the jumps towards all ground faces of the area side by side
+			i = 0;
+			while (i < area2->numfaces)
 			{
-				face2num = aasworld.faceindex[area2->firstface + i];
-				face2 = &aasworld.faces[abs(face2num)];
-				//if it is not a ground face
-				if (!(face2->faceflags & FACE_GROUND)) continue;
-				//get the center of the face
-				AAS_FaceCenter(face2num, facecenter);
-				//only go higher up
-				if (facecenter[2] < areastart[2]) continue;
-				//get the jumppad jump z velocity
-				zvel = velocity[2];
-				//get the horizontal speed for the jump, if it isn't possible to calculate this
-				//speed
-				ret = AAS_HorizontalVelocityForJump(zvel, areastart, facecenter, &speed);
-				if (ret && speed < 150)
+				numpredict = 0;
+				for (; i < area2->numfaces && numpredict < MAX_PREDICTMOVES; i++)
 				{
-					//direction towards the face center
-					VectorSubtract(facecenter, areastart, dir);
-					dir[2] = 0;
-					//hordist = VectorNormalize(dir);
-					//if (hordist < 1.6 * facecenter[2] - areastart[2])
+					face2num = aasworld.faceindex[area2->firstface + i];
+					face2 = &aasworld.faces[abs(face2num)];
+					//if it is not a ground face
+					if (!(face2->faceflags & FACE_GROUND)) continue;
+					//get the center of the face
+					AAS_FaceCenter(face2num, facecenter);
+					//only go higher up
+					if (facecenter[2] < areastart[2]) continue;
+					//get the jumppad jump z velocity
+					zvel = velocity[2];
+					//get the horizontal speed for the jump, if it isn't possible to calculate this
+					//speed
+					ret = AAS_HorizontalVelocityForJump(zvel, areastart, facecenter, &speed);
+					if (ret && speed < 150)
 					{
-						//get command movement
-						VectorScale(dir, speed, cmdmove);
-						//
-						AAS_PredictClientMovement(&move, -1, areastart, PRESENCE_NORMAL, qfalse,
-													velocity, cmdmove, 30, 30, 0.1f,
-													SE_ENTERWATER|SE_ENTERSLIME|
-													SE_ENTERLAVA|SE_HITGROUNDDAMAGE|
-													SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER|SE_HITGROUNDAREA, area2num, visualize);
-						//if prediction time wasn't enough to fully predict the movement
-						//don't enter slime or lava and don't fall from too high
-						if (move.frames < 30 && 
-								!(move.stopevent & (SE_ENTERSLIME|SE_ENTERLAVA|SE_HITGROUNDDAMAGE))
-								&& (move.stopevent & (SE_HITGROUNDAREA|SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER)))
+						//direction towards the face center
+						VectorSubtract(facecenter, areastart, dir);
+						dir[2] = 0;
+						//hordist = VectorNormalize(dir);
+						//if (hordist < 1.6 * facecenter[2] - areastart[2])
+						{
+							//get command movement
+							VectorScale(dir, speed, cmdmove);
+							//
+							VectorCopy(facecenter, facecenters[numpredict]);
+							AAS_SetPredictMove(&predict[numpredict], -1, areastart, PRESENCE_NORMAL, qfalse,
+												velocity, cmdmove, 30, 30, 0.1f,
+												SE_ENTERWATER|SE_ENTERSLIME|
+												SE_ENTERLAVA|SE_HITGROUNDDAMAGE|
+												SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER|SE_HITGROUNDAREA, area2num,
+												vec3_origin, vec3_origin, visualize);
+							numpredict++;
+						} //end if
+					} //end if
+				} //end for
+				AAS_PredictClientMovements(moves, predict, numpredict);
+				//handle the predictions in face order
+				for (k = 0; k < numpredict; k++)
+				{
+					//if prediction time wasn't enough to fully predict the movement
+					//don't enter slime or lava and don't fall from too high
+					if (moves[k].frames < 30 && 
+							!(moves[k].stopevent & (SE_ENTERSLIME|SE_ENTERLAVA|SE_HITGROUNDDAMAGE))
+							&& (moves[k].stopevent & (SE_HITGROUNDAREA|SE_TOUCHJUMPPAD|SE_TOUCHTELEPORTER)))
+					{
+						//never go back to the same jumppad
+						for (link = areas; link; link = link->next_area)
+						{
+							if (link->areanum == moves[k].endarea) break;
+						}
+						if (!link)
 						{
-							//never go back to the same jumppad
 							for (link = areas; link; link = link->next_area)
 							{
-								if (link->areanum == move.endarea) break;
-							}
-							if (!link)
-							{
-								for (link = areas; link; link = link->next_area)
+								if (!AAS_AreaJumpPad(link->areanum)) continue;
+								if (AAS_ReachabilityExists(link->areanum, area2num)) continue;
+								//create a jumppad reachability from area1 to area2
+								lreach = AAS_AllocReachability();
+								if (!lreach)
 								{
-									if (!AAS_AreaJumpPad(link->areanum)) continue;
-									if (AAS_ReachabilityExists(link->areanum, area2num)) continue;
-									//create a jumppad reachability from area1 to area2
-									lreach = AAS_AllocReachability();
-									if (!lreach)
-									{
-										AAS_UnlinkFromAreas(areas);
-										return;
-									} //end if
-									lreach->areanum = move.endarea;
-									//NOTE: the facenum is the Z velocity
-									lreach->facenum = velocity[2];
-									//NOTE: the edgenum is the horizontal velocity
-									lreach->edgenum = sqrt(cmdmove[0] * cmdmove[0] + cmdmove[1] * cmdmove[1]);
-									VectorCopy(areastart, lreach->start);
-									VectorCopy(facecenter, lreach->end);
-									lreach->traveltype = TRAVEL_JUMPPAD;
-									lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
-									lreach->traveltime = aassettings.rs_aircontrolledjumppad;
-									lreach->next = areareachability[link->areanum];
-									areareachability[link->areanum] = lreach;
-									//
-									reach_jumppad++;
-								} //end for
-							}
-						} //end if
+									AAS_UnlinkFromAreas(areas);
+									return;
+								} //end if
+								lreach->areanum = moves[k].endarea;
+								//NOTE: the facenum is the Z velocity
+								lreach->facenum = velocity[2];
+								//NOTE: the edgenum is the horizontal velocity
+								lreach->edgenum = sqrt(predict[k].cmdmove[0] * predict[k].cmdmove[0] + predict[k].cmdmove[1] * predict[k].cmdmove[1]);
+								VectorCopy(areastart, lreach->start);
+								VectorCopy(facecenters[k], lreach->end);
+								lreach->traveltype = TRAVEL_JUMPPAD;
+								lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
+								lreach->traveltime = aassettings.rs_aircontrolledjumppad;
+								lreach->next = areareachability[link->areanum];
+								areareachability[link->areanum] = lreach;
+								//
+								reach_jumppad++;
+							} //end for
+						}
 					} //end if
 				} //end for
-			} //end for
+			} //end while
 		} //end for
 		AAS_UnlinkFromAreas(areas);
 	} //end for
@@ -4007,15 +4024,17 @@ static void AAS_SetWeaponJumpAreaFlags(void)
 //===========================================================================
 int AAS_Reachability_WeaponJump(int area1num, int area2num)
 {
-	int face2num, i, n, ret, visualize;
+	int face2num, i, k, n, ret, visualize;
+	int numpredict, weapons[MAX_PREDICTMOVES];
 	float speed, zvel;
 	//float hordist;
 	aas_face_t *face2;
 	aas_area_t *area1, *area2;
 	aas_lreachability_t *lreach;
 	vec3_t areastart, facecenter, start, end, dir, cmdmove;// teststart;
-	vec3_t velocity;
-	aas_clientmove_t move;
+	vec3_t velocity, facecenters[MAX_PREDICTMOVES];
+	aas_clientmove_t moves[MAX_PREDICTMOVES];
+	aas_predictmove_t predict[MAX_PREDICTMOVES];
 	aas_trace_t trace;
 
 	visualize = qfalse;
@@ -4045,82 +4064,97 @@ int AAS_Reachability_WeaponJump(int area1num, int area2num)
 	//
 	//areastart is now the start point
 	//
-	for (i = 0; i < area2->numfaces; i++)
+	//predict the jumps towards all ground faces of the area side by side
+	i = 0;
+	while (i < area2->numfaces)
 	{
-		face2num = aasworld.faceindex[area2->firstface + i];
-		face2 = &aasworld.faces[abs(face2num)];
-		//if it is not a solid face
-		if (!(face2->faceflags & FACE_GROUND)) continue;
-		//get the center of the face
-		AAS_FaceCenter(face2num, facecenter);
-		//only go higher up with weapon jumps
-		if (facecenter[2] < areastart[2] + 64) continue;
-		//NOTE: set to 2 to allow bfg jump reachabilities
-		for (n = 0; n < 1/*2*/; n++)
+		numpredict = 0;
+		for (; i < area2->numfaces && numpredict < MAX_PREDICTMOVES; i++)
 		{
-			//get the weapon jump z velocity
-			if (n) zvel = AAS_BFGJumpZVelocity(areastart);
-			else zvel = AAS_RocketJumpZVelocity(areastart);
-			//get the horizontal speed for the jump, if it isn't possible to calculate this
-			//speed (the jump is not possible) then there's no jump reachability created
-			ret = AAS_HorizontalVelocityForJump(zvel, areastart, facecenter, &speed);
-			if (ret && speed < 300)
+			face2num = aasworld.faceindex[area2->firstface + i];
+			face2 = &aasworld.faces[abs(face2num)];
+			//if it is not a solid face
+			if (!(face2->faceflags & FACE_GROUND)) continue;
+			//get the center of the face
+			AAS_FaceCenter(face2num, facecenter);
+			//only go higher up with weapon jumps
+			if (facecenter[2] < areastart[2] + 64) continue;
+			//NOTE: set to 2 to allow bfg jump reachabilities
+			for (n = 0; n < 1/*2*/; n++)
 			{
-				//direction towards the face center
-				VectorSubtract(facecenter, areastart, dir);
-				dir[2] = 0;
-				//hordist = VectorNormalize(dir);
-				//if (hordist < 1.6 * (facecenter[2] - areastart[2]))
+				//get the weapon jump z velocity
+				if (n) zvel = AAS_BFGJumpZVelocity(areastart);
+				else zvel = AAS_RocketJumpZVelocity(areastart);
+				//get the horizontal speed for the jump, if it isn't possible to calculate this
+				//speed (the jump is not possible) then there's no jump reachability created
+				ret = AAS_HorizontalVelocityForJump(zvel, areastart, facecenter, &speed);
+				if (ret && speed < 300)
 				{
-					//get command movement
-					VectorScale(dir, speed, cmdmove);
-					VectorSet(velocity, 0, 0, zvel);
-					/*
-					//get command movement
-					VectorScale(dir, speed, velocity);
-					velocity[2] = zvel;
-					VectorSet(cmdmove, 0, 0, 0);
-					*/
-					//
-					AAS_PredictClientMovement(&move, -1, areastart, PRESENCE_NORMAL, qtrue,
-												velocity, cmdmove, 30, 30, 0.1f,
-												SE_ENTERWATER|SE_ENTERSLIME|
-												SE_ENTERLAVA|SE_HITGROUNDDAMAGE|
-												SE_TOUCHJUMPPAD|SE_HITGROUND|SE_HITGROUNDAREA, area2num, visualize);
-					//if prediction time wasn't enough to fully predict the movement
-					//don't enter slime or lava and don't fall from too high
-					if (move.frames < 30 && 
-							!(move.stopevent & (SE_ENTERSLIME|SE_ENTERLAVA|SE_HITGROUNDDAMAGE))
-								&& (move.stopevent & (SE_HITGROUNDAREA|SE_TOUCHJUMPPAD)))
+					//direction towards the face center
+					VectorSubtract(facecenter, areastart, dir);
+					dir[2] = 0;
+					//hordist = VectorNormalize(dir);
+					//if (hordist < 1.6 * (facecenter[2] - areastart[2]))
 					{
-						//create a rocket or bfg jump reachability from area1 to area2
-						lreach = AAS_AllocReachability();
-						if (!lreach) return qfalse;
-						lreach->areanum = area2num;
-						lreach->facenum = 0;
-						lreach->edgenum = 0;
-						VectorCopy(areastart, lreach->start);
-						VectorCopy(facecenter, lreach->end);
-						if (n)
-						{
-							lreach->traveltype = TRAVEL_BFGJUMP;
-							lreach->traveltime = aassettings.rs_bfgjump;
-						} //end if
-						else
-						{
-							lreach->traveltype = TRAVEL_ROCKETJUMP;
-							lreach->traveltime = aassettings.rs_rocketjump;
-						} //end else
-						lreach->next = areareachability[area1num];
-						areareachability[area1num] = lreach;
+						//get command movement
+						VectorScale(dir, speed, cmdmove);
+						VectorSet(velocity, 0, 0, zvel);
+						/*
+						//get command movement
+						VectorScale(dir, speed, velocity);
+						velocity[2] = zvel;
+						VectorSet(cmdmove, 0, 0, 0);
+						*/
 						//
-						reach_rocketjump++;
-						return qtrue;
+						VectorCopy(facecenter, facecenters[numpredict]);
+						weapons[numpredict] = n;
+						AAS_SetPredictMove(&predict[numpredict], -1, areastart, PRESENCE_NORMAL, qtrue,
+											velocity, cmdmove, 30, 30, 0.1f,
+											SE_ENTERWATER|SE_ENTERSLIME|
+											SE_ENTERLAVA|SE_HITGROUNDDAMAGE|
+											SE_TOUCHJUMPPAD|SE_HITGROUND|SE_HITGROUNDAREA, area2num,
+											vec3_origin, vec3_origin, visualize);
+						numpredict++;
 					} //end if
 				} //end if
+			} //end for
+		} //end for
+		AAS_PredictClientMovements(moves, predict, numpredict);
+		//the first face in order that can be reached wins
+		for (k = 0; k < numpredict; k++)
+		{
+			//if prediction time wasn't enough to fully predict the movement
+			//don't enter slime or lava and don't fall from too high
+			if (moves[k].frames < 30 && 
+					!(moves[k].stopevent & (SE_ENTERSLIME|SE_ENTERLAVA|SE_HITGROUNDDAMAGE))
+						&& (moves[k].stopevent & (SE_HITGROUNDAREA|SE_TOUCHJUMPPAD)))
+			{
+				//create a rocket or bfg jump reachability from area1 to area2
+				lreach = AAS_AllocReachability();
+				if (!lreach) return qfalse;
+				lreach->areanum = area2num;
+				lreach->facenum = 0;
+				lreach->edgenum = 0;
+				VectorCopy(areastart, lreach->start);
+				VectorCopy(facecenters[k], lreach->end);
+				if (weapons[k])
+				{
+					lreach->traveltype = TRAVEL_BFGJUMP;
+					lreach->traveltime = aassettings.rs_bfgjump;
+				} //end if
+				else
+				{
+					lreach->traveltype = TRAVEL_ROCKETJUMP;
+					lreach->traveltime = aassettings.rs_rocketjump;
+				} //end else
+				lreach->next = areareachability[area1num];
+				areareachability[area1num] = lreach;
+				//
+				reach_rocketjump++;
+				return qtrue;
 			} //end if
 		} //end for
-	} //end for
+	} //end while
 	//
 	return qfalse;
 } //end of the function AAS_Reachability_WeaponJump
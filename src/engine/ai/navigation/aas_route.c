@@ -38,6 +38,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../util/script.h"
 #include "../util/precomp.h"
 #include "../util/struct.h"
+#include "../util/schedule.h"
 #include "../navigation/aasfile.h"
 #include "../ai_public.h"
 #include "../navigation/aas.h"
@@ -83,6 +84,8 @@ int numportalcacheupdates;
 
 int routingcachesize;
 int max_routingcachesize;
+//changes whenever travel times may have changed
+static int routinggeneration;
 
 //===========================================================================
 //
@@ -298,6 +301,7 @@ static void AAS_RemoveRoutingCacheUsingArea( int areanum )
 		} //end for
 		aasworld.portalcache[i] = NULL;
 	} //end for
+	routinggeneration++;
 } //end of the function AAS_RemoveRoutingCacheUsingArea
 //===========================================================================
 //
@@ -334,6 +338,17 @@ int AAS_EnableRoutingArea(int areanum, int enable)
 	return !flags;
 } //end of the function AAS_EnableRoutingArea
 //===========================================================================
+// returns a number that changes whenever travel times may have changed
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_RoutingGeneration(void)
+{
+	return routinggeneration;
+} //end of the function AAS_RoutingGeneration
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1244,6 +1259,7 @@ void AAS_InitRouting(void)
 	//
 	routingcachesize = 0;
 	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
+	routinggeneration++;
 	// read any routing cache if available
 	AAS_ReadRouteCache();
 } //end of the function AAS_InitRouting
@@ -1429,7 +1445,10 @@ static aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum,
 		cache->next = clustercache;
 		if (clustercache) clustercache->prev = cache;
 		aasworld.clusterareacache[clusternum][clusterareanum] = cache;
+		//routing updates are never deferred but use up the bot think budget
+		BotScheduleWork(BOTTASK_ROUTING, aasworld.clusters[clusternum].numreachabilityareas);
 		AAS_UpdateAreaRoutingCache(cache);
+		BotScheduleTaskDone(BOTTASK_ROUTING);
 	} //end if
 	else
 	{
@@ -1569,7 +1588,9 @@ static aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum
 		if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
 		aasworld.portalcache[areanum] = cache;
 		//update the cache
+		BotScheduleWork(BOTTASK_ROUTING, aasworld.numportals);
 		AAS_UpdatePortalRoutingCache(cache);
+		BotScheduleTaskDone(BOTTASK_ROUTING);
 	} //end if
 	else
 	{
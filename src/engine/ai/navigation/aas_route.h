@@ -55,6 +55,8 @@ void AAS_ReachabilityFromNum(int num, struct aas_reachability_s *reach);
 int AAS_RandomGoalArea(int areanum, int travelflags, int *goalareanum, vec3_t goalorigin);
 //enable or disable an area for routing
 int AAS_EnableRoutingArea(int areanum, int enable);
+//returns a number that changes whenever travel times may have changed
+int AAS_RoutingGeneration(void);
 //returns the travel time within the given area from start to end
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //returns the travel time from the area to the goal area using the given travel flags
@@ -53,6 +53,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define TRACEPLANE_EPSILON			0.125
 
+#define POINTGRID_CELLSIZE			128
+#define POINTGRID_MAXCELLS			(1 << 18)
+#define POINTGRID_PLANE_EPSILON		0.125		//cells closer to a plane stay above it
+#define POINTCACHE_SIZE				256			//must be a power of two
+
 typedef struct aas_tracestack_s
 {
 	vec3_t start;		//start point of the piece of line to trace
@@ -61,8 +66,18 @@ typedef struct aas_tracestack_s
 	int nodenum;		//node found after splitting with planenum
 } aas_tracestack_t;
 
+typedef struct aas_pointcache_s
+{
+	vec3_t point;
+	int areanum;
+} aas_pointcache_t;
+
 static int numaaslinks;
 
+//0 = always descend from the root, 1 = start at the point grid, 2 = verify the grid
+static int pointgridmode;
+static aas_pointcache_t pointcache[POINTCACHE_SIZE];
+
 //===========================================================================
 //
 // Parameter:				-
@@ -203,27 +218,218 @@ void AAS_FreeAASLinkedEntities(void)
 	aasworld.arealinkedentities = NULL;
 } //end of the function AAS_InitAASLinkedEntities
 //===========================================================================
-// returns the AAS area the point is in
+// returns which side of the plane the whole box is on, 0 = front,
+// 1 = back, -1 = the box is too close to or crosses the plane
 //
 // Parameter:				-
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
-int AAS_PointAreaNum(vec3_t point)
+static int AAS_PointGridBoxSide(vec3_t mins, vec3_t maxs, aas_plane_t *plane)
 {
-	int nodenum;
-	vec_t	dist;
+	int i;
+	double mindist, maxdist;
+
+	mindist = maxdist = -plane->dist;
+	for (i = 0; i < 3; i++)
+	{
+		if (plane->normal[i] > 0)
+		{
+			mindist += (double) plane->normal[i] * mins[i];
+			maxdist += (double) plane->normal[i] * maxs[i];
+		} //end if
+		else
+		{
+			mindist += (double) plane->normal[i] * maxs[i];
+			maxdist += (double) plane->normal[i] * mins[i];
+		} //end else
+	} //end for
+	if (mindist > POINTGRID_PLANE_EPSILON) return 0;
+	if (maxdist < -POINTGRID_PLANE_EPSILON) return 1;
+	return -1;
+} //end of the function AAS_PointGridBoxSide
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreePointGrid(void)
+{
+	if (aasworld.pointgrid) FreeMemory(aasworld.pointgrid);
+	aasworld.pointgrid = NULL;
+	if (aasworld.nodeparents) FreeMemory(aasworld.nodeparents);
+	aasworld.nodeparents = NULL;
+	if (aasworld.nodedepths) FreeMemory(aasworld.nodedepths);
+	aasworld.nodedepths = NULL;
+	VectorClear(aasworld.pointgridsize);
+	Com_Memset(pointcache, 0, sizeof(pointcache));
+} //end of the function AAS_FreePointGrid
+//===========================================================================
+// stores for every grid cell the deepest node the cell lies fully on one
+// side of all parent planes of, the BSP descent of any point or line in
+// the cell never splits before that node so it can start there
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitPointGrid(void)
+{
+	int i, j, x, y, z, side, nodenum, child, numcells, *stack, stacksize;
+	float cellsize;
+	vec3_t mins, maxs, cellmins, cellmaxs;
 	aas_node_t *node;
-	aas_plane_t *plane;
 
-	if (!aasworld.loaded)
+	AAS_FreePointGrid();
+#ifdef BSPC
+	pointgridmode = 1;
+#else
+	pointgridmode = (int) LibVarValue("bot_aasgrid", "1");
+#endif
+	if (!aasworld.loaded || pointgridmode <= 0) return;
+	if (aasworld.numnodes < 2 || aasworld.numareas < 2) return;
+	//parent and depth of every node, used to find the node where a line splits
+	aasworld.nodeparents = (int *) GetMemory(aasworld.numnodes * sizeof(int));
+	aasworld.nodedepths = (int *) GetClearedMemory(aasworld.numnodes * sizeof(int));
+	for (i = 0; i < aasworld.numnodes; i++) aasworld.nodeparents[i] = 0;
+	stack = (int *) GetMemory(aasworld.numnodes * sizeof(int));
+	stacksize = 0;
+	stack[stacksize++] = 1;
+	while (stacksize > 0)
 	{
-		botimport.Print(PRT_ERROR, "AAS_PointAreaNum: aas not loaded\n");
-		return 0;
-	} //end if
+		nodenum = stack[--stacksize];
+		node = &aasworld.nodes[nodenum];
+		for (j = 0; j < 2; j++)
+		{
+			child = node->children[j];
+			if (child <= 0) continue;
+			if (child >= aasworld.numnodes || child == 1 || aasworld.nodeparents[child])
+			{
+				//not a plain tree, traces through several cells start at the root
+				aasworld.nodeparents[1] = -1;
+				stacksize = 0;
+				break;
+			} //end if
+			aasworld.nodeparents[child] = nodenum;
+			aasworld.nodedepths[child] = aasworld.nodedepths[nodenum] + 1;
+			stack[stacksize++] = child;
+		} //end for
+	} //end while
+	FreeMemory(stack);
+	//bounds of the world
+	ClearBounds(mins, maxs);
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		AddPointToBounds(aasworld.areas[i].mins, mins, maxs);
+		AddPointToBounds(aasworld.areas[i].maxs, mins, maxs);
+	} //end for
+	//grow the cells until the grid is small enough
+	for (cellsize = POINTGRID_CELLSIZE; ; cellsize *= 2)
+	{
+		numcells = 1;
+		for (i = 0; i < 3; i++)
+		{
+			aasworld.pointgridsize[i] = (int) ((maxs[i] - mins[i]) / cellsize) + 1;
+			numcells *= aasworld.pointgridsize[i];
+		} //end for
+		if (numcells <= POINTGRID_MAXCELLS) break;
+	} //end for
+	aasworld.pointgridcellsize = cellsize;
+	VectorCopy(mins, aasworld.pointgridmins);
+	aasworld.pointgrid = (int *) GetMemory(numcells * sizeof(int));
+	i = 0;
+	for (z = 0; z < aasworld.pointgridsize[2]; z++)
+	{
+		for (y = 0; y < aasworld.pointgridsize[1]; y++)
+		{
+			for (x = 0; x < aasworld.pointgridsize[0]; x++)
+			{
+				//pad the cell so points rounded into a neighbour cell are covered as well
+				cellmins[0] = mins[0] + x * cellsize - 1;
+				cellmins[1] = mins[1] + y * cellsize - 1;
+				cellmins[2] = mins[2] + z * cellsize - 1;
+				cellmaxs[0] = cellmins[0] + cellsize + 2;
+				cellmaxs[1] = cellmins[1] + cellsize + 2;
+				cellmaxs[2] = cellmins[2] + cellsize + 2;
+				//stop at the last node, the leaf test is as cheap as the cell lookup
+				nodenum = 1;
+				while (1)
+				{
+					node = &aasworld.nodes[nodenum];
+					side = AAS_PointGridBoxSide(cellmins, cellmaxs, &aasworld.planes[node->planenum]);
+					if (side < 0 || node->children[side] <= 0) break;
+					nodenum = node->children[side];
+				} //end while
+				aasworld.pointgrid[i++] = nodenum;
+			} //end for
+		} //end for
+	} //end for
+	botimport.Print(PRT_MESSAGE, "AAS point grid %d x %d x %d cells of %d units\n",
+						aasworld.pointgridsize[0], aasworld.pointgridsize[1],
+						aasworld.pointgridsize[2], (int) cellsize);
+} //end of the function AAS_InitPointGrid
+//===========================================================================
+// returns the node the BSP descent for the point can start with
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_PointGridNode(vec3_t point)
+{
+	int i, cell[3];
+	float f;
+
+	if (!aasworld.pointgrid || pointgridmode <= 0) return 1;
+	for (i = 0; i < 3; i++)
+	{
+		f = (point[i] - aasworld.pointgridmins[i]) / aasworld.pointgridcellsize;
+		//also rejects NaN
+		if (!(f >= 0 && f < aasworld.pointgridsize[i])) return 1;
+		cell[i] = (int) f;
+	} //end for
+	return aasworld.pointgrid[(cell[2] * aasworld.pointgridsize[1] + cell[1]) *
+								aasworld.pointgridsize[0] + cell[0]];
+} //end of the function AAS_PointGridNode
+//===========================================================================
+// returns the node the BSP descent for the line from start to end can start
+// with, which is the deepest node both end points share
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_LineGridNode(vec3_t start, vec3_t end)
+{
+	int node1, node2;
+
+	node1 = AAS_PointGridNode(start);
+	node2 = AAS_PointGridNode(end);
+	if (node1 == node2) return node1;
+	if (node1 == 1 || node2 == 1 || aasworld.nodeparents[1] < 0) return 1;
+	while (aasworld.nodedepths[node1] > aasworld.nodedepths[node2]) node1 = aasworld.nodeparents[node1];
+	while (aasworld.nodedepths[node2] > aasworld.nodedepths[node1]) node2 = aasworld.nodeparents[node2];
+	while (node1 != node2)
+	{
+		node1 = aasworld.nodeparents[node1];
+		node2 = aasworld.nodeparents[node2];
+	} //end while
+	return node1;
+} //end of the function AAS_LineGridNode
+//===========================================================================
+// returns the AAS area the point is in, starting at the given node
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_PointAreaNumFromNode(vec3_t point, int nodenum)
+{
+	vec_t	dist;
+	aas_node_t *node;
+	aas_plane_t *plane;
 
-	//start with node 1 because node zero is a dummy used for solid leafs
-	nodenum = 1;
 	while (nodenum > 0)
 	{
 //		botimport.Print(PRT_MESSAGE, "[%d]", nodenum);
@@ -255,6 +461,58 @@ int AAS_PointAreaNum(vec3_t point)
 		return 0;
 	} //end if
 	return -nodenum;
+} //end of the function AAS_PointAreaNumFromNode
+//===========================================================================
+// returns the AAS area the point is in
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AAS_PointAreaNum(vec3_t point)
+{
+	int areanum, nodenum;
+	unsigned int hash;
+	floatint_t bits[3];
+	aas_pointcache_t *cache;
+
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_PointAreaNum: aas not loaded\n");
+		return 0;
+	} //end if
+
+	if (pointgridmode <= 0 || !aasworld.pointgrid)
+	{
+		//start with node 1 because node zero is a dummy used for solid leafs
+		return AAS_PointAreaNumFromNode(point, 1);
+	} //end if
+	//the same origins are sampled many times each frame
+	bits[0].f = point[0];
+	bits[1].f = point[1];
+	bits[2].f = point[2];
+	hash = bits[0].u * 73856093u ^ bits[1].u * 19349663u ^ bits[2].u * 83492791u;
+	cache = &pointcache[(hash ^ (hash >> 16)) & (POINTCACHE_SIZE - 1)];
+	if (cache->areanum && VectorCompare(cache->point, point))
+	{
+		areanum = cache->areanum;
+	} //end if
+	else
+	{
+		nodenum = AAS_PointGridNode(point);
+		areanum = AAS_PointAreaNumFromNode(point, nodenum);
+		if (areanum)
+		{
+			VectorCopy(point, cache->point);
+			cache->areanum = areanum;
+		} //end if
+	} //end else
+	if (pointgridmode >= 2 && areanum != AAS_PointAreaNumFromNode(point, 1))
+	{
+		botimport.Print(PRT_ERROR, "AAS_PointAreaNum: grid area %d != %d at (%f %f %f)\n",
+							areanum, AAS_PointAreaNumFromNode(point, 1), point[0], point[1], point[2]);
+	} //end if
+	return areanum;
 } //end of the function AAS_PointAreaNum
 //===========================================================================
 //
@@ -470,7 +728,8 @@ aas_trace_t AAS_TraceClientBBox(vec3_t start, vec3_t end, int presencetype,
 	VectorCopy(end, tstack_p->end);
 	tstack_p->planenum = 0;
 	//start with node 1 because node zero is a dummy for a solid leaf
-	tstack_p->nodenum = 1;		//starting at the root of the tree
+	//the line is not split above the node shared by the grid cells of both end points
+	tstack_p->nodenum = AAS_LineGridNode(start, end);
 	tstack_p++;
 	
 	while (1)
@@ -745,7 +1004,8 @@ int AAS_TraceAreas(vec3_t start, vec3_t end, int *areas, vec3_t *points, int max
 	VectorCopy(end, tstack_p->end);
 	tstack_p->planenum = 0;
 	//start with node 1 because node zero is a dummy for a solid leaf
-	tstack_p->nodenum = 1;		//starting at the root of the tree
+	//the line is not split above the node shared by the grid cells of both end points
+	tstack_p->nodenum = AAS_LineGridNode(start, end);
 	tstack_p++;
 
 	while (1)
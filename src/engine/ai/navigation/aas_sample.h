@@ -34,6 +34,8 @@ void AAS_InitAASLinkHeap(void);
 void AAS_InitAASLinkedEntities(void);
 void AAS_FreeAASLinkHeap(void);
 void AAS_FreeAASLinkedEntities(void);
+void AAS_InitPointGrid(void);
+void AAS_FreePointGrid(void);
 #if 0
 aas_face_t *AAS_AreaGroundFace(int areanum, vec3_t point);
 #endif
@@ -54,11 +54,13 @@ typedef enum {qfalse, qtrue}	qboolean;
 
 #ifdef BOTLIB
 #include "../../common/q_shared.h"
+#include "../../core/qcommon.h"
 #include "../ai_public.h"
 #include "../ai_interface.h"
 #include "../util/memory.h"
 #include "../util/script.h"
 #include "../util/precomp.h"
+#include "../util/libvar.h"
 #include "../util/log.h"
 #endif //BOTLIB
 
@@ -119,6 +121,71 @@ token_t *freetokens;					//free tokens from the heap
 //list with global defines added to every source loaded
 static define_t *globaldefines;
 
+#ifdef BOTLIB
+//file read while preprocessing a cached source
+typedef struct sourcecachefile_s
+{
+	char filename[MAX_QPATH];
+	int length;
+	unsigned int crc;
+} sourcecachefile_t;
+
+//preprocessed token
+typedef struct cachedtoken_s
+{
+	int string;							//offset in the string pool
+	int type;
+	int subtype;
+	unsigned long int intvalue;
+	float floatvalue;
+	int line;							//line in the file the token was read from
+	int file;							//file the token was read from
+} cachedtoken_t;
+
+//all the preprocessed tokens of a source
+typedef struct sourcecache_s
+{
+	char name[MAX_QPATH * 2];			//base folder and file name
+	unsigned int definecrc;				//crc of the global defines
+	int numfiles;						//the source file and all the included files
+	sourcecachefile_t *files;
+	int numtokens;
+	cachedtoken_t *tokens;
+	int stringsize;
+	char *strings;
+	int refs;							//number of sources reading from the cache
+	qboolean linked;					//true when in the cache list
+	struct sourcecache_s *next;
+} sourcecache_t;
+
+//header of a source cache written to disk
+typedef struct sourcecacheheader_s
+{
+	int ident;
+	int version;
+	int tokensize;
+	char name[MAX_QPATH * 2];
+	unsigned int definecrc;
+	int numfiles;
+	int numtokens;
+	int stringsize;
+} sourcecacheheader_t;
+
+#define SCID						(('H'<<24)+('C'<<16)+('C'<<8)+'P')
+#define SCVERSION					1
+
+#define MAX_SOURCECACHEFILES		64
+
+//cached preprocessed sources
+static sourcecache_t *sourcecache;
+//files read while building a source cache
+static source_t *cachebuildsource;
+static sourcecachefile_t cachebuildfiles[MAX_SOURCECACHEFILES];
+static int numcachebuildfiles;
+//number of errors reported so far
+static int numsourceerrors;
+#endif //BOTLIB
+
 //============================================================================
 //
 // Parameter:				-
@@ -134,6 +201,7 @@ void QDECL SourceError(source_t *source, const char *fmt, ...)
 	Q_vsnprintf(text, sizeof(text), fmt, ap);
 	va_end(ap);
 #ifdef BOTLIB
+	numsourceerrors++;
 	botimport.Print(PRT_ERROR, "file %s, line %d: %s\n", source->scriptstack->filename, source->scriptstack->line, text);
 #endif	//BOTLIB
 #ifdef MEQCC
@@ -210,6 +278,31 @@ static void PC_PopIndent(source_t *source, int *type, int *skip)
 	source->skip -= indent->skip;
 	FreeMemory(indent);
 } //end of the function PC_PopIndent
+#ifdef BOTLIB
+//============================================================================
+// remembers a file read while building a source cache
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_AddSourceCacheFile(const script_t *script)
+{
+	sourcecachefile_t *file;
+
+	//too many files to cache the source
+	if (numcachebuildfiles < 0) return;
+	if (numcachebuildfiles >= MAX_SOURCECACHEFILES)
+	{
+		numcachebuildfiles = -1;
+		return;
+	} //end if
+	file = &cachebuildfiles[numcachebuildfiles++];
+	Q_strncpyz(file->filename, script->filename, sizeof(file->filename));
+	file->length = script->length;
+	file->crc = crc32_buffer((byte *) script->buffer, script->length);
+} //end of the function PC_AddSourceCacheFile
+#endif //BOTLIB
 //============================================================================
 //
 // Parameter:				-
@@ -231,6 +324,9 @@ static void PC_PushScript(source_t *source, script_t *script)
 	//push the script on the script stack
 	script->next = source->scriptstack;
 	source->scriptstack = script;
+#ifdef BOTLIB
+	if (source == cachebuildsource) PC_AddSourceCacheFile(script);
+#endif //BOTLIB
 } //end of the function PC_PushScript
 //============================================================================
 //
@@ -2714,6 +2810,56 @@ static int QuakeCMacro(source_t *source)
 	return qtrue;
 } //end of the function QuakeCMacro
 #endif //QUAKEC
+#ifdef BOTLIB
+//============================================================================
+// reads the next preprocessed token from the source cache
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static int PC_ReadCachedToken(source_t *source, token_t *token)
+{
+	const sourcecache_t *cache;
+	const cachedtoken_t *ct;
+	token_t *t;
+
+	//unread tokens are read first
+	if (source->tokens)
+	{
+		Com_Memcpy(token, source->tokens, sizeof(token_t));
+		t = source->tokens;
+		source->tokens = source->tokens->next;
+		PC_FreeToken(t);
+	} //end if
+	else
+	{
+		cache = source->cache;
+		if (source->cachetoken >= cache->numtokens) return qfalse;
+		ct = &cache->tokens[source->cachetoken++];
+		Q_strncpyz(token->string, &cache->strings[ct->string], sizeof(token->string));
+		token->type = ct->type;
+		token->subtype = ct->subtype;
+		token->intvalue = ct->intvalue;
+		token->floatvalue = ct->floatvalue;
+		token->whitespace_p = NULL;
+		token->endwhitespace_p = NULL;
+		token->line = ct->line;
+		token->linescrossed = 0;
+		token->next = NULL;
+		//keep the file and line up to date for error messages
+		if (source->cachetoken == 1 || ct->file != ct[-1].file)
+		{
+			Q_strncpyz(source->scriptstack->filename, cache->files[ct->file].filename,
+							sizeof(source->scriptstack->filename));
+		} //end if
+		source->scriptstack->line = ct->line;
+	} //end else
+	//copy token for unreading
+	Com_Memcpy(&source->token, token, sizeof(token_t));
+	return qtrue;
+} //end of the function PC_ReadCachedToken
+#endif //BOTLIB
 //============================================================================
 //
 // Parameter:				-
@@ -2724,6 +2870,9 @@ int PC_ReadToken(source_t *source, token_t *token)
 {
 	define_t *define;
 
+#ifdef BOTLIB
+	if (source->cache) return PC_ReadCachedToken(source, token);
+#endif //BOTLIB
 	while(1)
 	{
 		if (!PC_ReadSourceToken(source, token)) return qfalse;
@@ -3001,6 +3150,420 @@ void PC_SetPunctuations(source_t *source, punctuation_t *p)
 	source->punctuations = p;
 } //end of the function PC_SetPunctuations
 #endif
+#ifdef BOTLIB
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static sourcecache_t *PC_AllocSourceCache(int numfiles, int numtokens, int stringsize)
+{
+	sourcecache_t *cache;
+	char *ptr;
+
+	ptr = (char *) GetClearedMemory(sizeof(sourcecache_t) + numfiles * sizeof(sourcecachefile_t) +
+										numtokens * sizeof(cachedtoken_t) + stringsize);
+	cache = (sourcecache_t *) ptr;
+	ptr += sizeof(sourcecache_t);
+	cache->files = (sourcecachefile_t *) ptr;
+	ptr += numfiles * sizeof(sourcecachefile_t);
+	cache->tokens = (cachedtoken_t *) ptr;
+	ptr += numtokens * sizeof(cachedtoken_t);
+	cache->strings = ptr;
+	cache->numfiles = numfiles;
+	cache->numtokens = numtokens;
+	cache->stringsize = stringsize;
+	return cache;
+} //end of the function PC_AllocSourceCache
+//============================================================================
+// frees the cache once it is no longer in the cache list and no
+// source reads from it
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_ReleaseSourceCache(sourcecache_t *cache)
+{
+	if (cache->refs > 0) cache->refs--;
+	if (!cache->refs && !cache->linked) FreeMemory(cache);
+} //end of the function PC_ReleaseSourceCache
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_UnlinkSourceCache(sourcecache_t *cache)
+{
+	sourcecache_t **prev;
+
+	for (prev = &sourcecache; *prev; prev = &(*prev)->next)
+	{
+		if (*prev == cache)
+		{
+			*prev = cache->next;
+			break;
+		} //end if
+	} //end for
+	cache->next = NULL;
+	cache->linked = qfalse;
+	if (!cache->refs) FreeMemory(cache);
+} //end of the function PC_UnlinkSourceCache
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+void PC_ShutdownSourceCache(void)
+{
+	sourcecache_t *cache;
+
+	while(sourcecache)
+	{
+		cache = sourcecache;
+		PC_UnlinkSourceCache(cache);
+	} //end while
+} //end of the function PC_ShutdownSourceCache
+//============================================================================
+// the global defines are part of the cache key because they change
+// the preprocessed tokens
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static unsigned int PC_GlobalDefinesCRC(void)
+{
+	const define_t *define;
+	const token_t *token;
+	unsigned int crc;
+
+	crc = 0;
+	for (define = globaldefines; define; define = define->next)
+	{
+		crc = crc * 33 + crc32_buffer((const byte *) define->name, strlen(define->name));
+		crc = crc * 33 + define->numparms;
+		for (token = define->parms; token; token = token->next)
+		{
+			crc = crc * 33 + crc32_buffer((const byte *) token->string, strlen(token->string));
+		} //end for
+		for (token = define->tokens; token; token = token->next)
+		{
+			crc = crc * 33 + crc32_buffer((const byte *) token->string, strlen(token->string));
+		} //end for
+	} //end for
+	return crc;
+} //end of the function PC_GlobalDefinesCRC
+//============================================================================
+// returns qtrue if none of the files the cache was built from changed,
+// the source file itself is already loaded so it is always compared by crc,
+// included files are only loaded and compared by crc when full is set and
+// otherwise just have their length checked
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static qboolean PC_SourceCacheValid(const sourcecache_t *cache, const script_t *script, qboolean full)
+{
+	const sourcecachefile_t *file;
+	script_t *s;
+	qboolean valid;
+	int i;
+
+	file = &cache->files[0];
+	if (file->length != script->length ||
+		file->crc != crc32_buffer((byte *) script->buffer, script->length))
+	{
+		return qfalse;
+	} //end if
+	for (i = 1; i < cache->numfiles; i++)
+	{
+		file = &cache->files[i];
+		if (!full)
+		{
+			if (PS_FileLength(file->filename) != file->length) return qfalse;
+			continue;
+		} //end if
+		s = LoadScriptFile(file->filename);
+		if (!s) return qfalse;
+		valid = (file->length == s->length && file->crc == crc32_buffer((byte *) s->buffer, s->length));
+		FreeScript(s);
+		if (!valid) return qfalse;
+	} //end for
+	return qtrue;
+} //end of the function PC_SourceCacheValid
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_SourceCachePath(const char *name, unsigned int definecrc, char *path, int size)
+{
+	char filename[MAX_QPATH];
+	int i;
+
+	Q_strncpyz(filename, name, sizeof(filename));
+	for (i = 0; filename[i]; i++)
+	{
+		if (!isalnum(filename[i]) && filename[i] != '.' && filename[i] != '-') filename[i] = '_';
+	} //end for
+	Com_sprintf(path, size, "botcache/%s_%08x.pcc", filename, definecrc);
+} //end of the function PC_SourceCachePath
+//============================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_WriteSourceCache(const sourcecache_t *cache)
+{
+	sourcecacheheader_t header;
+	char path[MAX_QPATH * 2];
+	fileHandle_t fp;
+
+	PC_SourceCachePath(cache->name, cache->definecrc, path, sizeof(path));
+	botimport.FS_FOpenFile(path, &fp, FS_WRITE);
+	if (!fp) return;
+	Com_Memset(&header, 0, sizeof(header));
+	header.ident = SCID;
+	header.version = SCVERSION;
+	header.tokensize = sizeof(cachedtoken_t);
+	Q_strncpyz(header.name, cache->name, sizeof(header.name));
+	header.definecrc = cache->definecrc;
+	header.numfiles = cache->numfiles;
+	header.numtokens = cache->numtokens;
+	header.stringsize = cache->stringsize;
+	botimport.FS_Write(&header, sizeof(header), fp);
+	botimport.FS_Write(cache->files, cache->numfiles * sizeof(sourcecachefile_t), fp);
+	botimport.FS_Write(cache->tokens, cache->numtokens * sizeof(cachedtoken_t), fp);
+	botimport.FS_Write(cache->strings, cache->stringsize, fp);
+	botimport.FS_FCloseFile(fp);
+} //end of the function PC_WriteSourceCache
+//============================================================================
+// reads a source cache written by an earlier session, returns NULL if
+// there is none or it doesn't belong to this source and define set
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static sourcecache_t *PC_ReadSourceCache(const char *name, unsigned int definecrc)
+{
+	sourcecacheheader_t header;
+	sourcecache_t *cache;
+	char path[MAX_QPATH * 2];
+	fileHandle_t fp;
+	int length, i;
+
+	PC_SourceCachePath(name, definecrc, path, sizeof(path));
+	length = botimport.FS_FOpenFile(path, &fp, FS_READ);
+	if (!fp) return NULL;
+	if (length < (int) sizeof(header))
+	{
+		botimport.FS_FCloseFile(fp);
+		return NULL;
+	} //end if
+	botimport.FS_Read(&header, sizeof(header), fp);
+	header.name[sizeof(header.name) - 1] = '\0';
+	if (header.ident != SCID || header.version != SCVERSION ||
+		header.tokensize != sizeof(cachedtoken_t) ||
+		header.definecrc != definecrc || strcmp(header.name, name) ||
+		header.numfiles < 1 || header.numfiles > MAX_SOURCECACHEFILES ||
+		header.numtokens < 0 || header.stringsize < 1 ||
+		length != (int) (sizeof(header) + header.numfiles * sizeof(sourcecachefile_t) +
+							header.numtokens * sizeof(cachedtoken_t) + header.stringsize))
+	{
+		botimport.FS_FCloseFile(fp);
+		return NULL;
+	} //end if
+	cache = PC_AllocSourceCache(header.numfiles, header.numtokens, header.stringsize);
+	Q_strncpyz(cache->name, name, sizeof(cache->name));
+	cache->definecrc = definecrc;
+	botimport.FS_Read(cache->files, cache->numfiles * sizeof(sourcecachefile_t), fp);
+	botimport.FS_Read(cache->tokens, cache->numtokens * sizeof(cachedtoken_t), fp);
+	botimport.FS_Read(cache->strings, cache->stringsize, fp);
+	botimport.FS_FCloseFile(fp);
+	//make sure the cache can't be used to read outside the arrays
+	cache->strings[cache->stringsize - 1] = '\0';
+	for (i = 0; i < cache->numfiles; i++)
+	{
+		cache->files[i].filename[sizeof(cache->files[i].filename) - 1] = '\0';
+	} //end for
+	for (i = 0; i < cache->numtokens; i++)
+	{
+		if (cache->tokens[i].string < 0 || cache->tokens[i].string >= cache->stringsize ||
+			cache->tokens[i].file < 0 || cache->tokens[i].file >= cache->numfiles)
+		{
+			FreeMemory(cache);
+			return NULL;
+		} //end if
+	} //end for
+	return cache;
+} //end of the function PC_ReadSourceCache
+//============================================================================
+// preprocesses the whole source and stores the tokens, the cache is not
+// linked when preprocessing failed or too many files were included
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static sourcecache_t *PC_BuildSourceCache(source_t *source, const char *name, unsigned int definecrc)
+{
+	token_t token;
+	token_t *t;
+	cachedtoken_t *tokens, *ct;
+	char *strings, *newptr;
+	int numtokens, maxtokens, stringsize, maxstringsize, len, i, errors;
+	sourcecache_t *cache;
+
+	maxtokens = 1024;
+	tokens = (cachedtoken_t *) GetMemory(maxtokens * sizeof(cachedtoken_t));
+	maxstringsize = 16384;
+	strings = (char *) GetMemory(maxstringsize);
+	numtokens = 0;
+	stringsize = 0;
+	//remember all the files read
+	cachebuildsource = source;
+	numcachebuildfiles = 0;
+	PC_AddSourceCacheFile(source->scriptstack);
+	errors = numsourceerrors;
+	while(PC_ReadToken(source, &token))
+	{
+		if (numtokens >= maxtokens)
+		{
+			newptr = (char *) GetMemory(maxtokens * 2 * sizeof(cachedtoken_t));
+			Com_Memcpy(newptr, tokens, maxtokens * sizeof(cachedtoken_t));
+			FreeMemory(tokens);
+			tokens = (cachedtoken_t *) newptr;
+			maxtokens *= 2;
+		} //end if
+		len = strlen(token.string) + 1;
+		while(stringsize + len > maxstringsize)
+		{
+			newptr = (char *) GetMemory(maxstringsize * 2);
+			Com_Memcpy(newptr, strings, stringsize);
+			FreeMemory(strings);
+			strings = newptr;
+			maxstringsize *= 2;
+		} //end while
+		ct = &tokens[numtokens++];
+		ct->string = stringsize;
+		Com_Memcpy(&strings[stringsize], token.string, len);
+		stringsize += len;
+		ct->type = token.type;
+		ct->subtype = token.subtype;
+		ct->intvalue = token.intvalue;
+		ct->floatvalue = token.floatvalue;
+		ct->line = source->scriptstack->line;
+		ct->file = 0;
+		for (i = 0; i < numcachebuildfiles; i++)
+		{
+			if (!strcmp(cachebuildfiles[i].filename, source->scriptstack->filename))
+			{
+				ct->file = i;
+				break;
+			} //end if
+		} //end for
+	} //end while
+	cachebuildsource = NULL;
+	//free tokens left unread at the end of the source
+	while(source->tokens)
+	{
+		t = source->tokens;
+		source->tokens = source->tokens->next;
+		PC_FreeToken(t);
+	} //end while
+	//
+	if (!stringsize) strings[stringsize++] = '\0';
+	cache = PC_AllocSourceCache(numcachebuildfiles > 0 ? numcachebuildfiles : 1, numtokens, stringsize);
+	Q_strncpyz(cache->name, name, sizeof(cache->name));
+	cache->definecrc = definecrc;
+	if (numcachebuildfiles > 0)
+	{
+		Com_Memcpy(cache->files, cachebuildfiles, numcachebuildfiles * sizeof(sourcecachefile_t));
+	} //end if
+	Com_Memcpy(cache->tokens, tokens, numtokens * sizeof(cachedtoken_t));
+	Com_Memcpy(cache->strings, strings, stringsize);
+	FreeMemory(tokens);
+	FreeMemory(strings);
+	//only a source that preprocessed without errors is kept
+	if (numsourceerrors == errors && numcachebuildfiles > 0 &&
+		!source->scriptstack->next && EndOfScript(source->scriptstack))
+	{
+		cache->linked = qtrue;
+		cache->next = sourcecache;
+		sourcecache = cache;
+	} //end if
+	return cache;
+} //end of the function PC_BuildSourceCache
+//============================================================================
+// makes the source read its tokens from the cache, the cache is either
+// found in memory, read from disk or built by preprocessing the source
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+static void PC_CacheSource(source_t *source)
+{
+	char name[MAX_QPATH * 2];
+	unsigned int definecrc;
+	sourcecache_t *cache;
+	int mode;
+
+	//0 = no cache, 1 = cache in memory, 2 = also keep the cache on disk
+	mode = LibVarValue("bot_sourcecache", "2");
+	if (mode <= 0) return;
+	//
+	if (*PS_BaseFolder()) Com_sprintf(name, sizeof(name), "%s/%s", PS_BaseFolder(), source->filename);
+	else Q_strncpyz(name, source->filename, sizeof(name));
+	definecrc = PC_GlobalDefinesCRC();
+	for (cache = sourcecache; cache; cache = cache->next)
+	{
+		if (cache->definecrc == definecrc && !strcmp(cache->name, name)) break;
+	} //end for
+	//if any of the files changed the cache is rebuilt, a cache built or
+	//verified during this session only needs the cheap check
+	if (cache && !PC_SourceCacheValid(cache, source->scriptstack, qfalse))
+	{
+		PC_UnlinkSourceCache(cache);
+		cache = NULL;
+	} //end if
+	if (!cache && mode >= 2)
+	{
+		cache = PC_ReadSourceCache(name, definecrc);
+		if (cache)
+		{
+			//the files may have changed in any way since it was written
+			if (PC_SourceCacheValid(cache, source->scriptstack, qtrue))
+			{
+				cache->linked = qtrue;
+				cache->next = sourcecache;
+				sourcecache = cache;
+			} //end if
+			else
+			{
+				FreeMemory(cache);
+				cache = NULL;
+			} //end else
+		} //end if
+	} //end if
+	if (!cache)
+	{
+		cache = PC_BuildSourceCache(source, name, definecrc);
+		if (cache->linked && mode >= 2) PC_WriteSourceCache(cache);
+	} //end if
+	cache->refs++;
+	source->cache = cache;
+	source->cachetoken = 0;
+} //end of the function PC_CacheSource
+#endif //BOTLIB
 //============================================================================
 //
 // Parameter:			-
@@ -3035,6 +3598,25 @@ source_t *LoadSourceFile(const char *filename)
 	PC_AddGlobalDefinesToSource(source);
 	return source;
 } //end of the function LoadSourceFile
+#ifdef BOTLIB
+//============================================================================
+// loads a source that is read from the source cache, only used for the
+// files botlib parses itself, sources loaded through the VM interface
+// are read token by token by the game and are never cached
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+source_t *LoadSourceFileCached(const char *filename)
+{
+	source_t *source;
+
+	source = LoadSourceFile(filename);
+	if (source) PC_CacheSource(source);
+	return source;
+} //end of the function LoadSourceFileCached
+#endif //BOTLIB
 #if 0
 //============================================================================
 //
@@ -3085,6 +3667,9 @@ void FreeSource(source_t *source)
 	int i;
 
 	//PC_PrintDefineHashTable(source->definehash);
+#ifdef BOTLIB
+	if (source->cache) PC_ReleaseSourceCache(source->cache);
+#endif //BOTLIB
 	//free all the scripts
 	while(source->scriptstack)
 	{
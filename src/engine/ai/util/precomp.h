@@ -104,6 +104,8 @@ typedef struct source_s
 	indent_t *indentstack;					//stack with indents
 	int skip;								// > 0 if skipping conditional code
 	token_t token;							//last read token
+	struct sourcecache_s *cache;			//preprocessed tokens the source is read from
+	int cachetoken;							//next token to read from the cache
 } source_t;
 
 
@@ -147,8 +149,14 @@ source_t *LoadSourceMemory(char *ptr, int length, char *name);
 void PC_SetBaseFolder(const char *path);
 //load a source file
 source_t *LoadSourceFile(const char *filename);
+#ifdef BOTLIB
+//load a source file that is read from the preprocessed source cache
+source_t *LoadSourceFileCached(const char *filename);
+#endif //BOTLIB
 //free the given source
 void FreeSource(source_t *source);
+//free all the cached preprocessed sources
+void PC_ShutdownSourceCache(void);
 //print a source error
 void QDECL SourceError(source_t *source, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
 //print a source warning
@@ -0,0 +1,703 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		regress.c
+ *
+ * desc:		recording and checking of bot decisions against a baseline
+ *
+ * Every routing, movement and goal decision the game asks for through the
+ * export table is stored as a hash of its input and output together with
+ * the time the call took. With bot_regress 1 the decisions are written to
+ * botregress/<bot_regressfile>.brg on shutdown, with bot_regress 2 they are
+ * checked against that baseline and the first decision that differs and
+ * the functions that became slower are reported on shutdown.
+ *
+ * Replaying the same input every run is left to the engine journal, record
+ * a session with +set journal 1 and replay it on a dedicated server with
+ * +set journal 2.
+ *
+ *****************************************************************************/
+
+#include "../../common/q_shared.h"
+#include "../../core/qcommon.h"
+#include "../util/memory.h"
+#include "../util/libvar.h"
+#include "../util/regress.h"
+#include "../navigation/aasfile.h"
+#include "../ai_public.h"
+#include "../navigation/aas.h"
+#include "../navigation/aas_funcs.h"
+#include "../navigation/aas_def.h"
+#include "../ai_interface.h"
+#include "../behavior/ai_goal.h"
+#include "../behavior/ai_move.h"
+
+#define REGRESSID				(('G'<<24)+('R'<<16)+('B'<<8)+'B')
+#define REGRESSVERSION			1
+#define MAX_REGRESSRECORDS		(1<<22)
+//floats are compared with this precision so tiny differences don't count
+#define REGRESS_FLOATSCALE		8.0f
+
+//recorded functions
+#define REGRESS_TRAVELTIME		0
+#define REGRESS_PREDICTROUTE	1
+#define REGRESS_PREDICTMOVE		2
+#define REGRESS_MOVETOGOAL		3
+#define REGRESS_CHOOSELTG		4
+#define REGRESS_CHOOSENBG		5
+#define REGRESS_NUMFUNCS		6
+
+typedef struct regressheader_s
+{
+	int ident;
+	int version;
+	int recordsize;
+	int numrecords;
+	int numframes;
+} regressheader_t;
+
+typedef struct regressrecord_s
+{
+	int frame;							//frame the decision was made in
+	int func;							//REGRESS_?
+	unsigned int input;					//hash of the input
+	unsigned int output;				//hash of the output
+	int usec;							//time the call took
+} regressrecord_t;
+
+typedef struct regressfunc_s
+{
+	const char *name;
+	int numcalls;
+	int64_t usec;
+	int baselinecalls;
+	int64_t baselineusec;
+} regressfunc_t;
+
+static regressfunc_t regressfuncs[REGRESS_NUMFUNCS] =
+{
+	{"traveltime"},
+	{"predictroute"},
+	{"predictmove"},
+	{"movetogoal"},
+	{"chooseltg"},
+	{"choosenbg"}
+};
+
+static libvar_t *bot_regressfile;			//name of the baseline
+static libvar_t *bot_regresstolerance;		//fraction a function may become slower
+static libvar_t *bot_regressmintime;		//usec a function must take before it's timed
+
+static int regressmode;
+static int regressframe;
+//records of this run when recording, the baseline when comparing
+static regressrecord_t *regressrecords;
+static int numregressrecords;
+static int maxregressrecords;
+static int numbaselineframes;
+//compare state
+static int numcompared;
+static int numoutputdrift;
+static int numinputdrift;
+static regressrecord_t firstdrift;
+static regressrecord_t firstdriftbaseline;
+
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void Regress_FilePath(char *path, int size)
+{
+	char filename[MAX_QPATH];
+	int i;
+
+	Q_strncpyz(filename, bot_regressfile->string, sizeof(filename));
+	for (i = 0; filename[i]; i++)
+	{
+		if (!isalnum(filename[i]) && filename[i] != '-') filename[i] = '_';
+	} //end for
+	Com_sprintf(path, size, "botregress/%s.brg", filename);
+} //end of the function Regress_FilePath
+//===========================================================================
+// FNV-1a over the bytes of the value
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static unsigned int Regress_HashInt(unsigned int hash, int value)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= 16777619u;
+	} //end for
+	return hash;
+} //end of the function Regress_HashInt
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static unsigned int Regress_HashFloat(unsigned int hash, float value)
+{
+	return Regress_HashInt(hash, (int) floor(value * REGRESS_FLOATSCALE));
+} //end of the function Regress_HashFloat
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static unsigned int Regress_HashVector(unsigned int hash, const vec3_t v)
+{
+	if (!v) return Regress_HashInt(hash, 0);
+	hash = Regress_HashFloat(hash, v[0]);
+	hash = Regress_HashFloat(hash, v[1]);
+	return Regress_HashFloat(hash, v[2]);
+} //end of the function Regress_HashVector
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static unsigned int Regress_HashGoal(unsigned int hash, const bot_goal_t *goal)
+{
+	if (!goal) return Regress_HashInt(hash, -1);
+	hash = Regress_HashVector(hash, goal->origin);
+	hash = Regress_HashInt(hash, goal->areanum);
+	hash = Regress_HashInt(hash, goal->entitynum);
+	hash = Regress_HashInt(hash, goal->number);
+	return Regress_HashInt(hash, goal->flags);
+} //end of the function Regress_HashGoal
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void Regress_GrowRecords(void)
+{
+	regressrecord_t *records;
+	int max;
+
+	max = maxregressrecords ? maxregressrecords * 2 : 4096;
+	if (max > MAX_REGRESSRECORDS) max = MAX_REGRESSRECORDS;
+	records = (regressrecord_t *) GetMemory(max * sizeof(regressrecord_t));
+	if (regressrecords)
+	{
+		Com_Memcpy(records, regressrecords, numregressrecords * sizeof(regressrecord_t));
+		FreeMemory(regressrecords);
+	} //end if
+	regressrecords = records;
+	maxregressrecords = max;
+} //end of the function Regress_GrowRecords
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void Regress_Record(int func, unsigned int input, unsigned int output, int64_t starttime)
+{
+	regressrecord_t record, *baseline;
+
+	record.frame = regressframe;
+	record.func = func;
+	record.input = input;
+	record.output = output;
+	record.usec = (int) (Sys_Microseconds() - starttime);
+	regressfuncs[func].numcalls++;
+	regressfuncs[func].usec += record.usec;
+	if (regressmode == REGRESS_RECORD)
+	{
+		if (numregressrecords >= maxregressrecords)
+		{
+			if (maxregressrecords >= MAX_REGRESSRECORDS)
+			{
+				if (numregressrecords == MAX_REGRESSRECORDS)
+				{
+					botimport.Print(PRT_WARNING, "bot regression baseline full, later decisions are not recorded\n");
+					numregressrecords++;
+				} //end if
+				return;
+			} //end if
+			Regress_GrowRecords();
+		} //end if
+		regressrecords[numregressrecords++] = record;
+		return;
+	} //end if
+	//compare with the decision at the same position in the baseline
+	if (numcompared >= numregressrecords)
+	{
+		numcompared++;
+		return;
+	} //end if
+	baseline = &regressrecords[numcompared++];
+	if (baseline->frame == record.frame && baseline->func == record.func &&
+			baseline->input == record.input && baseline->output == record.output)
+	{
+		return;
+	} //end if
+	if (!numoutputdrift && !numinputdrift)
+	{
+		firstdrift = record;
+		firstdriftbaseline = *baseline;
+	} //end if
+	//the same question with a different answer is a change in behaviour,
+	//a different question usually follows from an earlier different answer
+	if (baseline->frame == record.frame && baseline->func == record.func &&
+			baseline->input == record.input) numoutputdrift++;
+	else numinputdrift++;
+} //end of the function Regress_Record
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int Regress_WriteBaseline(void)
+{
+	regressheader_t header;
+	char path[MAX_QPATH * 2];
+	fileHandle_t fp;
+	int numrecords;
+
+	Regress_FilePath(path, sizeof(path));
+	botimport.FS_FOpenFile(path, &fp, FS_WRITE);
+	if (!fp)
+	{
+		botimport.Print(PRT_ERROR, "can't write bot regression baseline %s\n", path);
+		return qfalse;
+	} //end if
+	numrecords = numregressrecords;
+	if (numrecords > MAX_REGRESSRECORDS) numrecords = MAX_REGRESSRECORDS;
+	header.ident = LittleLong(REGRESSID);
+	header.version = LittleLong(REGRESSVERSION);
+	header.recordsize = LittleLong(sizeof(regressrecord_t));
+	header.numrecords = LittleLong(numrecords);
+	header.numframes = LittleLong(regressframe);
+	botimport.FS_Write(&header, sizeof(header), fp);
+	if (numrecords) botimport.FS_Write(regressrecords, numrecords * sizeof(regressrecord_t), fp);
+	botimport.FS_FCloseFile(fp);
+	botimport.Print(PRT_MESSAGE, "wrote %d bot decisions in %d frames to %s\n", numrecords, regressframe, path);
+	return qtrue;
+} //end of the function Regress_WriteBaseline
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static int Regress_ReadBaseline(void)
+{
+	regressheader_t header;
+	char path[MAX_QPATH * 2];
+	fileHandle_t fp;
+	int length, i;
+
+	Regress_FilePath(path, sizeof(path));
+	length = botimport.FS_FOpenFile(path, &fp, FS_READ);
+	if (!fp)
+	{
+		botimport.Print(PRT_ERROR, "no bot regression baseline %s\n", path);
+		return qfalse;
+	} //end if
+	if (length >= (int) sizeof(header)) botimport.FS_Read(&header, sizeof(header), fp);
+	else Com_Memset(&header, 0, sizeof(header));
+	header.ident = LittleLong(header.ident);
+	header.version = LittleLong(header.version);
+	header.recordsize = LittleLong(header.recordsize);
+	header.numrecords = LittleLong(header.numrecords);
+	header.numframes = LittleLong(header.numframes);
+	if (header.ident != REGRESSID || header.version != REGRESSVERSION ||
+			header.recordsize != sizeof(regressrecord_t) ||
+			header.numrecords < 0 || header.numrecords > MAX_REGRESSRECORDS ||
+			length != (int) (sizeof(header) + header.numrecords * sizeof(regressrecord_t)))
+	{
+		botimport.FS_FCloseFile(fp);
+		botimport.Print(PRT_ERROR, "%s is not a valid bot regression baseline\n", path);
+		return qfalse;
+	} //end if
+	numregressrecords = maxregressrecords = header.numrecords;
+	numbaselineframes = header.numframes;
+	regressrecords = (regressrecord_t *) GetMemory((header.numrecords + 1) * sizeof(regressrecord_t));
+	botimport.FS_Read(regressrecords, header.numrecords * sizeof(regressrecord_t), fp);
+	botimport.FS_FCloseFile(fp);
+	for (i = 0; i < numregressrecords; i++)
+	{
+		if (regressrecords[i].func < 0 || regressrecords[i].func >= REGRESS_NUMFUNCS)
+		{
+			regressrecords[i].func = -1;
+			continue;
+		} //end if
+		regressfuncs[regressrecords[i].func].baselinecalls++;
+		regressfuncs[regressrecords[i].func].baselineusec += regressrecords[i].usec;
+	} //end for
+	botimport.Print(PRT_MESSAGE, "checking bot decisions against %d decisions in %d frames from %s\n",
+							numregressrecords, numbaselineframes, path);
+	return qtrue;
+} //end of the function Regress_ReadBaseline
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void Regress_Report(void)
+{
+	regressfunc_t *f;
+	int i, numslower;
+	float tolerance;
+
+	//behaviour
+	if (numcompared < numregressrecords)
+	{
+		botimport.Print(PRT_MESSAGE, "bot regression: stopped after %d of %d baseline decisions\n",
+								numcompared, numregressrecords);
+	} //end if
+	else if (numcompared > numregressrecords)
+	{
+		botimport.Print(PRT_MESSAGE, "bot regression: %d decisions more than the baseline\n",
+								numcompared - numregressrecords);
+	} //end else if
+	if (numoutputdrift || numinputdrift)
+	{
+		botimport.Print(PRT_WARNING, "bot regression: %d decisions changed, %d decisions followed different input\n",
+								numoutputdrift, numinputdrift);
+		botimport.Print(PRT_WARNING, "first change in frame %d: %s input %08x output %08x, baseline frame %d: %s input %08x output %08x\n",
+								firstdrift.frame, regressfuncs[firstdrift.func].name, firstdrift.input, firstdrift.output,
+								firstdriftbaseline.frame,
+								firstdriftbaseline.func >= 0 ? regressfuncs[firstdriftbaseline.func].name : "?",
+								firstdriftbaseline.input, firstdriftbaseline.output);
+	} //end if
+	else
+	{
+		botimport.Print(PRT_MESSAGE, "bot regression: all %d decisions match the baseline\n", numcompared);
+	} //end else
+	//performance
+	tolerance = bot_regresstolerance->value;
+	numslower = 0;
+	for (i = 0; i < REGRESS_NUMFUNCS; i++)
+	{
+		f = &regressfuncs[i];
+		if (!f->numcalls && !f->baselinecalls) continue;
+		botimport.Print(PRT_MESSAGE, "%-12s %8d calls %10d usec, baseline %8d calls %10d usec\n",
+								f->name, f->numcalls, (int) f->usec, f->baselinecalls, (int) f->baselineusec);
+		if (f->baselineusec < bot_regressmintime->value) continue;
+		if (f->usec > f->baselineusec * (1.0f + tolerance))
+		{
+			botimport.Print(PRT_WARNING, "bot regression: %s is %d%% slower than the baseline\n",
+								f->name, (int) ((f->usec - f->baselineusec) * 100 / f->baselineusec));
+			numslower++;
+		} //end if
+	} //end for
+	if (!numslower)
+	{
+		botimport.Print(PRT_MESSAGE, "bot regression: no function more than %d%% slower than the baseline\n",
+								(int) (tolerance * 100));
+	} //end if
+} //end of the function Regress_Report
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotSetupRegress(void)
+{
+	int i;
+
+	regressmode = (int) LibVarValue("bot_regress", "0");
+	bot_regressfile = LibVar("bot_regressfile", "baseline");
+	bot_regresstolerance = LibVar("bot_regresstolerance", "0.25");
+	bot_regressmintime = LibVar("bot_regressmintime", "10000");
+	regressframe = 0;
+	regressrecords = NULL;
+	numregressrecords = 0;
+	maxregressrecords = 0;
+	numbaselineframes = 0;
+	numcompared = 0;
+	numoutputdrift = 0;
+	numinputdrift = 0;
+	for (i = 0; i < REGRESS_NUMFUNCS; i++)
+	{
+		regressfuncs[i].numcalls = 0;
+		regressfuncs[i].usec = 0;
+		regressfuncs[i].baselinecalls = 0;
+		regressfuncs[i].baselineusec = 0;
+	} //end for
+	if (regressmode == REGRESS_COMPARE)
+	{
+		if (!Regress_ReadBaseline()) regressmode = REGRESS_OFF;
+	} //end if
+	else if (regressmode != REGRESS_RECORD)
+	{
+		regressmode = REGRESS_OFF;
+	} //end else if
+} //end of the function BotSetupRegress
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotShutdownRegress(void)
+{
+	if (regressmode == REGRESS_RECORD) Regress_WriteBaseline();
+	else if (regressmode == REGRESS_COMPARE) Regress_Report();
+	if (regressrecords) FreeMemory(regressrecords);
+	regressrecords = NULL;
+	numregressrecords = 0;
+	maxregressrecords = 0;
+	regressmode = REGRESS_OFF;
+	//the library variables are freed on shutdown
+	bot_regressfile = NULL;
+	bot_regresstolerance = NULL;
+	bot_regressmintime = NULL;
+} //end of the function BotShutdownRegress
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotRegressStartFrame(float time)
+{
+	if (!regressmode) return;
+	regressframe++;
+} //end of the function BotRegressStartFrame
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Regress_AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags)
+{
+	unsigned int input;
+	int64_t starttime;
+	int traveltime;
+
+	if (!regressmode) return AAS_AreaTravelTimeToGoalArea(areanum, origin, goalareanum, travelflags);
+	starttime = Sys_Microseconds();
+	traveltime = AAS_AreaTravelTimeToGoalArea(areanum, origin, goalareanum, travelflags);
+	input = Regress_HashInt(2166136261u, areanum);
+	input = Regress_HashVector(input, origin);
+	input = Regress_HashInt(input, goalareanum);
+	input = Regress_HashInt(input, travelflags);
+	Regress_Record(REGRESS_TRAVELTIME, input, Regress_HashInt(2166136261u, traveltime), starttime);
+	return traveltime;
+} //end of the function Regress_AAS_AreaTravelTimeToGoalArea
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Regress_AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
+							int goalareanum, int travelflags, int maxareas, int maxtime,
+							int stopevent, int stopcontents, int stoptfl, int stopareanum)
+{
+	unsigned int input, output;
+	int64_t starttime;
+	int result;
+
+	if (!regressmode)
+	{
+		return AAS_PredictRoute(route, areanum, origin, goalareanum, travelflags, maxareas, maxtime,
+								stopevent, stopcontents, stoptfl, stopareanum);
+	} //end if
+	starttime = Sys_Microseconds();
+	result = AAS_PredictRoute(route, areanum, origin, goalareanum, travelflags, maxareas, maxtime,
+								stopevent, stopcontents, stoptfl, stopareanum);
+	input = Regress_HashInt(2166136261u, areanum);
+	input = Regress_HashVector(input, origin);
+	input = Regress_HashInt(input, goalareanum);
+	input = Regress_HashInt(input, travelflags);
+	input = Regress_HashInt(input, maxareas);
+	input = Regress_HashInt(input, maxtime);
+	input = Regress_HashInt(input, stopevent);
+	input = Regress_HashInt(input, stopcontents);
+	input = Regress_HashInt(input, stoptfl);
+	input = Regress_HashInt(input, stopareanum);
+	output = Regress_HashInt(2166136261u, result);
+	output = Regress_HashVector(output, route->endpos);
+	output = Regress_HashInt(output, route->endarea);
+	output = Regress_HashInt(output, route->stopevent);
+	output = Regress_HashInt(output, route->endcontents);
+	output = Regress_HashInt(output, route->endtravelflags);
+	output = Regress_HashInt(output, route->numareas);
+	output = Regress_HashInt(output, route->time);
+	Regress_Record(REGRESS_PREDICTROUTE, input, output, starttime);
+	return result;
+} //end of the function Regress_AAS_PredictRoute
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Regress_AAS_PredictClientMovement(struct aas_clientmove_s *move,
+								int entnum, const vec3_t origin,
+								int presencetype, int onground,
+								const vec3_t velocity, const vec3_t cmdmove,
+								int cmdframes,
+								int maxframes, float frametime,
+								int stopevent, int stopareanum, int visualize)
+{
+	unsigned int input, output;
+	int64_t starttime;
+	int result;
+
+	if (!regressmode)
+	{
+		return AAS_PredictClientMovement(move, entnum, origin, presencetype, onground,
+								velocity, cmdmove, cmdframes, maxframes, frametime,
+								stopevent, stopareanum, visualize);
+	} //end if
+	starttime = Sys_Microseconds();
+	result = AAS_PredictClientMovement(move, entnum, origin, presencetype, onground,
+								velocity, cmdmove, cmdframes, maxframes, frametime,
+								stopevent, stopareanum, visualize);
+	input = Regress_HashInt(2166136261u, entnum);
+	input = Regress_HashVector(input, origin);
+	input = Regress_HashInt(input, presencetype);
+	input = Regress_HashInt(input, onground);
+	input = Regress_HashVector(input, velocity);
+	input = Regress_HashVector(input, cmdmove);
+	input = Regress_HashInt(input, cmdframes);
+	input = Regress_HashInt(input, maxframes);
+	input = Regress_HashFloat(input, frametime * 1000);
+	input = Regress_HashInt(input, stopevent);
+	input = Regress_HashInt(input, stopareanum);
+	output = Regress_HashInt(2166136261u, result);
+	output = Regress_HashVector(output, move->endpos);
+	output = Regress_HashInt(output, move->endarea);
+	output = Regress_HashVector(output, move->velocity);
+	output = Regress_HashInt(output, move->presencetype);
+	output = Regress_HashInt(output, move->stopevent);
+	output = Regress_HashInt(output, move->endcontents);
+	output = Regress_HashInt(output, move->frames);
+	Regress_Record(REGRESS_PREDICTMOVE, input, output, starttime);
+	return result;
+} //end of the function Regress_AAS_PredictClientMovement
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void Regress_BotMoveToGoal(struct bot_moveresult_s *result, int movestate, struct bot_goal_s *goal, int travelflags)
+{
+	unsigned int input, output;
+	int64_t starttime;
+
+	if (!regressmode)
+	{
+		BotMoveToGoal(result, movestate, goal, travelflags);
+		return;
+	} //end if
+	starttime = Sys_Microseconds();
+	BotMoveToGoal(result, movestate, goal, travelflags);
+	input = Regress_HashInt(2166136261u, movestate);
+	input = Regress_HashGoal(input, goal);
+	input = Regress_HashInt(input, travelflags);
+	output = Regress_HashInt(2166136261u, result->failure);
+	output = Regress_HashInt(output, result->type);
+	output = Regress_HashInt(output, result->blocked);
+	output = Regress_HashInt(output, result->blockentity);
+	output = Regress_HashInt(output, result->traveltype);
+	output = Regress_HashInt(output, result->flags);
+	output = Regress_HashInt(output, result->weapon);
+	output = Regress_HashVector(output, result->movedir);
+	if (result->flags & MOVERESULT_MOVEMENTVIEW) output = Regress_HashVector(output, result->ideal_viewangles);
+	Regress_Record(REGRESS_MOVETOGOAL, input, output, starttime);
+} //end of the function Regress_BotMoveToGoal
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static unsigned int Regress_HashChosenGoal(int goalstate, int result)
+{
+	bot_goal_t goal;
+	unsigned int output;
+
+	output = Regress_HashInt(2166136261u, result);
+	if (result && BotGetTopGoal(goalstate, &goal)) output = Regress_HashGoal(output, &goal);
+	return output;
+} //end of the function Regress_HashChosenGoal
+//===========================================================================
+// the inventory is left out of the input, its size is only known to the game
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Regress_BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
+{
+	unsigned int input;
+	int64_t starttime;
+	int result;
+
+	if (!regressmode) return BotChooseLTGItem(goalstate, origin, inventory, travelflags);
+	starttime = Sys_Microseconds();
+	result = BotChooseLTGItem(goalstate, origin, inventory, travelflags);
+	input = Regress_HashInt(2166136261u, goalstate);
+	input = Regress_HashVector(input, origin);
+	input = Regress_HashInt(input, travelflags);
+	Regress_Record(REGRESS_CHOOSELTG, input, Regress_HashChosenGoal(goalstate, result), starttime);
+	return result;
+} //end of the function Regress_BotChooseLTGItem
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int Regress_BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelflags,
+							struct bot_goal_s *ltg, float maxtime)
+{
+	unsigned int input;
+	int64_t starttime;
+	int result;
+
+	if (!regressmode) return BotChooseNBGItem(goalstate, origin, inventory, travelflags, ltg, maxtime);
+	starttime = Sys_Microseconds();
+	result = BotChooseNBGItem(goalstate, origin, inventory, travelflags, ltg, maxtime);
+	input = Regress_HashInt(2166136261u, goalstate);
+	input = Regress_HashVector(input, origin);
+	input = Regress_HashInt(input, travelflags);
+	input = Regress_HashGoal(input, ltg);
+	input = Regress_HashFloat(input, maxtime);
+	Regress_Record(REGRESS_CHOOSENBG, input, Regress_HashChosenGoal(goalstate, result), starttime);
+	return result;
+} //end of the function Regress_BotChooseNBGItem
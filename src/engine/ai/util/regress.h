@@ -0,0 +1,61 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		regress.h
+ *
+ * desc:		recording and checking of bot decisions against a baseline
+ *
+ *****************************************************************************/
+
+//modes of bot_regress
+#define REGRESS_OFF				0
+#define REGRESS_RECORD			1		//write the decisions to the baseline
+#define REGRESS_COMPARE			2		//check the decisions against the baseline
+
+struct aas_predictroute_s;
+struct aas_clientmove_s;
+struct bot_moveresult_s;
+struct bot_goal_s;
+
+//setup the decision recording
+void BotSetupRegress(void);
+//writes the baseline or reports the differences with it
+void BotShutdownRegress(void);
+//start of a new frame
+void BotRegressStartFrame(float time);
+//recorded versions of the exported routing, movement and goal functions
+int Regress_AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags);
+int Regress_AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
+							int goalareanum, int travelflags, int maxareas, int maxtime,
+							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+int Regress_AAS_PredictClientMovement(struct aas_clientmove_s *move,
+								int entnum, const vec3_t origin,
+								int presencetype, int onground,
+								const vec3_t velocity, const vec3_t cmdmove,
+								int cmdframes,
+								int maxframes, float frametime,
+								int stopevent, int stopareanum, int visualize);
+void Regress_BotMoveToGoal(struct bot_moveresult_s *result, int movestate, struct bot_goal_s *goal, int travelflags);
+int Regress_BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags);
+int Regress_BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelflags,
+							struct bot_goal_s *ltg, float maxtime);
@@ -0,0 +1,285 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		schedule.c
+ *
+ * desc:		per frame budget for expensive bot tasks
+ *
+ * The budget is spent with fixed cost estimates instead of measured time so
+ * the tasks that get deferred only depend on the order of the bot calls,
+ * which keeps bot behaviour reproducible. Measured times are only reported.
+ *
+ *****************************************************************************/
+
+#include "../../common/q_shared.h"
+#include "../../core/qcommon.h"
+#include "../ai_public.h"
+#include "../ai_interface.h"
+#include "../util/libvar.h"
+#include "../util/schedule.h"
+
+#define MAX_SCHEDULEHANDLES		(MAX_CLIENTS + 1)
+#define MAX_SCHEDULEDEPTH		16
+//part of the frame budget nearby goal selection can use
+#define NBG_BUDGETSHARE			0.75f
+
+typedef struct bot_task_s
+{
+	const char *name;
+	float cost;									//estimated cost per unit of work in usec
+	//statistics
+	int numrun;
+	int numdeferred;
+	int numforced;
+	double estimated;
+	int64_t measured;
+} bot_task_t;
+
+//a task running inside another task, routing updates happen while goals
+//are chosen, so every running task keeps its own start time
+typedef struct bot_taskrun_s
+{
+	int64_t starttime;
+	int64_t nested;								//time spent in tasks running inside this one
+} bot_taskrun_t;
+
+static bot_task_t bottasks[BOTTASK_NUM] =
+{
+	{"routing",		0.1f},
+	{"ltg",			60.0f},
+	{"nbg",			30.0f},
+	{"replychat",	25.0f}
+};
+
+static bot_taskrun_t taskstack[MAX_SCHEDULEDEPTH];
+//frames nearby goal selection was deferred in a row per handle
+static int nbgdeferred[MAX_SCHEDULEHANDLES];
+
+static libvar_t *bot_thinkbudget;				//usec each frame, 0 = no budget
+static libvar_t *bot_thinkmaxdefer;				//frames a task can be deferred in a row
+static libvar_t *bot_thinkstats;				//seconds between statistics, 0 = never
+
+static double frameestimated;
+static int64_t framemeasured;
+static int framedepth;
+static int numframes;
+static int numoverbudget;
+static double worstestimated;
+static int64_t worstmeasured;
+static float laststatstime;
+
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotResetScheduleStatistics(void)
+{
+	int i;
+
+	for (i = 0; i < BOTTASK_NUM; i++)
+	{
+		bottasks[i].numrun = 0;
+		bottasks[i].numdeferred = 0;
+		bottasks[i].numforced = 0;
+		bottasks[i].estimated = 0;
+		bottasks[i].measured = 0;
+	} //end for
+	numframes = 0;
+	numoverbudget = 0;
+	worstestimated = 0;
+	worstmeasured = 0;
+} //end of the function BotResetScheduleStatistics
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotScheduleStatistics(void)
+{
+	int i;
+	bot_task_t *task;
+
+	botimport.Print(PRT_MESSAGE, "bot think budget %d usec, %d frames, %d over budget, worst frame %d usec estimated %d usec measured\n",
+					(int) bot_thinkbudget->value, numframes, numoverbudget, (int) worstestimated, (int) worstmeasured);
+	for (i = 0; i < BOTTASK_NUM; i++)
+	{
+		task = &bottasks[i];
+		botimport.Print(PRT_MESSAGE, "%-10s %6d run %6d deferred %6d forced %9d usec estimated %9d usec measured\n",
+						task->name, task->numrun, task->numdeferred, task->numforced, (int) task->estimated, (int) task->measured);
+	} //end for
+} //end of the function BotScheduleStatistics
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotSetupSchedule(void)
+{
+	bot_thinkbudget = LibVar("bot_thinkbudget", "0");
+	bot_thinkmaxdefer = LibVar("bot_thinkmaxdefer", "10");
+	bot_thinkstats = LibVar("bot_thinkstats", "0");
+	Com_Memset(nbgdeferred, 0, sizeof(nbgdeferred));
+	BotResetScheduleStatistics();
+	frameestimated = 0;
+	framemeasured = 0;
+	framedepth = 0;
+	laststatstime = 0;
+} //end of the function BotSetupSchedule
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotShutdownSchedule(void)
+{
+	if (!bot_thinkbudget) return;
+	if (bot_thinkstats->value > 0 && numframes > 0) BotScheduleStatistics();
+	//the library variables are freed on shutdown
+	bot_thinkbudget = NULL;
+	bot_thinkmaxdefer = NULL;
+	bot_thinkstats = NULL;
+} //end of the function BotShutdownSchedule
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotScheduleStartFrame(float time)
+{
+	if (!bot_thinkbudget) return;
+	//close the previous frame
+	if (frameestimated > worstestimated) worstestimated = frameestimated;
+	if (framemeasured > worstmeasured) worstmeasured = framemeasured;
+	if (bot_thinkbudget->value > 0 && frameestimated > bot_thinkbudget->value) numoverbudget++;
+	numframes++;
+	frameestimated = 0;
+	framemeasured = 0;
+	framedepth = 0;
+	//report the statistics every now and then
+	if (bot_thinkstats->value > 0)
+	{
+		if (time < laststatstime) laststatstime = time;
+		if (time - laststatstime >= bot_thinkstats->value)
+		{
+			BotScheduleStatistics();
+			BotResetScheduleStatistics();
+			laststatstime = time;
+		} //end if
+	} //end if
+} //end of the function BotScheduleStartFrame
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void BotScheduleRun(bot_task_t *task, float cost)
+{
+	task->numrun++;
+	task->estimated += cost;
+	frameestimated += cost;
+	if (framedepth < MAX_SCHEDULEDEPTH)
+	{
+		taskstack[framedepth].starttime = Sys_Microseconds();
+		taskstack[framedepth].nested = 0;
+	} //end if
+	framedepth++;
+} //end of the function BotScheduleRun
+//===========================================================================
+// nearby goal selection may use its share of the budget that is left this
+// frame, other tasks always run, a task deferred too many frames in a row
+// always runs
+//
+// Parameter:				-
+// Returns:					qtrue when the task should run now
+// Changes Globals:		-
+//===========================================================================
+int BotScheduleTask(int task, int handle)
+{
+	bot_task_t *t;
+	int *deferred;
+
+	if (!bot_thinkbudget) return qtrue;
+	t = &bottasks[task];
+	if (task != BOTTASK_NBG)
+	{
+		BotScheduleRun(t, t->cost);
+		return qtrue;
+	} //end if
+	if (handle <= 0 || handle >= MAX_SCHEDULEHANDLES) handle = 0;
+	deferred = &nbgdeferred[handle];
+	if (bot_thinkbudget->value > 0 && frameestimated > 0 &&
+			frameestimated + t->cost > bot_thinkbudget->value * NBG_BUDGETSHARE)
+	{
+		if (*deferred < (int) bot_thinkmaxdefer->value)
+		{
+			(*deferred)++;
+			t->numdeferred++;
+			return qfalse;
+		} //end if
+		t->numforced++;
+	} //end if
+	*deferred = 0;
+	BotScheduleRun(t, t->cost);
+	return qtrue;
+} //end of the function BotScheduleTask
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotScheduleWork(int task, int units)
+{
+	if (!bot_thinkbudget) return;
+	BotScheduleRun(&bottasks[task], bottasks[task].cost * units);
+} //end of the function BotScheduleWork
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotScheduleTaskDone(int task)
+{
+	bot_task_t *t;
+	bot_taskrun_t *run;
+	int64_t elapsed;
+
+	if (!bot_thinkbudget || framedepth <= 0) return;
+	t = &bottasks[task];
+	framedepth--;
+	if (framedepth >= MAX_SCHEDULEDEPTH) return;
+	run = &taskstack[framedepth];
+	elapsed = Sys_Microseconds() - run->starttime;
+	//a task is only charged the time not spent in tasks nested inside it
+	t->measured += elapsed - run->nested;
+	if (framedepth > 0) taskstack[framedepth - 1].nested += elapsed;
+	else framemeasured += elapsed;
+} //end of the function BotScheduleTaskDone
@@ -0,0 +1,52 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		schedule.h
+ *
+ * desc:		per frame budget for expensive bot tasks
+ *
+ *****************************************************************************/
+
+//tasks charged against the budget, only nearby goal selection is ever
+//deferred because the bot keeps its long term goal and retries later,
+//the other tasks are charged as work that always runs
+#define BOTTASK_ROUTING			0		//routing cache update
+#define BOTTASK_LTG				1		//long term goal selection
+#define BOTTASK_NBG				2		//nearby goal selection
+#define BOTTASK_REPLYCHAT		3		//reply chat matching
+#define BOTTASK_NUM				4
+
+//setup the scheduler
+void BotSetupSchedule(void);
+//shut down the scheduler
+void BotShutdownSchedule(void);
+//print the scheduler statistics collected so far
+void BotScheduleStatistics(void);
+//start a new frame with a fresh budget
+void BotScheduleStartFrame(float time);
+//returns qtrue when the task for the given handle can run this frame
+int BotScheduleTask(int task, int handle);
+//charges work that always runs against the budget of this frame
+void BotScheduleWork(int task, int units);
+//called when a task that was allowed to run or charged is done
+void BotScheduleTaskDone(int task);
@@ -1465,4 +1465,40 @@ void PS_SetBaseFolder( const char *path )
 {
 	Q_strncpyz( basefolder, path, sizeof( basefolder ) );
 } //end of the function PS_SetBaseFolder
+//============================================================================
+// returns the base folder files are loaded from
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+const char *PS_BaseFolder( void )
+{
+	return basefolder;
+} //end of the function PS_BaseFolder
+#ifdef BOTLIB
+//============================================================================
+// returns the length of the file without reading it, -1 if it doesn't exist
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//============================================================================
+int PS_FileLength( const char *filename )
+{
+	fileHandle_t fp;
+	char pathname[MAX_QPATH*2];
+	int length;
+
+	if ( basefolder[0] != '\0' )
+		Com_sprintf( pathname, sizeof( pathname ), "%s/%s", basefolder, filename );
+	else
+		Com_sprintf( pathname, sizeof( pathname ), "%s", filename );
+
+	length = botimport.FS_FOpenFile( pathname, &fp, FS_READ );
+	if (!fp) return -1;
+	botimport.FS_FCloseFile( fp );
+	return length;
+} //end of the function PS_FileLength
+#endif //BOTLIB
 
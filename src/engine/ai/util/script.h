@@ -239,6 +239,12 @@ script_t *LoadScriptMemory(const char *ptr, int length, const char *name);
 void FreeScript(script_t *script);
 //set the base folder to load files from
 void PS_SetBaseFolder(const char *path);
+//returns the base folder files are loaded from
+const char *PS_BaseFolder(void);
+#ifdef BOTLIB
+//returns the length of the file without reading it, -1 if it doesn't exist
+int PS_FileLength(const char *filename);
+#endif //BOTLIB
 //print a script error with filename and line number
 void QDECL ScriptError(script_t *script, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
 
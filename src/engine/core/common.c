@@ -28,8 +28,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <netinet/in.h>
 #include <sys/stat.h> // umask
 #include <sys/time.h>
+#include <pthread.h>
 #else
 #include <winsock.h>
+#include <process.h>
 #if defined(_DEBUG)
 #include "../../platform/windows/win_local.h"
 #endif
@@ -59,7 +61,6 @@ static jmp_buf abortframe;	// an ERR_DROP occurred, exit the entire frame
 
 int		CPU_Flags = 0;
 
-static fileHandle_t logfile = FS_INVALID_HANDLE;
 static fileHandle_t com_journalFile = FS_INVALID_HANDLE ; // events are written here
 fileHandle_t com_journalDataFile = FS_INVALID_HANDLE; // config files are written here
 
@@ -82,6 +83,10 @@ cvar_t	*com_timedemo;
 cvar_t	*com_affinityMask;
 #endif
 static cvar_t *com_logfile;		// 1 = buffer log, 2 = flush after each print
+static cvar_t *com_logfileFormat;
+static cvar_t *com_logfileMaxSize;
+static cvar_t *com_logfileRotate;
+static cvar_t *com_logfileBackups;
 static cvar_t *com_showtrace;
 cvar_t	*com_version;
 static cvar_t *com_buildScript;	// for automated data building scripts
@@ -162,2364 +167,3573 @@ void Com_EndRedirect( void )
 
 
 /*
-=============
-Com_Printf
+==============================================================================
 
-Both client and server can use this, and it will output
-to the appropriate place.
+LOGFILE
 
-A raw string should NEVER be passed as fmt, because of "%f" type crashers.
-=============
-*/
-void FORMAT_PRINTF(1, 2) QDECL Com_Printf( const char *fmt, ... ) {
-	static qboolean opening_qconsole = qfalse;
-	va_list		argptr;
-	char		msg[MAXPRINTMSG];
-	int			len;
+Com_Printf only copies the text into a bounded lock-free ring, a background
+thread formats it and does all of the file I/O, so disk stalls never reach
+the frame. Text that doesn't fit in the ring is dropped and counted instead
+of waiting for the writer.
 
-	va_start( argptr, fmt );
-	len = Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
-	va_end( argptr );
+==============================================================================
+*/
 
-	if ( rd_buffer && !rd_flushing ) {
-		if ( len + (int)strlen( rd_buffer ) > ( rd_buffersize - 1 ) ) {
-			rd_flushing = qtrue;
-			rd_flush( rd_buffer );
-			rd_flushing = qfalse;
-			*rd_buffer = '\0';
-		}
-		Q_strcat( rd_buffer, rd_buffersize, msg );
-		// TTimo nooo .. that would defeat the purpose
-		//rd_flush(rd_buffer);
-		//*rd_buffer = '\0';
-		return;
-	}
+#define LOG_QUEUE_CELLS		4096	// must be a power of two
+#define LOG_CELL_TEXT		112
+#define LOG_WRITER_MSEC		5		// writer poll interval while the ring is empty
+#define LOG_FLUSH_MSEC		250		// how long a forced flush waits for the writer
 
-#ifndef DEDICATED
-	// echo to client console if we're not a dedicated server
-	if ( !com_dedicated || !com_dedicated->integer ) {
-		CL_ConsolePrint( msg );
-	}
+// producers never lock, the ring is only touched through these
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LOG_LOAD( p )				( *(volatile const unsigned int *)(p) )
+#define LOG_STORE( p, v )			( *(volatile unsigned int *)(p) = (v) )
+#define LOG_CAS( p, o, n )			( _InterlockedCompareExchange( (volatile long *)(p), (long)(n), (long)(o) ) == (long)(o) )
+#define LOG_ADD( p, v )				_InterlockedExchangeAdd( (volatile long *)(p), (long)(v) )
+#define LOG_EXCHANGE( p, v )		( (unsigned int)_InterlockedExchange( (volatile long *)(p), (long)(v) ) )
+#else
+#define LOG_LOAD( p )				__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define LOG_STORE( p, v )			__atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#define LOG_CAS( p, o, n )			Com_LogCompareExchange( (p), (o), (n) )
+#define LOG_ADD( p, v )				__atomic_fetch_add( (p), (v), __ATOMIC_RELAXED )
+#define LOG_EXCHANGE( p, v )		__atomic_exchange_n( (p), (v), __ATOMIC_ACQ_REL )
+
+static qboolean Com_LogCompareExchange( unsigned int *p, unsigned int expected, unsigned int desired ) {
+	return __atomic_compare_exchange_n( p, &expected, desired, qfalse, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ? qtrue : qfalse;
+}
 #endif
 
-	// echo to dedicated console and early console
-	Sys_Print( msg );
-
-	// logfile
-	if ( com_logfile && com_logfile->integer ) {
-		// TTimo: only open the qconsole.log if the filesystem is in an initialized state
-		//   also, avoid recursing in the qconsole.log opening (i.e. if fs_debug is on)
-		if ( logfile == FS_INVALID_HANDLE && FS_Initialized() && !opening_qconsole ) {
-			const char *logName = "qconsole.log";
-			int mode;
+typedef enum {
+	LOG_FORMAT_PLAIN,
+	LOG_FORMAT_TIMESTAMP,
+	LOG_FORMAT_JSON
+} logFormat_t;
 
-			opening_qconsole = qtrue;
+typedef struct {
+	unsigned int	sequence;		// position when free, position + 1 once filled
+	int				length;
+	int				msec;			// Sys_Milliseconds() when queued
+	time_t			time;
+	char			text[ LOG_CELL_TEXT ];
+} logCell_t;
 
-			mode = com_logfile->integer - 1;
+typedef struct {
+	logCell_t		cells[ LOG_QUEUE_CELLS ];
+	unsigned int	enqueuePos;
+	unsigned int	dequeuePos;		// only changed while holding consumer
+	unsigned int	consumer;		// set while someone drains the ring
+	unsigned int	dropped;		// messages lost on a full ring
+	unsigned int	shouldTerminate;
+
+	FILE			*file;
+	char			ospath[ MAX_OSPATH ];
+	qboolean		sync;			// flush after every drained batch
+	long			size;
+	time_t			openTime;
+
+	// settings latched by the main thread
+	int				format;
+	long			maxSize;		// bytes, 0 = no size rotation
+	int				rotateTime;		// seconds, 0 = no time rotation
+	int				backups;
+
+	// line being formatted
+	qboolean		lineStart;
+	time_t			lineTime;
+	int				lineMsec;
+	char			line[ MAXPRINTMSG ];
+	int				lineLength;
+
+	qboolean		started;
+#ifdef _WIN32
+	HANDLE			thread;
+#else
+	pthread_t		thread;
+#endif
+} logWriter_t;
 
-			if ( mode & 2 )
-				logfile = FS_FOpenFileAppend( logName );
-			else
-				logfile = FS_FOpenFileWrite( logName );
+static logWriter_t logWriter;
 
-			if ( logfile != FS_INVALID_HANDLE ) {
-				struct tm *newtime;
-				time_t aclock;
-				char timestr[32];
 
-				time( &aclock );
-				newtime = localtime( &aclock );
-				strftime( timestr, sizeof( timestr ), "%a %b %d %X %Y", newtime );
+/*
+================
+Com_LogQueue
 
-				Com_Printf( "logfile opened on %s\n", timestr );
+Reserves consecutive cells for the whole message so concurrent printers
+never interleave, returns qfalse without waiting if the ring is full
+================
+*/
+static qboolean Com_LogQueue( const char *text, int len ) {
+	logCell_t *cell;
+	unsigned int pos, last, seq;
+	int numCells, n, i;
+	time_t now;
+	int msec;
+
+	numCells = ( len + LOG_CELL_TEXT - 1 ) / LOG_CELL_TEXT;
+	if ( numCells <= 0 ) {
+		return qtrue;
+	}
+	if ( numCells > LOG_QUEUE_CELLS ) {
+		return qfalse;
+	}
 
-				if ( mode & 1 ) {
-					// force it to not buffer so we get valid
-					// data even if we are crashing
-					FS_ForceFlush( logfile );
-				}
-			} else {
-				Com_Printf( S_COLOR_YELLOW "Opening %s failed!\n", logName );
-				Cvar_Set( "logfile", "0" );
-			}
+	now = time( NULL );
+	msec = Sys_Milliseconds();
 
-			opening_qconsole = qfalse;
+	for ( ;; ) {
+		pos = LOG_LOAD( &logWriter.enqueuePos );
+		last = pos + numCells - 1;
+		// the ring is drained in order, so once the last cell is free all of them are
+		seq = LOG_LOAD( &logWriter.cells[ last & ( LOG_QUEUE_CELLS - 1 ) ].sequence );
+		if ( (int)( seq - last ) < 0 ) {
+			return qfalse;
 		}
-		if ( logfile != FS_INVALID_HANDLE && FS_Initialized() ) {
-			FS_Write( msg, len, logfile );
+		if ( seq == last && LOG_CAS( &logWriter.enqueuePos, pos, pos + numCells ) ) {
+			break;
 		}
 	}
+
+	for ( i = 0; i < numCells; i++, text += n, len -= n ) {
+		cell = &logWriter.cells[ ( pos + i ) & ( LOG_QUEUE_CELLS - 1 ) ];
+		n = MIN( len, LOG_CELL_TEXT );
+		Com_Memcpy( cell->text, text, n );
+		cell->length = n;
+		cell->msec = msec;
+		cell->time = now;
+		LOG_STORE( &cell->sequence, pos + i + 1 );
+	}
+
+	return qtrue;
 }
 
 
 /*
 ================
-Com_DPrintf
+Com_LogRotate
 
-A Com_Printf that only shows up if the "developer" cvar is set
+Renames qconsole.log to qconsole.log.1, shifting older backups up
 ================
 */
-void FORMAT_PRINTF(1, 2) QDECL Com_DPrintf( const char *fmt, ... ) {
-	va_list		argptr;
-	char		msg[MAXPRINTMSG];
+static void Com_LogRotate( void ) {
+	char from[ MAX_OSPATH + 4 ], to[ MAX_OSPATH + 4 ];
+	int i;
 
-	if ( !com_developer || !com_developer->integer ) {
-		return;			// don't confuse non-developers with techie stuff...
+	fclose( logWriter.file );
+
+	if ( logWriter.backups > 0 ) {
+		Com_sprintf( to, sizeof( to ), "%s.%i", logWriter.ospath, logWriter.backups );
+		remove( to );
+		for ( i = logWriter.backups - 1; i > 0; i-- ) {
+			Com_sprintf( from, sizeof( from ), "%s.%i", logWriter.ospath, i );
+			Com_sprintf( to, sizeof( to ), "%s.%i", logWriter.ospath, i + 1 );
+			rename( from, to );
+		}
+		Com_sprintf( to, sizeof( to ), "%s.1", logWriter.ospath );
+		rename( logWriter.ospath, to );
 	}
 
-	va_start( argptr,fmt );
-	Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
-	va_end( argptr );
+	logWriter.file = Sys_FOpen( logWriter.ospath, "wb" );
+	if ( !logWriter.file ) {
+		// keep appending to whatever is there rather than losing the log
+		logWriter.file = Sys_FOpen( logWriter.ospath, "ab" );
+	}
 
-	Com_Printf( S_COLOR_CYAN "%s", msg );
+	logWriter.size = 0;
+	logWriter.openTime = time( NULL );
 }
 
 
 /*
-=============
-Com_Error
-
-Both client and server can use this, and it will
-do the appropriate things.
-=============
+================
+Com_LogOutput
+================
 */
-void NORETURN FORMAT_PRINTF(2, 3) QDECL Com_Error( errorParm_t code, const char *fmt, ... ) {
-	va_list		argptr;
-	static int	lastErrorTime;
-	static int	errorCount;
-	static qboolean	calledSysError = qfalse;
-	int			currentTime;
-
-#if defined(_WIN32) && defined(_DEBUG)
-	if ( code != ERR_DISCONNECT && code != ERR_NEED_CD ) {
-		if ( !com_noErrorInterrupt->integer ) {
-			ShowWindow( g_wv.hWnd, SW_MINIMIZE );
-			DebugBreak();
-		}
+static void Com_LogOutput( const char *text, int len ) {
+	if ( len <= 0 || !logWriter.file ) {
+		return;
 	}
-#endif
+	fwrite( text, 1, len, logWriter.file );
+	logWriter.size += len;
+}
 
-	if ( com_errorEntered ) {
-		if ( !calledSysError ) {
-			calledSysError = qtrue;
-			Sys_Error( "recursive error after: %s", com_errorMessage );
-		}
+
+/*
+================
+Com_LogBeginLine
+
+Rotates on line boundaries only, so a record is never split across files
+================
+*/
+static void Com_LogBeginLine( time_t t ) {
+	if ( !logWriter.file ) {
+		return;
 	}
+	if ( ( logWriter.maxSize > 0 && logWriter.size >= logWriter.maxSize ) ||
+		( logWriter.rotateTime > 0 && t - logWriter.openTime >= logWriter.rotateTime ) ) {
+		Com_LogRotate();
+	}
+}
 
-	com_errorEntered = qtrue;
 
-	Cvar_SetIntegerValue( "com_errorCode", code );
+/*
+================
+Com_LogTimeString
+================
+*/
+static void Com_LogTimeString( time_t t, const char *format, char *buf, int size ) {
+	struct tm tm;
 
-	// when we are running automated scripts, make sure we
-	// know if anything failed
-	if ( com_buildScript && com_buildScript->integer ) {
-		code = ERR_FATAL;
-	}
+#ifdef _WIN32
+	tm = *localtime( &t ); // the CRT keeps a per-thread buffer
+#else
+	localtime_r( &t, &tm );
+#endif
+	strftime( buf, size, format, &tm );
+}
 
-	// if we are getting a solid stream of ERR_DROP, do an ERR_FATAL
-	currentTime = Sys_Milliseconds();
-	if ( currentTime - lastErrorTime < 100 ) {
-		if ( ++errorCount > 3 ) {
-			code = ERR_FATAL;
-		}
-	} else {
-		errorCount = 0;
-	}
-	lastErrorTime = currentTime;
 
-	va_start( argptr, fmt );
-	Q_vsnprintf( com_errorMessage, sizeof( com_errorMessage ), fmt, argptr );
-	va_end( argptr );
+/*
+================
+Com_LogWriteRecord
 
-	if ( code != ERR_DISCONNECT && code != ERR_NEED_CD ) {
-		// we can't recover from ERR_FATAL so there is no recipients for com_errorMessage
-		// also if ERR_FATAL was called from S_Malloc - CopyString for a long (2+ chars) text
-		// will trigger recursive error without proper client/server shutdown
-		if ( code != ERR_FATAL ) {
-			Cvar_Set( "com_errorMessage", com_errorMessage );
+Writes the current line as a JSON object, color codes stripped
+================
+*/
+static void Com_LogWriteRecord( void ) {
+	char buf[ MAXPRINTMSG * 2 ];
+	char stamp[ 32 ];
+	const char *s, *end;
+	int len, c;
+
+	Com_LogBeginLine( logWriter.lineTime );
+	Com_LogTimeString( logWriter.lineTime, "%Y-%m-%dT%H:%M:%S", stamp, sizeof( stamp ) );
+	len = Com_sprintf( buf, sizeof( buf ), "{\"time\":\"%s\",\"msec\":%i,\"text\":\"", stamp, logWriter.lineMsec );
+
+	s = logWriter.line;
+	end = logWriter.line + logWriter.lineLength;
+	while ( s < end ) {
+		if ( len > (int)sizeof( buf ) - 8 ) {
+			Com_LogOutput( buf, len );
+			len = 0;
+		}
+		if ( Q_IsColorString( s ) && s + 1 < end ) {
+			s += 2;
+			continue;
+		}
+		c = *(const byte *)s++;
+		if ( c == '"' || c == '\\' ) {
+			buf[ len++ ] = '\\';
+			buf[ len++ ] = c;
+		} else if ( c == '\t' ) {
+			buf[ len++ ] = '\\';
+			buf[ len++ ] = 't';
+		} else if ( c < ' ' || c == 127 ) {
+			if ( c != '\r' ) {
+				len += Com_sprintf( buf + len, sizeof( buf ) - len, "\\u%04x", c );
+			}
+		} else {
+			buf[ len++ ] = c;
 		}
 	}
 
-	Cbuf_Init();
+	buf[ len++ ] = '"';
+	buf[ len++ ] = '}';
+	buf[ len++ ] = '\n';
+	Com_LogOutput( buf, len );
 
-	if ( code == ERR_DISCONNECT || code == ERR_SERVERDISCONNECT ) {
-		VM_Forced_Unload_Start();
-		SV_Shutdown( "Server disconnected" );
-		Com_EndRedirect();
-#ifndef DEDICATED
-		CL_Disconnect( qfalse );
-		CL_FlushMemory();
-#endif
-		VM_Forced_Unload_Done();
+	logWriter.lineLength = 0;
+}
 
-		// make sure we can get at our local stuff
-		FS_PureServerSetLoadedPaks( "", "" );
-		com_errorEntered = qfalse;
 
-		Q_longjmp( abortframe, 1 );
-	} else if ( code == ERR_DROP ) {
-		Com_Printf( "********************\nERROR: %s\n********************\n",
-			com_errorMessage );
-		VM_Forced_Unload_Start();
-		SV_Shutdown( va( "Server crashed: %s",  com_errorMessage ) );
-		Com_EndRedirect();
-#ifndef DEDICATED
-		CL_Disconnect( qfalse );
-		CL_FlushMemory();
-#endif
-		VM_Forced_Unload_Done();
+/*
+================
+Com_LogFormat
 
-		FS_PureServerSetLoadedPaks( "", "" );
-		com_errorEntered = qfalse;
+Text comes in arbitrary fragments, line state is carried between them
+================
+*/
+static void Com_LogFormat( const char *text, int len, time_t t, int msec ) {
+	char stamp[ 40 ];
+	const char *eol;
+	int n;
+
+	while ( len > 0 ) {
+		eol = memchr( text, '\n', len );
+		n = eol ? (int)( eol - text ) + 1 : len;
+
+		if ( logWriter.lineStart ) {
+			logWriter.lineStart = qfalse;
+			logWriter.lineTime = t;
+			logWriter.lineMsec = msec;
+			if ( logWriter.format != LOG_FORMAT_JSON ) {
+				Com_LogBeginLine( t );
+			}
+			if ( logWriter.format == LOG_FORMAT_TIMESTAMP ) {
+				Com_LogTimeString( t, "[%Y-%m-%d %H:%M:%S] ", stamp, sizeof( stamp ) );
+				Com_LogOutput( stamp, (int)strlen( stamp ) );
+			}
+		}
 
-		Q_longjmp( abortframe, 1 );
-	} else if ( code == ERR_NEED_CD ) {
-		SV_Shutdown( "Server didn't have CD" );
-		Com_EndRedirect();
-#ifndef DEDICATED
-		if ( com_cl_running && com_cl_running->integer ) {
-			CL_Disconnect( qfalse );
-			VM_Forced_Unload_Start();
-			CL_FlushMemory();
-			VM_Forced_Unload_Done();
-			CL_CDDialog();
+		if ( logWriter.format == LOG_FORMAT_JSON ) {
+			if ( logWriter.lineLength + n > (int)sizeof( logWriter.line ) ) {
+				Com_LogWriteRecord();
+			}
+			Com_Memcpy( logWriter.line + logWriter.lineLength, text, n );
+			logWriter.lineLength += n;
+			if ( eol ) {
+				logWriter.lineLength--; // newline is implied by the record
+				Com_LogWriteRecord();
+			}
 		} else {
-			Com_Printf( "Server didn't have CD\n" );
+			Com_LogOutput( text, n );
 		}
-#endif
-		FS_PureServerSetLoadedPaks( "", "" );
-		com_errorEntered = qfalse;
-
-		Q_longjmp( abortframe, 1 );
-	} else {
-		VM_Forced_Unload_Start();
-#ifndef DEDICATED
-		CL_Shutdown( va( "Server fatal crashed: %s", com_errorMessage ), qtrue );
-#endif
-		SV_Shutdown( va( "Server fatal crashed: %s", com_errorMessage ) );
-		Com_EndRedirect();
-		VM_Forced_Unload_Done();
-	}
 
-	Com_Shutdown();
+		if ( eol ) {
+			logWriter.lineStart = qtrue;
+		}
 
-	calledSysError = qtrue;
-	Sys_Error( "%s", com_errorMessage );
+		text += n;
+		len -= n;
+	}
 }
 
 
 /*
-=============
-Com_Quit_f
+================
+Com_LogDrain
 
-Both client and server can use this, and it will
-do the appropriate things.
-=============
+Formats and writes everything queued so far. The writer thread and forced
+flushes share this, whoever gets the consumer flag does the work. Returns
+the number of cells written or -1 if the ring is busy.
+================
 */
-void Com_Quit_f( void ) {
-	const char *p = Cmd_ArgsFrom( 1 );
-	// don't try to shutdown if we are in a recursive error
-	if ( !com_errorEntered ) {
-		// Some VMs might execute "quit" command directly,
-		// which would trigger an unload of active VM error.
-		// Sys_Quit will kill this process anyways, so
-		// a corrupt call stack makes no difference
-		VM_Forced_Unload_Start();
-		SV_Shutdown( p[0] ? p : "Server quit" );
-#ifndef DEDICATED
-		CL_Shutdown( p[0] ? p : "Client quit", qtrue );
-#endif
-		VM_Forced_Unload_Done();
-		Com_Shutdown();
-		FS_Shutdown( qtrue );
+static int Com_LogDrain( qboolean wait, qboolean flush ) {
+	logCell_t *cell;
+	char msg[ 64 ];
+	unsigned int dropped;
+	int count, start;
+
+	if ( !LOG_CAS( &logWriter.consumer, 0, 1 ) ) {
+		if ( !wait ) {
+			return -1;
+		}
+		// bounded, the writer might have died with the flag set
+		start = Sys_Milliseconds();
+		while ( !LOG_CAS( &logWriter.consumer, 0, 1 ) ) {
+			if ( Sys_Milliseconds() - start > LOG_FLUSH_MSEC ) {
+				return -1;
+			}
+		}
 	}
-	Sys_Quit();
+
+	// at most one lap, so losses get reported while producers keep up the pressure
+	for ( count = 0; count < LOG_QUEUE_CELLS; count++ ) {
+		cell = &logWriter.cells[ logWriter.dequeuePos & ( LOG_QUEUE_CELLS - 1 ) ];
+		if ( LOG_LOAD( &cell->sequence ) != logWriter.dequeuePos + 1 ) {
+			break;
+		}
+		Com_LogFormat( cell->text, cell->length, cell->time, cell->msec );
+		LOG_STORE( &cell->sequence, logWriter.dequeuePos + LOG_QUEUE_CELLS );
+		logWriter.dequeuePos++;
+	}
+
+	if ( logWriter.lineStart && LOG_LOAD( &logWriter.dropped ) ) {
+		dropped = LOG_EXCHANGE( &logWriter.dropped, 0 );
+		Com_sprintf( msg, sizeof( msg ), "logfile: %u messages dropped\n", dropped );
+		Com_LogFormat( msg, (int)strlen( msg ), time( NULL ), Sys_Milliseconds() );
+	}
+
+	if ( logWriter.file && ( flush || ( count && logWriter.sync ) ) ) {
+		fflush( logWriter.file );
+	}
+
+	LOG_STORE( &logWriter.consumer, 0 );
+
+	return count;
 }
 
 
 /*
-============================================================================
+================
+Com_LogThread
+================
+*/
+#ifdef _WIN32
+static unsigned __stdcall Com_LogThread( void *arg )
+#else
+static void *Com_LogThread( void *arg )
+#endif
+{
+#ifndef _WIN32
+	struct timespec ts;
+#endif
 
-COMMAND LINE FUNCTIONS
+	(void)arg;
 
-+ characters separate the commandLine string into multiple console
-command lines.
+	while ( !LOG_LOAD( &logWriter.shouldTerminate ) ) {
+		if ( Com_LogDrain( qfalse, qfalse ) > 0 ) {
+			continue;
+		}
+#ifdef _WIN32
+		Sleep( LOG_WRITER_MSEC );
+#else
+		ts.tv_sec = 0;
+		ts.tv_nsec = LOG_WRITER_MSEC * 1000000;
+		nanosleep( &ts, NULL );
+#endif
+	}
 
-All of these are valid:
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
 
-quake3 +set test blah +map test
-quake3 set test blah+map test
-quake3 set test blah + map test
 
-============================================================================
-*/
+/*
+================
+Com_LogLatchSettings
 
-#define	MAX_CONSOLE_LINES	32
-static int	com_numConsoleLines;
-static char	*com_consoleLines[MAX_CONSOLE_LINES];
+Copies the logfile cvars for the writer thread
+================
+*/
+static void Com_LogLatchSettings( void ) {
+	logWriter.format = com_logfileFormat->integer;
+	logWriter.maxSize = (long)com_logfileMaxSize->integer * 1024;
+	logWriter.rotateTime = com_logfileRotate->integer * 60;
+	logWriter.backups = com_logfileBackups->integer;
+
+	com_logfileFormat->modified = qfalse;
+	com_logfileMaxSize->modified = qfalse;
+	com_logfileRotate->modified = qfalse;
+	com_logfileBackups->modified = qfalse;
+}
 
-// master rcon password
-char	rconPassword2[MAX_CVAR_VALUE_STRING];
 
 /*
-==================
-Com_ParseCommandLine
+================
+Com_LogOpen
 
-Break it up into multiple console lines
-==================
+The filesystem creates the path and applies the overwrite/append mode,
+then the writer gets its own stdio handle so it never touches FS state
+================
 */
-static void Com_ParseCommandLine( char *commandLine ) {
-	static int parsed = 0;
-	int inq;
+static qboolean Com_LogOpen( const char *logName, int mode ) {
+	fileHandle_t f;
+	int i;
 
-	if ( parsed )
-		return;
+	if ( mode & 2 )
+		f = FS_FOpenFileAppend( logName );
+	else
+		f = FS_FOpenFileWrite( logName );
 
-	inq = 0;
-	com_consoleLines[0] = commandLine;
-	rconPassword2[0] = '\0';
+	if ( f == FS_INVALID_HANDLE ) {
+		return qfalse;
+	}
 
-	while ( *commandLine ) {
-		if (*commandLine == '"') {
-			inq = !inq;
-		}
-		// look for a + separating character
-		// if commandLine came from a file, we might have real line separators
-		if ( (*commandLine == '+' && !inq) || *commandLine == '\n'  || *commandLine == '\r' ) {
-			if ( com_numConsoleLines == MAX_CONSOLE_LINES ) {
-				break;
-			}
-			com_consoleLines[com_numConsoleLines] = commandLine + 1;
-			com_numConsoleLines++;
-			*commandLine = '\0';
-		}
-		commandLine++;
+	FS_FCloseFile( f );
+
+	Com_Memset( &logWriter, 0, sizeof( logWriter ) );
+	Q_strncpyz( logWriter.ospath, FS_BuildOSPath( FS_GetHomePath(), NULL, logName ), sizeof( logWriter.ospath ) );
+
+	logWriter.file = Sys_FOpen( logWriter.ospath, "ab" );
+	if ( !logWriter.file ) {
+		return qfalse;
 	}
-	parsed = 1;
+
+	fseek( logWriter.file, 0, SEEK_END );
+	logWriter.size = ftell( logWriter.file );
+	logWriter.openTime = time( NULL );
+	logWriter.sync = ( mode & 1 ) ? qtrue : qfalse;
+	logWriter.lineStart = qtrue;
+	for ( i = 0; i < LOG_QUEUE_CELLS; i++ ) {
+		logWriter.cells[ i ].sequence = i;
+	}
+	Com_LogLatchSettings();
+
+#ifdef _WIN32
+	logWriter.thread = (HANDLE)_beginthreadex( NULL, 0, Com_LogThread, NULL, 0, NULL );
+	logWriter.started = logWriter.thread ? qtrue : qfalse;
+#else
+	logWriter.started = ( pthread_create( &logWriter.thread, NULL, Com_LogThread, NULL ) == 0 ) ? qtrue : qfalse;
+#endif
+
+	return qtrue;
 }
 
-char cl_title[ MAX_CVAR_VALUE_STRING ] = CLIENT_WINDOW_TITLE;
 
 /*
-===================
-Com_EarlyParseCmdLine
+================
+Com_LogWrite
 
-returns qtrue if both vid_xpos and vid_ypos was set
-===================
+Doesn't wait unless asked to, in which case a full ring is drained
+on the calling thread
+================
 */
-qboolean Com_EarlyParseCmdLine( char *commandLine, char *con_title, int title_size, int *vid_xpos, int *vid_ypos )
-{
-	int		flags = 0;
-	int		i;
-
-	*con_title = '\0';
-	Com_ParseCommandLine( commandLine );
-
-	for ( i = 0 ; i < com_numConsoleLines ; i++ ) {
-		Cmd_TokenizeString( com_consoleLines[i] );
-		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "cl_title" ) ) {
-			com_consoleLines[i][0] = '\0';
-			Q_strncpyz( cl_title, Cmd_ArgsFrom( 2 ), sizeof(cl_title) );
-			continue;
-		}
-		if ( !Q_stricmp( Cmd_Argv(0), "cl_title" ) ) {
-			com_consoleLines[i][0] = '\0';
-			Q_strncpyz( cl_title, Cmd_ArgsFrom( 1 ), sizeof(cl_title) );
-			continue;
-		}
-		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "con_title" ) ) {
-			com_consoleLines[i][0] = '\0';
-			Q_strncpyz( con_title, Cmd_ArgsFrom( 2 ), title_size );
-			continue;
-		}
-		if ( !Q_stricmp( Cmd_Argv(0), "con_title" ) ) {
-			com_consoleLines[i][0] = '\0';
-			Q_strncpyz( con_title, Cmd_ArgsFrom( 1 ), title_size );
-			continue;
-		}
-		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "vid_xpos" ) ) {
-			*vid_xpos = atoi( Cmd_Argv( 2 ) );
-			flags |= 1;
-			continue;
-		}
-		if ( !Q_stricmp( Cmd_Argv(0), "vid_xpos" ) ) {
-			*vid_xpos = atoi( Cmd_Argv( 1 ) );
-			flags |= 1;
-			continue;
-		}
-		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "vid_ypos" ) ) {
-			*vid_ypos = atoi( Cmd_Argv( 2 ) );
-			flags |= 2;
-			continue;
-		}
-		if ( !Q_stricmp( Cmd_Argv(0), "vid_ypos" ) ) {
-			*vid_ypos = atoi( Cmd_Argv( 1 ) );
-			flags |= 2;
-			continue;
-		}
-		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "rconPassword2" ) ) {
-			com_consoleLines[i][0] = '\0';
-			Q_strncpyz( rconPassword2, Cmd_Argv( 2 ), sizeof( rconPassword2 ) );
-			continue;
+static void Com_LogWrite( const char *text, int len, qboolean wait ) {
+	while ( !Com_LogQueue( text, len ) ) {
+		if ( !wait || Com_LogDrain( qtrue, qfalse ) <= 0 ) {
+			LOG_ADD( &logWriter.dropped, 1 );
+			return;
 		}
 	}
 
-	return (flags == 3) ? qtrue : qfalse ;
+	// no writer thread, do it the old way
+	if ( !logWriter.started ) {
+		Com_LogDrain( qtrue, qfalse );
+	}
 }
 
 
 /*
-===================
-Com_SafeMode
+================
+Com_LogFlush
 
-Check for "safe" on the command line, which will
-skip loading of q3config.cfg
-===================
+Writes out everything queued so far, also used on crash paths
+================
 */
-qboolean Com_SafeMode( void ) {
-	int		i;
-
-	for ( i = 0 ; i < com_numConsoleLines ; i++ ) {
-		Cmd_TokenizeString( com_consoleLines[i] );
-		if ( !Q_stricmp( Cmd_Argv(0), "safe" )
-			|| !Q_stricmp( Cmd_Argv(0), "cvar_restart" ) ) {
-			com_consoleLines[i][0] = '\0';
-			return qtrue;
-		}
+void Com_LogFlush( void ) {
+	if ( logWriter.file ) {
+		Com_LogDrain( qtrue, qtrue );
 	}
-	return qfalse;
 }
 
 
 /*
-===============
-Com_StartupVariable
-
-Searches for command line parameters that are set commands.
-If match is not NULL, only that cvar will be looked for.
-That is necessary because cddir and basedir need to be set
-before the filesystem is started, but all other sets should
-be after execing the config and default.
-===============
+================
+Com_LogClose
+================
 */
-void Com_StartupVariable( const char *match ) {
-	int i;
-	const char *name;
+static void Com_LogClose( void ) {
+	if ( !logWriter.file ) {
+		return;
+	}
 
-	for ( i = 0; i < com_numConsoleLines; i++ ) {
-		Cmd_TokenizeString( com_consoleLines[i] );
-		if ( Q_stricmp( Cmd_Argv( 0 ), "set" ) ) {
-			continue;
-		}
+	if ( logWriter.started ) {
+		LOG_STORE( &logWriter.shouldTerminate, 1 );
+#ifdef _WIN32
+		WaitForSingleObject( logWriter.thread, INFINITE );
+		CloseHandle( logWriter.thread );
+#else
+		pthread_join( logWriter.thread, NULL );
+#endif
+		logWriter.started = qfalse;
+	}
 
-		name = Cmd_Argv( 1 );
-		if ( !match || Q_stricmp( name, match ) == 0 ) {
-			if ( Cvar_Flags( name ) == CVAR_NONEXISTENT )
-				Cvar_Get( name, Cmd_ArgsFrom( 2 ), CVAR_USER_CREATED );
-			else
-				Cvar_Set2( name, Cmd_ArgsFrom( 2 ), qfalse );
-		}
+	Com_LogDrain( qtrue, qfalse );
+	if ( logWriter.format == LOG_FORMAT_JSON && logWriter.lineLength ) {
+		Com_LogWriteRecord();
 	}
+
+	fclose( logWriter.file );
+	logWriter.file = NULL;
 }
 
 
 /*
-=================
-Com_AddStartupCommands
+=============
+Com_Printf
 
-Adds command line parameters as script statements
-Commands are separated by + signs
+Both client and server can use this, and it will output
+to the appropriate place.
 
-Returns qtrue if any late commands were added, which
-will keep the demoloop from immediately starting
-=================
+A raw string should NEVER be passed as fmt, because of "%f" type crashers.
+=============
 */
-static qboolean Com_AddStartupCommands( void ) {
-	int		i;
-	qboolean	added;
+void FORMAT_PRINTF(1, 2) QDECL Com_Printf( const char *fmt, ... ) {
+	static qboolean opening_qconsole = qfalse;
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+	int			len;
 
-	added = qfalse;
-	// quote every token, so args with semicolons can work
-	for (i=0 ; i < com_numConsoleLines ; i++) {
-		if ( !com_consoleLines[i] || !com_consoleLines[i][0] ) {
-			continue;
-		}
+	va_start( argptr, fmt );
+	len = Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
+	va_end( argptr );
 
-		// set commands already added with Com_StartupVariable
-		if ( !Q_stricmpn( com_consoleLines[i], "set ", 4 ) ) {
-			continue;
+	if ( rd_buffer && !rd_flushing ) {
+		if ( len + (int)strlen( rd_buffer ) > ( rd_buffersize - 1 ) ) {
+			rd_flushing = qtrue;
+			rd_flush( rd_buffer );
+			rd_flushing = qfalse;
+			*rd_buffer = '\0';
 		}
-
-		added = qtrue;
-		Cbuf_AddText( com_consoleLines[i] );
-		Cbuf_AddText( "\n" );
+		Q_strcat( rd_buffer, rd_buffersize, msg );
+		// TTimo nooo .. that would defeat the purpose
+		//rd_flush(rd_buffer);
+		//*rd_buffer = '\0';
+		return;
 	}
 
-	return added;
-}
-
-
-//============================================================================
-
-void Info_Print( const char *s ) {
-	char	key[BIG_INFO_KEY];
-	char	value[BIG_INFO_VALUE];
+#ifndef DEDICATED
+	// echo to client console if we're not a dedicated server
+	if ( !com_dedicated || !com_dedicated->integer ) {
+		CL_ConsolePrint( msg );
+	}
+#endif
 
-	do {
-		s = Info_NextPair( s, key, value );
-		if ( key[0] == '\0' )
-			break;
+	// echo to dedicated console and early console
+	Sys_Print( msg );
 
-		if ( value[0] == '\0' )
-			strcpy( value, "MISSING VALUE" );
+	// logfile
+	if ( com_logfile && com_logfile->integer ) {
+		// TTimo: only open the qconsole.log if the filesystem is in an initialized state
+		//   also, avoid recursing in the qconsole.log opening (i.e. if fs_debug is on)
+		if ( !logWriter.file && FS_Initialized() && !opening_qconsole ) {
+			const char *logName = "qconsole.log";
 
-		Com_Printf( "%-20s %s\n", key, value );
+			opening_qconsole = qtrue;
 
-	} while ( *s != '\0' );
-}
+			if ( Com_LogOpen( logName, com_logfile->integer - 1 ) ) {
+				struct tm *newtime;
+				time_t aclock;
+				char timestr[32];
 
+				time( &aclock );
+				newtime = localtime( &aclock );
+				strftime( timestr, sizeof( timestr ), "%a %b %d %X %Y", newtime );
 
-/*
-============
-Com_StringContains
-============
-*/
-static const char *Com_StringContains( const char *str1, const char *str2, int len2 ) {
-	int len, i, j;
+				Com_Printf( "logfile opened on %s\n", timestr );
 
-	len = strlen(str1) - len2;
-	for (i = 0; i <= len; i++, str1++) {
-		for (j = 0; str2[j]; j++) {
-			if (locase[(byte)str1[j]] != locase[(byte)str2[j]]) {
-				break;
+				if ( !logWriter.started ) {
+					Com_Printf( S_COLOR_YELLOW "Failed to start the log writer thread, logging synchronously\n" );
+				}
+			} else {
+				Com_Printf( S_COLOR_YELLOW "Opening %s failed!\n", logName );
+				Cvar_Set( "logfile", "0" );
 			}
+
+			opening_qconsole = qfalse;
 		}
-		if (!str2[j]) {
-			return str1;
+		if ( logWriter.file ) {
+			Com_LogWrite( msg, len, qfalse );
 		}
 	}
-	return NULL;
 }
 
 
 /*
-============
-Com_Filter
-============
+================
+Com_DPrintf
+
+A Com_Printf that only shows up if the "developer" cvar is set
+================
 */
-int Com_Filter( const char *filter, const char *name )
-{
-	char buf[ MAX_TOKEN_CHARS ];
-	const char *ptr;
-	int i, found;
+void FORMAT_PRINTF(1, 2) QDECL Com_DPrintf( const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
 
-	while(*filter) {
-		if (*filter == '*') {
-			filter++;
-			for (i = 0; *filter; i++) {
-				if (*filter == '*' || *filter == '?')
-					break;
-				buf[i] = *filter;
-				filter++;
-			}
-			buf[i] = '\0';
-			if ( i ) {
-				ptr = Com_StringContains( name, buf, i );
-				if ( !ptr )
-					return qfalse;
-				name = ptr + i;
-			}
-		}
-		else if (*filter == '?') {
-			filter++;
-			name++;
-		}
-		else if (*filter == '[' && *(filter+1) == '[') {
-			filter++;
-		}
-		else if (*filter == '[') {
-			filter++;
-			found = qfalse;
-			while(*filter && !found) {
-				if (*filter == ']' && *(filter+1) != ']') break;
-				if (*(filter+1) == '-' && *(filter+2) && (*(filter+2) != ']' || *(filter+3) == ']')) {
-					if (locase[(byte)*name] >= locase[(byte)*filter] &&
-						locase[(byte)*name] <= locase[(byte)*(filter+2)])
-							found = qtrue;
-					filter += 3;
-				}
-				else {
-					if (locase[(byte)*filter] == locase[(byte)*name])
-						found = qtrue;
-					filter++;
-				}
-			}
-			if (!found) return qfalse;
-			while(*filter) {
-				if (*filter == ']' && *(filter+1) != ']') break;
-				filter++;
-			}
-			filter++;
-			name++;
-		}
-		else {
-			if (locase[(byte)*filter] != locase[(byte)*name])
-				return qfalse;
-			filter++;
-			name++;
-		}
+	if ( !com_developer || !com_developer->integer ) {
+		return;			// don't confuse non-developers with techie stuff...
 	}
-	return qtrue;
+
+	va_start( argptr,fmt );
+	Q_vsnprintf( msg, sizeof( msg ), fmt, argptr );
+	va_end( argptr );
+
+	Com_Printf( S_COLOR_CYAN "%s", msg );
 }
 
 
 /*
-============
-Com_FilterExt
-============
+=============
+Com_Error
+
+Both client and server can use this, and it will
+do the appropriate things.
+=============
 */
-qboolean Com_FilterExt( const char *filter, const char *name )
-{
-	char buf[ MAX_TOKEN_CHARS ];
-	const char *ptr;
-	int i;
+void NORETURN FORMAT_PRINTF(2, 3) QDECL Com_Error( errorParm_t code, const char *fmt, ... ) {
+	va_list		argptr;
+	static int	lastErrorTime;
+	static int	errorCount;
+	static qboolean	calledSysError = qfalse;
+	int			currentTime;
 
-	while ( *filter ) {
-		if ( *filter == '*' ) {
-			filter++;
-			for ( i = 0; *filter != '\0' && i < sizeof(buf)-1; i++ ) {
-				if ( *filter == '*' || *filter == '?' )
-					break;
-				buf[i] = *filter++;
-			}
-			buf[ i ] = '\0';
-			if ( i ) {
-				ptr = Com_StringContains( name, buf, i );
-				if ( !ptr )
-					return qfalse;
-				name = ptr + i;
-			} else if ( *filter == '\0' ) {
-				return qtrue;
-			}
-		}
-		else if ( *filter == '?' ) {
-			if ( *name == '\0' )
-				return qfalse;
-			filter++;
-			name++;
-		}
-		else {
-			if ( locase[(byte)*filter] != locase[(byte)*name] )
-				return qfalse;
-			filter++;
-			name++;
+#if defined(_WIN32) && defined(_DEBUG)
+	if ( code != ERR_DISCONNECT && code != ERR_NEED_CD ) {
+		if ( !com_noErrorInterrupt->integer ) {
+			ShowWindow( g_wv.hWnd, SW_MINIMIZE );
+			DebugBreak();
 		}
 	}
-	if ( *name ) {
-		return qfalse;
-	}
-	return qtrue;
-}
-
-
-/*
-============
-Com_HasPatterns
-============
-*/
-qboolean Com_HasPatterns( const char *str )
-{
-	int c;
+#endif
 
-	while ( (c = *str++) != '\0' )
-	{
-		if ( c == '*' || c == '?' )
-		{
-			return qtrue;
+	if ( com_errorEntered ) {
+		if ( !calledSysError ) {
+			calledSysError = qtrue;
+			Sys_Error( "recursive error after: %s", com_errorMessage );
 		}
 	}
 
-	return qfalse;
-}
+	com_errorEntered = qtrue;
 
+	Cvar_SetIntegerValue( "com_errorCode", code );
 
-/*
-============
-Com_FilterPath
-============
-*/
-int Com_FilterPath( const char *filter, const char *name )
-{
-	int i;
-	char new_filter[MAX_QPATH];
-	char new_name[MAX_QPATH];
+	// when we are running automated scripts, make sure we
+	// know if anything failed
+	if ( com_buildScript && com_buildScript->integer ) {
+		code = ERR_FATAL;
+	}
 
-	for (i = 0; i < MAX_QPATH-1 && filter[i]; i++) {
-		if ( filter[i] == '\\' || filter[i] == ':' ) {
-			new_filter[i] = '/';
-		}
-		else {
-			new_filter[i] = filter[i];
+	// if we are getting a solid stream of ERR_DROP, do an ERR_FATAL
+	currentTime = Sys_Milliseconds();
+	if ( currentTime - lastErrorTime < 100 ) {
+		if ( ++errorCount > 3 ) {
+			code = ERR_FATAL;
 		}
+	} else {
+		errorCount = 0;
 	}
-	new_filter[i] = '\0';
-	for (i = 0; i < MAX_QPATH-1 && name[i]; i++) {
-		if ( name[i] == '\\' || name[i] == ':' ) {
-			new_name[i] = '/';
-		}
-		else {
-			new_name[i] = name[i];
+	lastErrorTime = currentTime;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( com_errorMessage, sizeof( com_errorMessage ), fmt, argptr );
+	va_end( argptr );
+
+	if ( code != ERR_DISCONNECT && code != ERR_NEED_CD ) {
+		// we can't recover from ERR_FATAL so there is no recipients for com_errorMessage
+		// also if ERR_FATAL was called from S_Malloc - CopyString for a long (2+ chars) text
+		// will trigger recursive error without proper client/server shutdown
+		if ( code != ERR_FATAL ) {
+			Cvar_Set( "com_errorMessage", com_errorMessage );
 		}
 	}
-	new_name[i] = '\0';
-	return Com_Filter( new_filter, new_name );
-}
 
+	Cbuf_Init();
 
-/*
-================
-Com_RealTime
-================
-*/
-int Com_RealTime(qtime_t *qtime) {
-	time_t t;
-	struct tm *tms;
+	if ( code == ERR_DISCONNECT || code == ERR_SERVERDISCONNECT ) {
+		VM_Forced_Unload_Start();
+		SV_Shutdown( "Server disconnected" );
+		Com_EndRedirect();
+#ifndef DEDICATED
+		CL_Disconnect( qfalse );
+		CL_FlushMemory();
+#endif
+		VM_Forced_Unload_Done();
 
-	t = time(NULL);
-	if (!qtime)
-		return t;
-	tms = localtime(&t);
-	if (tms) {
-		qtime->tm_sec = tms->tm_sec;
-		qtime->tm_min = tms->tm_min;
-		qtime->tm_hour = tms->tm_hour;
-		qtime->tm_mday = tms->tm_mday;
-		qtime->tm_mon = tms->tm_mon;
-		qtime->tm_year = tms->tm_year;
-		qtime->tm_wday = tms->tm_wday;
-		qtime->tm_yday = tms->tm_yday;
-		qtime->tm_isdst = tms->tm_isdst;
-	}
-	return t;
-}
+		// make sure we can get at our local stuff
+		FS_PureServerSetLoadedPaks( "", "" );
+		com_errorEntered = qfalse;
 
+		Q_longjmp( abortframe, 1 );
+	} else if ( code == ERR_DROP ) {
+		Com_Printf( "********************\nERROR: %s\n********************\n",
+			com_errorMessage );
+		VM_Forced_Unload_Start();
+		SV_Shutdown( va( "Server crashed: %s",  com_errorMessage ) );
+		Com_EndRedirect();
+#ifndef DEDICATED
+		CL_Disconnect( qfalse );
+		CL_FlushMemory();
+#endif
+		VM_Forced_Unload_Done();
 
-/*
-================
-Sys_Microseconds
-================
-*/
-int64_t Sys_Microseconds( void )
-{
-#ifdef _WIN32
-	static qboolean inited = qfalse;
-	static LARGE_INTEGER base;
-	static LARGE_INTEGER freq;
-	LARGE_INTEGER curr;
+		FS_PureServerSetLoadedPaks( "", "" );
+		com_errorEntered = qfalse;
 
-	if ( !inited )
-	{
-		QueryPerformanceFrequency( &freq );
-		QueryPerformanceCounter( &base );
-		if ( !freq.QuadPart )
-		{
-			return (int64_t)Sys_Milliseconds() * 1000LL; // fallback
+		Q_longjmp( abortframe, 1 );
+	} else if ( code == ERR_NEED_CD ) {
+		SV_Shutdown( "Server didn't have CD" );
+		Com_EndRedirect();
+#ifndef DEDICATED
+		if ( com_cl_running && com_cl_running->integer ) {
+			CL_Disconnect( qfalse );
+			VM_Forced_Unload_Start();
+			CL_FlushMemory();
+			VM_Forced_Unload_Done();
+			CL_CDDialog();
+		} else {
+			Com_Printf( "Server didn't have CD\n" );
 		}
-		inited = qtrue;
-		return 0;
+#endif
+		FS_PureServerSetLoadedPaks( "", "" );
+		com_errorEntered = qfalse;
+
+		Q_longjmp( abortframe, 1 );
+	} else {
+		VM_Forced_Unload_Start();
+#ifndef DEDICATED
+		CL_Shutdown( va( "Server fatal crashed: %s", com_errorMessage ), qtrue );
+#endif
+		SV_Shutdown( va( "Server fatal crashed: %s", com_errorMessage ) );
+		Com_EndRedirect();
+		VM_Forced_Unload_Done();
 	}
 
-	QueryPerformanceCounter( &curr );
+	Com_Shutdown();
 
-	return ((curr.QuadPart - base.QuadPart) * 1000000LL) / freq.QuadPart;
-#else
-	struct timeval curr;
-	gettimeofday( &curr, NULL );
+	calledSysError = qtrue;
+	Sys_Error( "%s", com_errorMessage );
+}
 
-	return (int64_t)curr.tv_sec * 1000000LL + (int64_t)curr.tv_usec;
+
+/*
+=============
+Com_Quit_f
+
+Both client and server can use this, and it will
+do the appropriate things.
+=============
+*/
+void Com_Quit_f( void ) {
+	const char *p = Cmd_ArgsFrom( 1 );
+	// don't try to shutdown if we are in a recursive error
+	if ( !com_errorEntered ) {
+		// Some VMs might execute "quit" command directly,
+		// which would trigger an unload of active VM error.
+		// Sys_Quit will kill this process anyways, so
+		// a corrupt call stack makes no difference
+		VM_Forced_Unload_Start();
+		SV_Shutdown( p[0] ? p : "Server quit" );
+#ifndef DEDICATED
+		CL_Shutdown( p[0] ? p : "Client quit", qtrue );
 #endif
+		VM_Forced_Unload_Done();
+		Com_Shutdown();
+		FS_Shutdown( qtrue );
+	}
+	Sys_Quit();
 }
 
 
 /*
-==============================================================================
+============================================================================
 
-						ZONE MEMORY ALLOCATION
+COMMAND LINE FUNCTIONS
 
-There is never any space between memblocks, and there will never be two
-contiguous free memblocks.
++ characters separate the commandLine string into multiple console
+command lines.
 
-The rover can be left pointing at a non-empty block
+All of these are valid:
 
-The zone calls are pretty much only used for small strings and structures,
-all big things are allocated on the hunk.
-==============================================================================
+quake3 +set test blah +map test
+quake3 set test blah+map test
+quake3 set test blah + map test
+
+============================================================================
 */
 
-#define	ZONEID	0x1d4a11
-#define MINFRAGMENT	64
+#define	MAX_CONSOLE_LINES	32
+static int	com_numConsoleLines;
+static char	*com_consoleLines[MAX_CONSOLE_LINES];
 
-#ifdef USE_MULTI_SEGMENT
-#if 1 // forward lookup, faster allocation
-#define DIRECTION next
-// we may have up to 4 lists to group free blocks by size
-//#define TINY_SIZE	32
-#define SMALL_SIZE	64
-#define MEDIUM_SIZE	128
-#else // backward lookup, better free space consolidation
-#define DIRECTION prev
-#define TINY_SIZE	64
-#define SMALL_SIZE	128
-#define MEDIUM_SIZE	256
-#endif
-#endif
+// master rcon password
+char	rconPassword2[MAX_CVAR_VALUE_STRING];
 
-#define USE_STATIC_TAGS
-#define USE_TRASH_TEST
+/*
+==================
+Com_ParseCommandLine
 
-#ifdef ZONE_DEBUG
-typedef struct zonedebug_s {
-	const char *label;
-	const char *file;
-	int line;
-	int allocSize;
-} zonedebug_t;
-#endif
+Break it up into multiple console lines
+==================
+*/
+static void Com_ParseCommandLine( char *commandLine ) {
+	static int parsed = 0;
+	int inq;
 
-typedef struct memblock_s {
-	struct memblock_s	*next, *prev;
-	int			size;	// including the header and possibly tiny fragments
-	memtag_t	tag;	// a tag of 0 is a free block
-	int			id;		// should be ZONEID
-#ifdef ZONE_DEBUG
-	zonedebug_t d;
-#endif
-} memblock_t;
+	if ( parsed )
+		return;
 
-typedef struct freeblock_s {
-	struct freeblock_s *prev;
-	struct freeblock_s *next;
-} freeblock_t;
+	inq = 0;
+	com_consoleLines[0] = commandLine;
+	rconPassword2[0] = '\0';
 
-typedef struct memzone_s {
-	int		size;			// total bytes malloced, including header
-	int		used;			// total bytes used
-	memblock_t	blocklist;	// start / end cap for linked list
-#ifdef USE_MULTI_SEGMENT
-	memblock_t	dummy0;		// just to allocate some space before freelist
-	freeblock_t	freelist_tiny;
-	memblock_t	dummy1;
-	freeblock_t	freelist_small;
-	memblock_t	dummy2;
-	freeblock_t	freelist_medium;
-	memblock_t	dummy3;
-	freeblock_t	freelist;
-#else
-	memblock_t	*rover;
-#endif
-} memzone_t;
+	while ( *commandLine ) {
+		if (*commandLine == '"') {
+			inq = !inq;
+		}
+		// look for a + separating character
+		// if commandLine came from a file, we might have real line separators
+		if ( (*commandLine == '+' && !inq) || *commandLine == '\n'  || *commandLine == '\r' ) {
+			if ( com_numConsoleLines == MAX_CONSOLE_LINES ) {
+				break;
+			}
+			com_consoleLines[com_numConsoleLines] = commandLine + 1;
+			com_numConsoleLines++;
+			*commandLine = '\0';
+		}
+		commandLine++;
+	}
+	parsed = 1;
+}
 
-static int minfragment = MINFRAGMENT; // may be adjusted at runtime
+char cl_title[ MAX_CVAR_VALUE_STRING ] = CLIENT_WINDOW_TITLE;
 
-// main zone for all "dynamic" memory allocation
-static memzone_t *mainzone;
+/*
+===================
+Com_EarlyParseCmdLine
 
-// we also have a small zone for small allocations that would only
-// fragment the main zone (think of cvar and cmd strings)
-static memzone_t *smallzone;
+returns qtrue if both vid_xpos and vid_ypos was set
+===================
+*/
+qboolean Com_EarlyParseCmdLine( char *commandLine, char *con_title, int title_size, int *vid_xpos, int *vid_ypos )
+{
+	int		flags = 0;
+	int		i;
 
+	*con_title = '\0';
+	Com_ParseCommandLine( commandLine );
 
-#ifdef USE_MULTI_SEGMENT
+	for ( i = 0 ; i < com_numConsoleLines ; i++ ) {
+		Cmd_TokenizeString( com_consoleLines[i] );
+		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "cl_title" ) ) {
+			com_consoleLines[i][0] = '\0';
+			Q_strncpyz( cl_title, Cmd_ArgsFrom( 2 ), sizeof(cl_title) );
+			continue;
+		}
+		if ( !Q_stricmp( Cmd_Argv(0), "cl_title" ) ) {
+			com_consoleLines[i][0] = '\0';
+			Q_strncpyz( cl_title, Cmd_ArgsFrom( 1 ), sizeof(cl_title) );
+			continue;
+		}
+		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "con_title" ) ) {
+			com_consoleLines[i][0] = '\0';
+			Q_strncpyz( con_title, Cmd_ArgsFrom( 2 ), title_size );
+			continue;
+		}
+		if ( !Q_stricmp( Cmd_Argv(0), "con_title" ) ) {
+			com_consoleLines[i][0] = '\0';
+			Q_strncpyz( con_title, Cmd_ArgsFrom( 1 ), title_size );
+			continue;
+		}
+		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "vid_xpos" ) ) {
+			*vid_xpos = atoi( Cmd_Argv( 2 ) );
+			flags |= 1;
+			continue;
+		}
+		if ( !Q_stricmp( Cmd_Argv(0), "vid_xpos" ) ) {
+			*vid_xpos = atoi( Cmd_Argv( 1 ) );
+			flags |= 1;
+			continue;
+		}
+		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "vid_ypos" ) ) {
+			*vid_ypos = atoi( Cmd_Argv( 2 ) );
+			flags |= 2;
+			continue;
+		}
+		if ( !Q_stricmp( Cmd_Argv(0), "vid_ypos" ) ) {
+			*vid_ypos = atoi( Cmd_Argv( 1 ) );
+			flags |= 2;
+			continue;
+		}
+		if ( !Q_stricmpn( Cmd_Argv(0), "set", 3 ) && !Q_stricmp( Cmd_Argv(1), "rconPassword2" ) ) {
+			com_consoleLines[i][0] = '\0';
+			Q_strncpyz( rconPassword2, Cmd_Argv( 2 ), sizeof( rconPassword2 ) );
+			continue;
+		}
+	}
 
-static void InitFree( freeblock_t *fb )
-{
-	memblock_t *block = (memblock_t*)( (byte*)fb - sizeof( memblock_t ) );
-	Com_Memset( block, 0, sizeof( *block ) );
+	return (flags == 3) ? qtrue : qfalse ;
 }
 
 
-static void RemoveFree( memblock_t *block )
-{
-	freeblock_t *fb = (freeblock_t*)( block + 1 );
-	freeblock_t *prev;
-	freeblock_t *next;
-
-#ifdef ZONE_DEBUG
-	if ( fb->next == NULL || fb->prev == NULL || fb->next == fb || fb->prev == fb ) {
-		Com_Error( ERR_FATAL, "RemoveFree: bad pointers fb->next: %p, fb->prev: %p\n", fb->next, fb->prev );
-	}
-#endif
+/*
+===================
+Com_SafeMode
 
-	prev = fb->prev;
-	next = fb->next;
+Check for "safe" on the command line, which will
+skip loading of q3config.cfg
+===================
+*/
+qboolean Com_SafeMode( void ) {
+	int		i;
 
-	prev->next = next;
-	next->prev = prev;
+	for ( i = 0 ; i < com_numConsoleLines ; i++ ) {
+		Cmd_TokenizeString( com_consoleLines[i] );
+		if ( !Q_stricmp( Cmd_Argv(0), "safe" )
+			|| !Q_stricmp( Cmd_Argv(0), "cvar_restart" ) ) {
+			com_consoleLines[i][0] = '\0';
+			return qtrue;
+		}
+	}
+	return qfalse;
 }
 
 
-static void InsertFree( memzone_t *zone, memblock_t *block )
-{
-	freeblock_t *fb = (freeblock_t*)( block + 1 );
-	freeblock_t *prev, *next;
-#ifdef TINY_SIZE
-	if ( block->size <= TINY_SIZE )
-		prev = &zone->freelist_tiny;
-	else
-#endif
-#ifdef SMALL_SIZE
-	if ( block->size <= SMALL_SIZE )
-		prev = &zone->freelist_small;
-	else
-#endif
-#ifdef MEDIUM_SIZE
-	if ( block->size <= MEDIUM_SIZE )
-		prev = &zone->freelist_medium;
-	else
-#endif
-		prev = &zone->freelist;
-
-	next = prev->next;
+/*
+===============
+Com_StartupVariable
 
-#ifdef ZONE_DEBUG
-	if ( block->size < sizeof( *fb ) + sizeof( *block ) ) {
-		Com_Error( ERR_FATAL, "InsertFree: bad block size: %i\n", block->size );
-	}
-#endif
+Searches for command line parameters that are set commands.
+If match is not NULL, only that cvar will be looked for.
+That is necessary because cddir and basedir need to be set
+before the filesystem is started, but all other sets should
+be after execing the config and default.
+===============
+*/
+void Com_StartupVariable( const char *match ) {
+	int i;
+	const char *name;
 
-	prev->next = fb;
-	next->prev = fb;
+	for ( i = 0; i < com_numConsoleLines; i++ ) {
+		Cmd_TokenizeString( com_consoleLines[i] );
+		if ( Q_stricmp( Cmd_Argv( 0 ), "set" ) ) {
+			continue;
+		}
 
-	fb->prev = prev;
-	fb->next = next;
+		name = Cmd_Argv( 1 );
+		if ( !match || Q_stricmp( name, match ) == 0 ) {
+			if ( Cvar_Flags( name ) == CVAR_NONEXISTENT )
+				Cvar_Get( name, Cmd_ArgsFrom( 2 ), CVAR_USER_CREATED );
+			else
+				Cvar_Set2( name, Cmd_ArgsFrom( 2 ), qfalse );
+		}
+	}
 }
 
 
 /*
-================
-NewBlock
+=================
+Com_AddStartupCommands
 
-Allocates new free block within specified memory zone
+Adds command line parameters as script statements
+Commands are separated by + signs
 
-Separator is needed to avoid additional runtime checks in Z_Free()
-to prevent merging it with previous free block
-================
+Returns qtrue if any late commands were added, which
+will keep the demoloop from immediately starting
+=================
 */
-static freeblock_t *NewBlock( memzone_t *zone, int size )
-{
-	memblock_t *prev, *next;
-	memblock_t *block, *sep;
-	int alloc_size;
+static qboolean Com_AddStartupCommands( void ) {
+	int		i;
+	qboolean	added;
 
-	// zone->prev is pointing on last block in the list
-	prev = zone->blocklist.prev;
-	next = prev->next;
+	added = qfalse;
+	// quote every token, so args with semicolons can work
+	for (i=0 ; i < com_numConsoleLines ; i++) {
+		if ( !com_consoleLines[i] || !com_consoleLines[i][0] ) {
+			continue;
+		}
 
-	size = PAD( size, 1<<21 ); // round up to 2M blocks
-	// allocate separator block before new free block
-	alloc_size = size + sizeof( *sep );
+		// set commands already added with Com_StartupVariable
+		if ( !Q_stricmpn( com_consoleLines[i], "set ", 4 ) ) {
+			continue;
+		}
 
-	sep = (memblock_t *) calloc( alloc_size, 1 );
-	if ( sep == NULL ) {
-		Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-			size, zone == smallzone ? "small" : "main" );
-		return NULL;
+		added = qtrue;
+		Cbuf_AddText( com_consoleLines[i] );
+		Cbuf_AddText( "\n" );
 	}
-	block = sep+1;
-
-	// link separator with prev
-	prev->next = sep;
-	sep->prev = prev;
 
-	// link separator with block
-	sep->next = block;
-	block->prev = sep;
+	return added;
+}
 
-	// link block with next
-	block->next = next;
-	next->prev = block;
 
-	sep->tag = TAG_GENERAL; // in-use block
-	sep->id = -ZONEID;
-	sep->size = 0;
+//============================================================================
 
-	block->tag = TAG_FREE;
+void Info_Print( const char *s ) {
+	char	key[BIG_INFO_KEY];
+	char	value[BIG_INFO_VALUE];
+
+	do {
+		s = Info_NextPair( s, key, value );
+		if ( key[0] == '\0' )
+			break;
+
+		if ( value[0] == '\0' )
+			strcpy( value, "MISSING VALUE" );
+
+		Com_Printf( "%-20s %s\n", key, value );
+
+	} while ( *s != '\0' );
+}
+
+
+/*
+============
+Com_StringContains
+============
+*/
+static const char *Com_StringContains( const char *str1, const char *str2, int len2 ) {
+	int len, i, j;
+
+	len = strlen(str1) - len2;
+	for (i = 0; i <= len; i++, str1++) {
+		for (j = 0; str2[j]; j++) {
+			if (locase[(byte)str1[j]] != locase[(byte)str2[j]]) {
+				break;
+			}
+		}
+		if (!str2[j]) {
+			return str1;
+		}
+	}
+	return NULL;
+}
+
+
+/*
+============
+Com_Filter
+============
+*/
+int Com_Filter( const char *filter, const char *name )
+{
+	char buf[ MAX_TOKEN_CHARS ];
+	const char *ptr;
+	int i, found;
+
+	while(*filter) {
+		if (*filter == '*') {
+			filter++;
+			for (i = 0; *filter; i++) {
+				if (*filter == '*' || *filter == '?')
+					break;
+				buf[i] = *filter;
+				filter++;
+			}
+			buf[i] = '\0';
+			if ( i ) {
+				ptr = Com_StringContains( name, buf, i );
+				if ( !ptr )
+					return qfalse;
+				name = ptr + i;
+			}
+		}
+		else if (*filter == '?') {
+			filter++;
+			name++;
+		}
+		else if (*filter == '[' && *(filter+1) == '[') {
+			filter++;
+		}
+		else if (*filter == '[') {
+			filter++;
+			found = qfalse;
+			while(*filter && !found) {
+				if (*filter == ']' && *(filter+1) != ']') break;
+				if (*(filter+1) == '-' && *(filter+2) && (*(filter+2) != ']' || *(filter+3) == ']')) {
+					if (locase[(byte)*name] >= locase[(byte)*filter] &&
+						locase[(byte)*name] <= locase[(byte)*(filter+2)])
+							found = qtrue;
+					filter += 3;
+				}
+				else {
+					if (locase[(byte)*filter] == locase[(byte)*name])
+						found = qtrue;
+					filter++;
+				}
+			}
+			if (!found) return qfalse;
+			while(*filter) {
+				if (*filter == ']' && *(filter+1) != ']') break;
+				filter++;
+			}
+			filter++;
+			name++;
+		}
+		else {
+			if (locase[(byte)*filter] != locase[(byte)*name])
+				return qfalse;
+			filter++;
+			name++;
+		}
+	}
+	return qtrue;
+}
+
+
+/*
+============
+Com_FilterExt
+============
+*/
+qboolean Com_FilterExt( const char *filter, const char *name )
+{
+	char buf[ MAX_TOKEN_CHARS ];
+	const char *ptr;
+	int i;
+
+	while ( *filter ) {
+		if ( *filter == '*' ) {
+			filter++;
+			for ( i = 0; *filter != '\0' && i < sizeof(buf)-1; i++ ) {
+				if ( *filter == '*' || *filter == '?' )
+					break;
+				buf[i] = *filter++;
+			}
+			buf[ i ] = '\0';
+			if ( i ) {
+				ptr = Com_StringContains( name, buf, i );
+				if ( !ptr )
+					return qfalse;
+				name = ptr + i;
+			} else if ( *filter == '\0' ) {
+				return qtrue;
+			}
+		}
+		else if ( *filter == '?' ) {
+			if ( *name == '\0' )
+				return qfalse;
+			filter++;
+			name++;
+		}
+		else {
+			if ( locase[(byte)*filter] != locase[(byte)*name] )
+				return qfalse;
+			filter++;
+			name++;
+		}
+	}
+	if ( *name ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+
+/*
+============
+Com_HasPatterns
+============
+*/
+qboolean Com_HasPatterns( const char *str )
+{
+	int c;
+
+	while ( (c = *str++) != '\0' )
+	{
+		if ( c == '*' || c == '?' )
+		{
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+
+/*
+============
+Com_FilterPath
+============
+*/
+int Com_FilterPath( const char *filter, const char *name )
+{
+	int i;
+	char new_filter[MAX_QPATH];
+	char new_name[MAX_QPATH];
+
+	for (i = 0; i < MAX_QPATH-1 && filter[i]; i++) {
+		if ( filter[i] == '\\' || filter[i] == ':' ) {
+			new_filter[i] = '/';
+		}
+		else {
+			new_filter[i] = filter[i];
+		}
+	}
+	new_filter[i] = '\0';
+	for (i = 0; i < MAX_QPATH-1 && name[i]; i++) {
+		if ( name[i] == '\\' || name[i] == ':' ) {
+			new_name[i] = '/';
+		}
+		else {
+			new_name[i] = name[i];
+		}
+	}
+	new_name[i] = '\0';
+	return Com_Filter( new_filter, new_name );
+}
+
+
+/*
+================
+Com_RealTime
+================
+*/
+int Com_RealTime(qtime_t *qtime) {
+	time_t t;
+	struct tm *tms;
+
+	t = time(NULL);
+	if (!qtime)
+		return t;
+	tms = localtime(&t);
+	if (tms) {
+		qtime->tm_sec = tms->tm_sec;
+		qtime->tm_min = tms->tm_min;
+		qtime->tm_hour = tms->tm_hour;
+		qtime->tm_mday = tms->tm_mday;
+		qtime->tm_mon = tms->tm_mon;
+		qtime->tm_year = tms->tm_year;
+		qtime->tm_wday = tms->tm_wday;
+		qtime->tm_yday = tms->tm_yday;
+		qtime->tm_isdst = tms->tm_isdst;
+	}
+	return t;
+}
+
+
+/*
+================
+Sys_Microseconds
+================
+*/
+int64_t Sys_Microseconds( void )
+{
+#ifdef _WIN32
+	static qboolean inited = qfalse;
+	static LARGE_INTEGER base;
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER curr;
+
+	if ( !inited )
+	{
+		QueryPerformanceFrequency( &freq );
+		QueryPerformanceCounter( &base );
+		if ( !freq.QuadPart )
+		{
+			return (int64_t)Sys_Milliseconds() * 1000LL; // fallback
+		}
+		inited = qtrue;
+		return 0;
+	}
+
+	QueryPerformanceCounter( &curr );
+
+	return ((curr.QuadPart - base.QuadPart) * 1000000LL) / freq.QuadPart;
+#else
+	struct timeval curr;
+	gettimeofday( &curr, NULL );
+
+	return (int64_t)curr.tv_sec * 1000000LL + (int64_t)curr.tv_usec;
+#endif
+}
+
+
+/*
+==============================================================================
+
+						ZONE MEMORY ALLOCATION
+
+There is never any space between memblocks, and there will never be two
+contiguous free memblocks.
+
+The rover can be left pointing at a non-empty block
+
+The zone calls are pretty much only used for small strings and structures,
+all big things are allocated on the hunk.
+==============================================================================
+*/
+
+#define	ZONEID	0x1d4a11
+#define MINFRAGMENT	64
+
+#ifdef USE_MULTI_SEGMENT
+#if 1 // forward lookup, faster allocation
+#define DIRECTION next
+// we may have up to 4 lists to group free blocks by size
+//#define TINY_SIZE	32
+#define SMALL_SIZE	64
+#define MEDIUM_SIZE	128
+#else // backward lookup, better free space consolidation
+#define DIRECTION prev
+#define TINY_SIZE	64
+#define SMALL_SIZE	128
+#define MEDIUM_SIZE	256
+#endif
+#endif
+
+#define USE_STATIC_TAGS
+#define USE_TRASH_TEST
+
+#ifdef ZONE_DEBUG
+typedef struct zonedebug_s {
+	const char *label;
+	const char *file;
+	int line;
+	int allocSize;
+} zonedebug_t;
+#endif
+
+typedef struct memblock_s {
+	struct memblock_s	*next, *prev;
+	int			size;	// including the header and possibly tiny fragments
+	memtag_t	tag;	// a tag of 0 is a free block
+	int			id;		// should be ZONEID
+#ifdef ZONE_DEBUG
+	zonedebug_t d;
+#endif
+} memblock_t;
+
+typedef struct freeblock_s {
+	struct freeblock_s *prev;
+	struct freeblock_s *next;
+} freeblock_t;
+
+typedef struct memzone_s {
+	int		size;			// total bytes malloced, including header
+	int		used;			// total bytes used
+	memblock_t	blocklist;	// start / end cap for linked list
+#ifdef USE_MULTI_SEGMENT
+	memblock_t	dummy0;		// just to allocate some space before freelist
+	freeblock_t	freelist_tiny;
+	memblock_t	dummy1;
+	freeblock_t	freelist_small;
+	memblock_t	dummy2;
+	freeblock_t	freelist_medium;
+	memblock_t	dummy3;
+	freeblock_t	freelist;
+#else
+	memblock_t	*rover;
+#endif
+} memzone_t;
+
+static int minfragment = MINFRAGMENT; // may be adjusted at runtime
+
+// main zone for all "dynamic" memory allocation
+static memzone_t *mainzone;
+
+// we also have a small zone for small allocations that would only
+// fragment the main zone (think of cvar and cmd strings)
+static memzone_t *smallzone;
+
+
+#ifdef USE_MULTI_SEGMENT
+
+static void InitFree( freeblock_t *fb )
+{
+	memblock_t *block = (memblock_t*)( (byte*)fb - sizeof( memblock_t ) );
+	Com_Memset( block, 0, sizeof( *block ) );
+}
+
+
+static void RemoveFree( memblock_t *block )
+{
+	freeblock_t *fb = (freeblock_t*)( block + 1 );
+	freeblock_t *prev;
+	freeblock_t *next;
+
+#ifdef ZONE_DEBUG
+	if ( fb->next == NULL || fb->prev == NULL || fb->next == fb || fb->prev == fb ) {
+		Com_Error( ERR_FATAL, "RemoveFree: bad pointers fb->next: %p, fb->prev: %p\n", fb->next, fb->prev );
+	}
+#endif
+
+	prev = fb->prev;
+	next = fb->next;
+
+	prev->next = next;
+	next->prev = prev;
+}
+
+
+static void InsertFree( memzone_t *zone, memblock_t *block )
+{
+	freeblock_t *fb = (freeblock_t*)( block + 1 );
+	freeblock_t *prev, *next;
+#ifdef TINY_SIZE
+	if ( block->size <= TINY_SIZE )
+		prev = &zone->freelist_tiny;
+	else
+#endif
+#ifdef SMALL_SIZE
+	if ( block->size <= SMALL_SIZE )
+		prev = &zone->freelist_small;
+	else
+#endif
+#ifdef MEDIUM_SIZE
+	if ( block->size <= MEDIUM_SIZE )
+		prev = &zone->freelist_medium;
+	else
+#endif
+		prev = &zone->freelist;
+
+	next = prev->next;
+
+#ifdef ZONE_DEBUG
+	if ( block->size < sizeof( *fb ) + sizeof( *block ) ) {
+		Com_Error( ERR_FATAL, "InsertFree: bad block size: %i\n", block->size );
+	}
+#endif
+
+	prev->next = fb;
+	next->prev = fb;
+
+	fb->prev = prev;
+	fb->next = next;
+}
+
+
+/*
+================
+NewBlock
+
+Allocates new free block within specified memory zone
+
+Separator is needed to avoid additional runtime checks in Z_Free()
+to prevent merging it with previous free block
+================
+*/
+static freeblock_t *NewBlock( memzone_t *zone, int size )
+{
+	memblock_t *prev, *next;
+	memblock_t *block, *sep;
+	int alloc_size;
+
+	// zone->prev is pointing on last block in the list
+	prev = zone->blocklist.prev;
+	next = prev->next;
+
+	size = PAD( size, 1<<21 ); // round up to 2M blocks
+	// allocate separator block before new free block
+	alloc_size = size + sizeof( *sep );
+
+	sep = (memblock_t *) calloc( alloc_size, 1 );
+	if ( sep == NULL ) {
+		Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+			size, zone == smallzone ? "small" : "main" );
+		return NULL;
+	}
+	block = sep+1;
+
+	// link separator with prev
+	prev->next = sep;
+	sep->prev = prev;
+
+	// link separator with block
+	sep->next = block;
+	block->prev = sep;
+
+	// link block with next
+	block->next = next;
+	next->prev = block;
+
+	sep->tag = TAG_GENERAL; // in-use block
+	sep->id = -ZONEID;
+	sep->size = 0;
+
+	block->tag = TAG_FREE;
+	block->id = ZONEID;
+	block->size = size;
+
+	// update zone statistics
+	zone->size += alloc_size;
+	zone->used += sizeof( *sep );
+
+	InsertFree( zone, block );
+
+	return (freeblock_t*)( block + 1 );
+}
+
+
+static memblock_t *SearchFree( memzone_t *zone, int size )
+{
+	const freeblock_t *fb;
+	memblock_t *base;
+
+#ifdef TINY_SIZE
+	if ( size <= TINY_SIZE )
+		fb = zone->freelist_tiny.DIRECTION;
+	else
+#endif
+#ifdef SMALL_SIZE
+	if ( size <= SMALL_SIZE )
+		fb = zone->freelist_small.DIRECTION;
+	else
+#endif
+#ifdef MEDIUM_SIZE
+	if ( size <= MEDIUM_SIZE )
+		fb = zone->freelist_medium.DIRECTION;
+	else
+#endif
+		fb = zone->freelist.DIRECTION;
+
+	for ( ;; ) {
+		// not found, allocate new segment?
+		if ( fb == &zone->freelist ) {
+			fb = NewBlock( zone, size );
+		} else {
+#ifdef TINY_SIZE
+			if ( fb == &zone->freelist_tiny ) {
+				fb = zone->freelist_small.DIRECTION;
+				continue;
+			}
+#endif
+#ifdef SMALL_SIZE
+			if ( fb == &zone->freelist_small ) {
+				fb = zone->freelist_medium.DIRECTION;
+				continue;
+			}
+#endif
+#ifdef MEDIUM_SIZE
+			if ( fb == &zone->freelist_medium ) {
+				fb = zone->freelist.DIRECTION;
+				continue;
+			}
+#endif
+		}
+		base = (memblock_t*)( (byte*) fb - sizeof( *base ) );
+		fb = fb->DIRECTION;
+		if ( base->size >= size ) {
+			return base;
+		}
+	}
+	return NULL;
+}
+#endif // USE_MULTI_SEGMENT
+
+
+/*
+========================
+Z_ClearZone
+========================
+*/
+static void Z_ClearZone( memzone_t *zone, memzone_t *head, int size, int segnum ) {
+	memblock_t	*block;
+	int min_fragment;
+
+#ifdef USE_MULTI_SEGMENT
+	min_fragment = sizeof( memblock_t ) + sizeof( freeblock_t );
+#else
+	min_fragment = sizeof( memblock_t );
+#endif
+
+	if ( minfragment < min_fragment ) {
+		// in debug mode size of memblock_t may exceed MINFRAGMENT
+		minfragment = PAD( min_fragment, sizeof( intptr_t ) );
+		Com_DPrintf( "zone.minfragment adjusted to %i bytes\n", minfragment );
+	}
+
+	// set the entire zone to one free block
+	zone->blocklist.next = zone->blocklist.prev = block = (memblock_t *)( zone + 1 );
+	zone->blocklist.tag = TAG_GENERAL; // in use block
+	zone->blocklist.id = -ZONEID;
+	zone->blocklist.size = 0;
+#ifndef USE_MULTI_SEGMENT
+	zone->rover = block;
+#endif
+	zone->size = size;
+	zone->used = 0;
+
+	block->prev = block->next = &zone->blocklist;
+	block->tag = TAG_FREE;	// free block
 	block->id = ZONEID;
-	block->size = size;
 
-	// update zone statistics
-	zone->size += alloc_size;
-	zone->used += sizeof( *sep );
+	block->size = size - sizeof(memzone_t);
+
+#ifdef USE_MULTI_SEGMENT
+	InitFree( &zone->freelist );
+	zone->freelist.next = zone->freelist.prev = &zone->freelist;
+
+	InitFree( &zone->freelist_medium );
+	zone->freelist_medium.next = zone->freelist_medium.prev = &zone->freelist_medium;
+
+	InitFree( &zone->freelist_small );
+	zone->freelist_small.next = zone->freelist_small.prev = &zone->freelist_small;
+
+	InitFree( &zone->freelist_tiny );
+	zone->freelist_tiny.next = zone->freelist_tiny.prev = &zone->freelist_tiny;
+
+	InsertFree( zone, block );
+#endif
+}
+
+
+/*
+========================
+Z_AvailableZoneMemory
+========================
+*/
+static int Z_AvailableZoneMemory( const memzone_t *zone ) {
+#ifdef USE_MULTI_SEGMENT
+	return (1024*1024*1024); // unlimited
+#else
+	return zone->size - zone->used;
+#endif
+}
+
+
+/*
+========================
+Z_AvailableMemory
+========================
+*/
+int Z_AvailableMemory( void ) {
+	return Z_AvailableZoneMemory( mainzone );
+}
+
+
+static void MergeBlock( memblock_t *curr_free, const memblock_t *next )
+{
+	curr_free->size += next->size;
+	curr_free->next = next->next;
+	curr_free->next->prev = curr_free;
+}
+
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free( void *ptr ) {
+	memblock_t	*block, *other;
+	memzone_t *zone;
+
+	if (!ptr) {
+		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
+	}
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if (block->id != ZONEID) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
+	}
+
+	if (block->tag == TAG_FREE) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
+	}
+
+	// if static memory
+#ifdef USE_STATIC_TAGS
+	if (block->tag == TAG_STATIC) {
+		return;
+	}
+#endif
+
+	// check the memory trash tester
+#ifdef USE_TRASH_TEST
+	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
+		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
+	}
+#endif
+
+	if ( block->tag == TAG_SMALL ) {
+		zone = smallzone;
+	} else {
+		zone = mainzone;
+	}
+
+	zone->used -= block->size;
+
+	// set the block to something that should cause problems
+	// if it is referenced...
+	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
+
+	block->tag = TAG_FREE; // mark as free
+	block->id = ZONEID;
+
+	other = block->prev;
+	if ( other->tag == TAG_FREE ) {
+#ifdef USE_MULTI_SEGMENT
+		RemoveFree( other );
+#endif
+		// merge with previous free block
+		MergeBlock( other, block );
+#ifndef USE_MULTI_SEGMENT
+		if ( block == zone->rover ) {
+			zone->rover = other;
+		}
+#endif
+		block = other;
+	}
+
+#ifndef USE_MULTI_SEGMENT
+	zone->rover = block;
+#endif
+
+	other = block->next;
+	if ( other->tag == TAG_FREE ) {
+#ifdef USE_MULTI_SEGMENT
+		RemoveFree( other );
+#endif
+		// merge the next free block onto the end
+		MergeBlock( block, other );
+	}
+
+#ifdef USE_MULTI_SEGMENT
+	InsertFree( zone, block );
+#endif
+}
+
+
+/*
+================
+Z_FreeTags
+================
+*/
+int Z_FreeTags( memtag_t tag ) {
+	int			count;
+	memzone_t	*zone;
+	memblock_t	*block, *freed;
+
+	if ( tag == TAG_STATIC ) {
+		Com_Error( ERR_FATAL, "Z_FreeTags( TAG_STATIC )" );
+		return 0;
+	} else if ( tag == TAG_SMALL ) {
+		zone = smallzone;
+	} else {
+		zone = mainzone;
+	}
+
+	count = 0;
+	for ( block = zone->blocklist.next ; ; ) {
+		if ( block->tag == tag && block->id == ZONEID ) {
+			if ( block->prev->tag == TAG_FREE )
+				freed = block->prev;  // current block will be merged with previous
+			else
+				freed = block; // will leave in place
+			Z_Free( (void*)( block + 1 ) );
+			block = freed;
+			count++;
+		}
+		if ( block->next == &zone->blocklist ) {
+			break;	// all blocks have been hit
+		}
+		block = block->next;
+	}
+
+	return count;
+}
+
+
+/*
+================
+Z_TagMalloc
+================
+*/
+#ifdef ZONE_DEBUG
+void *Z_TagMallocDebug( int size, memtag_t tag, char *label, char *file, int line ) {
+	int		allocSize;
+#else
+void *Z_TagMalloc( int size, memtag_t tag ) {
+#endif
+	int		extra;
+#ifndef USE_MULTI_SEGMENT
+	memblock_t	*start, *rover;
+#endif
+	memblock_t *base;
+	memzone_t *zone;
+
+	if ( tag == TAG_FREE ) {
+		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use with TAG_FREE" );
+	}
+
+	if ( tag == TAG_SMALL ) {
+		zone = smallzone;
+	} else {
+		zone = mainzone;
+	}
+
+#ifdef ZONE_DEBUG
+	allocSize = size;
+#endif
+
+#ifdef USE_MULTI_SEGMENT
+	if ( size < (sizeof( freeblock_t ) ) ) {
+		size = (sizeof( freeblock_t ) );
+	}
+#endif
+
+	//
+	// scan through the block list looking for the first free block
+	// of sufficient size
+	//
+	size += sizeof( *base );	// account for size of block header
+#ifdef USE_TRASH_TEST
+	size += 4;					// space for memory trash tester
+#endif
+
+	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
+
+#ifdef USE_MULTI_SEGMENT
+	base = SearchFree( zone, size );
+
+	RemoveFree( base );
+#else
+
+	base = rover = zone->rover;
+	start = base->prev;
+
+	do {
+		if ( rover == start ) {
+			// scanned all the way around the list
+#ifdef ZONE_DEBUG
+			Z_LogHeap();
+			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
+								size, zone == smallzone ? "small" : "main", file, line, label );
+#else
+			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+								size, zone == smallzone ? "small" : "main" );
+#endif
+			return NULL;
+		}
+		if ( rover->tag != TAG_FREE ) {
+			base = rover = rover->next;
+		} else {
+			rover = rover->next;
+		}
+	} while (base->tag != TAG_FREE || base->size < size);
+#endif
+
+	//
+	// found a block big enough
+	//
+	extra = base->size - size;
+	if ( extra >= minfragment ) {
+		memblock_t *fragment;
+		// there will be a free fragment after the allocated block
+		fragment = (memblock_t *)( (byte *)base + size );
+		fragment->size = extra;
+		fragment->tag = TAG_FREE; // free block
+		fragment->id = ZONEID;
+		fragment->prev = base;
+		fragment->next = base->next;
+		fragment->next->prev = fragment;
+		base->next = fragment;
+		base->size = size;
+#ifdef USE_MULTI_SEGMENT
+		InsertFree( zone, fragment );
+#endif
+	}
+
+#ifndef USE_MULTI_SEGMENT
+	zone->rover = base->next;	// next allocation will start looking here
+#endif
+	zone->used += base->size;
+
+	base->tag = tag;			// no longer a free block
+	base->id = ZONEID;
+
+#ifdef ZONE_DEBUG
+	base->d.label = label;
+	base->d.file = file;
+	base->d.line = line;
+	base->d.allocSize = allocSize;
+#endif
+
+#ifdef USE_TRASH_TEST
+	// marker for memory trash testing
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
+#endif
+
+	return (void *) ( base + 1 );
+}
+
+
+/*
+========================
+Z_Malloc
+========================
+*/
+#ifdef ZONE_DEBUG
+void *Z_MallocDebug( int size, char *label, char *file, int line ) {
+#else
+void *Z_Malloc( int size ) {
+#endif
+	void	*buf;
+
+  //Z_CheckHeap ();	// DEBUG
+
+#ifdef ZONE_DEBUG
+	buf = Z_TagMallocDebug( size, TAG_GENERAL, label, file, line );
+#else
+	buf = Z_TagMalloc( size, TAG_GENERAL );
+#endif
+	Com_Memset( buf, 0, size );
+
+	return buf;
+}
+
+
+/*
+========================
+S_Malloc
+========================
+*/
+#ifdef ZONE_DEBUG
+void *S_MallocDebug( int size, char *label, char *file, int line ) {
+	return Z_TagMallocDebug( size, TAG_SMALL, label, file, line );
+}
+#else
+void *S_Malloc( int size ) {
+	return Z_TagMalloc( size, TAG_SMALL );
+}
+#endif
+
+
+/*
+========================
+Z_CheckHeap
+========================
+*/
+static void Z_CheckHeap( void ) {
+	const memblock_t *block;
+	const memzone_t *zone;
+
+	zone =  mainzone;
+	for ( block = zone->blocklist.next ; ; ) {
+		if ( block->next == &zone->blocklist ) {
+			break;	// all blocks have been hit
+		}
+		if ( (byte *)block + block->size != (byte *)block->next) {
+#ifdef USE_MULTI_SEGMENT
+			const memblock_t *next = block->next;
+			if ( next->size == 0 && next->id == -ZONEID && next->tag == TAG_GENERAL ) {
+				block = next; // new zone segment
+			} else
+#endif
+			Com_Error( ERR_FATAL, "Z_CheckHeap: block size does not touch the next block" );
+		}
+		if ( block->next->prev != block) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: next block doesn't have proper back link" );
+		}
+		if ( block->tag == TAG_FREE && block->next->tag == TAG_FREE ) {
+			Com_Error( ERR_FATAL, "Z_CheckHeap: two consecutive free blocks" );
+		}
+		block = block->next;
+	}
+}
+
+
+/*
+========================
+Z_LogZoneHeap
+========================
+*/
+static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
+#ifdef ZONE_DEBUG
+	char dump[32], *ptr;
+	int  i, j;
+#endif
+	memblock_t	*block;
+	char		buf[4096];
+	int size, allocSize, numBlocks;
+	int len;
+
+	if ( !logWriter.file )
+		return;
+
+	size = numBlocks = 0;
+#ifdef ZONE_DEBUG
+	allocSize = 0;
+#endif
+	len = Com_sprintf( buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name );
+	Com_LogWrite( buf, len, qtrue );
+	for ( block = zone->blocklist.next ; ; ) {
+		if ( block->tag != TAG_FREE ) {
+#ifdef ZONE_DEBUG
+			ptr = ((char *) block) + sizeof(memblock_t);
+			j = 0;
+			for (i = 0; i < 20 && i < block->d.allocSize; i++) {
+				if (ptr[i] >= 32 && ptr[i] < 127) {
+					dump[j++] = ptr[i];
+				}
+				else {
+					dump[j++] = '_';
+				}
+			}
+			dump[j] = '\0';
+			len = Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
+			Com_LogWrite( buf, len, qtrue );
+			allocSize += block->d.allocSize;
+#endif
+			size += block->size;
+			numBlocks++;
+		}
+		if ( block->next == &zone->blocklist ) {
+			break; // all blocks have been hit
+		}
+		block = block->next;
+	}
+#ifdef ZONE_DEBUG
+	// subtract debug memory
+	size -= numBlocks * sizeof(zonedebug_t);
+#else
+	allocSize = numBlocks * sizeof(memblock_t); // + 32 bit alignment
+#endif
+	len = Com_sprintf( buf, sizeof( buf ), "%d %s memory in %d blocks\r\n", size, name, numBlocks );
+	Com_LogWrite( buf, len, qtrue );
+	len = Com_sprintf( buf, sizeof( buf ), "%d %s memory overhead\r\n", size - allocSize, name );
+	Com_LogWrite( buf, len, qtrue );
+	Com_LogFlush();
+}
+
+
+/*
+========================
+Z_LogHeap
+========================
+*/
+void Z_LogHeap( void ) {
+	Z_LogZoneHeap( mainzone, "MAIN" );
+	Z_LogZoneHeap( smallzone, "SMALL" );
+}
+
+#ifdef USE_STATIC_TAGS
+
+// static mem blocks to reduce a lot of small zone overhead
+typedef struct memstatic_s {
+	memblock_t b;
+	byte mem[2];
+} memstatic_t;
+
+#define MEM_STATIC(chr) { { NULL, NULL, PAD(sizeof(memstatic_t),4), TAG_STATIC, ZONEID }, {chr,'\0'} }
+
+static const memstatic_t emptystring =
+	MEM_STATIC( '\0' );
+
+static const memstatic_t numberstring[] = {
+	MEM_STATIC( '0' ),
+	MEM_STATIC( '1' ),
+	MEM_STATIC( '2' ),
+	MEM_STATIC( '3' ),
+	MEM_STATIC( '4' ),
+	MEM_STATIC( '5' ),
+	MEM_STATIC( '6' ),
+	MEM_STATIC( '7' ),
+	MEM_STATIC( '8' ),
+	MEM_STATIC( '9' )
+};
+#endif // USE_STATIC_TAGS
+
+/*
+========================
+CopyString
+
+ NOTE:	never write over the memory CopyString returns because
+		memory from a memstatic_t might be returned
+========================
+*/
+char *CopyString( const char *in ) {
+	char *out;
+#ifdef USE_STATIC_TAGS
+	if ( in[0] == '\0' ) {
+		return ((char *)&emptystring) + sizeof(memblock_t);
+	}
+	else if ( in[0] >= '0' && in[0] <= '9' && in[1] == '\0' ) {
+		return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+	}
+#endif
+	out = S_Malloc( strlen( in ) + 1 );
+	strcpy( out, in );
+	return out;
+}
+
 
-	InsertFree( zone, block );
+/*
+==============================================================================
 
-	return (freeblock_t*)( block + 1 );
-}
+Goals:
+	reproducible without history effects -- no out of memory errors on weird map to map changes
+	allow restarting of the client without fragmentation
+	minimize total pages in use at run time
+	minimize total pages needed during load time
 
+  Single block of memory with stack allocators coming from both ends towards the middle.
 
-static memblock_t *SearchFree( memzone_t *zone, int size )
+  One side is designated the temporary memory allocator.
+
+  Temporary memory can be allocated and freed in any order.
+
+  A highwater mark is kept of the most in use at any time.
+
+  When there is no temporary memory allocated, the permanent and temp sides
+  can be switched, allowing the already touched temp memory to be used for
+  permanent storage.
+
+  Temp memory must never be allocated on two ends at once, or fragmentation
+  could occur.
+
+  If we have any in-use temp memory, additional temp allocations must come from
+  that side.
+
+  If not, we can choose to make either side the new temp side and push future
+  permanent allocations to the other side.  Permanent allocations should be
+  kept on the side that has the current greatest wasted highwater mark.
+
+==============================================================================
+*/
+
+
+#define	HUNK_MAGIC	0x89537892
+#define	HUNK_FREE_MAGIC	0x89537893
+
+typedef struct {
+	unsigned int magic;
+	unsigned int size;
+} hunkHeader_t;
+
+typedef struct {
+	int		mark;
+	int		permanent;
+	int		temp;
+	int		tempHighwater;
+} hunkUsed_t;
+
+typedef struct hunkblock_s {
+	int size;
+	byte printed;
+	struct hunkblock_s *next;
+	const char *label;
+	const char *file;
+	int line;
+} hunkblock_t;
+
+static	hunkblock_t *hunkblocks;
+
+static	hunkUsed_t	hunk_low, hunk_high;
+static	hunkUsed_t	*hunk_permanent, *hunk_temp;
+
+static	byte	*s_hunkData = NULL;
+static	int		s_hunkTotal;
+
+static const char *tagName[ TAG_COUNT ] = {
+	"FREE",
+	"GENERAL",
+	"PACK",
+	"SEARCH-PATH",
+	"SEARCH-PACK",
+	"SEARCH-DIR",
+	"BOTLIB",
+	"RENDERER",
+	"CLIENTS",
+	"SMALL",
+	"STATIC"
+};
+
+typedef struct zone_stats_s {
+	int	zoneSegments;
+	int zoneBlocks;
+	int	zoneBytes;
+	int	botlibBytes;
+	int	rendererBytes;
+	int freeBytes;
+	int freeBlocks;
+	int freeSmallest;
+	int freeLargest;
+} zone_stats_t;
+
+
+static void Zone_Stats( const char *name, const memzone_t *z, qboolean printDetails, zone_stats_t *stats )
 {
-	const freeblock_t *fb;
-	memblock_t *base;
+	const memblock_t *block;
+	const memzone_t *zone;
+	zone_stats_t st;
 
-#ifdef TINY_SIZE
-	if ( size <= TINY_SIZE )
-		fb = zone->freelist_tiny.DIRECTION;
-	else
-#endif
-#ifdef SMALL_SIZE
-	if ( size <= SMALL_SIZE )
-		fb = zone->freelist_small.DIRECTION;
-	else
-#endif
-#ifdef MEDIUM_SIZE
-	if ( size <= MEDIUM_SIZE )
-		fb = zone->freelist_medium.DIRECTION;
-	else
-#endif
-		fb = zone->freelist.DIRECTION;
+	memset( &st, 0, sizeof( st ) );
+	zone = z;
+	st.zoneSegments = 1;
+	st.freeSmallest = 0x7FFFFFFF;
 
-	for ( ;; ) {
-		// not found, allocate new segment?
-		if ( fb == &zone->freelist ) {
-			fb = NewBlock( zone, size );
-		} else {
-#ifdef TINY_SIZE
-			if ( fb == &zone->freelist_tiny ) {
-				fb = zone->freelist_small.DIRECTION;
-				continue;
-			}
-#endif
-#ifdef SMALL_SIZE
-			if ( fb == &zone->freelist_small ) {
-				fb = zone->freelist_medium.DIRECTION;
-				continue;
+	//if ( printDetails ) {
+	//	Com_Printf( "---------- %s zone segment #%i ----------\n", name, zone->segnum );
+	//}
+
+	for ( block = zone->blocklist.next ; ; ) {
+		if ( printDetails ) {
+			int tag = block->tag;
+			Com_Printf( "block:%p  size:%8i  tag: %s\n", (void *)block, block->size,
+				(unsigned)tag < TAG_COUNT ? tagName[ tag ] : va( "%i", tag ) );
+		}
+		if ( block->tag != TAG_FREE ) {
+			st.zoneBytes += block->size;
+			st.zoneBlocks++;
+			if ( block->tag == TAG_BOTLIB ) {
+				st.botlibBytes += block->size;
+			} else if ( block->tag == TAG_RENDERER ) {
+				st.rendererBytes += block->size;
 			}
-#endif
-#ifdef MEDIUM_SIZE
-			if ( fb == &zone->freelist_medium ) {
-				fb = zone->freelist.DIRECTION;
+		} else {
+			st.freeBytes += block->size;
+			st.freeBlocks++;
+			if ( block->size > st.freeLargest )
+				st.freeLargest = block->size;
+			if ( block->size < st.freeSmallest )
+				st.freeSmallest = block->size;
+		}
+		if ( block->next == &zone->blocklist ) {
+			break; // all blocks have been hit
+		}
+		if ( (byte *)block + block->size != (byte *)block->next) {
+#ifdef USE_MULTI_SEGMENT
+			const memblock_t *next = block->next;
+			if ( next->size == 0 && next->id == -ZONEID && next->tag == TAG_GENERAL ) {
+				st.zoneSegments++;
+				if ( printDetails ) {
+					Com_Printf( "---------- %s zone segment #%i ----------\n", name, st.zoneSegments );
+				}
+				block = next->next;
 				continue;
-			}
+			} else
 #endif
+				Com_Printf( "ERROR: block size does not touch the next block\n" );
 		}
-		base = (memblock_t*)( (byte*) fb - sizeof( *base ) );
-		fb = fb->DIRECTION;
-		if ( base->size >= size ) {
-			return base;
+		if ( block->next->prev != block) {
+			Com_Printf( "ERROR: next block doesn't have proper back link\n" );
+		}
+		if ( block->tag == TAG_FREE && block->next->tag == TAG_FREE ) {
+			Com_Printf( "ERROR: two consecutive free blocks\n" );
 		}
+		block = block->next;
+	}
+
+	// export stats
+	if ( stats ) {
+		memcpy( stats, &st, sizeof( *stats ) );
+	}
+}
+
+
+/*
+=================
+Com_Meminfo_f
+=================
+*/
+static void Com_Meminfo_f( void ) {
+	zone_stats_t st;
+	int		unused;
+
+	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i low mark\n", hunk_low.mark );
+	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
+	if ( hunk_low.temp != hunk_low.permanent ) {
+		Com_Printf( "%8i low temp\n", hunk_low.temp );
+	}
+	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i high mark\n", hunk_high.mark );
+	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
+	if ( hunk_high.temp != hunk_high.permanent ) {
+		Com_Printf( "%8i high temp\n", hunk_high.temp );
+	}
+	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
+	unused = 0;
+	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
+		unused += hunk_low.tempHighwater - hunk_low.permanent;
+	}
+	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
+		unused += hunk_high.tempHighwater - hunk_high.permanent;
+	}
+	Com_Printf( "%8i unused highwater\n", unused );
+	Com_Printf( "\n" );
+
+	Zone_Stats( "main", mainzone, !Q_stricmp( Cmd_Argv(1), "main" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
+	Com_Printf( "%8i bytes total main zone\n\n", mainzone->size );
+	Com_Printf( "%8i bytes in %i main zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
+		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
+	Com_Printf( "        %8i bytes in botlib\n", st.botlibBytes );
+	Com_Printf( "        %8i bytes in renderer\n", st.rendererBytes );
+	Com_Printf( "        %8i bytes in other\n", st.zoneBytes - ( st.botlibBytes + st.rendererBytes ) );
+	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
+	if ( st.freeBlocks > 1 ) {
+		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+	}
+
+	Zone_Stats( "small", smallzone, !Q_stricmp( Cmd_Argv(1), "small" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
+	Com_Printf( "%8i bytes total small zone\n\n", smallzone->size );
+	Com_Printf( "%8i bytes in %i small zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
+		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
+	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
+	if ( st.freeBlocks > 1 ) {
+		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
 	}
-	return NULL;
 }
-#endif // USE_MULTI_SEGMENT
 
 
 /*
-========================
-Z_ClearZone
-========================
-*/
-static void Z_ClearZone( memzone_t *zone, memzone_t *head, int size, int segnum ) {
-	memblock_t	*block;
-	int min_fragment;
-
-#ifdef USE_MULTI_SEGMENT
-	min_fragment = sizeof( memblock_t ) + sizeof( freeblock_t );
-#else
-	min_fragment = sizeof( memblock_t );
-#endif
-
-	if ( minfragment < min_fragment ) {
-		// in debug mode size of memblock_t may exceed MINFRAGMENT
-		minfragment = PAD( min_fragment, sizeof( intptr_t ) );
-		Com_DPrintf( "zone.minfragment adjusted to %i bytes\n", minfragment );
-	}
+===============
+Com_TouchMemory
 
-	// set the entire zone to one free block
-	zone->blocklist.next = zone->blocklist.prev = block = (memblock_t *)( zone + 1 );
-	zone->blocklist.tag = TAG_GENERAL; // in use block
-	zone->blocklist.id = -ZONEID;
-	zone->blocklist.size = 0;
-#ifndef USE_MULTI_SEGMENT
-	zone->rover = block;
-#endif
-	zone->size = size;
-	zone->used = 0;
+Touch all known used data to make sure it is paged in
+===============
+*/
+unsigned int Com_TouchMemory( void ) {
+	const memblock_t *block;
+	const memzone_t *zone;
+	int		start, end;
+	int		i, j;
+	unsigned int sum;
 
-	block->prev = block->next = &zone->blocklist;
-	block->tag = TAG_FREE;	// free block
-	block->id = ZONEID;
+	Z_CheckHeap();
 
-	block->size = size - sizeof(memzone_t);
+	start = Sys_Milliseconds();
 
-#ifdef USE_MULTI_SEGMENT
-	InitFree( &zone->freelist );
-	zone->freelist.next = zone->freelist.prev = &zone->freelist;
+	sum = 0;
 
-	InitFree( &zone->freelist_medium );
-	zone->freelist_medium.next = zone->freelist_medium.prev = &zone->freelist_medium;
+	j = hunk_low.permanent >> 2;
+	for ( i = 0 ; i < j ; i+=64 ) {			// only need to touch each page
+		sum += ((unsigned int *)s_hunkData)[i];
+	}
 
-	InitFree( &zone->freelist_small );
-	zone->freelist_small.next = zone->freelist_small.prev = &zone->freelist_small;
+	i = ( s_hunkTotal - hunk_high.permanent ) >> 2;
+	j = hunk_high.permanent >> 2;
+	for (  ; i < j ; i+=64 ) {			// only need to touch each page
+		sum += ((unsigned int *)s_hunkData)[i];
+	}
 
-	InitFree( &zone->freelist_tiny );
-	zone->freelist_tiny.next = zone->freelist_tiny.prev = &zone->freelist_tiny;
+	zone = mainzone;
+	for (block = zone->blocklist.next ; ; block = block->next) {
+		if ( block->tag != TAG_FREE ) {
+			j = block->size >> 2;
+			for ( i = 0 ; i < j ; i+=64 ) {				// only need to touch each page
+				sum += ((unsigned int *)block)[i];
+			}
+		}
+		if ( block->next == &zone->blocklist ) {
+			break; // all blocks have been hit
+		}
+	}
 
-	InsertFree( zone, block );
-#endif
-}
+	end = Sys_Milliseconds();
 
+	Com_Printf( "Com_TouchMemory: %i msec\n", end - start );
 
-/*
-========================
-Z_AvailableZoneMemory
-========================
-*/
-static int Z_AvailableZoneMemory( const memzone_t *zone ) {
-#ifdef USE_MULTI_SEGMENT
-	return (1024*1024*1024); // unlimited
-#else
-	return zone->size - zone->used;
-#endif
+	return sum; // just to silent compiler warning
 }
 
 
 /*
-========================
-Z_AvailableMemory
-========================
+=================
+Com_InitSmallZoneMemory
+=================
 */
-int Z_AvailableMemory( void ) {
-	return Z_AvailableZoneMemory( mainzone );
-}
-
+static void Com_InitSmallZoneMemory( void ) {
+	static byte s_buf[ 512 * 1024 ];
+	int smallZoneSize;
 
-static void MergeBlock( memblock_t *curr_free, const memblock_t *next )
-{
-	curr_free->size += next->size;
-	curr_free->next = next->next;
-	curr_free->next->prev = curr_free;
+	smallZoneSize = sizeof( s_buf );
+	Com_Memset( s_buf, 0, smallZoneSize );
+	smallzone = (memzone_t *)s_buf;
+	Z_ClearZone( smallzone, smallzone, smallZoneSize, 1 );
 }
 
 
 /*
-========================
-Z_Free
-========================
+=================
+Com_InitZoneMemory
+=================
 */
-void Z_Free( void *ptr ) {
-	memblock_t	*block, *other;
-	memzone_t *zone;
-
-	if (!ptr) {
-		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
-	}
-
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
-	}
-
-	if (block->tag == TAG_FREE) {
-		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
-	}
-
-	// if static memory
-#ifdef USE_STATIC_TAGS
-	if (block->tag == TAG_STATIC) {
-		return;
-	}
-#endif
-
-	// check the memory trash tester
-#ifdef USE_TRASH_TEST
-	if ( *(int *)((byte *)block + block->size - 4 ) != ZONEID ) {
-		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
-	}
-#endif
-
-	if ( block->tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
-	}
-
-	zone->used -= block->size;
-
-	// set the block to something that should cause problems
-	// if it is referenced...
-	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
+static void Com_InitZoneMemory( void ) {
+	int		mainZoneSize;
+	cvar_t	*cv;
 
-	block->tag = TAG_FREE; // mark as free
-	block->id = ZONEID;
+	// Please note: com_zoneMegs can only be set on the command line, and
+	// not in q3config.cfg or Com_StartupVariable, as they haven't been
+	// executed by this point. It's a chicken and egg problem. We need the
+	// memory manager configured to handle those places where you would
+	// configure the memory manager.
 
-	other = block->prev;
-	if ( other->tag == TAG_FREE ) {
-#ifdef USE_MULTI_SEGMENT
-		RemoveFree( other );
-#endif
-		// merge with previous free block
-		MergeBlock( other, block );
-#ifndef USE_MULTI_SEGMENT
-		if ( block == zone->rover ) {
-			zone->rover = other;
-		}
-#endif
-		block = other;
-	}
+	// allocate the random block zone
+	cv = Cvar_Get( "com_zoneMegs", XSTRING( DEF_COMZONEMEGS ), CVAR_LATCH | CVAR_ARCHIVE );
+	Cvar_CheckRange( cv, "1", NULL, CV_INTEGER );
+	Cvar_SetDescription( cv, "Initial amount of memory (RAM) allocated for the main block zone (in MB)." );
 
 #ifndef USE_MULTI_SEGMENT
-	zone->rover = block;
+	if ( cv->integer < DEF_COMZONEMEGS )
+		mainZoneSize = 1024 * 1024 * DEF_COMZONEMEGS;
+	else
 #endif
+		mainZoneSize = cv->integer * 1024 * 1024;
 
-	other = block->next;
-	if ( other->tag == TAG_FREE ) {
-#ifdef USE_MULTI_SEGMENT
-		RemoveFree( other );
-#endif
-		// merge the next free block onto the end
-		MergeBlock( block, other );
+	mainzone = calloc( mainZoneSize, 1 );
+	if ( !mainzone ) {
+		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", mainZoneSize / (1024*1024) );
 	}
-
-#ifdef USE_MULTI_SEGMENT
-	InsertFree( zone, block );
-#endif
+	Z_ClearZone( mainzone, mainzone, mainZoneSize, 1 );
 }
 
 
 /*
-================
-Z_FreeTags
-================
+=================
+Hunk_Log
+=================
 */
-int Z_FreeTags( memtag_t tag ) {
-	int			count;
-	memzone_t	*zone;
-	memblock_t	*block, *freed;
+void Hunk_Log( void ) {
+	hunkblock_t	*block;
+	char		buf[4096];
+	int size, numBlocks;
 
-	if ( tag == TAG_STATIC ) {
-		Com_Error( ERR_FATAL, "Z_FreeTags( TAG_STATIC )" );
-		return 0;
-	} else if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
-	}
+	if ( !logWriter.file )
+		return;
 
-	count = 0;
-	for ( block = zone->blocklist.next ; ; ) {
-		if ( block->tag == tag && block->id == ZONEID ) {
-			if ( block->prev->tag == TAG_FREE )
-				freed = block->prev;  // current block will be merged with previous
-			else
-				freed = block; // will leave in place
-			Z_Free( (void*)( block + 1 ) );
-			block = freed;
-			count++;
-		}
-		if ( block->next == &zone->blocklist ) {
-			break;	// all blocks have been hit
-		}
-		block = block->next;
+	size = 0;
+	numBlocks = 0;
+	Com_sprintf(buf, sizeof(buf), "\r\n================\r\nHunk log\r\n================\r\n");
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+	for (block = hunkblocks ; block; block = block->next) {
+#ifdef HUNK_DEBUG
+		Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s)\r\n", block->size, block->file, block->line, block->label);
+		Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+#endif
+		size += block->size;
+		numBlocks++;
 	}
-
-	return count;
+	Com_sprintf(buf, sizeof(buf), "%d Hunk memory\r\n", size);
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
 }
 
 
 /*
-================
-Z_TagMalloc
-================
+=================
+Hunk_SmallLog
+=================
 */
-#ifdef ZONE_DEBUG
-void *Z_TagMallocDebug( int size, memtag_t tag, char *label, char *file, int line ) {
-	int		allocSize;
-#else
-void *Z_TagMalloc( int size, memtag_t tag ) {
-#endif
-	int		extra;
-#ifndef USE_MULTI_SEGMENT
-	memblock_t	*start, *rover;
-#endif
-	memblock_t *base;
-	memzone_t *zone;
+#ifdef HUNK_DEBUG
+void Hunk_SmallLog( void ) {
+	hunkblock_t	*block, *block2;
+	char		buf[4096];
+	int size, locsize, numBlocks;
 
-	if ( tag == TAG_FREE ) {
-		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use with TAG_FREE" );
-	}
+	if ( !logWriter.file )
+		return;
 
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
+	for (block = hunkblocks ; block; block = block->next) {
+		block->printed = qfalse;
 	}
-
-#ifdef ZONE_DEBUG
-	allocSize = size;
-#endif
-
-#ifdef USE_MULTI_SEGMENT
-	if ( size < (sizeof( freeblock_t ) ) ) {
-		size = (sizeof( freeblock_t ) );
+	size = 0;
+	numBlocks = 0;
+	Com_sprintf(buf, sizeof(buf), "\r\n================\r\nHunk Small log\r\n================\r\n");
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+	for (block = hunkblocks; block; block = block->next) {
+		if (block->printed) {
+			continue;
+		}
+		locsize = block->size;
+		for (block2 = block->next; block2; block2 = block2->next) {
+			if (block->line != block2->line) {
+				continue;
+			}
+			if (Q_stricmp(block->file, block2->file)) {
+				continue;
+			}
+			size += block2->size;
+			locsize += block2->size;
+			block2->printed = qtrue;
+		}
+		Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s)\r\n", locsize, block->file, block->line, block->label);
+		Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+		size += block->size;
+		numBlocks++;
 	}
+	Com_sprintf(buf, sizeof(buf), "%d Hunk memory\r\n", size);
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
+	Com_LogWrite( buf, (int)strlen( buf ), qtrue );
+}
 #endif
 
-	//
-	// scan through the block list looking for the first free block
-	// of sufficient size
-	//
-	size += sizeof( *base );	// account for size of block header
-#ifdef USE_TRASH_TEST
-	size += 4;					// space for memory trash tester
-#endif
-
-	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
 
-#ifdef USE_MULTI_SEGMENT
-	base = SearchFree( zone, size );
+/*
+=================
+Com_InitHunkMemory
+=================
+*/
+static void Com_InitHunkMemory( void ) {
+	cvar_t	*cv;
 
-	RemoveFree( base );
-#else
+	// make sure the file system has allocated and "not" freed any temp blocks
+	// this allows the config and product id files ( journal files too ) to be loaded
+	// by the file system without redundant routines in the file system utilizing different
+	// memory systems
+	if ( FS_LoadStack() != 0 ) {
+		Com_Error( ERR_FATAL, "Hunk initialization failed. File system load stack not zero" );
+	}
 
-	base = rover = zone->rover;
-	start = base->prev;
+	// allocate the stack based hunk allocator
+	cv = Cvar_Get( "com_hunkMegs", XSTRING( DEF_COMHUNKMEGS ), CVAR_LATCH | CVAR_ARCHIVE );
+	Cvar_CheckRange( cv, XSTRING( MIN_COMHUNKMEGS ), NULL, CV_INTEGER );
+	Cvar_SetDescription( cv, "The size of the hunk memory segment." );
 
-	do {
-		if ( rover == start ) {
-			// scanned all the way around the list
-#ifdef ZONE_DEBUG
-			Z_LogHeap();
-			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
-								size, zone == smallzone ? "small" : "main", file, line, label );
-#else
-			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-								size, zone == smallzone ? "small" : "main" );
-#endif
-			return NULL;
-		}
-		if ( rover->tag != TAG_FREE ) {
-			base = rover = rover->next;
-		} else {
-			rover = rover->next;
-		}
-	} while (base->tag != TAG_FREE || base->size < size);
-#endif
+	s_hunkTotal = cv->integer * 1024 * 1024;
 
-	//
-	// found a block big enough
-	//
-	extra = base->size - size;
-	if ( extra >= minfragment ) {
-		memblock_t *fragment;
-		// there will be a free fragment after the allocated block
-		fragment = (memblock_t *)( (byte *)base + size );
-		fragment->size = extra;
-		fragment->tag = TAG_FREE; // free block
-		fragment->id = ZONEID;
-		fragment->prev = base;
-		fragment->next = base->next;
-		fragment->next->prev = fragment;
-		base->next = fragment;
-		base->size = size;
-#ifdef USE_MULTI_SEGMENT
-		InsertFree( zone, fragment );
-#endif
+	s_hunkData = calloc( s_hunkTotal + 63, 1 );
+	if ( !s_hunkData ) {
+		Com_Error( ERR_FATAL, "Hunk data failed to allocate %i megs", s_hunkTotal / (1024*1024) );
 	}
 
-#ifndef USE_MULTI_SEGMENT
-	zone->rover = base->next;	// next allocation will start looking here
-#endif
-	zone->used += base->size;
-
-	base->tag = tag;			// no longer a free block
-	base->id = ZONEID;
+	// cacheline align
+	s_hunkData = PADP( s_hunkData, 64 );
+	Hunk_Clear();
 
+	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
 #ifdef ZONE_DEBUG
-	base->d.label = label;
-	base->d.file = file;
-	base->d.line = line;
-	base->d.allocSize = allocSize;
+	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
-
-#ifdef USE_TRASH_TEST
-	// marker for memory trash testing
-	*(int *)((byte *)base + base->size - 4) = ZONEID;
+#ifdef HUNK_DEBUG
+	Cmd_AddCommand( "hunklog", Hunk_Log );
+	Cmd_AddCommand( "hunksmalllog", Hunk_SmallLog );
 #endif
-
-	return (void *) ( base + 1 );
 }
 
 
 /*
-========================
-Z_Malloc
-========================
+====================
+Hunk_MemoryRemaining
+====================
 */
-#ifdef ZONE_DEBUG
-void *Z_MallocDebug( int size, char *label, char *file, int line ) {
-#else
-void *Z_Malloc( int size ) {
-#endif
-	void	*buf;
-
-  //Z_CheckHeap ();	// DEBUG
+int	Hunk_MemoryRemaining( void ) {
+	int		low, high;
 
-#ifdef ZONE_DEBUG
-	buf = Z_TagMallocDebug( size, TAG_GENERAL, label, file, line );
-#else
-	buf = Z_TagMalloc( size, TAG_GENERAL );
-#endif
-	Com_Memset( buf, 0, size );
+	low = hunk_low.permanent > hunk_low.temp ? hunk_low.permanent : hunk_low.temp;
+	high = hunk_high.permanent > hunk_high.temp ? hunk_high.permanent : hunk_high.temp;
 
-	return buf;
+	return s_hunkTotal - ( low + high );
 }
 
 
 /*
-========================
-S_Malloc
-========================
+===================
+Hunk_SetMark
+
+The server calls this after the level and game VM have been loaded
+===================
 */
-#ifdef ZONE_DEBUG
-void *S_MallocDebug( int size, char *label, char *file, int line ) {
-	return Z_TagMallocDebug( size, TAG_SMALL, label, file, line );
-}
-#else
-void *S_Malloc( int size ) {
-	return Z_TagMalloc( size, TAG_SMALL );
+void Hunk_SetMark( void ) {
+	hunk_low.mark = hunk_low.permanent;
+	hunk_high.mark = hunk_high.permanent;
 }
-#endif
 
 
 /*
-========================
-Z_CheckHeap
-========================
-*/
-static void Z_CheckHeap( void ) {
-	const memblock_t *block;
-	const memzone_t *zone;
-
-	zone =  mainzone;
-	for ( block = zone->blocklist.next ; ; ) {
-		if ( block->next == &zone->blocklist ) {
-			break;	// all blocks have been hit
-		}
-		if ( (byte *)block + block->size != (byte *)block->next) {
-#ifdef USE_MULTI_SEGMENT
-			const memblock_t *next = block->next;
-			if ( next->size == 0 && next->id == -ZONEID && next->tag == TAG_GENERAL ) {
-				block = next; // new zone segment
-			} else
-#endif
-			Com_Error( ERR_FATAL, "Z_CheckHeap: block size does not touch the next block" );
-		}
-		if ( block->next->prev != block) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: next block doesn't have proper back link" );
-		}
-		if ( block->tag == TAG_FREE && block->next->tag == TAG_FREE ) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: two consecutive free blocks" );
-		}
-		block = block->next;
-	}
+=================
+Hunk_ClearToMark
+
+The client calls this before starting a vid_restart or snd_restart
+=================
+*/
+void Hunk_ClearToMark( void ) {
+	hunk_low.permanent = hunk_low.temp = hunk_low.mark;
+	hunk_high.permanent = hunk_high.temp = hunk_high.mark;
 }
 
 
 /*
-========================
-Z_LogZoneHeap
-========================
+=================
+Hunk_CheckMark
+=================
 */
-static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
-#ifdef ZONE_DEBUG
-	char dump[32], *ptr;
-	int  i, j;
-#endif
-	memblock_t	*block;
-	char		buf[4096];
-	int size, allocSize, numBlocks;
-	int len;
-
-	if ( logfile == FS_INVALID_HANDLE || !FS_Initialized() )
-		return;
-
-	size = numBlocks = 0;
-#ifdef ZONE_DEBUG
-	allocSize = 0;
-#endif
-	len = Com_sprintf( buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name );
-	FS_Write( buf, len, logfile );
-	for ( block = zone->blocklist.next ; ; ) {
-		if ( block->tag != TAG_FREE ) {
-#ifdef ZONE_DEBUG
-			ptr = ((char *) block) + sizeof(memblock_t);
-			j = 0;
-			for (i = 0; i < 20 && i < block->d.allocSize; i++) {
-				if (ptr[i] >= 32 && ptr[i] < 127) {
-					dump[j++] = ptr[i];
-				}
-				else {
-					dump[j++] = '_';
-				}
-			}
-			dump[j] = '\0';
-			len = Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
-			FS_Write( buf, len, logfile );
-			allocSize += block->d.allocSize;
-#endif
-			size += block->size;
-			numBlocks++;
-		}
-		if ( block->next == &zone->blocklist ) {
-			break; // all blocks have been hit
-		}
-		block = block->next;
+qboolean Hunk_CheckMark( void ) {
+	if( hunk_low.mark || hunk_high.mark ) {
+		return qtrue;
 	}
-#ifdef ZONE_DEBUG
-	// subtract debug memory
-	size -= numBlocks * sizeof(zonedebug_t);
-#else
-	allocSize = numBlocks * sizeof(memblock_t); // + 32 bit alignment
-#endif
-	len = Com_sprintf( buf, sizeof( buf ), "%d %s memory in %d blocks\r\n", size, name, numBlocks );
-	FS_Write( buf, len, logfile );
-	len = Com_sprintf( buf, sizeof( buf ), "%d %s memory overhead\r\n", size - allocSize, name );
-	FS_Write( buf, len, logfile );
-	FS_Flush( logfile );
+	return qfalse;
 }
 
+void CL_ShutdownCGame( void );
+void CL_ShutdownUI( void );
+void SV_ShutdownGameProgs( void );
 
 /*
-========================
-Z_LogHeap
-========================
+=================
+Hunk_Clear
+
+The server calls this before shutting down or loading a new map
+=================
 */
-void Z_LogHeap( void ) {
-	Z_LogZoneHeap( mainzone, "MAIN" );
-	Z_LogZoneHeap( smallzone, "SMALL" );
+void Hunk_Clear( void ) {
+
+#ifndef DEDICATED
+	CL_ShutdownCGame();
+	CL_ShutdownUI();
+#endif
+	SV_ShutdownGameProgs();
+#ifndef DEDICATED
+	CIN_CloseAllVideos();
+#endif
+	hunk_low.mark = 0;
+	hunk_low.permanent = 0;
+	hunk_low.temp = 0;
+	hunk_low.tempHighwater = 0;
+
+	hunk_high.mark = 0;
+	hunk_high.permanent = 0;
+	hunk_high.temp = 0;
+	hunk_high.tempHighwater = 0;
+
+	hunk_permanent = &hunk_low;
+	hunk_temp = &hunk_high;
+
+	Com_Printf( "Hunk_Clear: reset the hunk ok\n" );
+	VM_Clear();
+#ifdef HUNK_DEBUG
+	hunkblocks = NULL;
+#endif
 }
 
-#ifdef USE_STATIC_TAGS
 
-// static mem blocks to reduce a lot of small zone overhead
-typedef struct memstatic_s {
-	memblock_t b;
-	byte mem[2];
-} memstatic_t;
+static void Hunk_SwapBanks( void ) {
+	hunkUsed_t	*swap;
 
-#define MEM_STATIC(chr) { { NULL, NULL, PAD(sizeof(memstatic_t),4), TAG_STATIC, ZONEID }, {chr,'\0'} }
+	// can't swap banks if there is any temp already allocated
+	if ( hunk_temp->temp != hunk_temp->permanent ) {
+		return;
+	}
 
-static const memstatic_t emptystring =
-	MEM_STATIC( '\0' );
+	// if we have a larger highwater mark on this side, start making
+	// our permanent allocations here and use the other side for temp
+	if ( hunk_temp->tempHighwater - hunk_temp->permanent >
+		hunk_permanent->tempHighwater - hunk_permanent->permanent ) {
+		swap = hunk_temp;
+		hunk_temp = hunk_permanent;
+		hunk_permanent = swap;
+	}
+}
 
-static const memstatic_t numberstring[] = {
-	MEM_STATIC( '0' ),
-	MEM_STATIC( '1' ),
-	MEM_STATIC( '2' ),
-	MEM_STATIC( '3' ),
-	MEM_STATIC( '4' ),
-	MEM_STATIC( '5' ),
-	MEM_STATIC( '6' ),
-	MEM_STATIC( '7' ),
-	MEM_STATIC( '8' ),
-	MEM_STATIC( '9' )
-};
-#endif // USE_STATIC_TAGS
 
 /*
-========================
-CopyString
+=================
+Hunk_Alloc
 
- NOTE:	never write over the memory CopyString returns because
-		memory from a memstatic_t might be returned
-========================
+Allocate permanent (until the hunk is cleared) memory
+=================
 */
-char *CopyString( const char *in ) {
-	char *out;
-#ifdef USE_STATIC_TAGS
-	if ( in[0] == '\0' ) {
-		return ((char *)&emptystring) + sizeof(memblock_t);
+#ifdef HUNK_DEBUG
+void *Hunk_AllocDebug( int size, ha_pref preference, char *label, char *file, int line ) {
+#else
+void *Hunk_Alloc( int size, ha_pref preference ) {
+#endif
+	void	*buf;
+
+	if ( s_hunkData == NULL)
+	{
+		Com_Error( ERR_FATAL, "Hunk_Alloc: Hunk memory system not initialized" );
 	}
-	else if ( in[0] >= '0' && in[0] <= '9' && in[1] == '\0' ) {
-		return ((char *)&numberstring[in[0]-'0']) + sizeof(memblock_t);
+
+	// can't do preference if there is any temp allocated
+	if (preference == h_dontcare || hunk_temp->temp != hunk_temp->permanent) {
+		Hunk_SwapBanks();
+	} else {
+		if (preference == h_low && hunk_permanent != &hunk_low) {
+			Hunk_SwapBanks();
+		} else if (preference == h_high && hunk_permanent != &hunk_high) {
+			Hunk_SwapBanks();
+		}
 	}
-#endif
-	out = S_Malloc( strlen( in ) + 1 );
-	strcpy( out, in );
-	return out;
-}
 
+#ifdef HUNK_DEBUG
+	size += sizeof(hunkblock_t);
+#endif
 
-/*
-==============================================================================
+	// round to cacheline
+	size = PAD( size, 64 );
 
-Goals:
-	reproducible without history effects -- no out of memory errors on weird map to map changes
-	allow restarting of the client without fragmentation
-	minimize total pages in use at run time
-	minimize total pages needed during load time
+	if ( hunk_low.temp + hunk_high.temp + size > s_hunkTotal ) {
+#ifdef HUNK_DEBUG
+		Hunk_Log();
+		Hunk_SmallLog();
 
-  Single block of memory with stack allocators coming from both ends towards the middle.
+		Com_Error(ERR_DROP, "Hunk_Alloc failed on %i: %s, line: %d (%s)", size, file, line, label);
+#else
+		Com_Error(ERR_DROP, "Hunk_Alloc failed on %i", size);
+#endif
+	}
 
-  One side is designated the temporary memory allocator.
+	if ( hunk_permanent == &hunk_low ) {
+		buf = (void *)(s_hunkData + hunk_permanent->permanent);
+		hunk_permanent->permanent += size;
+	} else {
+		hunk_permanent->permanent += size;
+		buf = (void *)(s_hunkData + s_hunkTotal - hunk_permanent->permanent );
+	}
 
-  Temporary memory can be allocated and freed in any order.
+	hunk_permanent->temp = hunk_permanent->permanent;
 
-  A highwater mark is kept of the most in use at any time.
+	Com_Memset( buf, 0, size );
 
-  When there is no temporary memory allocated, the permanent and temp sides
-  can be switched, allowing the already touched temp memory to be used for
-  permanent storage.
+#ifdef HUNK_DEBUG
+	{
+		hunkblock_t *block;
 
-  Temp memory must never be allocated on two ends at once, or fragmentation
-  could occur.
+		block = (hunkblock_t *) buf;
+		block->size = size - sizeof(hunkblock_t);
+		block->file = file;
+		block->label = label;
+		block->line = line;
+		block->next = hunkblocks;
+		hunkblocks = block;
+		buf = ((byte *) buf) + sizeof(hunkblock_t);
+	}
+#endif
+	return buf;
+}
 
-  If we have any in-use temp memory, additional temp allocations must come from
-  that side.
 
-  If not, we can choose to make either side the new temp side and push future
-  permanent allocations to the other side.  Permanent allocations should be
-  kept on the side that has the current greatest wasted highwater mark.
+/*
+=================
+Hunk_AllocateTempMemory
 
-==============================================================================
+This is used by the file loading system.
+Multiple files can be loaded in temporary memory.
+When the files-in-use count reaches zero, all temp memory will be deleted
+=================
 */
+void *Hunk_AllocateTempMemory( int size ) {
+	void		*buf;
+	hunkHeader_t	*hdr;
 
+	// return a Z_Malloc'd block if the hunk has not been initialized
+	// this allows the config and product id files ( journal files too ) to be loaded
+	// by the file system without redundant routines in the file system utilizing different
+	// memory systems
+	if ( s_hunkData == NULL )
+	{
+		return Z_Malloc(size);
+	}
 
-#define	HUNK_MAGIC	0x89537892
-#define	HUNK_FREE_MAGIC	0x89537893
+	Hunk_SwapBanks();
 
-typedef struct {
-	unsigned int magic;
-	unsigned int size;
-} hunkHeader_t;
+	size = PAD(size, sizeof(intptr_t)) + sizeof( hunkHeader_t );
 
-typedef struct {
-	int		mark;
-	int		permanent;
-	int		temp;
-	int		tempHighwater;
-} hunkUsed_t;
+	if ( hunk_temp->temp + hunk_permanent->permanent + size > s_hunkTotal ) {
+		Com_Error( ERR_DROP, "Hunk_AllocateTempMemory: failed on %i bytes (temp: %i, perm: %i, total: %i)", 
+			size, hunk_temp->temp, hunk_permanent->permanent, s_hunkTotal );
+	}
 
-typedef struct hunkblock_s {
-	int size;
-	byte printed;
-	struct hunkblock_s *next;
-	const char *label;
-	const char *file;
-	int line;
-} hunkblock_t;
+	if ( hunk_temp == &hunk_low ) {
+		buf = (void *)(s_hunkData + hunk_temp->temp);
+		hunk_temp->temp += size;
+	} else {
+		hunk_temp->temp += size;
+		buf = (void *)(s_hunkData + s_hunkTotal - hunk_temp->temp );
+	}
 
-static	hunkblock_t *hunkblocks;
+	if ( hunk_temp->temp > hunk_temp->tempHighwater ) {
+		hunk_temp->tempHighwater = hunk_temp->temp;
+	}
 
-static	hunkUsed_t	hunk_low, hunk_high;
-static	hunkUsed_t	*hunk_permanent, *hunk_temp;
+	hdr = (hunkHeader_t *)buf;
+	buf = (void *)(hdr+1);
 
-static	byte	*s_hunkData = NULL;
-static	int		s_hunkTotal;
+	hdr->magic = HUNK_MAGIC;
+	hdr->size = size;
 
-static const char *tagName[ TAG_COUNT ] = {
-	"FREE",
-	"GENERAL",
-	"PACK",
-	"SEARCH-PATH",
-	"SEARCH-PACK",
-	"SEARCH-DIR",
-	"BOTLIB",
-	"RENDERER",
-	"CLIENTS",
-	"SMALL",
-	"STATIC"
-};
+	// don't bother clearing, because we are going to load a file over it
+	return buf;
+}
 
-typedef struct zone_stats_s {
-	int	zoneSegments;
-	int zoneBlocks;
-	int	zoneBytes;
-	int	botlibBytes;
-	int	rendererBytes;
-	int freeBytes;
-	int freeBlocks;
-	int freeSmallest;
-	int freeLargest;
-} zone_stats_t;
 
+/*
+==================
+Hunk_FreeTempMemory
+==================
+*/
+void Hunk_FreeTempMemory( void *buf ) {
+	hunkHeader_t	*hdr;
 
-static void Zone_Stats( const char *name, const memzone_t *z, qboolean printDetails, zone_stats_t *stats )
-{
-	const memblock_t *block;
-	const memzone_t *zone;
-	zone_stats_t st;
+	// free with Z_Free if the hunk has not been initialized
+	// this allows the config and product id files ( journal files too ) to be loaded
+	// by the file system without redundant routines in the file system utilizing different
+	// memory systems
+	if ( s_hunkData == NULL )
+	{
+		Z_Free(buf);
+		return;
+	}
 
-	memset( &st, 0, sizeof( st ) );
-	zone = z;
-	st.zoneSegments = 1;
-	st.freeSmallest = 0x7FFFFFFF;
+	hdr = ( (hunkHeader_t *)buf ) - 1;
+	if ( hdr->magic != HUNK_MAGIC ) {
+		Com_Error( ERR_FATAL, "Hunk_FreeTempMemory: bad magic" );
+	}
 
-	//if ( printDetails ) {
-	//	Com_Printf( "---------- %s zone segment #%i ----------\n", name, zone->segnum );
-	//}
+	hdr->magic = HUNK_FREE_MAGIC;
 
-	for ( block = zone->blocklist.next ; ; ) {
-		if ( printDetails ) {
-			int tag = block->tag;
-			Com_Printf( "block:%p  size:%8i  tag: %s\n", (void *)block, block->size,
-				(unsigned)tag < TAG_COUNT ? tagName[ tag ] : va( "%i", tag ) );
-		}
-		if ( block->tag != TAG_FREE ) {
-			st.zoneBytes += block->size;
-			st.zoneBlocks++;
-			if ( block->tag == TAG_BOTLIB ) {
-				st.botlibBytes += block->size;
-			} else if ( block->tag == TAG_RENDERER ) {
-				st.rendererBytes += block->size;
-			}
+	// this only works if the files are freed in stack order,
+	// otherwise the memory will stay around until Hunk_ClearTempMemory
+	if ( hunk_temp == &hunk_low ) {
+		if ( hdr == (void *)(s_hunkData + hunk_temp->temp - hdr->size ) ) {
+			hunk_temp->temp -= hdr->size;
 		} else {
-			st.freeBytes += block->size;
-			st.freeBlocks++;
-			if ( block->size > st.freeLargest )
-				st.freeLargest = block->size;
-			if ( block->size < st.freeSmallest )
-				st.freeSmallest = block->size;
-		}
-		if ( block->next == &zone->blocklist ) {
-			break; // all blocks have been hit
-		}
-		if ( (byte *)block + block->size != (byte *)block->next) {
-#ifdef USE_MULTI_SEGMENT
-			const memblock_t *next = block->next;
-			if ( next->size == 0 && next->id == -ZONEID && next->tag == TAG_GENERAL ) {
-				st.zoneSegments++;
-				if ( printDetails ) {
-					Com_Printf( "---------- %s zone segment #%i ----------\n", name, st.zoneSegments );
-				}
-				block = next->next;
-				continue;
-			} else
-#endif
-				Com_Printf( "ERROR: block size does not touch the next block\n" );
-		}
-		if ( block->next->prev != block) {
-			Com_Printf( "ERROR: next block doesn't have proper back link\n" );
+			Com_Printf( "Hunk_FreeTempMemory: not the final block\n" );
 		}
-		if ( block->tag == TAG_FREE && block->next->tag == TAG_FREE ) {
-			Com_Printf( "ERROR: two consecutive free blocks\n" );
+	} else {
+		if ( hdr == (void *)(s_hunkData + s_hunkTotal - hunk_temp->temp ) ) {
+			hunk_temp->temp -= hdr->size;
+		} else {
+			Com_Printf( "Hunk_FreeTempMemory: not the final block\n" );
 		}
-		block = block->next;
-	}
-
-	// export stats
-	if ( stats ) {
-		memcpy( stats, &st, sizeof( *stats ) );
 	}
 }
 
 
 /*
 =================
-Com_Meminfo_f
+Hunk_ClearTempMemory
+
+The temp space is no longer needed.  If we have left more
+touched but unused memory on this side, have future
+permanent allocs use this side.
 =================
 */
-static void Com_Meminfo_f( void ) {
-	zone_stats_t st;
-	int		unused;
-
-	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i low mark\n", hunk_low.mark );
-	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
-	if ( hunk_low.temp != hunk_low.permanent ) {
-		Com_Printf( "%8i low temp\n", hunk_low.temp );
-	}
-	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i high mark\n", hunk_high.mark );
-	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
-	if ( hunk_high.temp != hunk_high.permanent ) {
-		Com_Printf( "%8i high temp\n", hunk_high.temp );
-	}
-	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
-	unused = 0;
-	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
-		unused += hunk_low.tempHighwater - hunk_low.permanent;
-	}
-	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
-		unused += hunk_high.tempHighwater - hunk_high.permanent;
-	}
-	Com_Printf( "%8i unused highwater\n", unused );
-	Com_Printf( "\n" );
-
-	Zone_Stats( "main", mainzone, !Q_stricmp( Cmd_Argv(1), "main" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
-	Com_Printf( "%8i bytes total main zone\n\n", mainzone->size );
-	Com_Printf( "%8i bytes in %i main zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
-		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
-	Com_Printf( "        %8i bytes in botlib\n", st.botlibBytes );
-	Com_Printf( "        %8i bytes in renderer\n", st.rendererBytes );
-	Com_Printf( "        %8i bytes in other\n", st.zoneBytes - ( st.botlibBytes + st.rendererBytes ) );
-	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
-	if ( st.freeBlocks > 1 ) {
-		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
-	}
-
-	Zone_Stats( "small", smallzone, !Q_stricmp( Cmd_Argv(1), "small" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
-	Com_Printf( "%8i bytes total small zone\n\n", smallzone->size );
-	Com_Printf( "%8i bytes in %i small zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
-		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
-	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
-	if ( st.freeBlocks > 1 ) {
-		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+void Hunk_ClearTempMemory( void ) {
+	if ( s_hunkData != NULL ) {
+		hunk_temp->temp = hunk_temp->permanent;
 	}
 }
 
-
 /*
-===============
-Com_TouchMemory
+===================================================================
 
-Touch all known used data to make sure it is paged in
-===============
+EVENTS AND JOURNALING
+
+In addition to these events, .cfg files are also copied to the
+journaled file
+===================================================================
 */
-unsigned int Com_TouchMemory( void ) {
-	const memblock_t *block;
-	const memzone_t *zone;
-	int		start, end;
-	int		i, j;
-	unsigned int sum;
 
-	Z_CheckHeap();
+#define	MAX_PUSHED_EVENTS 256
+static int com_pushedEventsHead = 0;
+static int com_pushedEventsTail = 0;
+static sysEvent_t com_pushedEvents[MAX_PUSHED_EVENTS];
 
-	start = Sys_Milliseconds();
 
-	sum = 0;
+/*
+Version 2 journals store records in Huffman compressed blocks. Network packets
+and per-frame timing are journaled along with the events, so a recorded
+session can be replayed as a benchmark without touching the network. Every JOURNAL_INDEX_BLOCKS blocks an
+index chunk lists their offsets, and the trailer written on shutdown points to
+the last index. Raw version 1 journals can still be replayed.
+*/
+
+#define JOURNAL_MAGIC			0x324e524a	// "JRN2"
+#define JOURNAL_VERSION			2
+#define JOURNAL_BLOCK_SIZE		32768		// raw record bytes per block, Huff_Compress takes up to 64k
+#define JOURNAL_BLOCK_FRAMES	40			// close blocks at least this often
+#define JOURNAL_INDEX_BLOCKS	64			// blocks listed by each index chunk
+#define JOURNAL_HISTOGRAM_USEC	25
+#define JOURNAL_HISTOGRAM_SIZE	4000		// frame times up to 100 msec
+
+typedef enum {
+	JR_EVENT = 1,		// sysEvent_t followed by evPtrLength bytes
+	JR_PACKET,			// netadr_t, length and the packet data
+	JR_FRAME,			// journalFrame_t, written at the end of each frame
+	JR_CLIENTPACKET		// like JR_PACKET, for packets the client received
+} journalRecord_t;
+
+typedef enum {
+	JC_BLOCK = 1,		// records, stored as is if size == raw
+	JC_INDEX,			// raw journalIndex_t entries, link is the previous index
+	JC_END				// frame and time of the last frame, link is the last index
+} journalChunkType_t;
 
-	j = hunk_low.permanent >> 2;
-	for ( i = 0 ; i < j ; i+=64 ) {			// only need to touch each page
-		sum += ((unsigned int *)s_hunkData)[i];
-	}
+typedef struct {
+	int			magic;
+	int			version;
+	int64_t		date;
+	char		engine[ 64 ];
+} journalHeader_t;
 
-	i = ( s_hunkTotal - hunk_high.permanent ) >> 2;
-	j = hunk_high.permanent >> 2;
-	for (  ; i < j ; i+=64 ) {			// only need to touch each page
-		sum += ((unsigned int *)s_hunkData)[i];
-	}
+typedef struct {
+	int			type;
+	int			size;		// bytes following the chunk header
+	int			raw;
+	int			frame;		// first frame in the chunk
+	int			time;		// com_frameTime of that frame
+	int			link;
+} journalChunk_t;
 
-	zone = mainzone;
-	for (block = zone->blocklist.next ; ; block = block->next) {
-		if ( block->tag != TAG_FREE ) {
-			j = block->size >> 2;
-			for ( i = 0 ; i < j ; i+=64 ) {				// only need to touch each page
-				sum += ((unsigned int *)block)[i];
-			}
-		}
-		if ( block->next == &zone->blocklist ) {
-			break; // all blocks have been hit
-		}
-	}
+typedef struct {
+	int			offset;
+	int			frame;
+	int			time;
+} journalIndex_t;
 
-	end = Sys_Milliseconds();
+typedef struct {
+	netadr_t	from;
+	int			length;		// packet data follows
+} journalPacket_t;
 
-	Com_Printf( "Com_TouchMemory: %i msec\n", end - start );
+typedef struct {
+	int			frameTime;
+	int			msec;
+	int			usec;		// server frame and packet processing time
+} journalFrame_t;
 
-	return sum; // just to silent compiler warning
-}
+typedef struct {
+	int			version;
+
+	byte		block[ JOURNAL_BLOCK_SIZE ];
+	int			blockSize;
+	int			blockPos;
+	int			blockFrame;
+	int			blockTime;
+	int			blockFrames;
+	byte		packed[ 65536 + 256 ];
+
+	journalIndex_t index[ JOURNAL_INDEX_BLOCKS ];
+	int			numIndex;
+	int			lastIndex;
+
+	// benchmark
+	int64_t		frameUsec;
+	int64_t		startUsec;
+	int			totalFrames;		// from the trailer, 0 if the recording wasn't closed
+	int			progress;
+	int			frames;
+	int64_t		replayUsec;
+	int64_t		recordedUsec;
+	int			replayMax;
+	int			recordedMax;
+	int			histogram[ JOURNAL_HISTOGRAM_SIZE + 1 ];
+	fileHandle_t timingFile;
+} journal_t;
+
+static journal_t journal;
+
+static cvar_t *com_journalTiming;
+static cvar_t *com_journalWarmup;
 
 
 /*
 =================
-Com_InitSmallZoneMemory
+Com_JournalWrite
 =================
 */
-static void Com_InitSmallZoneMemory( void ) {
-	static byte s_buf[ 512 * 1024 ];
-	int smallZoneSize;
-
-	smallZoneSize = sizeof( s_buf );
-	Com_Memset( s_buf, 0, smallZoneSize );
-	smallzone = (memzone_t *)s_buf;
-	Z_ClearZone( smallzone, smallzone, smallZoneSize, 1 );
+static void Com_JournalWrite( const void *data, int length ) {
+	if ( FS_Write( data, length, com_journalFile ) != length ) {
+		Com_Error( ERR_FATAL, "Error writing to journal file" );
+	}
 }
 
 
 /*
 =================
-Com_InitZoneMemory
+Com_JournalWriteHeader
 =================
 */
-static void Com_InitZoneMemory( void ) {
-	int		mainZoneSize;
-	cvar_t	*cv;
-
-	// Please note: com_zoneMegs can only be set on the command line, and
-	// not in q3config.cfg or Com_StartupVariable, as they haven't been
-	// executed by this point. It's a chicken and egg problem. We need the
-	// memory manager configured to handle those places where you would
-	// configure the memory manager.
+static void Com_JournalWriteHeader( void ) {
+	journalHeader_t header;
 
-	// allocate the random block zone
-	cv = Cvar_Get( "com_zoneMegs", XSTRING( DEF_COMZONEMEGS ), CVAR_LATCH | CVAR_ARCHIVE );
-	Cvar_CheckRange( cv, "1", NULL, CV_INTEGER );
-	Cvar_SetDescription( cv, "Initial amount of memory (RAM) allocated for the main block zone (in MB)." );
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.magic = JOURNAL_MAGIC;
+	header.version = JOURNAL_VERSION;
+	header.date = (int64_t)time( NULL );
+	Q_strncpyz( header.engine, Q3_VERSION " " PLATFORM_STRING, sizeof( header.engine ) );
 
-#ifndef USE_MULTI_SEGMENT
-	if ( cv->integer < DEF_COMZONEMEGS )
-		mainZoneSize = 1024 * 1024 * DEF_COMZONEMEGS;
-	else
-#endif
-		mainZoneSize = cv->integer * 1024 * 1024;
+	Com_JournalWrite( &header, sizeof( header ) );
 
-	mainzone = calloc( mainZoneSize, 1 );
-	if ( !mainzone ) {
-		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", mainZoneSize / (1024*1024) );
-	}
-	Z_ClearZone( mainzone, mainzone, mainZoneSize, 1 );
+	journal.version = JOURNAL_VERSION;
+	journal.lastIndex = -1;
 }
 
 
 /*
 =================
-Hunk_Log
+Com_JournalWriteIndex
 =================
 */
-void Hunk_Log( void ) {
-	hunkblock_t	*block;
-	char		buf[4096];
-	int size, numBlocks;
+static void Com_JournalWriteIndex( void ) {
+	journalChunk_t chunk;
 
-	if ( logfile == FS_INVALID_HANDLE || !FS_Initialized() )
+	if ( !journal.numIndex ) {
 		return;
-
-	size = 0;
-	numBlocks = 0;
-	Com_sprintf(buf, sizeof(buf), "\r\n================\r\nHunk log\r\n================\r\n");
-	FS_Write(buf, strlen(buf), logfile);
-	for (block = hunkblocks ; block; block = block->next) {
-#ifdef HUNK_DEBUG
-		Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s)\r\n", block->size, block->file, block->line, block->label);
-		FS_Write(buf, strlen(buf), logfile);
-#endif
-		size += block->size;
-		numBlocks++;
 	}
-	Com_sprintf(buf, sizeof(buf), "%d Hunk memory\r\n", size);
-	FS_Write(buf, strlen(buf), logfile);
-	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
-	FS_Write(buf, strlen(buf), logfile);
+
+	chunk.type = JC_INDEX;
+	chunk.size = journal.numIndex * sizeof( journalIndex_t );
+	chunk.raw = journal.numIndex;
+	chunk.frame = journal.index[ 0 ].frame;
+	chunk.time = journal.index[ 0 ].time;
+	chunk.link = journal.lastIndex;
+
+	journal.lastIndex = FS_FTell( com_journalFile );
+	Com_JournalWrite( &chunk, sizeof( chunk ) );
+	Com_JournalWrite( journal.index, chunk.size );
+
+	journal.numIndex = 0;
 }
 
 
 /*
 =================
-Hunk_SmallLog
+Com_JournalFlushBlock
+
+Compresses the current block and writes it out
 =================
 */
-#ifdef HUNK_DEBUG
-void Hunk_SmallLog( void ) {
-	hunkblock_t	*block, *block2;
-	char		buf[4096];
-	int size, locsize, numBlocks;
+static void Com_JournalFlushBlock( void ) {
+	journalChunk_t chunk;
+	journalIndex_t *index;
+	msg_t msg;
 
-	if ( logfile == FS_INVALID_HANDLE || !FS_Initialized() )
+	if ( !journal.blockSize ) {
 		return;
+	}
 
-	for (block = hunkblocks ; block; block = block->next) {
-		block->printed = qfalse;
+	MSG_Init( &msg, journal.packed, sizeof( journal.packed ) );
+	Com_Memcpy( journal.packed, journal.block, journal.blockSize );
+	msg.cursize = journal.blockSize;
+	Huff_Compress( &msg, 0 );
+
+	chunk.type = JC_BLOCK;
+	chunk.raw = journal.blockSize;
+	chunk.frame = journal.blockFrame;
+	chunk.time = journal.blockTime;
+	chunk.link = 0;
+
+	index = &journal.index[ journal.numIndex++ ];
+	index->offset = FS_FTell( com_journalFile );
+	index->frame = chunk.frame;
+	index->time = chunk.time;
+
+	if ( msg.cursize < journal.blockSize ) {
+		chunk.size = msg.cursize;
+		Com_JournalWrite( &chunk, sizeof( chunk ) );
+		Com_JournalWrite( journal.packed, chunk.size );
+	} else {
+		chunk.size = journal.blockSize;
+		Com_JournalWrite( &chunk, sizeof( chunk ) );
+		Com_JournalWrite( journal.block, chunk.size );
 	}
-	size = 0;
-	numBlocks = 0;
-	Com_sprintf(buf, sizeof(buf), "\r\n================\r\nHunk Small log\r\n================\r\n");
-	FS_Write(buf, strlen(buf), logfile);
-	for (block = hunkblocks; block; block = block->next) {
-		if (block->printed) {
-			continue;
-		}
-		locsize = block->size;
-		for (block2 = block->next; block2; block2 = block2->next) {
-			if (block->line != block2->line) {
-				continue;
-			}
-			if (Q_stricmp(block->file, block2->file)) {
-				continue;
-			}
-			size += block2->size;
-			locsize += block2->size;
-			block2->printed = qtrue;
-		}
-		Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s)\r\n", locsize, block->file, block->line, block->label);
-		FS_Write(buf, strlen(buf), logfile);
-		size += block->size;
-		numBlocks++;
+
+	if ( journal.numIndex == JOURNAL_INDEX_BLOCKS ) {
+		Com_JournalWriteIndex();
 	}
-	Com_sprintf(buf, sizeof(buf), "%d Hunk memory\r\n", size);
-	FS_Write(buf, strlen(buf), logfile);
-	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
-	FS_Write(buf, strlen(buf), logfile);
+
+	journal.blockSize = 0;
+	journal.blockFrames = 0;
 }
-#endif
 
 
 /*
 =================
-Com_InitHunkMemory
+Com_JournalWriteRecord
+
+Records never span blocks
 =================
 */
-static void Com_InitHunkMemory( void ) {
-	cvar_t	*cv;
+static void Com_JournalWriteRecord( journalRecord_t type, const void *data, int length, const void *data2, int length2 ) {
+	byte *p;
 
-	// make sure the file system has allocated and "not" freed any temp blocks
-	// this allows the config and product id files ( journal files too ) to be loaded
-	// by the file system without redundant routines in the file system utilizing different
-	// memory systems
-	if ( FS_LoadStack() != 0 ) {
-		Com_Error( ERR_FATAL, "Hunk initialization failed. File system load stack not zero" );
+	if ( journal.blockSize + 1 + length + length2 > JOURNAL_BLOCK_SIZE ) {
+		Com_JournalFlushBlock();
+		if ( 1 + length + length2 > JOURNAL_BLOCK_SIZE ) {
+			Com_Error( ERR_FATAL, "Journal record of %i bytes doesn't fit in a block", length + length2 );
+		}
 	}
 
-	// allocate the stack based hunk allocator
-	cv = Cvar_Get( "com_hunkMegs", XSTRING( DEF_COMHUNKMEGS ), CVAR_LATCH | CVAR_ARCHIVE );
-	Cvar_CheckRange( cv, XSTRING( MIN_COMHUNKMEGS ), NULL, CV_INTEGER );
-	Cvar_SetDescription( cv, "The size of the hunk memory segment." );
-
-	s_hunkTotal = cv->integer * 1024 * 1024;
-
-	s_hunkData = calloc( s_hunkTotal + 63, 1 );
-	if ( !s_hunkData ) {
-		Com_Error( ERR_FATAL, "Hunk data failed to allocate %i megs", s_hunkTotal / (1024*1024) );
+	if ( !journal.blockSize ) {
+		journal.blockFrame = com_frameNumber;
+		journal.blockTime = com_frameTime;
 	}
 
-	// cacheline align
-	s_hunkData = PADP( s_hunkData, 64 );
-	Hunk_Clear();
+	p = journal.block + journal.blockSize;
+	*p++ = type;
+	Com_Memcpy( p, data, length );
+	if ( length2 > 0 ) {
+		Com_Memcpy( p + length, data2, length2 );
+	}
 
-	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
-#ifdef ZONE_DEBUG
-	Cmd_AddCommand( "zonelog", Z_LogHeap );
-#endif
-#ifdef HUNK_DEBUG
-	Cmd_AddCommand( "hunklog", Hunk_Log );
-	Cmd_AddCommand( "hunksmalllog", Hunk_SmallLog );
-#endif
+	journal.blockSize += 1 + length + length2;
 }
 
 
 /*
-====================
-Hunk_MemoryRemaining
-====================
-*/
-int	Hunk_MemoryRemaining( void ) {
-	int		low, high;
+=================
+Com_JournalReadBlock
 
-	low = hunk_low.permanent > hunk_low.temp ? hunk_low.permanent : hunk_low.temp;
-	high = hunk_high.permanent > hunk_high.temp ? hunk_high.permanent : hunk_high.temp;
+Loads the next block, returns qfalse at the end of the recording
+=================
+*/
+static qboolean Com_JournalReadBlock( void ) {
+	journalChunk_t chunk;
+	msg_t msg;
 
-	return s_hunkTotal - ( low + high );
+	for ( ;; ) {
+		if ( FS_Read( &chunk, sizeof( chunk ), com_journalFile ) != sizeof( chunk ) ) {
+			return qfalse;
+		}
+		if ( chunk.type == JC_END ) {
+			return qfalse;
+		}
+		if ( chunk.size < 0 || ( chunk.type == JC_BLOCK && ( chunk.size > chunk.raw || chunk.raw > JOURNAL_BLOCK_SIZE ) ) ) {
+			Com_Error( ERR_FATAL, "Bad chunk in journal file" );
+		}
+		if ( chunk.type != JC_BLOCK ) {
+			FS_Seek( com_journalFile, chunk.size, FS_SEEK_CUR );
+			continue;
+		}
+		if ( chunk.size == chunk.raw ) {
+			if ( FS_Read( journal.block, chunk.size, com_journalFile ) != chunk.size ) {
+				return qfalse;
+			}
+		} else {
+			if ( FS_Read( journal.packed, chunk.size, com_journalFile ) != chunk.size ) {
+				return qfalse;
+			}
+			MSG_Init( &msg, journal.packed, sizeof( journal.packed ) );
+			msg.cursize = chunk.size;
+			Huff_Decompress( &msg, 0 );
+			if ( msg.cursize != chunk.raw ) {
+				Com_Error( ERR_FATAL, "Error decompressing journal block" );
+			}
+			Com_Memcpy( journal.block, journal.packed, chunk.raw );
+		}
+		journal.blockSize = chunk.raw;
+		journal.blockPos = 0;
+		return qtrue;
+	}
 }
 
 
 /*
-===================
-Hunk_SetMark
+=================
+Com_JournalPeekRecord
 
-The server calls this after the level and game VM have been loaded
-===================
+Returns the type of the next record or 0 at the end of the recording
+=================
 */
-void Hunk_SetMark( void ) {
-	hunk_low.mark = hunk_low.permanent;
-	hunk_high.mark = hunk_high.permanent;
+static int Com_JournalPeekRecord( void ) {
+	while ( journal.blockPos >= journal.blockSize ) {
+		if ( !Com_JournalReadBlock() ) {
+			return 0;
+		}
+	}
+	return journal.block[ journal.blockPos ];
 }
 
 
 /*
 =================
-Hunk_ClearToMark
-
-The client calls this before starting a vid_restart or snd_restart
+Com_JournalRead
 =================
 */
-void Hunk_ClearToMark( void ) {
-	hunk_low.permanent = hunk_low.temp = hunk_low.mark;
-	hunk_high.permanent = hunk_high.temp = hunk_high.mark;
+static void Com_JournalRead( void *data, int length ) {
+	if ( length < 0 || journal.blockPos + length > journal.blockSize ) {
+		Com_Error( ERR_FATAL, "Error reading from journal file" );
+	}
+	Com_Memcpy( data, journal.block + journal.blockPos, length );
+	journal.blockPos += length;
 }
 
 
 /*
 =================
-Hunk_CheckMark
+Com_JournalSummary
 =================
 */
-qboolean Hunk_CheckMark( void ) {
-	if( hunk_low.mark || hunk_high.mark ) {
-		return qtrue;
+static void Com_JournalSummary( void ) {
+	int64_t wall;
+	int p50, p99, i, n;
+
+	if ( com_journal->integer < 2 || journal.version < 2 || !journal.frames || com_journalTiming->integer <= 0 ) {
+		return;
 	}
-	return qfalse;
+
+	wall = Sys_Microseconds() - journal.startUsec;
+
+	p50 = p99 = 0;
+	for ( i = 0, n = 0; i <= JOURNAL_HISTOGRAM_SIZE; i++ ) {
+		n += journal.histogram[ i ];
+		if ( !p50 && n * 2 >= journal.frames )
+			p50 = ( i + 1 ) * JOURNAL_HISTOGRAM_USEC;
+		if ( !p99 && n * 100 >= journal.frames * 99 )
+			p99 = ( i + 1 ) * JOURNAL_HISTOGRAM_USEC;
+	}
+
+	Com_Printf( "Journal replay: %i frames in %.2f seconds, %.1f frames/sec\n", journal.frames,
+		wall / 1000000.0, wall > 0 ? journal.frames * 1000000.0 / wall : 0.0 );
+	Com_Printf( "  replayed frame time: avg %i usec, p50 <%i, p99 <%i, max %i\n",
+		(int)( journal.replayUsec / journal.frames ), p50, p99, journal.replayMax );
+	Com_Printf( "  recorded frame time: avg %i usec, max %i\n",
+		(int)( journal.recordedUsec / journal.frames ), journal.recordedMax );
 }
 
-void CL_ShutdownCGame( void );
-void CL_ShutdownUI( void );
-void SV_ShutdownGameProgs( void );
 
 /*
 =================
-Hunk_Clear
+Com_JournalEnd
+=================
+*/
+static void NORETURN Com_JournalEnd( void ) {
+	Com_Printf( "End of journal file\n" );
+	Com_JournalSummary();
+	Com_Quit_f();
+	// shouldn't get here
+	Sys_Quit();
+}
 
-The server calls this before shutting down or loading a new map
+
+/*
+=================
+Com_JournalReadHeader
+
+Picks up the recording details and uses the index to find its length
 =================
 */
-void Hunk_Clear( void ) {
+static void Com_JournalReadHeader( void ) {
+	journalHeader_t header;
+	journalChunk_t chunk;
+	char date[ 32 ];
+	time_t t;
+	int blocks, offset, startTime;
 
-#ifndef DEDICATED
-	CL_ShutdownCGame();
-	CL_ShutdownUI();
-#endif
-	SV_ShutdownGameProgs();
-#ifndef DEDICATED
-	CIN_CloseAllVideos();
-#endif
-	hunk_low.mark = 0;
-	hunk_low.permanent = 0;
-	hunk_low.temp = 0;
-	hunk_low.tempHighwater = 0;
+	if ( FS_Read( &header, sizeof( header ), com_journalFile ) != sizeof( header ) || header.magic != JOURNAL_MAGIC ) {
+		// raw version 1 stream
+		FS_Seek( com_journalFile, 0, FS_SEEK_SET );
+		journal.version = 1;
+		return;
+	}
+
+	if ( header.version != JOURNAL_VERSION ) {
+		Com_Error( ERR_FATAL, "journal.dat is version %i, expected %i", header.version, JOURNAL_VERSION );
+	}
+
+	journal.version = JOURNAL_VERSION;
+	header.engine[ sizeof( header.engine ) - 1 ] = '\0';
+	t = (time_t)header.date;
+	strftime( date, sizeof( date ), "%Y-%m-%d %H:%M", localtime( &t ) );
+	Com_Printf( "journal.dat recorded %s by %s\n", date, header.engine );
+
+	startTime = 0;
+	if ( FS_Read( &chunk, sizeof( chunk ), com_journalFile ) == sizeof( chunk ) ) {
+		startTime = chunk.time;
+	}
+
+	blocks = 0;
+	FS_Seek( com_journalFile, -(long)sizeof( chunk ), FS_SEEK_END );
+	if ( FS_Read( &chunk, sizeof( chunk ), com_journalFile ) == sizeof( chunk ) && chunk.type == JC_END ) {
+		journal.totalFrames = chunk.frame;
+		Com_Printf( "%i frames, %i seconds\n", chunk.frame, ( chunk.time - startTime ) / 1000 );
+		for ( offset = chunk.link; offset > 0; offset = chunk.link ) {
+			FS_Seek( com_journalFile, offset, FS_SEEK_SET );
+			if ( FS_Read( &chunk, sizeof( chunk ), com_journalFile ) != sizeof( chunk ) || chunk.type != JC_INDEX ) {
+				break;
+			}
+			blocks += chunk.raw;
+		}
+		Com_Printf( "%i blocks\n", blocks );
+	} else {
+		Com_Printf( "journal.dat has no trailer, the recording wasn't shut down\n" );
+	}
 
-	hunk_high.mark = 0;
-	hunk_high.permanent = 0;
-	hunk_high.temp = 0;
-	hunk_high.tempHighwater = 0;
+	FS_Seek( com_journalFile, sizeof( header ), FS_SEEK_SET );
 
-	hunk_permanent = &hunk_low;
-	hunk_temp = &hunk_high;
+	if ( com_journalTiming->integer > 1 ) {
+		journal.timingFile = FS_FOpenFileWrite( "journaltiming.csv" );
+		if ( journal.timingFile != FS_INVALID_HANDLE ) {
+			FS_Printf( journal.timingFile, "frame,time,msec,recorded_usec,replay_usec\n" );
+		}
+	}
 
-	Com_Printf( "Hunk_Clear: reset the hunk ok\n" );
-	VM_Clear();
-#ifdef HUNK_DEBUG
-	hunkblocks = NULL;
-#endif
+	journal.startUsec = Sys_Microseconds();
 }
 
 
-static void Hunk_SwapBanks( void ) {
-	hunkUsed_t	*swap;
+/*
+=================
+Com_JournalPacket
 
-	// can't swap banks if there is any temp already allocated
-	if ( hunk_temp->temp != hunk_temp->permanent ) {
+Packets are recorded when they arrive from the network,
+along with whether the server or the client got them
+=================
+*/
+void Com_JournalPacket( const netadr_t *from, const msg_t *msg, qboolean server ) {
+	journalPacket_t packet;
+
+	if ( com_journalFile == FS_INVALID_HANDLE || com_journal->integer != 1 || journal.version < 2 ) {
 		return;
 	}
 
-	// if we have a larger highwater mark on this side, start making
-	// our permanent allocations here and use the other side for temp
-	if ( hunk_temp->tempHighwater - hunk_temp->permanent >
-		hunk_permanent->tempHighwater - hunk_permanent->permanent ) {
-		swap = hunk_temp;
-		hunk_temp = hunk_permanent;
-		hunk_permanent = swap;
-	}
+	packet.from = *from;
+	packet.length = msg->cursize;
+	Com_JournalWriteRecord( server ? JR_PACKET : JR_CLIENTPACKET, &packet, sizeof( packet ), msg->data, msg->cursize );
 }
 
 
 /*
 =================
-Hunk_Alloc
+Com_JournalReplayPackets
 
-Allocate permanent (until the hunk is cleared) memory
+Runs the packets that were received while the recording slept
 =================
 */
-#ifdef HUNK_DEBUG
-void *Hunk_AllocDebug( int size, ha_pref preference, char *label, char *file, int line ) {
-#else
-void *Hunk_Alloc( int size, ha_pref preference ) {
-#endif
-	void	*buf;
-
-	if ( s_hunkData == NULL)
-	{
-		Com_Error( ERR_FATAL, "Hunk_Alloc: Hunk memory system not initialized" );
-	}
+static void Com_JournalReplayPackets( void ) {
+	byte bufData[ MAX_MSGLEN_BUF ];
+	journalPacket_t packet;
+	msg_t msg;
+	int type;
 
-	// can't do preference if there is any temp allocated
-	if (preference == h_dontcare || hunk_temp->temp != hunk_temp->permanent) {
-		Hunk_SwapBanks();
-	} else {
-		if (preference == h_low && hunk_permanent != &hunk_low) {
-			Hunk_SwapBanks();
-		} else if (preference == h_high && hunk_permanent != &hunk_high) {
-			Hunk_SwapBanks();
+	for ( ;; ) {
+		type = Com_JournalPeekRecord();
+		if ( type != JR_PACKET && type != JR_CLIENTPACKET ) {
+			break;
+		}
+		journal.blockPos++;
+		Com_JournalRead( &packet, sizeof( packet ) );
+		if ( packet.length < 0 || packet.length > MAX_MSGLEN ) {
+			Com_Error( ERR_FATAL, "Bad packet in journal file" );
+		}
+		MSG_Init( &msg, bufData, MAX_MSGLEN );
+		Com_JournalRead( bufData, packet.length );
+		msg.cursize = packet.length;
+		if ( type == JR_PACKET ) {
+			Com_RunAndTimeServerPacket( &packet.from, &msg );
+		}
+#ifndef DEDICATED
+		else {
+			CL_PacketEvent( &packet.from, &msg );
 		}
-	}
-
-#ifdef HUNK_DEBUG
-	size += sizeof(hunkblock_t);
 #endif
+	}
+}
 
-	// round to cacheline
-	size = PAD( size, 64 );
 
-	if ( hunk_low.temp + hunk_high.temp + size > s_hunkTotal ) {
-#ifdef HUNK_DEBUG
-		Hunk_Log();
-		Hunk_SmallLog();
+/*
+=================
+Com_JournalSleep
 
-		Com_Error(ERR_DROP, "Hunk_Alloc failed on %i: %s, line: %d (%s)", size, file, line, label);
-#else
-		Com_Error(ERR_DROP, "Hunk_Alloc failed on %i", size);
-#endif
+Used in place of NET_Sleep when replaying, the network is not read
+=================
+*/
+static void Com_JournalSleep( int usec ) {
+	if ( journal.version < 2 ) {
+		if ( com_journal->integer == 2 ) {
+			NET_Sleep( usec );
+		}
+		return;
 	}
 
-	if ( hunk_permanent == &hunk_low ) {
-		buf = (void *)(s_hunkData + hunk_permanent->permanent);
-		hunk_permanent->permanent += size;
-	} else {
-		hunk_permanent->permanent += size;
-		buf = (void *)(s_hunkData + s_hunkTotal - hunk_permanent->permanent );
+	if ( com_journal->integer == 2 && usec > 0 ) {
+		Sys_Sleep( usec / 1000 );
 	}
 
-	hunk_permanent->temp = hunk_permanent->permanent;
+	Com_JournalReplayPackets();
+}
 
-	Com_Memset( buf, 0, size );
 
-#ifdef HUNK_DEBUG
-	{
-		hunkblock_t *block;
+/*
+=================
+Com_JournalReplaying
 
-		block = (hunkblock_t *) buf;
-		block->size = size - sizeof(hunkblock_t);
-		block->file = file;
-		block->label = label;
-		block->line = line;
-		block->next = hunkblocks;
-		hunkblocks = block;
-		buf = ((byte *) buf) + sizeof(hunkblock_t);
-	}
-#endif
-	return buf;
+Returns qtrue while a journal that recorded network packets is replayed
+=================
+*/
+qboolean Com_JournalReplaying( void ) {
+	return com_journal->integer >= 2 && com_journalFile != FS_INVALID_HANDLE && journal.version >= 2;
 }
 
 
 /*
 =================
-Hunk_AllocateTempMemory
+Com_JournalWait
 
-This is used by the file loading system.
-Multiple files can be loaded in temporary memory.
-When the files-in-use count reaches zero, all temp memory will be deleted
+Used in place of an idle wait for console input or network packets,
+returns qfalse if the caller has to wait itself
 =================
 */
-void *Hunk_AllocateTempMemory( int size ) {
-	void		*buf;
-	hunkHeader_t	*hdr;
-
-	// return a Z_Malloc'd block if the hunk has not been initialized
-	// this allows the config and product id files ( journal files too ) to be loaded
-	// by the file system without redundant routines in the file system utilizing different
-	// memory systems
-	if ( s_hunkData == NULL )
-	{
-		return Z_Malloc(size);
+qboolean Com_JournalWait( void ) {
+	if ( !Com_JournalReplaying() ) {
+		return qfalse;
 	}
 
-	Hunk_SwapBanks();
+	Com_JournalReplayPackets();
 
-	size = PAD(size, sizeof(intptr_t)) + sizeof( hunkHeader_t );
+	return qtrue;
+}
 
-	if ( hunk_temp->temp + hunk_permanent->permanent + size > s_hunkTotal ) {
-		Com_Error( ERR_DROP, "Hunk_AllocateTempMemory: failed on %i bytes (temp: %i, perm: %i, total: %i)", 
-			size, hunk_temp->temp, hunk_permanent->permanent, s_hunkTotal );
-	}
 
-	if ( hunk_temp == &hunk_low ) {
-		buf = (void *)(s_hunkData + hunk_temp->temp);
-		hunk_temp->temp += size;
-	} else {
-		hunk_temp->temp += size;
-		buf = (void *)(s_hunkData + s_hunkTotal - hunk_temp->temp );
-	}
+/*
+=================
+Com_JournalEndFrame
 
-	if ( hunk_temp->temp > hunk_temp->tempHighwater ) {
-		hunk_temp->tempHighwater = hunk_temp->temp;
+Records the frame timing or checks the replay against it
+=================
+*/
+static void Com_JournalEndFrame( int msec ) {
+	journalFrame_t frame;
+	int usec;
+
+	if ( com_journalFile == FS_INVALID_HANDLE || journal.version < 2 ) {
+		return;
 	}
 
-	hdr = (hunkHeader_t *)buf;
-	buf = (void *)(hdr+1);
+	usec = (int)journal.frameUsec;
+	journal.frameUsec = 0;
 
-	hdr->magic = HUNK_MAGIC;
-	hdr->size = size;
+	if ( com_journal->integer == 1 ) {
+		frame.frameTime = com_frameTime;
+		frame.msec = msec;
+		frame.usec = usec;
+		Com_JournalWriteRecord( JR_FRAME, &frame, sizeof( frame ), NULL, 0 );
+		if ( ++journal.blockFrames >= JOURNAL_BLOCK_FRAMES ) {
+			Com_JournalFlushBlock();
+		}
+		return;
+	}
 
-	// don't bother clearing, because we are going to load a file over it
-	return buf;
-}
+	// packets received after the last sleep of the frame
+	Com_JournalReplayPackets();
 
+	switch ( Com_JournalPeekRecord() ) {
+	case 0:
+		Com_JournalEnd();
+	case JR_FRAME:
+		journal.blockPos++;
+		Com_JournalRead( &frame, sizeof( frame ) );
+		break;
+	default:
+		Com_Error( ERR_FATAL, "Journal replay is out of sync at frame %i", com_frameNumber );
+	}
 
-/*
-==================
-Hunk_FreeTempMemory
-==================
-*/
-void Hunk_FreeTempMemory( void *buf ) {
-	hunkHeader_t	*hdr;
+	if ( frame.frameTime != com_frameTime || frame.msec != msec ) {
+		Com_Error( ERR_FATAL, "Journal replay diverged at frame %i: time %i msec %i, recorded %i msec %i",
+			com_frameNumber, com_frameTime, msec, frame.frameTime, frame.msec );
+	}
 
-	// free with Z_Free if the hunk has not been initialized
-	// this allows the config and product id files ( journal files too ) to be loaded
-	// by the file system without redundant routines in the file system utilizing different
-	// memory systems
-	if ( s_hunkData == NULL )
-	{
-		Z_Free(buf);
-		return;
+	if ( journal.totalFrames > 0 && com_frameNumber * 10 / journal.totalFrames > journal.progress ) {
+		journal.progress = com_frameNumber * 10 / journal.totalFrames;
+		Com_Printf( "journal: %i%% replayed\n", journal.progress * 10 );
 	}
 
-	hdr = ( (hunkHeader_t *)buf ) - 1;
-	if ( hdr->magic != HUNK_MAGIC ) {
-		Com_Error( ERR_FATAL, "Hunk_FreeTempMemory: bad magic" );
+	if ( com_frameNumber < com_journalWarmup->integer ) {
+		return;
 	}
 
-	hdr->magic = HUNK_FREE_MAGIC;
+	journal.frames++;
+	journal.replayUsec += usec;
+	journal.recordedUsec += frame.usec;
+	if ( journal.replayMax < usec )
+		journal.replayMax = usec;
+	if ( journal.recordedMax < frame.usec )
+		journal.recordedMax = frame.usec;
+	journal.histogram[ MIN( usec / JOURNAL_HISTOGRAM_USEC, JOURNAL_HISTOGRAM_SIZE ) ]++;
 
-	// this only works if the files are freed in stack order,
-	// otherwise the memory will stay around until Hunk_ClearTempMemory
-	if ( hunk_temp == &hunk_low ) {
-		if ( hdr == (void *)(s_hunkData + hunk_temp->temp - hdr->size ) ) {
-			hunk_temp->temp -= hdr->size;
-		} else {
-			Com_Printf( "Hunk_FreeTempMemory: not the final block\n" );
-		}
-	} else {
-		if ( hdr == (void *)(s_hunkData + s_hunkTotal - hunk_temp->temp ) ) {
-			hunk_temp->temp -= hdr->size;
-		} else {
-			Com_Printf( "Hunk_FreeTempMemory: not the final block\n" );
-		}
+	if ( journal.timingFile != FS_INVALID_HANDLE ) {
+		FS_Printf( journal.timingFile, "%i,%i,%i,%i,%i\n", com_frameNumber, com_frameTime, msec, frame.usec, usec );
 	}
 }
 
 
 /*
 =================
-Hunk_ClearTempMemory
-
-The temp space is no longer needed.  If we have left more
-touched but unused memory on this side, have future
-permanent allocs use this side.
+Com_JournalClose
 =================
 */
-void Hunk_ClearTempMemory( void ) {
-	if ( s_hunkData != NULL ) {
-		hunk_temp->temp = hunk_temp->permanent;
+static void Com_JournalClose( void ) {
+	journalChunk_t chunk;
+
+	if ( com_journalFile == FS_INVALID_HANDLE ) {
+		return;
 	}
-}
 
-/*
-===================================================================
+	if ( com_journal->integer == 1 && journal.version >= 2 ) {
+		Com_JournalFlushBlock();
+		Com_JournalWriteIndex();
 
-EVENTS AND JOURNALING
+		Com_Memset( &chunk, 0, sizeof( chunk ) );
+		chunk.type = JC_END;
+		chunk.frame = com_frameNumber;
+		chunk.time = com_frameTime;
+		chunk.link = journal.lastIndex;
+		Com_JournalWrite( &chunk, sizeof( chunk ) );
+	}
 
-In addition to these events, .cfg files are also copied to the
-journaled file
-===================================================================
-*/
+	if ( journal.timingFile != FS_INVALID_HANDLE ) {
+		FS_FCloseFile( journal.timingFile );
+		journal.timingFile = FS_INVALID_HANDLE;
+	}
 
-#define	MAX_PUSHED_EVENTS 256
-static int com_pushedEventsHead = 0;
-static int com_pushedEventsTail = 0;
-static sysEvent_t com_pushedEvents[MAX_PUSHED_EVENTS];
+	FS_FCloseFile( com_journalFile );
+	com_journalFile = FS_INVALID_HANDLE;
+}
 
 
 /*
@@ -2532,14 +3746,22 @@ static void Com_InitJournaling( void ) {
 		return;
 	}
 
+	Com_Memset( &journal, 0, sizeof( journal ) );
+
 	if ( com_journal->integer == 1 ) {
 		Com_Printf( "Journaling events\n" );
 		com_journalFile = FS_FOpenFileWrite( "journal.dat" );
 		com_journalDataFile = FS_FOpenFileWrite( "journaldata.dat" );
-	} else if ( com_journal->integer == 2 ) {
-		Com_Printf( "Replaying journaled events\n" );
+		if ( com_journalFile != FS_INVALID_HANDLE ) {
+			Com_JournalWriteHeader();
+		}
+	} else if ( com_journal->integer >= 2 ) {
+		Com_Printf( "Replaying journaled events%s\n", com_journal->integer == 3 ? " as fast as possible" : "" );
 		FS_FOpenFileRead( "journal.dat", &com_journalFile, qtrue );
 		FS_FOpenFileRead( "journaldata.dat", &com_journalDataFile, qtrue );
+		if ( com_journalFile != FS_INVALID_HANDLE ) {
+			Com_JournalReadHeader();
+		}
 	}
 
 	if ( com_journalFile == FS_INVALID_HANDLE || com_journalDataFile == FS_INVALID_HANDLE ) {
@@ -2701,7 +3923,24 @@ static sysEvent_t Com_GetRealEvent( void ) {
 		int			r;
 		sysEvent_t	ev;
 
-		if ( com_journal->integer == 2 ) {
+		if ( com_journal->integer >= 2 && journal.version >= 2 ) {
+			Sys_SendKeyEvents();
+			switch ( Com_JournalPeekRecord() ) {
+			case 0:
+				Com_JournalEnd();
+			case JR_EVENT:
+				journal.blockPos++;
+				break;
+			default:
+				Com_Error( ERR_FATAL, "Journal replay is out of sync at frame %i", com_frameNumber );
+			}
+			Com_JournalRead( &ev, sizeof( ev ) );
+			ev.evPtr = NULL;
+			if ( ev.evPtrLength ) {
+				ev.evPtr = Z_Malloc( ev.evPtrLength );
+				Com_JournalRead( ev.evPtr, ev.evPtrLength );
+			}
+		} else if ( com_journal->integer >= 2 ) {
 			Sys_SendKeyEvents();
 			r = FS_Read( &ev, sizeof(ev), com_journalFile );
 			if ( r != sizeof(ev) ) {
@@ -2719,16 +3958,7 @@ static sysEvent_t Com_GetRealEvent( void ) {
 
 			// write the journal value out if needed
 			if ( com_journal->integer == 1 ) {
-				r = FS_Write( &ev, sizeof(ev), com_journalFile );
-				if ( r != sizeof(ev) ) {
-					Com_Error( ERR_FATAL, "Error writing to journal file" );
-				}
-				if ( ev.evPtrLength ) {
-					r = FS_Write( ev.evPtr, ev.evPtrLength, com_journalFile );
-					if ( r != ev.evPtrLength ) {
-						Com_Error( ERR_FATAL, "Error writing to journal file" );
-					}
-				}
+				Com_JournalWriteRecord( JR_EVENT, &ev, sizeof( ev ), ev.evPtr, ev.evPtrLength );
 			}
 		}
 
@@ -2807,15 +4037,25 @@ Com_RunAndTimeServerPacket
 */
 void Com_RunAndTimeServerPacket( const netadr_t *evFrom, msg_t *buf ) {
 	int		t1, t2, msec;
+	int64_t	start;
 
 	t1 = 0;
+	start = 0;
 
 	if ( com_speeds->integer ) {
 		t1 = Sys_Milliseconds ();
 	}
 
+	if ( com_journalFile != FS_INVALID_HANDLE ) {
+		start = Sys_Microseconds();
+	}
+
 	SV_PacketEvent( evFrom, buf );
 
+	if ( com_journalFile != FS_INVALID_HANDLE ) {
+		journal.frameUsec += Sys_Microseconds() - start;
+	}
+
 	if ( com_speeds->integer ) {
 		t2 = Sys_Milliseconds ();
 		msec = t2 - t1;
@@ -3801,8 +5041,21 @@ void Com_Init( char *commandLine ) {
 
 	Com_StartupVariable( "journal" );
 	com_journal = Cvar_Get( "journal", "0", CVAR_INIT | CVAR_PROTECTED );
-	Cvar_CheckRange( com_journal, "0", "2", CV_INTEGER );
-	Cvar_SetDescription( com_journal, "When enabled, writes events and its data to 'journal.dat' and 'journaldata.dat'.");
+	Cvar_CheckRange( com_journal, "0", "3", CV_INTEGER );
+	Cvar_SetDescription( com_journal, "Event journal in 'journal.dat' and 'journaldata.dat':\n"
+		" 0 - disabled\n"
+		" 1 - record events, network packets and frame times\n"
+		" 2 - replay in real time\n"
+		" 3 - replay as fast as possible, for benchmarking" );
+	com_journalTiming = Cvar_Get( "journal_timing", "1", 0 );
+	Cvar_CheckRange( com_journalTiming, "0", "2", CV_INTEGER );
+	Cvar_SetDescription( com_journalTiming, "Frame timing of journal replays:\n"
+		" 0 - disabled\n"
+		" 1 - print a summary at the end\n"
+		" 2 - also write each frame to 'journaltiming.csv'" );
+	com_journalWarmup = Cvar_Get( "journal_warmup", "0", 0 );
+	Cvar_CheckRange( com_journalWarmup, "0", NULL, CV_INTEGER );
+	Cvar_SetDescription( com_journalWarmup, "Number of replayed frames left out of the journal timing." );
 
 	Com_StartupVariable( "sv_master1" );
 	Com_StartupVariable( "sv_master2" );
@@ -3839,6 +5092,21 @@ void Com_Init( char *commandLine ) {
 		" 2 - overwrite mode, synced\n"
 		" 3 - append mode, buffered\n"
 		" 4 - append mode, synced\n" );
+	com_logfileFormat = Cvar_Get( "logfile_format", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( com_logfileFormat, "0", "2", CV_INTEGER );
+	Cvar_SetDescription( com_logfileFormat, "Format of logfile records:\n"
+		" 0 - plain console text\n"
+		" 1 - lines prefixed with the local time\n"
+		" 2 - one JSON object per line" );
+	com_logfileMaxSize = Cvar_Get( "logfile_maxsize", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( com_logfileMaxSize, "0", NULL, CV_INTEGER );
+	Cvar_SetDescription( com_logfileMaxSize, "Rotate the logfile once it grows past this many kilobytes, 0 to disable." );
+	com_logfileRotate = Cvar_Get( "logfile_rotate", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( com_logfileRotate, "0", NULL, CV_INTEGER );
+	Cvar_SetDescription( com_logfileRotate, "Rotate the logfile after this many minutes, 0 to disable." );
+	com_logfileBackups = Cvar_Get( "logfile_backups", "4", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( com_logfileBackups, "0", "32", CV_INTEGER );
+	Cvar_SetDescription( com_logfileBackups, "Number of rotated logfiles to keep as qconsole.log.1, qconsole.log.2 and so on." );
 
 	Com_InitJournaling();
 
@@ -4257,6 +5525,11 @@ void Com_Frame( qboolean noDelay ) {
 		com_viewlog->modified = qfalse;
 	}
 
+	// pass changed logfile settings on to the writer thread
+	if ( com_logfileFormat->modified || com_logfileMaxSize->modified || com_logfileRotate->modified || com_logfileBackups->modified ) {
+		Com_LogLatchSettings();
+	}
+
 #ifdef USE_AFFINITY_MASK
 	if ( com_affinityMask->modified ) {
 		Com_SetAffinityMask( com_affinityMask->string );
@@ -4322,7 +5595,10 @@ void Com_Frame( qboolean noDelay ) {
 		if ( timeVal > sleepMsec )
 			Com_EventLoop();
 #endif
-		NET_Sleep( sleepMsec * 1000 - 500 );
+		if ( com_journal->integer >= 2 && com_journalFile != FS_INVALID_HANDLE )
+			Com_JournalSleep( sleepMsec * 1000 - 500 );
+		else
+			NET_Sleep( sleepMsec * 1000 - 500 );
 	} while( Com_TimeVal( minMsec ) );
 
 	lastTime = com_frameTime;
@@ -4341,7 +5617,13 @@ void Com_Frame( qboolean noDelay ) {
 		timeBeforeServer = Sys_Milliseconds();
 	}
 
-	SV_Frame( msec );
+	if ( com_journalFile != FS_INVALID_HANDLE ) {
+		int64_t start = Sys_Microseconds();
+		SV_Frame( msec );
+		journal.frameUsec += Sys_Microseconds() - start;
+	} else {
+		SV_Frame( msec );
+	}
 
 	// if "dedicated" has been modified, start up
 	// or shut down the client system.
@@ -4447,6 +5729,8 @@ void Com_Frame( qboolean noDelay ) {
 		c_pointcontents = 0;
 	}
 
+	Com_JournalEndFrame( msec );
+
 	com_frameNumber++;
 }
 
@@ -4457,15 +5741,9 @@ Com_Shutdown
 =================
 */
 static void Com_Shutdown( void ) {
-	if ( logfile != FS_INVALID_HANDLE ) {
-		FS_FCloseFile( logfile );
-		logfile = FS_INVALID_HANDLE;
-	}
+	Com_LogClose();
 
-	if ( com_journalFile != FS_INVALID_HANDLE ) {
-		FS_FCloseFile( com_journalFile );
-		com_journalFile = FS_INVALID_HANDLE;
-	}
+	Com_JournalClose();
 
 	if ( com_journalDataFile != FS_INVALID_HANDLE ) {
 		FS_FCloseFile( com_journalDataFile );
@@ -955,6 +955,7 @@ void		Info_Print( const char *s );
 
 void		Com_BeginRedirect (char *buffer, int buffersize, void (*flush)(const char *));
 void		Com_EndRedirect( void );
+void		Com_LogFlush( void );
 void 		QDECL Com_Printf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
 void 		QDECL Com_DPrintf( const char *fmt, ... ) __attribute__ ((format (printf, 1, 2)));
 void 		Com_Quit_f( void );
@@ -986,6 +987,9 @@ int			Com_FilterPath( const char *filter, const char *name );
 int			Com_RealTime(qtime_t *qtime);
 qboolean	Com_SafeMode( void );
 void		Com_RunAndTimeServerPacket( const netadr_t *evFrom, msg_t *buf );
+void		Com_JournalPacket( const netadr_t *from, const msg_t *msg, qboolean server );
+qboolean	Com_JournalReplaying( void );
+qboolean	Com_JournalWait( void );
 
 void		Com_StartupVariable( const char *match );
 // checks for and removes command line "+set var arg" constructs
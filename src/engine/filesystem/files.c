@@ -2110,7 +2110,7 @@ int FS_ReadFile( const char *qpath, void **buffer ) {
 	// if this is a .cfg file and we are playing back a journal, read
 	// it from the journal file
 	if ( com_journalDataFile != FS_INVALID_HANDLE && strstr( qpath, ".cfg" ) ) {
-		if ( com_journal->integer == 2 ) {
+		if ( com_journal->integer >= 2 ) {
 			int		r;
 
 			Com_DPrintf( "Loading %s from journal file.\n", qpath );
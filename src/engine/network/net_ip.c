@@ -769,6 +769,11 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 	int ret = SOCKET_ERROR;
 	sockaddr_t addr;
 
+	// replayed journal traffic, the peers are not there
+	if ( Com_JournalReplaying() ) {
+		return;
+	}
+
 	switch ( to->type ) {
 		case NA_BROADCAST:
 		case NA_IP:
@@ -1836,12 +1841,16 @@ static void NET_Event( const fd_set *fdr )
 			}
 
 #ifdef DEDICATED
+			Com_JournalPacket( &from, &netmsg, qtrue );
 			Com_RunAndTimeServerPacket( &from, &netmsg );
 #else
-			if ( com_sv_running->integer || com_dedicated->integer )
+			if ( com_sv_running->integer || com_dedicated->integer ) {
+				Com_JournalPacket( &from, &netmsg, qtrue );
 				Com_RunAndTimeServerPacket( &from, &netmsg );
-			else
+			} else {
+				Com_JournalPacket( &from, &netmsg, qfalse );
 				CL_PacketEvent( &from, &netmsg );
+			}
 #endif
 		}
 		else
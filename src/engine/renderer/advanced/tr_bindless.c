@@ -125,6 +125,12 @@ void R_ShutdownBindlessResources( void ) {
     
     R_DestroyBindlessPool( &bindlessState.pool );
     
+    if ( bindlessState.dummyImage ) {
+        vkDestroyImageView( vk.device, bindlessState.dummyImageView, NULL );
+        vk_mem_free( (uint64_t)bindlessState.dummyImage );
+        vkDestroyImage( vk.device, bindlessState.dummyImage, NULL );
+    }
+    
     Com_Memset( &bindlessState, 0, sizeof( bindlessState ) );
 }
 
@@ -325,18 +331,7 @@ static void R_InitializeDummyDescriptors( bindlessPool_t *pool ) {
     VkDeviceMemory dummyMemory;
     VK_CHECK( vkCreateImage( vk.device, &imageInfo, NULL, &dummyImage ) );
     
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( vk.device, dummyImage, &memReqs );
-    
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = vk_find_memory_type( memReqs.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT )
-    };
-    
-    VK_CHECK( vkAllocateMemory( vk.device, &allocInfo, NULL, &dummyMemory ) );
-    VK_CHECK( vkBindImageMemory( vk.device, dummyImage, dummyMemory, 0 ) );
+    dummyMemory = vk_mem_bind_image( dummyImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qfalse );
     
     // Create dummy image view
     VkImageViewCreateInfo viewInfo = {
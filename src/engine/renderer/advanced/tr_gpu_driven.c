@@ -211,23 +211,23 @@ static void R_ShutdownMultiDrawIndirect( void ) {
     multiDrawIndirect_t *mdi = &gpuContext.multiDraw;
     
     if ( mdi->drawBuffer ) {
+        vk_mem_free( (uint64_t)mdi->drawBuffer );
         vkDestroyBuffer( vk.device, mdi->drawBuffer, NULL );
-        vkFreeMemory( vk.device, mdi->drawMemory, NULL );
     }
     
     if ( mdi->countBuffer ) {
+        vk_mem_free( (uint64_t)mdi->countBuffer );
         vkDestroyBuffer( vk.device, mdi->countBuffer, NULL );
-        vkFreeMemory( vk.device, mdi->countMemory, NULL );
     }
     
     if ( mdi->instanceBuffer ) {
+        vk_mem_free( (uint64_t)mdi->instanceBuffer );
         vkDestroyBuffer( vk.device, mdi->instanceBuffer, NULL );
-        vkFreeMemory( vk.device, mdi->instanceMemory, NULL );
     }
     
     if ( mdi->visibilityBuffer ) {
+        vk_mem_free( (uint64_t)mdi->visibilityBuffer );
         vkDestroyBuffer( vk.device, mdi->visibilityBuffer, NULL );
-        vkFreeMemory( vk.device, mdi->visibilityMemory, NULL );
     }
     
     if ( mdi->cullPipeline ) {
@@ -505,8 +505,8 @@ Destroy hierarchical-Z buffer
 static void R_DestroyHiZBuffer( void ) {
     if ( gpuContext.hiZBuffer ) {
         vkDestroyImageView( vk.device, gpuContext.hiZBufferView, NULL );
+        vk_mem_free( (uint64_t)gpuContext.hiZBuffer );
         vkDestroyImage( vk.device, gpuContext.hiZBuffer, NULL );
-        vkFreeMemory( vk.device, gpuContext.hiZBufferMemory, NULL );
     }
 }
 
@@ -616,17 +616,8 @@ void R_CreateGPUBuffer( VkBuffer *buffer, VkDeviceMemory *memory, VkDeviceSize s
     
     VK_CHECK( vkCreateBuffer( vk.device, &bufferInfo, NULL, buffer ) );
     
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements( vk.device, *buffer, &memRequirements );
-    
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = vk_find_memory_type( memRequirements.memoryTypeBits, properties )
-    };
-    
-    VK_CHECK( vkAllocateMemory( vk.device, &allocInfo, NULL, memory ) );
-    VK_CHECK( vkBindBufferMemory( vk.device, *buffer, *memory, 0 ) );
+    // sub-allocated, release with vk_mem_free( buffer )
+    *memory = vk_mem_bind_buffer( *buffer, properties, qfalse );
 }
 
 /*
@@ -655,18 +646,8 @@ void R_CreateGPUImage( VkImage *image, VkDeviceMemory *memory, VkImageView *view
     
     VK_CHECK( vkCreateImage( vk.device, &imageInfo, NULL, image ) );
     
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements( vk.device, *image, &memRequirements );
-    
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = vk_find_memory_type( memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT )
-    };
-    
-    VK_CHECK( vkAllocateMemory( vk.device, &allocInfo, NULL, memory ) );
-    VK_CHECK( vkBindImageMemory( vk.device, *image, *memory, 0 ) );
+    // render targets get their own allocation, release with vk_mem_free( image )
+    *memory = vk_mem_bind_image( *image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qtrue );
     
     // Create image view
     VkImageViewCreateInfo viewInfo = {
@@ -748,16 +729,18 @@ static void R_UpdateGPUBuffer( VkCommandBuffer commandBuffer, VkBuffer buffer,
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingMemory;
     
+    if ( buffer == VK_NULL_HANDLE || size == 0 ) {
+        return;
+    }
+    
     R_CreateGPUBuffer( &stagingBuffer, &stagingMemory, size,
                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
     
     // Copy data to staging buffer
-    void *mapped;
-    vkMapMemory( vk.device, stagingMemory, 0, size, 0, &mapped );
-    memcpy( mapped, data, size );
-    vkUnmapMemory( vk.device, stagingMemory );
+    // host-visible sub-allocations are persistently mapped
+    memcpy( vk_mem_mapped( (uint64_t)stagingBuffer ), data, size );
     
     // Copy staging buffer to GPU buffer
     VkBufferCopy copyRegion = { 0, 0, size };
@@ -776,9 +759,8 @@ static void R_UpdateGPUBuffer( VkCommandBuffer commandBuffer, VkBuffer buffer,
                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
                          0, 1, &barrier, 0, NULL, 0, NULL );
     
-    // Clean up staging buffer
-    vkDestroyBuffer( vk.device, stagingBuffer, NULL );
-    vkFreeMemory( vk.device, stagingMemory, NULL );
+    // the copy runs when the frame is submitted, keep the staging buffer until it completed
+    vk_mem_destroy_buffer_deferred( stagingBuffer );
 }
 
 /*
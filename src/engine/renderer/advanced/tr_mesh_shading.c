@@ -113,8 +113,8 @@ void R_ShutdownMeshShading( void ) {
     R_DestroyMeshShadingPipelines();
     
     if ( gpuContext.meshShading.meshletBuffer ) {
+        vk_mem_free( (uint64_t)gpuContext.meshShading.meshletBuffer );
         vkDestroyBuffer( vk.device, gpuContext.meshShading.meshletBuffer, NULL );
-        vkFreeMemory( vk.device, gpuContext.meshShading.meshletMemory, NULL );
     }
 }
 
@@ -463,38 +463,10 @@ void R_UploadMeshShadingData( meshShadingSurface_t *surface ) {
     VkDeviceSize vertexSize = surface->numVertices * sizeof( meshletVertex_t );
     VkDeviceSize primitiveSize = surface->numPrimitives * sizeof( meshletPrimitive_t );
     
-    // Create staging buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    VkDeviceSize totalSize = meshletSize + vertexSize + primitiveSize;
-    
-    R_CreateGPUBuffer( &stagingBuffer, &stagingMemory, totalSize,
-                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-    
-    // Map and copy data
-    void *data;
-    vkMapMemory( vk.device, stagingMemory, 0, totalSize, 0, &data );
-    
-    memcpy( data, surface->meshlets, meshletSize );
-    memcpy( (byte *)data + meshletSize, surface->vertices, vertexSize );
-    memcpy( (byte *)data + meshletSize + vertexSize, surface->primitives, primitiveSize );
-    
-    vkUnmapMemory( vk.device, stagingMemory );
-    
-    // Copy to GPU buffer
-    VkCommandBuffer cmd = vk.cmd->command_buffer;
-    vk_begin_command_buffer( cmd );
-    
-    VkBufferCopy copyRegion = { 0, 0, totalSize };
-    vkCmdCopyBuffer( cmd, stagingBuffer, surface->meshletBuffer, 1, &copyRegion );
-    
-    vk_end_command_buffer( cmd );
-    
-    // Cleanup staging buffer
-    vkDestroyBuffer( vk.device, stagingBuffer, NULL );
-    vkFreeMemory( vk.device, stagingMemory, NULL );
+    // Queue copies through the staging ring, they complete before the next frame renders
+    vk_push_staging_buffer( surface->meshletBuffer, 0, meshletSize, surface->meshlets );
+    vk_push_staging_buffer( surface->meshletBuffer, meshletSize, vertexSize, surface->vertices );
+    vk_push_staging_buffer( surface->meshletBuffer, meshletSize + vertexSize, primitiveSize, surface->primitives );
 }
 
 /*
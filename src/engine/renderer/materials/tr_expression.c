@@ -86,6 +86,115 @@ static void Material_InitExpressionTables(void) {
     tablesInitialized = qtrue;
 }
 
+// Compiled program table, programs live on the hunk with the materials
+#define EXP_PROGRAM_HASH_SIZE   256
+
+static expProgram_t *expProgramHash[EXP_PROGRAM_HASH_SIZE];
+
+static struct {
+    int     numPrograms;
+    int     numMaterials;
+    int     sourceOps;
+    int     foldedOps;
+    int     deadOps;
+    int     parmOps;
+    int     timeOps;
+    int     frameEvals;
+    int     sharedEvals;
+} expStats;
+
+/*
+================
+Material_ApplyExpressionOp
+
+Apply a single expression operation, shared by constant folding and
+program execution so both produce identical results
+================
+*/
+static float Material_ApplyExpressionOp(int op, int tableIndex, float a, float b) {
+    switch (op) {
+    case EXP_OP_ADD:
+        return a + b;
+
+    case EXP_OP_SUBTRACT:
+        return a - b;
+
+    case EXP_OP_MULTIPLY:
+        return a * b;
+
+    case EXP_OP_DIVIDE:
+        return (b != 0) ? a / b : 0;
+
+    case EXP_OP_MOD:
+        return (b != 0) ? fmod(a, b) : 0;
+
+    case EXP_OP_TABLE:
+        return Material_TableLookup(tableIndex, a);
+
+    case EXP_OP_SIN:
+        return sin(a);
+
+    case EXP_OP_COS:
+        return cos(a);
+
+    case EXP_OP_SQUARE:
+        return a * a;
+
+    case EXP_OP_INVERSE:
+        return (a != 0) ? 1.0f / a : 0;
+
+    case EXP_OP_CLAMP:
+        if (a < 0) return 0;
+        if (a > 1) return 1;
+        return a;
+
+    case EXP_OP_MIN:
+        return (a < b) ? a : b;
+
+    case EXP_OP_MAX:
+        return (a > b) ? a : b;
+
+    case EXP_OP_RANDOM:
+        return random();
+
+    default:
+        ri.Printf(PRINT_DEVELOPER, "Unknown expression operation %d\n", op);
+        return 0;
+    }
+}
+
+/*
+================
+Material_RunExpressionInstrs
+================
+*/
+static void Material_RunExpressionInstrs(float *slots, const expInstr_t *instr, int count) {
+    int i;
+
+    for (i = 0; i < count; i++, instr++) {
+        slots[instr->dst] = Material_ApplyExpressionOp(instr->op, instr->table,
+                                                      slots[instr->src[0]], slots[instr->src[1]]);
+    }
+}
+
+/*
+================
+Material_ParmGeneration
+
+Changes whenever one of the parm cvars is modified
+================
+*/
+static int Material_ParmGeneration(void) {
+    int gen = 0;
+
+    if (r_materialParm0) gen += r_materialParm0->modificationCount;
+    if (r_materialParm1) gen += r_materialParm1->modificationCount;
+    if (r_materialParm2) gen += r_materialParm2->modificationCount;
+    if (r_materialParm3) gen += r_materialParm3->modificationCount;
+
+    return gen;
+}
+
 /*
 ================
 Material_EvaluateExpressions
@@ -94,20 +203,16 @@ Evaluate all expressions for a material
 ================
 */
 void Material_EvaluateExpressions(material_t *material, float time) {
-    int i;
+    expProgram_t *prog;
     float *regs;
-    expression_t *exp;
-    float result;
+    int parmGen;
+    int i;
     
     if (!material || material->numExpressions == 0) {
         return;
     }
     
-    // Ensure tables are initialized
-    if (!tablesInitialized) {
-        Material_InitExpressionTables();
-    }
-    
+    prog = material->program;
     regs = material->expressionRegisters;
     
     // Set standard registers
@@ -117,86 +222,370 @@ void Material_EvaluateExpressions(material_t *material, float time) {
     regs[REG_PARM2] = r_materialParm2 ? r_materialParm2->value : 0;
     regs[REG_PARM3] = r_materialParm3 ? r_materialParm3->value : 0;
     
-    // Evaluate all expressions in order
+    // Fully folded at load time
+    if (!prog) {
+        return;
+    }
+    
+    parmGen = Material_ParmGeneration();
+    
+    // Shared programs only run once for a given time
+    if (prog->evaluated && prog->evalTime == time && prog->evalParmGeneration == parmGen) {
+        expStats.sharedEvals++;
+    } else {
+        prog->slots[EXP_SLOT_TIME] = time;
+        
+        if (!prog->evaluated || prog->evalParmGeneration != parmGen) {
+            for (i = 0; i < 4; i++) {
+                prog->slots[EXP_SLOT_PARM0 + i] = regs[REG_PARM0 + i];
+            }
+            Material_RunExpressionInstrs(prog->slots, prog->instrs, prog->numParmInstrs);
+        }
+        
+        Material_RunExpressionInstrs(prog->slots, prog->instrs + prog->numParmInstrs, prog->numTimeInstrs);
+        
+        prog->evalTime = time;
+        prog->evalParmGeneration = parmGen;
+        prog->evaluated = qtrue;
+        expStats.frameEvals++;
+    }
+    
+    for (i = 0; i < prog->numOutputs; i++) {
+        regs[prog->outputReg[i]] = prog->slots[prog->outputSlot[i]];
+    }
+}
+
+// Dependency class of a compiled value
+enum {
+    EXP_KIND_CONST,     // Known at load time
+    EXP_KIND_PARM,      // Depends on parm cvars only
+    EXP_KIND_TIME       // Depends on time or random
+};
+
+typedef struct {
+    expProgram_t    prog;
+    byte            kind[MAX_EXPRESSION_SLOTS];
+    int             numInstrs;
+} expCompiler_t;
+
+/*
+================
+Material_CompilerConstant
+
+Return the slot holding a constant, adding it to the pool if needed
+================
+*/
+static int Material_CompilerConstant(expCompiler_t *c, float value) {
+    int i, slot;
+
+    for (i = 0; i < c->prog.numConstants; i++) {
+        slot = EXP_NUM_INPUT_SLOTS + i;
+        if (!memcmp(&c->prog.constants[slot], &value, sizeof(value))) {
+            return slot;
+        }
+    }
+
+    slot = EXP_NUM_INPUT_SLOTS + c->prog.numConstants++;
+    c->prog.constants[slot] = value;
+    c->kind[slot] = EXP_KIND_CONST;
+    return slot;
+}
+
+/*
+================
+Material_CompilerSimplify
+
+Algebraic identities that make the result an existing slot, or -1
+================
+*/
+static int Material_CompilerSimplify(const expCompiler_t *c, int op, int a, int b) {
+    float cb = (c->kind[b] == EXP_KIND_CONST) ? c->prog.constants[b] : -1;
+    float ca = (c->kind[a] == EXP_KIND_CONST) ? c->prog.constants[a] : -1;
+
+    switch (op) {
+    case EXP_OP_ADD:
+        if (c->kind[b] == EXP_KIND_CONST && cb == 0) return a;
+        if (c->kind[a] == EXP_KIND_CONST && ca == 0) return b;
+        break;
+    case EXP_OP_SUBTRACT:
+        if (c->kind[b] == EXP_KIND_CONST && cb == 0) return a;
+        break;
+    case EXP_OP_MULTIPLY:
+        if (c->kind[b] == EXP_KIND_CONST && cb == 1) return a;
+        if (c->kind[a] == EXP_KIND_CONST && ca == 1) return b;
+        break;
+    case EXP_OP_DIVIDE:
+        if (c->kind[b] == EXP_KIND_CONST && cb == 1) return a;
+        break;
+    case EXP_OP_MIN:
+    case EXP_OP_MAX:
+        if (a == b) return a;
+        break;
+    }
+
+    return -1;
+}
+
+/*
+================
+Material_HashProgram
+================
+*/
+static int Material_HashProgram(const expProgram_t *prog) {
+    const byte *p = (const byte *)prog;
+    int size = (int)((const byte *)prog->slots - p);
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+
+    return (int)(hash & (EXP_PROGRAM_HASH_SIZE - 1));
+}
+
+/*
+================
+Material_CompileExpressions
+
+Compile the parsed expression list into a flat register program
+================
+*/
+void Material_CompileExpressions(material_t *material) {
+    static expCompiler_t c;
+    expInstr_t code[MAX_EXPRESSIONS];
+    int valueSlot[MAX_EXPRESSION_REGISTERS];
+    qboolean written[MAX_EXPRESSION_REGISTERS];
+    qboolean live[MAX_EXPRESSION_SLOTS];
+    int remap[MAX_EXPRESSION_SLOTS];
+    float constants[MAX_EXPRESSION_SLOTS];
+    expProgram_t *prog;
+    expression_t *exp;
+    int i, j, slot, src[2], result, hash, nextSlot, pass;
+    
+    material->program = NULL;
+    
+    if (material->numExpressions <= 0) {
+        return;
+    }
+    
+    if (!tablesInitialized) {
+        Material_InitExpressionTables();
+    }
+    
+    Com_Memset(&c, 0, sizeof(c));
+    Com_Memset(written, 0, sizeof(written));
+    Com_Memset(live, 0, sizeof(live));
+    
+    c.kind[EXP_SLOT_TIME] = EXP_KIND_TIME;
+    for (i = 0; i < 4; i++) {
+        c.kind[EXP_SLOT_PARM0 + i] = EXP_KIND_PARM;
+    }
+    
+    // Registers that are not runtime inputs start with their load-time value
+    for (i = 0; i < MAX_EXPRESSION_REGISTERS; i++) {
+        if (i == REG_TIME) {
+            valueSlot[i] = EXP_SLOT_TIME;
+        } else if (i >= REG_PARM0 && i <= REG_PARM3) {
+            valueSlot[i] = EXP_SLOT_PARM0 + (i - REG_PARM0);
+        } else {
+            valueSlot[i] = Material_CompilerConstant(&c, material->expressionRegisters[i]);
+        }
+    }
+    
+    // Temporaries are numbered after the worst-case constant pool and
+    // compacted once dead code is known
+    nextSlot = EXP_NUM_INPUT_SLOTS + MAX_EXPRESSION_REGISTERS + MAX_EXPRESSIONS * 3;
+    
     for (i = 0; i < material->numExpressions; i++) {
         exp = &material->expressions[i];
-        result = 0;
+        expStats.sourceOps++;
         
-        switch (exp->opType) {
-        case EXP_OP_ADD:
-            result = regs[exp->srcRegister[0]] + regs[exp->srcRegister[1]];
-            break;
-            
-        case EXP_OP_SUBTRACT:
-            result = regs[exp->srcRegister[0]] - regs[exp->srcRegister[1]];
-            break;
-            
-        case EXP_OP_MULTIPLY:
-            result = regs[exp->srcRegister[0]] * regs[exp->srcRegister[1]];
-            break;
-            
-        case EXP_OP_DIVIDE:
-            if (regs[exp->srcRegister[1]] != 0) {
-                result = regs[exp->srcRegister[0]] / regs[exp->srcRegister[1]];
+        for (j = 0; j < 2; j++) {
+            if (exp->srcIsConstant[j]) {
+                src[j] = Material_CompilerConstant(&c, exp->srcConstant[j]);
+            } else {
+                src[j] = valueSlot[exp->srcRegister[j] & (MAX_EXPRESSION_REGISTERS - 1)];
             }
-            break;
+        }
+        if (!Material_OperationNeedsSecondOperand(exp->opType)) {
+            src[1] = src[0];
+        }
+        
+        if (exp->opType != EXP_OP_RANDOM &&
+            c.kind[src[0]] == EXP_KIND_CONST && c.kind[src[1]] == EXP_KIND_CONST) {
+            // Fold at load time
+            result = Material_CompilerConstant(&c, Material_ApplyExpressionOp(exp->opType, exp->tableIndex,
+                                               c.prog.constants[src[0]], c.prog.constants[src[1]]));
+            expStats.foldedOps++;
+        } else if ((result = Material_CompilerSimplify(&c, exp->opType, src[0], src[1])) >= 0) {
+            expStats.foldedOps++;
+        } else {
+            result = nextSlot++;
+            code[c.numInstrs].op = exp->opType;
+            code[c.numInstrs].dst = result;
+            code[c.numInstrs].src[0] = src[0];
+            code[c.numInstrs].src[1] = src[1];
+            code[c.numInstrs].table = (exp->opType == EXP_OP_TABLE) ? exp->tableIndex : 0;
+            c.numInstrs++;
             
-        case EXP_OP_MOD:
-            if (regs[exp->srcRegister[1]] != 0) {
-                result = fmod(regs[exp->srcRegister[0]], regs[exp->srcRegister[1]]);
+            if (exp->opType == EXP_OP_RANDOM) {
+                c.kind[result] = EXP_KIND_TIME;
+            } else {
+                c.kind[result] = MAX(c.kind[src[0]], c.kind[src[1]]);
             }
-            break;
-            
-        case EXP_OP_TABLE:
-            result = Material_TableLookup(exp->tableIndex, regs[exp->srcRegister[0]]);
-            break;
-            
-        case EXP_OP_SIN:
-            result = sin(regs[exp->srcRegister[0]]);
-            break;
-            
-        case EXP_OP_COS:
-            result = cos(regs[exp->srcRegister[0]]);
-            break;
-            
-        case EXP_OP_SQUARE:
-            result = regs[exp->srcRegister[0]] * regs[exp->srcRegister[0]];
-            break;
+        }
+        
+        valueSlot[exp->destRegister] = result;
+        written[exp->destRegister] = qtrue;
+    }
+    
+    // Registers whose final value is known are written once now
+    for (i = 0; i < MAX_EXPRESSION_REGISTERS; i++) {
+        if (!written[i]) {
+            continue;
+        }
+        slot = valueSlot[i];
+        if (c.kind[slot] == EXP_KIND_CONST) {
+            material->expressionRegisters[i] = c.prog.constants[slot];
+        } else {
+            live[slot] = qtrue;
+        }
+    }
+    
+    // Dead-register elimination, walking back from the live outputs
+    for (i = c.numInstrs - 1; i >= 0; i--) {
+        if (!live[code[i].dst]) {
+            code[i].op = 0xFF;
+            expStats.deadOps++;
+            continue;
+        }
+        live[code[i].src[0]] = qtrue;
+        live[code[i].src[1]] = qtrue;
+    }
+    
+    // Compact the constant pool down to the constants still referenced
+    for (i = 0; i < MAX_EXPRESSION_SLOTS; i++) {
+        remap[i] = i;
+    }
+    Com_Memcpy(constants, c.prog.constants, sizeof(constants));
+    Com_Memset(c.prog.constants, 0, sizeof(c.prog.constants));
+    slot = EXP_NUM_INPUT_SLOTS;
+    for (i = 0; i < c.prog.numConstants; i++) {
+        if (live[EXP_NUM_INPUT_SLOTS + i]) {
+            remap[EXP_NUM_INPUT_SLOTS + i] = slot;
+            c.prog.constants[slot++] = constants[EXP_NUM_INPUT_SLOTS + i];
+        }
+    }
+    c.prog.numConstants = slot - EXP_NUM_INPUT_SLOTS;
+    
+    // Emit parm-only instructions first, then the per-frame ones
+    for (pass = EXP_KIND_PARM; pass <= EXP_KIND_TIME; pass++) {
+        for (i = 0; i < c.numInstrs; i++) {
+            expInstr_t *in;
             
-        case EXP_OP_INVERSE:
-            if (regs[exp->srcRegister[0]] != 0) {
-                result = 1.0f / regs[exp->srcRegister[0]];
+            if (code[i].op == 0xFF || c.kind[code[i].dst] != pass) {
+                continue;
             }
-            break;
+            in = &c.prog.instrs[c.prog.numParmInstrs + c.prog.numTimeInstrs];
+            *in = code[i];
+            in->src[0] = remap[in->src[0]];
+            in->src[1] = remap[in->src[1]];
+            remap[code[i].dst] = slot;
+            in->dst = slot++;
             
-        case EXP_OP_CLAMP:
-            result = regs[exp->srcRegister[0]];
-            if (result < 0) result = 0;
-            if (result > 1) result = 1;
-            break;
-            
-        case EXP_OP_MIN:
-            result = (regs[exp->srcRegister[0]] < regs[exp->srcRegister[1]]) ?
-                     regs[exp->srcRegister[0]] : regs[exp->srcRegister[1]];
-            break;
-            
-        case EXP_OP_MAX:
-            result = (regs[exp->srcRegister[0]] > regs[exp->srcRegister[1]]) ?
-                     regs[exp->srcRegister[0]] : regs[exp->srcRegister[1]];
-            break;
-            
-        case EXP_OP_RANDOM:
-            result = random();
-            break;
-            
-        default:
-            ri.Printf(PRINT_DEVELOPER, "Unknown expression operation %d\n", exp->opType);
+            if (pass == EXP_KIND_PARM) {
+                c.prog.numParmInstrs++;
+            } else {
+                c.prog.numTimeInstrs++;
+            }
+        }
+    }
+    c.prog.numSlots = slot;
+    
+    expStats.parmOps += c.prog.numParmInstrs;
+    expStats.timeOps += c.prog.numTimeInstrs;
+    
+    for (i = 0; i < MAX_EXPRESSION_REGISTERS; i++) {
+        if (written[i] && c.kind[valueSlot[i]] != EXP_KIND_CONST) {
+            c.prog.outputReg[c.prog.numOutputs] = i;
+            c.prog.outputSlot[c.prog.numOutputs] = remap[valueSlot[i]];
+            c.prog.numOutputs++;
+        }
+    }
+    
+    // Everything folded away
+    if (!c.prog.numOutputs) {
+        return;
+    }
+    
+    // Share identical programs
+    hash = Material_HashProgram(&c.prog);
+    for (prog = expProgramHash[hash]; prog; prog = prog->hashNext) {
+        if (!memcmp(prog, &c.prog, (const byte *)c.prog.slots - (const byte *)&c.prog)) {
             break;
         }
-        
-        // Store result in destination register
-        regs[exp->destRegister] = result;
     }
+    
+    if (!prog) {
+        prog = ri.Hunk_Alloc(sizeof(*prog), h_low);
+        Com_Memcpy(prog, &c.prog, sizeof(*prog));
+        Com_Memcpy(prog->slots, prog->constants, sizeof(prog->slots));
+        prog->hash = hash;
+        prog->hashNext = expProgramHash[hash];
+        expProgramHash[hash] = prog;
+        expStats.numPrograms++;
+    }
+    
+    prog->refCount++;
+    material->program = prog;
+    expStats.numMaterials++;
+}
+
+/*
+================
+Material_ClearExpressionPrograms
+
+Forget compiled programs, their memory goes away with the hunk
+================
+*/
+void Material_ClearExpressionPrograms(void) {
+    Com_Memset(expProgramHash, 0, sizeof(expProgramHash));
+    Com_Memset(&expStats, 0, sizeof(expStats));
+}
+
+/*
+================
+Material_ExpressionPrograms_f
+
+Print expression compiler statistics
+================
+*/
+void Material_ExpressionPrograms_f(void) {
+    const expProgram_t *prog;
+    int i, shared = 0;
+    
+    for (i = 0; i < EXP_PROGRAM_HASH_SIZE; i++) {
+        for (prog = expProgramHash[i]; prog; prog = prog->hashNext) {
+            if (prog->refCount > 1) {
+                shared++;
+            }
+            if (ri.Cmd_Argc() > 1) {
+                ri.Printf(PRINT_ALL, "%3d refs  %2d parm  %2d time  %2d outputs  %2d consts\n",
+                          prog->refCount, prog->numParmInstrs, prog->numTimeInstrs,
+                          prog->numOutputs, prog->numConstants);
+            }
+        }
+    }
+    
+    ri.Printf(PRINT_ALL, "--- Expression programs ---\n");
+    ri.Printf(PRINT_ALL, "%d materials use %d programs (%d shared)\n",
+              expStats.numMaterials, expStats.numPrograms, shared);
+    ri.Printf(PRINT_ALL, "%d source ops: %d folded, %d dead, %d parm, %d per-frame\n",
+              expStats.sourceOps, expStats.foldedOps, expStats.deadOps,
+              expStats.parmOps, expStats.timeOps);
+    ri.Printf(PRINT_ALL, "%d evaluations, %d served from shared results\n",
+              expStats.frameEvals, expStats.sharedEvals);
 }
 
 /*
@@ -253,10 +642,11 @@ void Material_ParseExpression(material_t *material, char **text) {
     
     // Check if it's a constant or register
     if (token[0] >= '0' && token[0] <= '9') {
-        // Constant value - store in scratch register
+        // Constant value - kept with the operand for the compiler
         exp->constantValue = atof(token);
         exp->srcRegister[0] = REG_SCRATCH0;
-        material->expressionRegisters[REG_SCRATCH0] = exp->constantValue;
+        exp->srcIsConstant[0] = qtrue;
+        exp->srcConstant[0] = exp->constantValue;
     } else {
         exp->srcRegister[0] = Material_ParseRegister(token);
     }
@@ -271,10 +661,11 @@ void Material_ParseExpression(material_t *material, char **text) {
         }
         
         if (token[0] >= '0' && token[0] <= '9') {
-            // Constant value - store in scratch register
+            // Constant value - kept with the operand for the compiler
             exp->constantValue = atof(token);
             exp->srcRegister[1] = REG_SCRATCH1;
-            material->expressionRegisters[REG_SCRATCH1] = exp->constantValue;
+            exp->srcIsConstant[1] = qtrue;
+            exp->srcConstant[1] = exp->constantValue;
         } else {
             exp->srcRegister[1] = Material_ParseRegister(token);
         }
@@ -73,6 +73,9 @@ void R_InitMaterialSystem(void) {
     stringPool.base = ri.Hunk_Alloc(stringPool.size, h_low);
     stringPool.used = 0;
     
+    // Compiled expression programs were allocated on the previous hunk
+    Material_ClearExpressionPrograms();
+    
     // Register CVars
     r_materialParm0 = ri.Cvar_Get("r_materialParm0", "0", 0);
     r_materialParm1 = ri.Cvar_Get("r_materialParm1", "0", 0);
@@ -323,6 +326,9 @@ material_t* Material_Parse(char *name, char **text) {
         }
     }
     
+    // Compile expressions into a shared register program
+    Material_CompileExpressions(material);
+    
     // Add to hash table
     Material_AddToHashTable(material);
     
@@ -718,6 +724,7 @@ Register material console commands
 void Material_RegisterCommands(void) {
     ri.Cmd_AddCommand("materiallist", Material_ListMaterials_f);
     ri.Cmd_AddCommand("materialinfo", Material_Info_f);
+    ri.Cmd_AddCommand("materialprograms", Material_ExpressionPrograms_f);
 }
 
 /*
@@ -777,6 +784,16 @@ void Material_Info_f(void) {
     ri.Printf(PRINT_ALL, "Cull: %s\n", 
               mat->cullType == CT_TWO_SIDED ? "none" :
               mat->cullType == CT_BACK_SIDED ? "back" : "front");
+    if (mat->numExpressions) {
+        ri.Printf(PRINT_ALL, "Expressions: %d", mat->numExpressions);
+        if (mat->program) {
+            ri.Printf(PRINT_ALL, " -> %d parm + %d per-frame instructions (%d refs)\n",
+                      mat->program->numParmInstrs, mat->program->numTimeInstrs,
+                      mat->program->refCount);
+        } else {
+            ri.Printf(PRINT_ALL, " -> folded at load time\n");
+        }
+    }
     
     // Print stage info
     for (i = 0; i < mat->numStages; i++) {
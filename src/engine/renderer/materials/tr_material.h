@@ -122,8 +122,54 @@ typedef struct expression_s {
     int             srcRegister[2];    // Source registers
     float           constantValue;     // Constant operand
     int             tableIndex;        // For table lookups
+    qboolean        srcIsConstant[2];  // Operand is a literal, not a register
+    float           srcConstant[2];    // Literal operand values
 } expression_t;
 
+/*
+Compiled expression programs
+
+Material_CompileExpressions translates a material's expression list into a
+flat program over a private slot file.  Constant sub-expressions are folded
+at load time, instructions that do not reach a register are dropped, and
+instructions that depend only on the parm cvars are split out so they only
+run when those cvars change.  Identical programs are shared between
+materials and evaluated at most once per frame.
+*/
+#define EXP_SLOT_TIME              0
+#define EXP_SLOT_PARM0             1
+#define EXP_NUM_INPUT_SLOTS        5
+#define MAX_EXPRESSION_SLOTS       160
+
+typedef struct expInstr_s {
+    byte            op;                // expOpType_t
+    byte            dst;               // Destination slot
+    byte            src[2];            // Source slots
+    byte            table;             // Table index for EXP_OP_TABLE
+} expInstr_t;
+
+typedef struct expProgram_s {
+    // Program key, compared when sharing programs between materials
+    int             numSlots;
+    int             numConstants;      // Constant slots follow the inputs
+    int             numParmInstrs;     // Run only when parm cvars change
+    int             numTimeInstrs;     // Run every frame
+    int             numOutputs;
+    expInstr_t      instrs[MAX_EXPRESSIONS];
+    byte            outputReg[MAX_EXPRESSION_REGISTERS];
+    byte            outputSlot[MAX_EXPRESSION_REGISTERS];
+    float           constants[MAX_EXPRESSION_SLOTS];
+
+    // Runtime state
+    float           slots[MAX_EXPRESSION_SLOTS];
+    float           evalTime;
+    int             evalParmGeneration;
+    qboolean        evaluated;
+    int             hash;
+    int             refCount;
+    struct expProgram_s *hashNext;
+} expProgram_t;
+
 // Material stage (enhanced from shaderStage_t)
 struct materialStage_s {
     qboolean            active;
@@ -235,6 +281,7 @@ struct material_s {
     float               expressionRegisters[MAX_EXPRESSION_REGISTERS];
     int                 numExpressions;
     int                 numRegisters;
+    expProgram_t        *program;           // Compiled expressions, may be shared
     
     // Optimization
     int                 vertexAttribs;      // Required vertex attributes
@@ -309,6 +356,9 @@ int Material_ParseRegister(const char *token);
 expOpType_t Material_ParseOperation(const char *token);
 qboolean Material_OperationNeedsSecondOperand(expOpType_t op);
 float Material_TableLookup(int tableIndex, float index);
+void Material_CompileExpressions(material_t *material);
+void Material_ClearExpressionPrograms(void);
+void Material_ExpressionPrograms_f(void);
 
 // Optimization
 void Material_OptimizeStages(material_t *material);
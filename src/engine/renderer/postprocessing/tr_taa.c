@@ -253,20 +253,9 @@ static qboolean R_CreateTAAResources( void ) {
         
         VK_CHECK( vkCreateImage( vk.device, &imageInfo, NULL, &taaState.resources.historyImage[i] ) );
         
-        VkMemoryRequirements memReqs;
-        vkGetImageMemoryRequirements( vk.device, taaState.resources.historyImage[i], &memReqs );
-        
-        VkMemoryAllocateInfo allocInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .allocationSize = memReqs.size,
-            .memoryTypeIndex = vk_find_memory_type( memReqs.memoryTypeBits,
-                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT )
-        };
-        
-        VK_CHECK( vkAllocateMemory( vk.device, &allocInfo, NULL, 
-                                    &taaState.resources.historyMemory[i] ) );
-        VK_CHECK( vkBindImageMemory( vk.device, taaState.resources.historyImage[i],
-                                     taaState.resources.historyMemory[i], 0 ) );
+        // resolution-sized targets get a dedicated allocation
+        taaState.resources.historyMemory[i] = vk_mem_bind_image( taaState.resources.historyImage[i],
+                                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qtrue );
         
         VkImageViewCreateInfo viewInfo = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -305,20 +294,8 @@ static qboolean R_CreateTAAResources( void ) {
     VK_CHECK( vkCreateImage( vk.device, &velocityInfo, NULL,
                             &taaState.resources.velocityImage ) );
     
-    VkMemoryRequirements velocityMemReqs;
-    vkGetImageMemoryRequirements( vk.device, taaState.resources.velocityImage, &velocityMemReqs );
-    
-    VkMemoryAllocateInfo velocityAllocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = velocityMemReqs.size,
-        .memoryTypeIndex = vk_find_memory_type( velocityMemReqs.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT )
-    };
-    
-    VK_CHECK( vkAllocateMemory( vk.device, &velocityAllocInfo, NULL,
-                               &taaState.resources.velocityMemory ) );
-    VK_CHECK( vkBindImageMemory( vk.device, taaState.resources.velocityImage,
-                                 taaState.resources.velocityMemory, 0 ) );
+    taaState.resources.velocityMemory = vk_mem_bind_image( taaState.resources.velocityImage,
+                                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qtrue );
     
     VkImageViewCreateInfo velocityViewInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -354,11 +331,10 @@ static void R_DestroyTAAResources( void ) {
             vkDestroyImageView( vk.device, taaState.resources.historyView[i], NULL );
         }
         if ( taaState.resources.historyImage[i] ) {
+            vk_mem_free( (uint64_t)taaState.resources.historyImage[i] );
             vkDestroyImage( vk.device, taaState.resources.historyImage[i], NULL );
         }
-        if ( taaState.resources.historyMemory[i] ) {
-            vkFreeMemory( vk.device, taaState.resources.historyMemory[i], NULL );
-        }
+        taaState.resources.historyMemory[i] = VK_NULL_HANDLE;
     }
     
     // Destroy velocity buffer
@@ -366,11 +342,10 @@ static void R_DestroyTAAResources( void ) {
         vkDestroyImageView( vk.device, taaState.resources.velocityView, NULL );
     }
     if ( taaState.resources.velocityImage ) {
+        vk_mem_free( (uint64_t)taaState.resources.velocityImage );
         vkDestroyImage( vk.device, taaState.resources.velocityImage, NULL );
     }
-    if ( taaState.resources.velocityMemory ) {
-        vkFreeMemory( vk.device, taaState.resources.velocityMemory, NULL );
-    }
+    taaState.resources.velocityMemory = VK_NULL_HANDLE;
 }
 
 /*
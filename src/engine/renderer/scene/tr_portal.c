@@ -37,6 +37,10 @@ static cvar_t *r_lockPVS;
 static cvar_t *r_maxPortalDepth;
 static cvar_t *r_portalDebug;
 static cvar_t *r_areaDebug;
+static cvar_t *r_portalMemo;
+
+// Portal clip results shared by every view rendered in a frame
+static portalMemo_t portalMemo[PORTAL_MEMO_SIZE];
 
 /*
 ================
@@ -67,6 +71,9 @@ void R_InitPortalSystem(void) {
     r_portalDebug = ri.Cvar_Get("r_portalDebug", "0", CVAR_CHEAT);
     r_areaDebug = ri.Cvar_Get("r_areaDebug", "-1", CVAR_CHEAT);
     
+    r_portalMemo = ri.Cvar_Get("r_portalMemo", "1", CVAR_ARCHIVE);
+    ri.Cvar_SetDescription(r_portalMemo, "Reuse portal frustum and scissor results between views of a frame");
+    
     // Initialize grid
     VectorSet(portalSystem.gridMins, -65536, -65536, -65536);
     VectorSet(portalSystem.gridMaxs, 65536, 65536, 65536);
@@ -124,6 +131,10 @@ void R_ClearPortals(void) {
     
     portalSystem.numAreas = 0;
     portalSystem.numPortals = 0;
+    portalSystem.areaPVSValid = qfalse;
+    portalSystem.areaPVSNumAreas = 0;
+    
+    Com_Memset(portalMemo, 0, sizeof(portalMemo));
 }
 
 /*
@@ -316,6 +327,7 @@ void R_SetupVisibilityQuery(visibilityQuery_t *query, const vec3_t origin, const
         query->frustum[i].type = tr.viewParms.frustum[i].type;
         SetPlaneSignbits(&query->frustum[i]);
     }
+    query->numFrustumPlanes = 6;
     
     query->maxPortalDepth = r_maxPortalDepth->integer;
     query->frameNum = tr.frameCount;
@@ -343,6 +355,26 @@ void R_FindVisibleAreas(visibilityQuery_t *query) {
     query->areasChecked = 0;
     query->portalsChecked = 0;
     query->surfacesChecked = 0;
+    query->visCount = ++portalSystem.visCount;
+    
+    // Roll per-frame statistics
+    if (portalSystem.statsFrame != query->frameNum) {
+        portalSystem.lastQueries = portalSystem.queriesThisFrame;
+        portalSystem.lastMemoHits = portalSystem.memoHits;
+        portalSystem.lastMemoMisses = portalSystem.memoMisses;
+        portalSystem.lastPvsPruned = portalSystem.pvsPruned;
+        portalSystem.queriesThisFrame = 0;
+        portalSystem.memoHits = 0;
+        portalSystem.memoMisses = 0;
+        portalSystem.pvsPruned = 0;
+        portalSystem.statsFrame = query->frameNum;
+    }
+    portalSystem.queriesThisFrame++;
+    
+    // Area PVS is built once after the areas of a map are known
+    if (portalSystem.areaPVSNumAreas != portalSystem.numAreas) {
+        R_BuildAreaConnectivity();
+    }
     
     // Handle locked PVS
     if (r_lockPVS->integer && portalSystem.lockedArea) {
@@ -373,6 +405,8 @@ void R_FindVisibleAreas(visibilityQuery_t *query) {
         return;  // No areas to render
     }
     
+    query->viewAreaPVS = R_GetAreaPVS(viewArea);
+    
     // Mark view area visible
     R_MarkAreaVisible(query, viewArea, NULL);
     
@@ -392,6 +426,127 @@ void R_FindVisibleAreas(visibilityQuery_t *query) {
     portalSystem.totalPortalsTraversed = query->numVisiblePortals;
 }
 
+/*
+================
+R_HashBytes
+================
+*/
+static unsigned int R_HashBytes(unsigned int hash, const void *data, int len) {
+    const byte *p = (const byte *)data;
+    
+    while (len-- > 0) {
+        hash = (hash ^ *p++) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+================
+R_PortalMemoHash
+================
+*/
+static unsigned int R_PortalMemoHash(const visibilityQuery_t *query, const portal_t *portal,
+                                     const portalArea_t *from, const int *scissor) {
+    unsigned int hash = 2166136261u;
+    int i;
+    
+    hash = R_HashBytes(hash, &portal->portalNum, sizeof(int));
+    hash = R_HashBytes(hash, &from->areaNum, sizeof(int));
+    hash = R_HashBytes(hash, scissor, sizeof(int) * 4);
+    hash = R_HashBytes(hash, tr.viewParms.or.origin, sizeof(vec3_t));
+    for (i = 0; i < query->numFrustumPlanes; i++) {
+        hash = R_HashBytes(hash, query->frustum[i].normal, sizeof(vec3_t));
+        hash = R_HashBytes(hash, &query->frustum[i].dist, sizeof(float));
+    }
+    
+    return hash;
+}
+
+/*
+================
+R_PortalMemoMatches
+================
+*/
+static qboolean R_PortalMemoMatches(const portalMemo_t *memo, const visibilityQuery_t *query,
+                                    const portal_t *portal, const portalArea_t *from,
+                                    const int *scissor, unsigned int hash) {
+    int i;
+    
+    if (memo->frameNum != query->frameNum || memo->hash != hash ||
+        memo->portalNum != portal->portalNum || memo->fromArea != from->areaNum ||
+        memo->numInPlanes != query->numFrustumPlanes) {
+        return qfalse;
+    }
+    
+    if (memcmp(memo->inScissor, scissor, sizeof(memo->inScissor)) ||
+        !VectorCompare(memo->viewOrigin, tr.viewParms.or.origin)) {
+        return qfalse;
+    }
+    
+    for (i = 0; i < memo->numInPlanes; i++) {
+        if (!VectorCompare(memo->inFrustum[i].normal, query->frustum[i].normal) ||
+            memo->inFrustum[i].dist != query->frustum[i].dist) {
+            return qfalse;
+        }
+    }
+    
+    return qtrue;
+}
+
+/*
+================
+R_ClipThroughPortal
+
+Compute the frustum and scissor seen through a portal, reusing the result
+if any view this frame already clipped the same frustum against it.
+Returns the number of planes written to outFrustum.
+================
+*/
+static int R_ClipThroughPortal(visibilityQuery_t *query, const portal_t *portal,
+                               const portalArea_t *from, int depth,
+                               cplane_t *outFrustum, int *outScissor) {
+    portalMemo_t *memo;
+    unsigned int hash;
+    const int *parentScissor = query->scissorStack[depth];
+    int numPlanes;
+    
+    hash = R_PortalMemoHash(query, portal, from, parentScissor);
+    memo = &portalMemo[hash & (PORTAL_MEMO_SIZE - 1)];
+    
+    if (r_portalMemo->integer && R_PortalMemoMatches(memo, query, portal, from, parentScissor, hash)) {
+        portalSystem.memoHits++;
+        Com_Memcpy(outFrustum, memo->outFrustum, sizeof(cplane_t) * memo->numOutPlanes);
+        Com_Memcpy(outScissor, memo->scissor, sizeof(memo->scissor));
+        return memo->numOutPlanes;
+    }
+    
+    portalSystem.memoMisses++;
+    
+    // Calculate portal scissor rect
+    query->portalDepth = depth;
+    R_PortalScissor(portal, query);
+    Com_Memcpy(outScissor, query->scissorStack[depth + 1], sizeof(int) * 4);
+    
+    // Tighten frustum through portal
+    numPlanes = R_PortalFrustum(portal, query->frustum, query->numFrustumPlanes, outFrustum);
+    
+    if (r_portalMemo->integer) {
+        memo->frameNum = query->frameNum;
+        memo->hash = hash;
+        memo->portalNum = portal->portalNum;
+        memo->fromArea = from->areaNum;
+        memo->numInPlanes = query->numFrustumPlanes;
+        Com_Memcpy(memo->inFrustum, query->frustum, sizeof(cplane_t) * query->numFrustumPlanes);
+        Com_Memcpy(memo->inScissor, parentScissor, sizeof(memo->inScissor));
+        VectorCopy(tr.viewParms.or.origin, memo->viewOrigin);
+        memo->numOutPlanes = numPlanes;
+        Com_Memcpy(memo->outFrustum, outFrustum, sizeof(cplane_t) * numPlanes);
+        Com_Memcpy(memo->scissor, outScissor, sizeof(memo->scissor));
+    }
+    
+    return numPlanes;
+}
+
 /*
 ================
 R_RecursePortals
@@ -403,11 +558,12 @@ void R_RecursePortals(visibilityQuery_t *query, portalArea_t *area, int depth) {
     int i;
     portal_t *portal;
     portalArea_t *nextArea;
-    cplane_t newFrustum[6];
-    cplane_t oldFrustum[6];
-    int oldScissor[4];
+    cplane_t newFrustum[MAX_PORTAL_FRUSTUM_PLANES];
+    cplane_t oldFrustum[MAX_PORTAL_FRUSTUM_PLANES];
+    int oldNumPlanes, newNumPlanes;
+    int scissor[4];
     
-    if (depth >= query->maxPortalDepth) {
+    if (depth >= query->maxPortalDepth || depth + 1 >= MAX_PORTAL_DEPTH) {
         if (depth > portalSystem.maxDepthReached) {
             portalSystem.maxDepthReached = depth;
         }
@@ -426,34 +582,38 @@ void R_RecursePortals(visibilityQuery_t *query, portalArea_t *area, int depth) {
         
         query->portalsChecked++;
         
-        // Check if portal is in frustum
-        if (!R_PortalInFrustum(portal, query->frustum)) {
-            continue;
-        }
-        
         // Get adjacent area
         nextArea = (portal->areas[0] == area) ? portal->areas[1] : portal->areas[0];
         
-        if (!nextArea || nextArea->visFrame == query->frameNum) {
+        if (!nextArea || nextArea->visCount == query->visCount) {
             continue;  // Already processed or invalid
         }
         
-        // Save current scissor
-        Com_Memcpy(oldScissor, query->scissorStack[depth], sizeof(oldScissor));
+        // Areas the view area can never see are not worth clipping against
+        if (query->viewAreaPVS &&
+            !(query->viewAreaPVS[nextArea->areaNum >> 3] & (1 << (nextArea->areaNum & 7)))) {
+            portalSystem.pvsPruned++;
+            continue;
+        }
+        
+        // Check if portal is in frustum
+        if (!R_PortalInFrustum(portal, query->frustum, query->numFrustumPlanes)) {
+            continue;
+        }
         
-        // Calculate portal scissor rect
-        R_PortalScissor(portal, query);
+        newNumPlanes = R_ClipThroughPortal(query, portal, area, depth, newFrustum, scissor);
         
         // Check if scissor is valid
-        if (query->scissorStack[depth + 1][2] <= 0 || 
-            query->scissorStack[depth + 1][3] <= 0) {
+        if (scissor[2] <= 0 || scissor[3] <= 0) {
             continue;  // Portal not visible on screen
         }
+        Com_Memcpy(query->scissorStack[depth + 1], scissor, sizeof(scissor));
         
         // Tighten frustum through portal
-        Com_Memcpy(oldFrustum, query->frustum, sizeof(cplane_t) * 6);
-        R_PortalFrustum(portal, query->frustum, newFrustum);
-        Com_Memcpy(query->frustum, newFrustum, sizeof(cplane_t) * 6);
+        oldNumPlanes = query->numFrustumPlanes;
+        Com_Memcpy(oldFrustum, query->frustum, sizeof(cplane_t) * oldNumPlanes);
+        Com_Memcpy(query->frustum, newFrustum, sizeof(cplane_t) * newNumPlanes);
+        query->numFrustumPlanes = newNumPlanes;
         
         // Add portal to chain
         query->portalChain[depth] = portal;
@@ -471,9 +631,9 @@ void R_RecursePortals(visibilityQuery_t *query, portalArea_t *area, int depth) {
         // Recurse into next area
         R_RecursePortals(query, nextArea, depth + 1);
         
-        // Restore frustum and scissor
-        Com_Memcpy(query->frustum, oldFrustum, sizeof(cplane_t) * 6);
-        Com_Memcpy(query->scissorStack[depth + 1], oldScissor, sizeof(oldScissor));
+        // Restore frustum
+        Com_Memcpy(query->frustum, oldFrustum, sizeof(cplane_t) * oldNumPlanes);
+        query->numFrustumPlanes = oldNumPlanes;
     }
 }
 
@@ -484,10 +644,10 @@ R_PortalInFrustum
 Check if portal intersects view frustum
 ================
 */
-qboolean R_PortalInFrustum(const portal_t *portal, const cplane_t frustum[6]) {
+qboolean R_PortalInFrustum(const portal_t *portal, const cplane_t *frustum, int numPlanes) {
     int i, j;
     
-    for (i = 0; i < 6; i++) {
+    for (i = 0; i < numPlanes; i++) {
         const cplane_t *plane = &frustum[i];
         int numBehind = 0;
         
@@ -510,33 +670,27 @@ qboolean R_PortalInFrustum(const portal_t *portal, const cplane_t frustum[6]) {
 ================
 R_PortalFrustum
 
-Create tightened frustum through portal
+Create tightened frustum through portal, returns the plane count
 ================
 */
-void R_PortalFrustum(const portal_t *portal, const cplane_t inFrustum[6], cplane_t outFrustum[6]) {
+int R_PortalFrustum(const portal_t *portal, const cplane_t *inFrustum, int numInPlanes, cplane_t *outFrustum) {
     int i, j;
-    vec3_t edges[MAX_PORTAL_POINTS][2];
-    int numEdges;
+    int numPlanes;
     
-    // Copy original frustum
-    Com_Memcpy(outFrustum, inFrustum, sizeof(cplane_t) * 6);
-    
-    // Build edge list
-    numEdges = 0;
-    for (i = 0; i < portal->numPoints; i++) {
-        j = (i + 1) % portal->numPoints;
-        VectorCopy(portal->points[i], edges[numEdges][0]);
-        VectorCopy(portal->points[j], edges[numEdges][1]);
-        numEdges++;
-    }
+    // Keep the original view frustum, edge planes from earlier portals are replaced
+    numPlanes = MIN(numInPlanes, 6);
+    Com_Memcpy(outFrustum, inFrustum, sizeof(cplane_t) * numPlanes);
     
     // Create planes from view origin through each edge
-    for (i = 0; i < numEdges && i < 4; i++) {  // Limit to 4 additional planes
+    for (i = 0; i < portal->numPoints && numPlanes < MAX_PORTAL_FRUSTUM_PLANES; i++) {
         vec3_t v1, v2, normal;
         float dist;
+        cplane_t *plane;
+        
+        j = (i + 1) % portal->numPoints;
         
-        VectorSubtract(edges[i][0], tr.viewParms.or.origin, v1);
-        VectorSubtract(edges[i][1], tr.viewParms.or.origin, v2);
+        VectorSubtract(portal->points[i], tr.viewParms.or.origin, v1);
+        VectorSubtract(portal->points[j], tr.viewParms.or.origin, v2);
         CrossProduct(v1, v2, normal);
         
         if (VectorNormalize(normal) < 0.001f) {
@@ -545,12 +699,20 @@ void R_PortalFrustum(const portal_t *portal, const cplane_t inFrustum[6], cplane
         
         dist = DotProduct(normal, tr.viewParms.or.origin);
         
-        // Add as additional frustum plane
-        VectorCopy(normal, outFrustum[6 + i].normal);
-        outFrustum[6 + i].dist = dist;
-        outFrustum[6 + i].type = PlaneTypeForNormal(normal);
-        SetPlaneSignbits(&outFrustum[6 + i]);
+        // Face the plane towards the portal interior
+        if (DotProduct(normal, portal->center) - dist < 0) {
+            VectorNegate(normal, normal);
+            dist = -dist;
+        }
+        
+        plane = &outFrustum[numPlanes++];
+        VectorCopy(normal, plane->normal);
+        plane->dist = dist;
+        plane->type = PlaneTypeForNormal(normal);
+        SetPlaneSignbits(plane);
     }
+    
+    return numPlanes;
 }
 
 /*
@@ -580,7 +742,7 @@ void R_PortalScissor(const portal_t *portal, visibilityQuery_t *query) {
     
     // Project portal points to screen
     for (i = 0; i < portal->numPoints; i++) {
-        if (R_ProjectPointToScreen(portal->points[i], &projected[0], &projected[1])) {
+        if (R_ProjectPointToScreen(portal->points[i], projected)) {
             if (projected[0] < minX) minX = projected[0];
             if (projected[0] > maxX) maxX = projected[0];
             if (projected[1] < minY) minY = projected[1];
@@ -618,10 +780,11 @@ Mark an area as visible in the query
 ================
 */
 void R_MarkAreaVisible(visibilityQuery_t *query, portalArea_t *area, portal_t *portal) {
-    if (!area || area->visFrame == query->frameNum) {
+    if (!area || area->visCount == query->visCount) {
         return;  // Already marked
     }
     
+    area->visCount = query->visCount;
     area->visFrame = query->frameNum;
     area->queryFrame = query->frameNum;
     
@@ -853,6 +1016,97 @@ void R_DrawAreaBounds(const portalArea_t *area) {
     }
 }
 
+/*
+================
+R_BuildAreaConnectivity
+
+Build the area-to-area potentially visible sets from the world cluster PVS.
+An area can see another if any cluster of the first sees any cluster of the
+second; portal recursion never enters an area the view area cannot see.
+================
+*/
+void R_BuildAreaConnectivity(void) {
+    mnode_t *leaf;
+    byte *clusters;
+    int areaBytes, clusterBytes;
+    int i, a, numLinks = 0;
+    
+    portalSystem.areaPVSValid = qfalse;
+    portalSystem.areaPVSNumAreas = portalSystem.numAreas;
+    
+    if (!tr.world || !tr.world->vis || portalSystem.numAreas <= 0) {
+        return;
+    }
+    
+    areaBytes = (portalSystem.numAreas + 7) >> 3;
+    clusterBytes = tr.world->clusterBytes;
+    clusters = ri.Hunk_AllocateTempMemory(clusterBytes);
+    
+    for (a = 0; a < portalSystem.numAreas; a++) {
+        portalArea_t *area = &portalSystem.areas[a];
+        
+        if (area->areaPVS) {
+            Z_Free(area->areaPVS);
+        }
+        area->areaPVS = Z_Malloc(areaBytes);
+        Com_Memset(area->areaPVS, 0, areaBytes);
+        
+        // Gather every cluster visible from a leaf of this area
+        Com_Memset(clusters, 0, clusterBytes);
+        for (i = tr.world->numDecisionNodes, leaf = tr.world->nodes + i; i < tr.world->numnodes; i++, leaf++) {
+            const byte *vis;
+            int j;
+            
+            if (leaf->area != area->areaNum || leaf->cluster < 0 || leaf->cluster >= tr.world->numClusters) {
+                continue;
+            }
+            vis = tr.world->vis + leaf->cluster * clusterBytes;
+            for (j = 0; j < clusterBytes; j++) {
+                clusters[j] |= vis[j];
+            }
+        }
+        
+        // Any leaf in a visible cluster makes its area visible
+        for (i = tr.world->numDecisionNodes, leaf = tr.world->nodes + i; i < tr.world->numnodes; i++, leaf++) {
+            if (leaf->cluster < 0 || leaf->cluster >= tr.world->numClusters ||
+                leaf->area < 0 || leaf->area >= portalSystem.numAreas) {
+                continue;
+            }
+            if (clusters[leaf->cluster >> 3] & (1 << (leaf->cluster & 7))) {
+                area->areaPVS[leaf->area >> 3] |= 1 << (leaf->area & 7);
+            }
+        }
+        
+        // An area always sees itself
+        area->areaPVS[a >> 3] |= 1 << (a & 7);
+        
+        for (i = 0; i < portalSystem.numAreas; i++) {
+            if (area->areaPVS[i >> 3] & (1 << (i & 7))) {
+                numLinks++;
+            }
+        }
+    }
+    
+    ri.Hunk_FreeTempMemory(clusters);
+    portalSystem.areaPVSValid = qtrue;
+    
+    ri.Printf(PRINT_DEVELOPER, "Area PVS: %d areas, %d visible pairs\n", portalSystem.numAreas, numLinks);
+}
+
+/*
+================
+R_GetAreaPVS
+
+Precomputed area visibility row, NULL when not available
+================
+*/
+byte* R_GetAreaPVS(const portalArea_t *area) {
+    if (!area || !portalSystem.areaPVSValid) {
+        return NULL;
+    }
+    return area->areaPVS;
+}
+
 /*
 ================
 R_PrintPortalStats
@@ -861,10 +1115,18 @@ Print portal system statistics
 ================
 */
 void R_PrintPortalStats(void) {
+    int lookups = portalSystem.lastMemoHits + portalSystem.lastMemoMisses;
+    
     ri.Printf(PRINT_ALL, "Portal System Statistics:\n");
     ri.Printf(PRINT_ALL, "  Areas: %d / %d\n", portalSystem.numAreas, MAX_PORTAL_AREAS);
     ri.Printf(PRINT_ALL, "  Portals: %d / %d\n", portalSystem.numPortals, MAX_PORTALS);
     ri.Printf(PRINT_ALL, "  Visible areas: %d\n", portalSystem.totalAreasVisible);
     ri.Printf(PRINT_ALL, "  Portals traversed: %d\n", portalSystem.totalPortalsTraversed);
     ri.Printf(PRINT_ALL, "  Max depth reached: %d\n", portalSystem.maxDepthReached);
-}
\ No newline at end of file
+    ri.Printf(PRINT_ALL, "  Area PVS: %s\n", portalSystem.areaPVSValid ? "precomputed" : "none");
+    ri.Printf(PRINT_ALL, "  Last frame: %d queries, %d portals pruned by area PVS\n",
+              portalSystem.lastQueries, portalSystem.lastPvsPruned);
+    ri.Printf(PRINT_ALL, "  Clip memo: %d hits / %d lookups (%.1f%%)\n",
+              portalSystem.lastMemoHits, lookups,
+              lookups ? 100.0f * portalSystem.lastMemoHits / lookups : 0.0f);
+}
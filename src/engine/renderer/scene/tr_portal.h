@@ -32,6 +32,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 #define MAX_PORTAL_POINTS       32
 #define MAX_PORTAL_DEPTH        16
 #define MAX_VISIBLE_AREAS       256
+#define MAX_PORTAL_FRUSTUM_PLANES   10  // View frustum plus 4 portal edge planes
+#define PORTAL_MEMO_SIZE        1024    // Per-frame portal clip cache entries
 
 // Forward declarations
 typedef struct portalArea_s portalArea_t;
@@ -112,6 +114,7 @@ typedef struct portalArea_s {
     // Visibility
     byte            *areaPVS;           // Which areas are potentially visible
     int             visFrame;           // Last frame this was visible
+    int             visCount;           // Last query that reached this area
     int             queryFrame;         // Last frame this was queried
     qboolean        skyArea;            // Contains sky surfaces
     qboolean        outsideArea;        // Exterior area
@@ -137,7 +140,9 @@ typedef struct visibilityQuery_s {
     float           nearPlane, farPlane;
     
     // Frustum planes
-    cplane_t        frustum[6];
+    cplane_t        frustum[MAX_PORTAL_FRUSTUM_PLANES];
+    int             numFrustumPlanes;
+    const byte      *viewAreaPVS;       // Precomputed area PVS of the view area
     
     // Portal traversal state
     portal_t        *portalChain[MAX_PORTAL_DEPTH];
@@ -159,8 +164,28 @@ typedef struct visibilityQuery_s {
     
     // Current frame
     int             frameNum;
+    int             visCount;           // Unique per query, several per frame
 } visibilityQuery_t;
 
+// Cached portal clip result, valid for one frame
+typedef struct portalMemo_s {
+    int             frameNum;
+    int             portalNum;
+    int             fromArea;
+    unsigned int    hash;
+    
+    // Key: incoming frustum, parent scissor and view origin
+    cplane_t        inFrustum[MAX_PORTAL_FRUSTUM_PLANES];
+    int             numInPlanes;
+    int             inScissor[4];
+    vec3_t          viewOrigin;
+    
+    // Result
+    cplane_t        outFrustum[MAX_PORTAL_FRUSTUM_PLANES];
+    int             numOutPlanes;
+    int             scissor[4];
+} portalMemo_t;
+
 // Portal system state
 typedef struct portalSystem_s {
     // Areas and portals
@@ -182,6 +207,18 @@ typedef struct portalSystem_s {
     int             totalAreasVisible;
     int             totalPortalsTraversed;
     int             maxDepthReached;
+    int             visCount;           // Query counter
+    int             statsFrame;
+    int             queriesThisFrame;
+    int             memoHits;
+    int             memoMisses;
+    int             pvsPruned;
+    int             lastQueries;        // Previous frame totals
+    int             lastMemoHits;
+    int             lastMemoMisses;
+    int             lastPvsPruned;
+    qboolean        areaPVSValid;
+    int             areaPVSNumAreas;    // Area count the PVS was built for
     
     // Debugging
     qboolean        showPortals;
@@ -220,8 +257,8 @@ qboolean R_AreaVisible(const portalArea_t *area, const visibilityQuery_t *query)
 qboolean R_PortalVisible(const portal_t *portal, const visibilityQuery_t *query);
 
 // Frustum operations
-qboolean R_PortalInFrustum(const portal_t *portal, const cplane_t frustum[6]);
-void R_PortalFrustum(const portal_t *portal, const cplane_t inFrustum[6], cplane_t outFrustum[6]);
+qboolean R_PortalInFrustum(const portal_t *portal, const cplane_t *frustum, int numPlanes);
+int R_PortalFrustum(const portal_t *portal, const cplane_t *inFrustum, int numInPlanes, cplane_t *outFrustum);
 void R_PortalScissor(const portal_t *portal, visibilityQuery_t *query);
 void R_ClipFrustumToPortal(const portal_t *portal, cplane_t frustum[6]);
 
@@ -2,6 +2,13 @@
 #include "vk.h"
 #include <stdio.h>  // For file operations
 
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
 #if defined (_DEBUG)
 #if defined (_WIN32)
 #define USE_VK_VALIDATION
@@ -32,7 +39,7 @@ static PFN_vkEnumeratePhysicalDevices					qvkEnumeratePhysicalDevices;
 static PFN_vkGetDeviceProcAddr							qvkGetDeviceProcAddr;
 static PFN_vkGetPhysicalDeviceFeatures					qvkGetPhysicalDeviceFeatures;
 static PFN_vkGetPhysicalDeviceFormatProperties			qvkGetPhysicalDeviceFormatProperties;
-static PFN_vkGetPhysicalDeviceMemoryProperties			qvkGetPhysicalDeviceMemoryProperties;
+PFN_vkGetPhysicalDeviceMemoryProperties					qvkGetPhysicalDeviceMemoryProperties;
 static PFN_vkGetPhysicalDeviceProperties				qvkGetPhysicalDeviceProperties;
 static PFN_vkGetPhysicalDeviceQueueFamilyProperties		qvkGetPhysicalDeviceQueueFamilyProperties;
 static PFN_vkDestroySurfaceKHR							qvkDestroySurfaceKHR;
@@ -44,17 +51,17 @@ static PFN_vkGetPhysicalDeviceSurfaceSupportKHR			qvkGetPhysicalDeviceSurfaceSup
 static PFN_vkCreateDebugReportCallbackEXT				qvkCreateDebugReportCallbackEXT;
 static PFN_vkDestroyDebugReportCallbackEXT				qvkDestroyDebugReportCallbackEXT;
 #endif
-static PFN_vkAllocateCommandBuffers						qvkAllocateCommandBuffers;
+PFN_vkAllocateCommandBuffers							qvkAllocateCommandBuffers;
 static PFN_vkAllocateDescriptorSets						qvkAllocateDescriptorSets;
-static PFN_vkAllocateMemory								qvkAllocateMemory;
-static PFN_vkBeginCommandBuffer							qvkBeginCommandBuffer;
-static PFN_vkBindBufferMemory							qvkBindBufferMemory;
-static PFN_vkBindImageMemory							qvkBindImageMemory;
-static PFN_vkCmdBeginRenderPass							qvkCmdBeginRenderPass;
-static PFN_vkCmdBindDescriptorSets						qvkCmdBindDescriptorSets;
-static PFN_vkCmdBindIndexBuffer							qvkCmdBindIndexBuffer;
-static PFN_vkCmdBindPipeline							qvkCmdBindPipeline;
-static PFN_vkCmdBindVertexBuffers						qvkCmdBindVertexBuffers;
+PFN_vkAllocateMemory									qvkAllocateMemory;
+PFN_vkBeginCommandBuffer								qvkBeginCommandBuffer;
+PFN_vkBindBufferMemory									qvkBindBufferMemory;
+PFN_vkBindImageMemory									qvkBindImageMemory;
+PFN_vkCmdBeginRenderPass								qvkCmdBeginRenderPass;
+PFN_vkCmdBindDescriptorSets								qvkCmdBindDescriptorSets;
+PFN_vkCmdBindIndexBuffer								qvkCmdBindIndexBuffer;
+PFN_vkCmdBindPipeline									qvkCmdBindPipeline;
+PFN_vkCmdBindVertexBuffers								qvkCmdBindVertexBuffers;
 static PFN_vkCmdBlitImage								qvkCmdBlitImage;
 static PFN_vkCmdClearAttachments						qvkCmdClearAttachments;
 static PFN_vkCmdCopyBuffer								qvkCmdCopyBuffer;
@@ -62,15 +69,17 @@ static PFN_vkCmdCopyBufferToImage						qvkCmdCopyBufferToImage;
 static PFN_vkCmdCopyImage								qvkCmdCopyImage;
 static PFN_vkCmdDraw									qvkCmdDraw;
 static PFN_vkCmdDrawIndexed								qvkCmdDrawIndexed;
+static PFN_vkCmdDrawIndexedIndirect						qvkCmdDrawIndexedIndirect;
 static PFN_vkCmdEndRenderPass							qvkCmdEndRenderPass;
+PFN_vkCmdExecuteCommands								qvkCmdExecuteCommands;
 static PFN_vkCmdNextSubpass								qvkCmdNextSubpass;
 static PFN_vkCmdPipelineBarrier							qvkCmdPipelineBarrier;
-static PFN_vkCmdPushConstants							qvkCmdPushConstants;
+PFN_vkCmdPushConstants									qvkCmdPushConstants;
 static PFN_vkCmdSetDepthBias							qvkCmdSetDepthBias;
-static PFN_vkCmdSetScissor								qvkCmdSetScissor;
-static PFN_vkCmdSetViewport								qvkCmdSetViewport;
+PFN_vkCmdSetScissor										qvkCmdSetScissor;
+PFN_vkCmdSetViewport									qvkCmdSetViewport;
 static PFN_vkCreateBuffer								qvkCreateBuffer;
-static PFN_vkCreateCommandPool							qvkCreateCommandPool;
+PFN_vkCreateCommandPool									qvkCreateCommandPool;
 static PFN_vkCreateDescriptorPool						qvkCreateDescriptorPool;
 static PFN_vkCreateDescriptorSetLayout					qvkCreateDescriptorSetLayout;
 static PFN_vkCreateFence								qvkCreateFence;
@@ -84,8 +93,8 @@ static PFN_vkCreateRenderPass							qvkCreateRenderPass;
 static PFN_vkCreateSampler								qvkCreateSampler;
 static PFN_vkCreateSemaphore							qvkCreateSemaphore;
 static PFN_vkCreateShaderModule							qvkCreateShaderModule;
-static PFN_vkDestroyBuffer								qvkDestroyBuffer;
-static PFN_vkDestroyCommandPool							qvkDestroyCommandPool;
+PFN_vkDestroyBuffer										qvkDestroyBuffer;
+PFN_vkDestroyCommandPool								qvkDestroyCommandPool;
 static PFN_vkDestroyDescriptorPool						qvkDestroyDescriptorPool;
 static PFN_vkDestroyDescriptorSetLayout					qvkDestroyDescriptorSetLayout;
 static PFN_vkDestroyDevice								qvkDestroyDevice;
@@ -95,31 +104,34 @@ static PFN_vkDestroyImage								qvkDestroyImage;
 static PFN_vkDestroyImageView							qvkDestroyImageView;
 static PFN_vkDestroyPipeline							qvkDestroyPipeline;
 static PFN_vkDestroyPipelineCache						qvkDestroyPipelineCache;
+static PFN_vkGetPipelineCacheData						qvkGetPipelineCacheData;
 static PFN_vkDestroyPipelineLayout						qvkDestroyPipelineLayout;
 static PFN_vkDestroyRenderPass							qvkDestroyRenderPass;
 static PFN_vkDestroySampler								qvkDestroySampler;
 static PFN_vkDestroySemaphore							qvkDestroySemaphore;
 static PFN_vkDestroyShaderModule						qvkDestroyShaderModule;
 static PFN_vkDeviceWaitIdle								qvkDeviceWaitIdle;
-static PFN_vkEndCommandBuffer							qvkEndCommandBuffer;
+PFN_vkEndCommandBuffer									qvkEndCommandBuffer;
 static PFN_vkFlushMappedMemoryRanges					qvkFlushMappedMemoryRanges;
 static PFN_vkFreeCommandBuffers							qvkFreeCommandBuffers;
 static PFN_vkFreeDescriptorSets							qvkFreeDescriptorSets;
-static PFN_vkFreeMemory									qvkFreeMemory;
-static PFN_vkGetBufferMemoryRequirements				qvkGetBufferMemoryRequirements;
+PFN_vkFreeMemory										qvkFreeMemory;
+PFN_vkGetBufferMemoryRequirements						qvkGetBufferMemoryRequirements;
 static PFN_vkGetDeviceQueue								qvkGetDeviceQueue;
-static PFN_vkGetImageMemoryRequirements					qvkGetImageMemoryRequirements;
+PFN_vkGetImageMemoryRequirements						qvkGetImageMemoryRequirements;
 static PFN_vkGetImageSubresourceLayout					qvkGetImageSubresourceLayout;
 static PFN_vkInvalidateMappedMemoryRanges				qvkInvalidateMappedMemoryRanges;
-static PFN_vkMapMemory									qvkMapMemory;
+PFN_vkMapMemory											qvkMapMemory;
 static PFN_vkQueueSubmit								qvkQueueSubmit;
 static PFN_vkQueueWaitIdle								qvkQueueWaitIdle;
 static PFN_vkResetCommandBuffer							qvkResetCommandBuffer;
+PFN_vkResetCommandPool									qvkResetCommandPool;
 static PFN_vkResetDescriptorPool						qvkResetDescriptorPool;
 static PFN_vkResetFences								qvkResetFences;
-static PFN_vkUnmapMemory								qvkUnmapMemory;
+PFN_vkUnmapMemory										qvkUnmapMemory;
 static PFN_vkUpdateDescriptorSets						qvkUpdateDescriptorSets;
 static PFN_vkWaitForFences								qvkWaitForFences;
+static PFN_vkGetFenceStatus								qvkGetFenceStatus;
 static PFN_vkAcquireNextImageKHR						qvkAcquireNextImageKHR;
 static PFN_vkCreateSwapchainKHR							qvkCreateSwapchainKHR;
 static PFN_vkDestroySwapchainKHR						qvkDestroySwapchainKHR;
@@ -1024,75 +1036,249 @@ static void vk_create_render_passes( void )
 }
 
 
-static void allocate_and_bind_image_memory(VkImage image) {
-	VkMemoryRequirements memory_requirements;
-	VkDeviceSize alignment;
-	ImageChunk *chunk;
-	int i;
+#ifdef USE_UPLOAD_QUEUE
+/*
+==============================================================================
 
-	qvkGetImageMemoryRequirements(vk.device, image, &memory_requirements);
+STAGING RING
 
-	if ( memory_requirements.size > vk.image_chunk_size ) {
-		ri.Error( ERR_FATAL, "Vulkan: could not allocate memory, image is too large (%ikbytes).",
-			(int)(memory_requirements.size/1024) );
-	}
+The staging buffer is persistently mapped and used as a ring. Uploads are
+recorded into one of NUM_STAGING_SLOTS command buffers; each submitted slot
+owns the ring range written since the previous submission and releases it
+once its fence is signalled, so new uploads never overwrite data the GPU
+may still be reading and never have to wait for a submission to complete
+unless the ring is actually full.
 
-	chunk = NULL;
+==============================================================================
+*/
 
-	// Try to find an existing chunk of sufficient capacity.
-	alignment = memory_requirements.alignment;
-	for ( i = 0; i < vk_world.num_image_chunks; i++ ) {
-		// ensure that memory region has proper alignment
-		VkDeviceSize offset = PAD( vk_world.image_chunks[i].used, alignment );
+/*
+================
+vk_staging_retire
 
-		if ( offset + memory_requirements.size <= vk.image_chunk_size ) {
-			chunk = &vk_world.image_chunks[i];
-			chunk->used = offset + memory_requirements.size;
-			break;
+Releases ring space of completed submissions,
+blocks on the oldest one if wait is set
+================
+*/
+static void vk_staging_retire( qboolean wait )
+{
+	VkResult res;
+	uint32_t n;
+
+	while ( vk.staging_buffer.pending ) {
+		n = vk.staging_buffer.oldest;
+		if ( wait ) {
+			res = qvkWaitForFences( vk.device, 1, &vk.staging_buffer.slots[n].fence, VK_TRUE, 5 * 1000000000ULL );
+			wait = qfalse;
+		} else {
+			res = qvkGetFenceStatus( vk.device, vk.staging_buffer.slots[n].fence );
+			if ( res == VK_NOT_READY ) {
+				break;
+			}
+		}
+		if ( res != VK_SUCCESS ) {
+			ri.Error( ERR_FATAL, "Vulkan: %s failed with %s", __func__, vk_result_string( res ) );
 		}
+		qvkResetFences( vk.device, 1, &vk.staging_buffer.slots[n].fence );
+		VK_CHECK( qvkResetCommandBuffer( vk.staging_buffer.slots[n].cmd, 0 ) );
+		vk.staging_buffer.tail = vk.staging_buffer.slots[n].end;
+		vk.staging_buffer.oldest = ( n + 1 ) % NUM_STAGING_SLOTS;
+		vk.staging_buffer.pending--;
+	}
+
+	if ( vk.staging_buffer.pending == 0 && vk.staging_buffer.head == vk.staging_buffer.slots[ vk.staging_buffer.slot ].end ) {
+		// nothing owned by the GPU or recorded yet - rewind for the largest contiguous block
+		vk.staging_buffer.head = 0;
+		vk.staging_buffer.tail = 0;
+		vk.staging_buffer.slots[ vk.staging_buffer.slot ].end = 0;
+	}
+}
+
+
+/*
+================
+vk_staging_wait_all
+================
+*/
+static void vk_staging_wait_all( void )
+{
+	while ( vk.staging_buffer.pending ) {
+		vk_staging_retire( qtrue );
+	}
+	vk.staging_buffer.unsynced = qfalse;
+}
+
+
+/*
+================
+vk_staging_begin
+
+Makes sure a staging command buffer is being recorded
+================
+*/
+static VkCommandBuffer vk_staging_begin( void )
+{
+	VkCommandBufferBeginInfo begin_info;
+	VkMemoryBarrier barrier;
+	VkCommandBuffer cmd;
+
+	if ( vk.staging_buffer.recording ) {
+		return vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd;
+	}
+
+	if ( vk.staging_buffer.pending == NUM_STAGING_SLOTS ) {
+		// all slots are in flight
+		vk_staging_retire( qtrue );
+		vk.staging_buffer.stalls++;
+		vk.staging_buffer.frame_stalls++;
+	}
+
+	cmd = vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd;
+
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.pNext = NULL;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begin_info.pInheritanceInfo = NULL;
+	VK_CHECK( qvkBeginCommandBuffer( cmd, &begin_info ) );
+
+	// order transfers against the ones still in flight from previous slots
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.pNext = NULL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	qvkCmdPipelineBarrier( cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL );
+
+	vk.staging_buffer.recording = qtrue;
+
+	return cmd;
+}
+
+
+/*
+================
+vk_staging_flush_copies
+================
+*/
+static void vk_staging_flush_copies( void )
+{
+	if ( vk.staging_buffer.num_copies ) {
+		qvkCmdCopyBuffer( vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd, vk.staging_buffer.handle,
+			vk.staging_buffer.copy_dst, vk.staging_buffer.num_copies, vk.staging_buffer.copies );
+		vk.staging_buffer.num_copies = 0;
 	}
+}
+
 
-	// Allocate a new chunk in case we couldn't find suitable existing chunk.
-	if (chunk == NULL) {
-		VkMemoryAllocateInfo alloc_info;
-		VkDeviceMemory memory;
+/*
+================
+vk_staging_copy_buffer
+
+Queues a copy from the staging ring, consecutive regions for the same
+destination buffer are merged and issued with a single vkCmdCopyBuffer
+================
+*/
+void vk_staging_copy_buffer( VkBuffer buffer, VkDeviceSize src_offset, VkDeviceSize dst_offset, VkDeviceSize size )
+{
+	VkBufferMemoryBarrier barrier;
+	VkBufferCopy *region;
+	uint32_t i;
 
-		if (vk_world.num_image_chunks >= MAX_IMAGE_CHUNKS) {
-			ri.Error(ERR_FATAL, "Vulkan: image chunk limit has been reached" );
+	if ( buffer != vk.staging_buffer.copy_dst ) {
+		vk_staging_flush_copies();
+		vk.staging_buffer.copy_dst = buffer;
+	} else {
+		// regions of a single copy command may not overlap
+		for ( i = 0; i < vk.staging_buffer.num_copies; i++ ) {
+			region = &vk.staging_buffer.copies[i];
+			if ( dst_offset < region->dstOffset + region->size && region->dstOffset < dst_offset + size ) {
+				vk_staging_flush_copies();
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.pNext = NULL;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = buffer;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				qvkCmdPipelineBarrier( vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL );
+				break;
+			}
 		}
+	}
 
-		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		alloc_info.pNext = NULL;
-		alloc_info.allocationSize = vk.image_chunk_size;
-		alloc_info.memoryTypeIndex = vk_find_memory_type( memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+	if ( vk.staging_buffer.num_copies ) {
+		region = &vk.staging_buffer.copies[ vk.staging_buffer.num_copies - 1 ];
+		if ( region->srcOffset + region->size == src_offset && region->dstOffset + region->size == dst_offset ) {
+			region->size += size;
+			return;
+		}
+	}
 
-		VK_CHECK( qvkAllocateMemory( vk.device, &alloc_info, NULL, &memory ) );
+	if ( vk.staging_buffer.num_copies >= MAX_STAGING_COPIES ) {
+		vk_staging_flush_copies();
+	}
 
-		chunk = &vk_world.image_chunks[vk_world.num_image_chunks];
-		chunk->memory = memory;
-		chunk->used = memory_requirements.size;
+	region = &vk.staging_buffer.copies[ vk.staging_buffer.num_copies++ ];
+	region->srcOffset = src_offset;
+	region->dstOffset = dst_offset;
+	region->size = size;
+}
 
-		SET_OBJECT_NAME( memory, va( "image memory chunk %i", vk_world.num_image_chunks ), VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT );
 
-		vk_world.num_image_chunks++;
+/*
+================
+vk_staging_fit
+================
+*/
+static qboolean vk_staging_fit( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset )
+{
+	const VkDeviceSize head = vk.staging_buffer.head;
+	const VkDeviceSize tail = vk.staging_buffer.tail;
+	const VkDeviceSize aligned = PAD( head, alignment );
+
+	if ( head >= tail ) {
+		// free space is [head, size) followed by [0, tail)
+		if ( aligned + size <= vk.staging_buffer.size ) {
+			*offset = aligned;
+			return qtrue;
+		}
+		if ( size < tail ) {
+			*offset = 0;
+			return qtrue;
+		}
+	} else {
+		// free space is [head, tail)
+		if ( aligned + size < tail ) {
+			*offset = aligned;
+			return qtrue;
+		}
 	}
 
-	VK_CHECK(qvkBindImageMemory(vk.device, image, chunk->memory, chunk->used - memory_requirements.size));
+	return qfalse;
 }
+#endif // USE_UPLOAD_QUEUE
 
 
 static void vk_clean_staging_buffer( void )
 {
+#ifdef USE_UPLOAD_QUEUE
+	// device is idle at this point, anything still recorded is discarded
+	vk_staging_wait_all();
+	if ( vk.staging_buffer.recording ) {
+		VK_CHECK( qvkEndCommandBuffer( vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd ) );
+		VK_CHECK( qvkResetCommandBuffer( vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd, 0 ) );
+		vk.staging_buffer.recording = qfalse;
+	}
+	vk.staging_buffer.num_copies = 0;
+	vk.staging_buffer.copy_dst = VK_NULL_HANDLE;
+#endif
+
 	if ( vk.staging_buffer.handle != VK_NULL_HANDLE ) {
 		qvkDestroyBuffer( vk.device, vk.staging_buffer.handle, NULL );
 		vk.staging_buffer.handle = VK_NULL_HANDLE;
 	}
 
-	//if ( vk.staging_buffer.ptr != NULL ) 
-	//	qvkUnmapMemory( vk.device, vk.staging_buffer.memory ) {
-	//	vk.staging_buffer.ptr = NULL;
-	//}
-
 	if ( vk.staging_buffer.memory != VK_NULL_HANDLE ) {
 		qvkFreeMemory( vk.device, vk.staging_buffer.memory, NULL );
 		vk.staging_buffer.memory = VK_NULL_HANDLE;
@@ -1101,46 +1287,30 @@ static void vk_clean_staging_buffer( void )
 	vk.staging_buffer.ptr = NULL;
 	vk.staging_buffer.size = 0;
 #ifdef USE_UPLOAD_QUEUE
-	vk.staging_buffer.offset = 0;
+	vk.staging_buffer.head = 0;
+	vk.staging_buffer.tail = 0;
+	vk.staging_buffer.slots[ vk.staging_buffer.slot ].end = 0;
 #endif
 }
 
 
 #ifdef USE_UPLOAD_QUEUE
-static qboolean vk_wait_staging_buffer( void )
-{
-	if ( vk.aux_fence_wait ) {
-		VkResult res = qvkWaitForFences( vk.device, 1, &vk.aux_fence, VK_TRUE, 5 * 1000000000ULL );
-		if ( res != VK_SUCCESS ) {
-			ri.Error( ERR_FATAL, "vkWaitForFences() failed with %s at %s", vk_result_string( res ), __func__ );
-		}
-		qvkResetFences( vk.device, 1, &vk.aux_fence );
-		VK_CHECK( qvkResetCommandBuffer( vk.staging_command_buffer, 0 ) );
-		vk.staging_buffer.offset = 0; // FIXME: is this correct?
-		vk.aux_fence_wait = qfalse;
-		return qtrue;
-	} else {
-		return qfalse;
-	}
-}
-
-
 static void vk_flush_staging_buffer( qboolean final )
 {
 	const VkPipelineStageFlags wait_dst_stage_mask = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 	VkSemaphore waits;
 	VkSubmitInfo submit_info;
-	VkResult res;
+	VkFence fence;
+	uint32_t n;
 
-	if ( vk.staging_buffer.offset == 0 ) {
-		return;
+	if ( !vk.staging_buffer.recording ) {
+		// earlier submissions still need to be covered by image_uploaded
+		if ( !final || !vk.staging_buffer.unsynced ) {
+			return;
+		}
 	}
 
-	//ri.Printf( PRINT_WARNING, S_COLOR_CYAN ">>> flush %i bytes (final=%i)<<<\n", (int)vk_world.staging_buffer_offset, final );
-
-	vk.staging_buffer.offset = 0;
-
-	VK_CHECK( qvkEndCommandBuffer( vk.staging_command_buffer ) );
+	n = vk.staging_buffer.slot;
 
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.pNext = NULL;
@@ -1158,30 +1328,44 @@ static void vk_flush_staging_buffer( qboolean final )
 		submit_info.pWaitDstStageMask = NULL;
 	}
 
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &vk.staging_command_buffer;
-
-	if ( vk.image_uploaded != VK_NULL_HANDLE ) {
-		ri.Error( ERR_FATAL, "Vulkan: incorrect state during image upload" );
+	if ( vk.staging_buffer.recording ) {
+		vk_staging_flush_copies();
+		VK_CHECK( qvkEndCommandBuffer( vk.staging_buffer.slots[n].cmd ) );
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &vk.staging_buffer.slots[n].cmd;
+		fence = vk.staging_buffer.slots[n].fence;
+	} else {
+		submit_info.commandBufferCount = 0;
+		submit_info.pCommandBuffers = NULL;
+		fence = VK_NULL_HANDLE;
 	}
+
 	if ( final ) {
-		// final submission before recording
+		// final submission before recording, semaphore signal covers all earlier submissions too
+		if ( vk.image_uploaded != VK_NULL_HANDLE ) {
+			ri.Error( ERR_FATAL, "Vulkan: incorrect state during image upload" );
+		}
 		submit_info.signalSemaphoreCount = 1;
 		submit_info.pSignalSemaphores = &vk.image_uploaded2;
 		vk.image_uploaded = vk.image_uploaded2;
-		VK_CHECK( qvkQueueSubmit( vk.queue, 1, &submit_info, vk.aux_fence ) );
-		vk.aux_fence_wait = qtrue;
+		vk.staging_buffer.unsynced = qfalse;
 	} else {
-		// if submission before another upload then do explicit wait
+		// submission before another upload, no need to wait for it
 		submit_info.signalSemaphoreCount = 0;
 		submit_info.pSignalSemaphores = NULL;
-		VK_CHECK( qvkQueueSubmit( vk.queue, 1, &submit_info, vk.aux_fence ) );
-		res = qvkWaitForFences( vk.device, 1, &vk.aux_fence, VK_TRUE, 5 * 1000000000ULL );
-		if ( res != VK_SUCCESS ) {
-			ri.Error( ERR_FATAL, "vkWaitForFences() failed with %s at %s", vk_result_string( res ), __func__ );
-		}
-		qvkResetFences( vk.device, 1, &vk.aux_fence );
-		VK_CHECK( qvkResetCommandBuffer( vk.staging_command_buffer, 0 ) );
+		vk.staging_buffer.unsynced = qtrue;
+	}
+
+	VK_CHECK( qvkQueueSubmit( vk.queue, 1, &submit_info, fence ) );
+
+	if ( vk.staging_buffer.recording ) {
+		vk.staging_buffer.recording = qfalse;
+		vk.staging_buffer.pending++;
+		vk.staging_buffer.submits++;
+		vk.staging_buffer.slot = ( n + 1 ) % NUM_STAGING_SLOTS;
+		vk.staging_buffer.slots[n].end = vk.staging_buffer.head;
+		// next slot starts where this one ended
+		vk.staging_buffer.slots[ vk.staging_buffer.slot ].end = vk.staging_buffer.head;
 	}
 }
 #endif // USE_UPLOAD_QUEUE
@@ -1197,7 +1381,7 @@ static void vk_alloc_staging_buffer( VkDeviceSize size )
 
 	vk_clean_staging_buffer();
 
-	vk.staging_buffer.size = MAX( size, STAGING_BUFFER_SIZE );
+	vk.staging_buffer.size = MAX( size, vk.defaults.staging_size );
 	vk.staging_buffer.size = PAD( vk.staging_buffer.size, 1024 * 1024 );
 
 	buffer_desc.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1224,14 +1408,75 @@ static void vk_alloc_staging_buffer( VkDeviceSize size )
 
 	VK_CHECK(qvkMapMemory(vk.device, vk.staging_buffer.memory, 0, VK_WHOLE_SIZE, 0, &data));
 	vk.staging_buffer.ptr = (byte*)data;
-#ifdef USE_UPLOAD_QUEUE
-	vk.staging_buffer.offset = 0;
-#endif
+
 	SET_OBJECT_NAME( vk.staging_buffer.handle, "staging buffer", VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT );
 	SET_OBJECT_NAME( vk.staging_buffer.memory, "staging buffer memory", VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT );
 }
 
 
+#ifdef USE_UPLOAD_QUEUE
+/*
+================
+vk_staging_alloc
+
+Returns mapped pointer to size bytes of the staging ring and their offset
+in vk.staging_buffer.handle, the staging command buffer is guaranteed to
+be recording on return
+================
+*/
+byte *vk_staging_alloc( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset )
+{
+	VkDeviceSize ofs;
+
+	if ( vk.staging_buffer.handle == VK_NULL_HANDLE ) {
+		vk_alloc_staging_buffer( size );
+	}
+
+	vk_staging_retire( qfalse );
+
+	for ( ;; ) {
+		vk_staging_begin();
+		if ( vk_staging_fit( size, alignment, &ofs ) ) {
+			break;
+		}
+		if ( vk.staging_buffer.pending ) {
+			// ring is full - wait for the oldest submission
+			vk_staging_retire( qtrue );
+			vk.staging_buffer.stalls++;
+			vk.staging_buffer.frame_stalls++;
+		} else if ( vk.staging_buffer.head != vk.staging_buffer.slots[ vk.staging_buffer.slot ].end ) {
+			// only our own recorded data is left
+			vk_flush_staging_buffer( qfalse );
+		} else {
+			// does not fit even into empty ring
+			vk_alloc_staging_buffer( size );
+		}
+	}
+
+	vk.staging_buffer.head = ofs + size;
+	vk.staging_buffer.frame_bytes += size;
+
+	*offset = ofs;
+
+	return vk.staging_buffer.ptr + ofs;
+}
+
+
+/*
+================
+vk_staging_info_f
+================
+*/
+void vk_staging_info_f( void )
+{
+	ri.Printf( PRINT_ALL, "staging ring: %i KB, %i slots, %i in flight\n", (int)( vk.staging_buffer.size / 1024 ), NUM_STAGING_SLOTS, vk.staging_buffer.pending );
+	ri.Printf( PRINT_ALL, "last frame: %i KB uploaded, %i stalls\n", (int)( vk.staging_buffer.last_frame_bytes / 1024 ), vk.staging_buffer.last_frame_stalls );
+	ri.Printf( PRINT_ALL, "peak frame: %i KB uploaded\n", (int)( vk.staging_buffer.peak_frame_bytes / 1024 ) );
+	ri.Printf( PRINT_ALL, "total: %i submits, %i stalls\n", vk.staging_buffer.submits, vk.staging_buffer.stalls );
+}
+#endif // USE_UPLOAD_QUEUE
+
+
 #ifdef USE_VK_VALIDATION
 
 // File handle for Vulkan validation logging
@@ -1906,6 +2151,12 @@ static qboolean vk_create_device( VkPhysicalDevice physical_device, int device_i
 			vk.samplerAnisotropy = qtrue;
 		}
 
+		// merged world VBO runs are issued via single indirect call
+		if ( device_features.multiDrawIndirect ) {
+			features.multiDrawIndirect = VK_TRUE;
+			vk.multiDrawIndirect = qtrue;
+		}
+
 		// Enable pipeline statistics query for profiling
 		if ( device_features.pipelineStatisticsQuery ) {
 			features.pipelineStatisticsQuery = VK_TRUE;
@@ -2237,7 +2488,9 @@ static void init_vulkan_library( void )
 	INIT_DEVICE_FUNCTION(vkCmdCopyImage)
 	INIT_DEVICE_FUNCTION(vkCmdDraw)
 	INIT_DEVICE_FUNCTION(vkCmdDrawIndexed)
+	INIT_DEVICE_FUNCTION(vkCmdDrawIndexedIndirect)
 	INIT_DEVICE_FUNCTION(vkCmdEndRenderPass)
+	INIT_DEVICE_FUNCTION(vkCmdExecuteCommands)
 	INIT_DEVICE_FUNCTION(vkCmdNextSubpass)
 	INIT_DEVICE_FUNCTION(vkCmdPipelineBarrier)
 	INIT_DEVICE_FUNCTION(vkCmdPushConstants)
@@ -2254,6 +2507,7 @@ static void init_vulkan_library( void )
 	INIT_DEVICE_FUNCTION(vkCreateImage)
 	INIT_DEVICE_FUNCTION(vkCreateImageView)
 	INIT_DEVICE_FUNCTION(vkCreatePipelineCache)
+	INIT_DEVICE_FUNCTION(vkGetPipelineCacheData)
 	INIT_DEVICE_FUNCTION(vkCreatePipelineLayout)
 	INIT_DEVICE_FUNCTION(vkCreateRenderPass)
 	INIT_DEVICE_FUNCTION(vkCreateSampler)
@@ -2290,11 +2544,13 @@ static void init_vulkan_library( void )
 	INIT_DEVICE_FUNCTION(vkQueueSubmit)
 	INIT_DEVICE_FUNCTION(vkQueueWaitIdle)
 	INIT_DEVICE_FUNCTION(vkResetCommandBuffer)
+	INIT_DEVICE_FUNCTION(vkResetCommandPool)
 	INIT_DEVICE_FUNCTION(vkResetDescriptorPool)
 	INIT_DEVICE_FUNCTION(vkResetFences)
 	INIT_DEVICE_FUNCTION(vkUnmapMemory)
 	INIT_DEVICE_FUNCTION(vkUpdateDescriptorSets)
 	INIT_DEVICE_FUNCTION(vkWaitForFences)
+	INIT_DEVICE_FUNCTION(vkGetFenceStatus)
 	INIT_DEVICE_FUNCTION(vkAcquireNextImageKHR)
 	INIT_DEVICE_FUNCTION(vkCreateSwapchainKHR)
 	INIT_DEVICE_FUNCTION(vkDestroySwapchainKHR)
@@ -2367,7 +2623,9 @@ static void deinit_device_functions( void )
 	qvkCmdCopyImage								= NULL;
 	qvkCmdDraw									= NULL;
 	qvkCmdDrawIndexed							= NULL;
+	qvkCmdDrawIndexedIndirect					= NULL;
 	qvkCmdEndRenderPass							= NULL;
+	qvkCmdExecuteCommands						= NULL;
 	qvkCmdNextSubpass							= NULL;
 	qvkCmdPipelineBarrier						= NULL;
 	qvkCmdPushConstants							= NULL;
@@ -2400,6 +2658,7 @@ static void deinit_device_functions( void )
 	qvkDestroyImageView							= NULL;
 	qvkDestroyPipeline							= NULL;
 	qvkDestroyPipelineCache						= NULL;
+	qvkGetPipelineCacheData						= NULL;
 	qvkDestroyPipelineLayout					= NULL;
 	qvkDestroyRenderPass						= NULL;
 	qvkDestroySampler							= NULL;
@@ -2420,11 +2679,13 @@ static void deinit_device_functions( void )
 	qvkQueueSubmit								= NULL;
 	qvkQueueWaitIdle							= NULL;
 	qvkResetCommandBuffer						= NULL;
+	qvkResetCommandPool							= NULL;
 	qvkResetDescriptorPool						= NULL;
 	qvkResetFences								= NULL;
 	qvkUnmapMemory								= NULL;
 	qvkUpdateDescriptorSets						= NULL;
 	qvkWaitForFences							= NULL;
+	qvkGetFenceStatus							= NULL;
 	qvkAcquireNextImageKHR						= NULL;
 	qvkCreateSwapchainKHR						= NULL;
 	qvkDestroySwapchainKHR						= NULL;
@@ -2791,7 +3052,7 @@ static void vk_create_geometry_buffers( VkDeviceSize size )
 
 	for ( i = 0 ; i < NUM_COMMAND_BUFFERS; i++ ) {
 		desc.size = size;
-		desc.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		desc.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 		VK_CHECK( qvkCreateBuffer( vk.device, &desc, NULL, &vk.tess[i].vertex_buffer ) );
 
 		qvkGetBufferMemoryRequirements( vk.device, vk.tess[i].vertex_buffer, &vb_memory_requirements );
@@ -2874,27 +3135,18 @@ static void vk_create_storage_buffer( uint32_t size )
 #ifdef USE_VBO
 void vk_release_vbo( void )
 {
-	if ( vk.vbo.vertex_buffer )
+	if ( vk.vbo.vertex_buffer ) {
+		vk_mem_free( (uint64_t)vk.vbo.vertex_buffer );
 		qvkDestroyBuffer( vk.device, vk.vbo.vertex_buffer, NULL );
+	}
 	vk.vbo.vertex_buffer = VK_NULL_HANDLE;
-
-	if ( vk.vbo.buffer_memory )
-		qvkFreeMemory( vk.device, vk.vbo.buffer_memory, NULL );
 	vk.vbo.buffer_memory = VK_NULL_HANDLE;
 }
 
 
 qboolean vk_alloc_vbo( const byte *vbo_data, int vbo_size )
 {
-	VkMemoryRequirements vb_mem_reqs;
-	VkMemoryAllocateInfo alloc_info;
 	VkBufferCreateInfo desc;
-	VkDeviceSize vertex_buffer_offset;
-	VkDeviceSize allocationSize;
-	uint32_t memory_type_bits;
-	VkCommandBuffer command_buffer;
-	VkBufferCopy copyRegion[1];
-	VkDeviceSize uploadDone;
 
 	vk_release_vbo();
 
@@ -2910,38 +3162,10 @@ qboolean vk_alloc_vbo( const byte *vbo_data, int vbo_size )
 	desc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 	VK_CHECK( qvkCreateBuffer( vk.device, &desc, NULL, &vk.vbo.vertex_buffer ) );
 
-	// memory requirements
-	qvkGetBufferMemoryRequirements( vk.device, vk.vbo.vertex_buffer, &vb_mem_reqs );
-	vertex_buffer_offset = 0;
-	allocationSize = vertex_buffer_offset + vb_mem_reqs.size;
-	memory_type_bits = vb_mem_reqs.memoryTypeBits;
+	vk.vbo.buffer_memory = vk_mem_bind_buffer( vk.vbo.vertex_buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qfalse );
 
-	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.pNext = NULL;
-	alloc_info.allocationSize = allocationSize;
-	alloc_info.memoryTypeIndex = find_memory_type( memory_type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-	VK_CHECK( qvkAllocateMemory( vk.device, &alloc_info, NULL, &vk.vbo.buffer_memory ) );
-	qvkBindBufferMemory( vk.device, vk.vbo.vertex_buffer, vk.vbo.buffer_memory, vertex_buffer_offset );
-
-	// staging buffers
-
-	// utilize existing staging buffer
-	vk_flush_staging_buffer( qfalse );
-	uploadDone = 0;
-	while ( uploadDone < vbo_size ) {
-		VkDeviceSize uploadSize = vk.staging_buffer.size;
-		if ( uploadDone + uploadSize > vbo_size ) {
-			uploadSize = vbo_size - uploadDone;
-		}
-		memcpy(vk.staging_buffer.ptr + 0, vbo_data + uploadDone, uploadSize);
-		command_buffer = begin_command_buffer();
-		copyRegion[0].srcOffset = 0;
-		copyRegion[0].dstOffset = uploadDone;
-		copyRegion[0].size = uploadSize;
-		qvkCmdCopyBuffer( command_buffer, vk.staging_buffer.handle, vk.vbo.vertex_buffer, 1, &copyRegion[0] );
-		end_command_buffer( command_buffer, __func__ );
-		uploadDone += uploadSize;
-	}
+	// upload through the staging ring, completes before the first frame that uses it
+	vk_push_staging_buffer( vk.vbo.vertex_buffer, 0, vbo_size, vbo_data );
 
 	SET_OBJECT_NAME( vk.vbo.vertex_buffer, "static VBO", VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT );
 	SET_OBJECT_NAME( vk.vbo.buffer_memory, "static VBO memory", VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT );
@@ -2951,24 +3175,7 @@ qboolean vk_alloc_vbo( const byte *vbo_data, int vbo_size )
 #endif
 
 void vk_upload_buffer_data( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, const void *data ) {
-	VkCommandBuffer command_buffer;
-	VkBufferCopy copyRegion;
-	
-	if ( size > vk.staging_buffer.size ) {
-		ri.Error( ERR_FATAL, "Upload size exceeds staging buffer capacity" );
-		return;
-	}
-	
-	// Copy data to staging buffer
-	memcpy( vk.staging_buffer.ptr, data, size );
-	
-	// Record copy command
-	command_buffer = begin_command_buffer();
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = offset;
-	copyRegion.size = size;
-	qvkCmdCopyBuffer( command_buffer, vk.staging_buffer.handle, buffer, 1, &copyRegion );
-	end_command_buffer( command_buffer, __func__ );
+	vk_push_staging_buffer( buffer, offset, size, data );
 }
 
 #include "../shaders/spirv/shader_data.c"
@@ -3980,12 +4187,13 @@ static void vk_create_sync_primitives( void ) {
 	fence_desc.flags = 0;
 
 #ifdef USE_UPLOAD_QUEUE
-	VK_CHECK( qvkCreateFence( vk.device, &fence_desc, NULL, &vk.aux_fence ) );
-	SET_OBJECT_NAME( vk.aux_fence, "aux fence", VK_DEBUG_REPORT_OBJECT_TYPE_FENCE_EXT );
+	for ( i = 0; i < NUM_STAGING_SLOTS; i++ ) {
+		VK_CHECK( qvkCreateFence( vk.device, &fence_desc, NULL, &vk.staging_buffer.slots[i].fence ) );
+		SET_OBJECT_NAME( vk.staging_buffer.slots[i].fence, va( "staging fence %i", i ), VK_DEBUG_REPORT_OBJECT_TYPE_FENCE_EXT );
+	}
 
 	vk.rendering_finished = VK_NULL_HANDLE;
 	vk.image_uploaded = VK_NULL_HANDLE;
-	vk.aux_fence_wait = qfalse;
 #endif
 }
 
@@ -4008,7 +4216,9 @@ static void vk_destroy_sync_primitives( void  ) {
 	}
 
 #ifdef USE_UPLOAD_QUEUE
-	qvkDestroyFence( vk.device, vk.aux_fence, NULL );
+	for ( i = 0; i < NUM_STAGING_SLOTS; i++ ) {
+		qvkDestroyFence( vk.device, vk.staging_buffer.slots[i].fence, NULL );
+	}
 
 	vk.rendering_finished = VK_NULL_HANDLE;
 	vk.image_uploaded = VK_NULL_HANDLE;
@@ -4094,7 +4304,8 @@ static void vk_restart_swapchain( const char *funcname, VkResult res )
 	}
 
 #ifdef USE_UPLOAD_QUEUE
-	qvkResetCommandBuffer( vk.staging_command_buffer, 0 );
+	// staging fences are recreated below, keep whatever is being recorded
+	vk_staging_wait_all();
 #endif
 
 	vk_destroy_pipelines( qfalse );
@@ -4161,6 +4372,159 @@ static void vk_set_render_scale( void )
 }
 
 
+/*
+==============================================================================
+
+PERSISTENT PIPELINE CACHE
+
+VkPipelineCache contents are saved to the homepath on shutdown and fed back
+on the next start so drivers can skip shader compilation for pipelines that
+were already seen. The blob is tagged with the device identity and rejected
+whenever the driver, device or cache UUID differ.
+
+==============================================================================
+*/
+
+#define VK_PIPELINE_CACHE_FILE		"vkpipeline.cache"
+#define VK_PIPELINE_CACHE_MAGIC		0x50434B56	// "VKCP"
+#define VK_PIPELINE_CACHE_VERSION	1
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vendorID;
+	uint32_t	deviceID;
+	uint32_t	driverVersion;
+	uint8_t		pipelineCacheUUID[ VK_UUID_SIZE ];
+	uint32_t	dataSize;
+	uint32_t	checksum;
+} vkPipelineCacheHeader_t;
+
+static cvar_t *r_pipelineCache;
+static cvar_t *r_pipelinePrecompile;
+
+static vkPipelineCacheHeader_t vk_pipeline_cache_ident;
+
+
+/*
+================
+vk_pipeline_cache_checksum
+
+FNV-1a over the cache blob, catches truncated or corrupted files
+================
+*/
+static uint32_t vk_pipeline_cache_checksum( const byte *data, uint32_t size ) {
+	uint32_t hash = 2166136261U;
+	uint32_t i;
+
+	for ( i = 0; i < size; i++ ) {
+		hash ^= data[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*
+================
+vk_create_pipeline_cache
+
+Creates vk.pipelineCache, seeded from disk when a matching blob exists
+================
+*/
+static void vk_create_pipeline_cache( const VkPhysicalDeviceProperties *props ) {
+	VkPipelineCacheCreateInfo ci;
+	const vkPipelineCacheHeader_t *header;
+	void *buffer;
+	int len;
+
+	r_pipelineCache = ri.Cvar_Get( "r_pipelineCache", "1", CVAR_ARCHIVE_ND | CVAR_LATCH );
+	ri.Cvar_SetDescription( r_pipelineCache, "Persist the Vulkan pipeline cache to disk between sessions." );
+	r_pipelinePrecompile = ri.Cvar_Get( "r_pipelinePrecompile", "4", CVAR_ARCHIVE_ND );
+	ri.Cvar_CheckRange( r_pipelinePrecompile, "0", "16", CV_INTEGER );
+	ri.Cvar_SetDescription( r_pipelinePrecompile, "Number of worker threads used to compile map pipelines during level load, 0 to compile lazily on first use." );
+
+	Com_Memset( &vk_pipeline_cache_ident, 0, sizeof( vk_pipeline_cache_ident ) );
+	vk_pipeline_cache_ident.magic = VK_PIPELINE_CACHE_MAGIC;
+	vk_pipeline_cache_ident.version = VK_PIPELINE_CACHE_VERSION;
+	vk_pipeline_cache_ident.vendorID = props->vendorID;
+	vk_pipeline_cache_ident.deviceID = props->deviceID;
+	vk_pipeline_cache_ident.driverVersion = props->driverVersion;
+	Com_Memcpy( vk_pipeline_cache_ident.pipelineCacheUUID, props->pipelineCacheUUID, VK_UUID_SIZE );
+
+	Com_Memset( &ci, 0, sizeof( ci ) );
+	ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	buffer = NULL;
+	len = 0;
+
+	if ( r_pipelineCache->integer ) {
+		len = ri.FS_ReadFile( VK_PIPELINE_CACHE_FILE, &buffer );
+	}
+
+	if ( buffer && len > (int)sizeof( *header ) ) {
+		header = (const vkPipelineCacheHeader_t *) buffer;
+		if ( header->magic != VK_PIPELINE_CACHE_MAGIC || header->version != VK_PIPELINE_CACHE_VERSION ) {
+			ri.Printf( PRINT_DEVELOPER, "...ignoring %s: bad header\n", VK_PIPELINE_CACHE_FILE );
+		} else if ( header->vendorID != props->vendorID || header->deviceID != props->deviceID
+			|| header->driverVersion != props->driverVersion
+			|| memcmp( header->pipelineCacheUUID, props->pipelineCacheUUID, VK_UUID_SIZE ) != 0 ) {
+			ri.Printf( PRINT_ALL, "...discarding %s: device or driver changed\n", VK_PIPELINE_CACHE_FILE );
+		} else if ( header->dataSize != (uint32_t)len - sizeof( *header )
+			|| header->checksum != vk_pipeline_cache_checksum( (const byte *)( header + 1 ), header->dataSize ) ) {
+			ri.Printf( PRINT_WARNING, "...discarding %s: corrupted data\n", VK_PIPELINE_CACHE_FILE );
+		} else {
+			ci.initialDataSize = header->dataSize;
+			ci.pInitialData = header + 1;
+			ri.Printf( PRINT_ALL, "...loaded %i bytes of pipeline cache\n", header->dataSize );
+		}
+	}
+
+	VK_CHECK( qvkCreatePipelineCache( vk.device, &ci, NULL, &vk.pipelineCache ) );
+
+	if ( buffer ) {
+		ri.FS_FreeFile( buffer );
+	}
+}
+
+
+/*
+================
+vk_save_pipeline_cache
+================
+*/
+static void vk_save_pipeline_cache( void ) {
+	vkPipelineCacheHeader_t *header;
+	size_t size;
+	byte *buffer;
+
+	if ( vk.pipelineCache == VK_NULL_HANDLE || !qvkGetPipelineCacheData )
+		return;
+
+	if ( !r_pipelineCache || !r_pipelineCache->integer )
+		return;
+
+	size = 0;
+	if ( qvkGetPipelineCacheData( vk.device, vk.pipelineCache, &size, NULL ) != VK_SUCCESS || size == 0 )
+		return;
+
+	// the blob can be several megabytes, keep it off the hunk
+	buffer = ri.Malloc( sizeof( *header ) + size );
+	header = (vkPipelineCacheHeader_t *) buffer;
+
+	if ( qvkGetPipelineCacheData( vk.device, vk.pipelineCache, &size, header + 1 ) == VK_SUCCESS ) {
+		*header = vk_pipeline_cache_ident;
+		header->dataSize = (uint32_t)size;
+		header->checksum = vk_pipeline_cache_checksum( (const byte *)( header + 1 ), header->dataSize );
+		ri.FS_WriteFile( VK_PIPELINE_CACHE_FILE, buffer, sizeof( *header ) + size );
+		ri.Printf( PRINT_DEVELOPER, "...saved %i bytes of pipeline cache\n", (int)size );
+	}
+
+	ri.Free( buffer );
+}
+
+
 void vk_initialize( void )
 {
 	char buf[64], driver_version[64];
@@ -4279,9 +4643,6 @@ void vk_initialize( void )
 	if ( glConfig.maxTextureSize > MAX_TEXTURE_SIZE )
 		glConfig.maxTextureSize = MAX_TEXTURE_SIZE; // ResampleTexture() relies on that maximum
 
-	// default chunk size, may be doubled on demand
-	vk.image_chunk_size = IMAGE_CHUNK_SIZE;
-
 	vk.maxLod = 1 + Q_log2( glConfig.maxTextureSize );
 
 	if ( props.limits.maxPerStageDescriptorSamplers != 0xFFFFFFFF )
@@ -4396,7 +4757,10 @@ void vk_initialize( void )
 		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 		alloc_info.commandBufferCount = 1;
 
-		VK_CHECK( qvkAllocateCommandBuffers( vk.device, &alloc_info, &vk.staging_command_buffer ) );
+		for ( i = 0; i < NUM_STAGING_SLOTS; i++ ) {
+			VK_CHECK( qvkAllocateCommandBuffers( vk.device, &alloc_info, &vk.staging_buffer.slots[i].cmd ) );
+			SET_OBJECT_NAME( vk.staging_buffer.slots[i].cmd, va( "staging command buffer %i", i ), VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT );
+		}
 	}
 #endif
 
@@ -4534,12 +4898,9 @@ void vk_initialize( void )
 
 	vk_create_shader_modules();
 
-	{
-		VkPipelineCacheCreateInfo ci;
-		Com_Memset( &ci, 0, sizeof( ci ) );
-		ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-		VK_CHECK( qvkCreatePipelineCache( vk.device, &ci, NULL, &vk.pipelineCache ) );
-	}
+	vk_create_pipeline_cache( &props );
+
+	vk_mem_init();
 
 	vk.renderPassIndex = RENDER_PASS_MAIN; // default render pass
 
@@ -4562,6 +4923,14 @@ void vk_initialize( void )
 		vk_alloc_staging_buffer( vk.defaults.staging_size );
 	}
 
+#ifdef USE_UPLOAD_QUEUE
+	ri.Cmd_AddCommand( "vkstaginginfo", vk_staging_info_f );
+#endif
+	ri.Cmd_AddCommand( "vkmeminfo", vk_meminfo_f );
+
+	vk_initialize_backend_thread();
+	ri.Cmd_AddCommand( "vkbackendinfo", vk_backend_info_f );
+
 	vk.active = qtrue;
 }
 
@@ -4752,6 +5121,7 @@ void vk_shutdown( refShutdownCode_t code )
 	vk_destroy_swapchain();
 
 	if ( vk.pipelineCache != VK_NULL_HANDLE ) {
+		vk_save_pipeline_cache();
 		qvkDestroyPipelineCache( vk.device, vk.pipelineCache, NULL );
 		vk.pipelineCache = VK_NULL_HANDLE;
 	}
@@ -4867,7 +5237,15 @@ void vk_shutdown( refShutdownCode_t code )
 	qvkDestroyShaderModule(vk.device, vk.modules.gamma_fs, NULL);
 
 __cleanup:
+#ifdef USE_UPLOAD_QUEUE
+	ri.Cmd_RemoveCommand( "vkstaginginfo" );
+#endif
+	ri.Cmd_RemoveCommand( "vkmeminfo" );
+	ri.Cmd_RemoveCommand( "vkbackendinfo" );
+
 	if ( vk.device != VK_NULL_HANDLE ) {
+		vk_shutdown_backend_thread();
+		vk_mem_shutdown();
 		qvkDestroyDevice( vk.device, NULL );
 	}
 
@@ -4900,9 +5278,6 @@ void vk_release_resources( void ) {
 
 	vk_wait_idle();
 
-	for (i = 0; i < vk_world.num_image_chunks; i++)
-		qvkFreeMemory(vk.device, vk_world.image_chunks[i].memory, NULL);
-
 	vk_clean_staging_buffer();
 
 	// vk_destroy_samplers();
@@ -4918,21 +5293,12 @@ void vk_release_resources( void ) {
 		Com_Memset( &vk.pipelines[i], 0, sizeof( vk.pipelines[0] ) );
 	}
 	vk.pipelines_count = vk.pipelines_world_base;
+	vk.pipelineBatch = qfalse; // in case a map load was aborted
 
 	VK_CHECK( qvkResetDescriptorPool( vk.device, vk.descriptor_pool, 0 ) );
 
-	if ( vk_world.num_image_chunks > 1 ) {
-		// if we allocated more than 2 image chunks - use doubled default size
-		vk.image_chunk_size = (IMAGE_CHUNK_SIZE * 2);
-	}
-#if 0 // do not reduce chunk size
-	else if ( vk_world.num_image_chunks == 1 ) {
-		// otherwise set to default if used less than a half
-		if ( vk_world.image_chunks[0].used < ( IMAGE_CHUNK_SIZE - (IMAGE_CHUNK_SIZE / 10) ) ) {
-			vk.image_chunk_size = IMAGE_CHUNK_SIZE;
-		}
-	}
-#endif
+	// hand back memory blocks emptied by the previous map
+	vk_mem_trim();
 
 	Com_Memset( &vk_world, 0, sizeof( vk_world ) );
 
@@ -4944,6 +5310,7 @@ void vk_release_resources( void ) {
 
 	Com_Memset( vk.cmd->buf_offset, 0, sizeof( vk.cmd->buf_offset ) );
 	Com_Memset( vk.cmd->vbo_offset, 0, sizeof( vk.cmd->vbo_offset ) );
+	Com_Memset( vk.cmd->bound_buffer, 0, sizeof( vk.cmd->bound_buffer ) );
 
 	Com_Memset( &vk.stats, 0, sizeof( vk.stats ) );
 }
@@ -4973,6 +5340,7 @@ void vk_create_image( image_t *image, int width, int height, int mip_levels ) {
 	VkFormat format = image->internalFormat;
 
 	if ( image->handle ) {
+		vk_mem_free( (uint64_t)image->handle );
 		qvkDestroyImage( vk.device, image->handle, NULL );
 		image->handle = VK_NULL_HANDLE;
 	}
@@ -5006,7 +5374,7 @@ void vk_create_image( image_t *image, int width, int height, int mip_levels ) {
 
 		VK_CHECK( qvkCreateImage( vk.device, &desc, NULL, &image->handle ) );
 
-		allocate_and_bind_image_memory( image->handle );
+		vk_mem_bind_image( image->handle, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, qfalse );
 	}
 
 	// create image view
@@ -5125,6 +5493,10 @@ void vk_upload_image_data( image_t *image, int x, int y, int width, int height,
 	VkCommandBuffer   command_buffer;
 	VkBufferImageCopy regions[16];
 	VkBufferImageCopy region;
+#ifdef USE_UPLOAD_QUEUE
+	VkDeviceSize staging_offset;
+	byte *ptr;
+#endif
 	byte *buf;
 	int n;
 
@@ -5168,39 +5540,15 @@ void vk_upload_image_data( image_t *image, int x, int y, int width, int height,
 	}
 
 #ifdef USE_UPLOAD_QUEUE
-	if ( vk_wait_staging_buffer() ) {
-		// wait for vkQueueSubmit() completion before new upload
-	}
-
-	if ( vk.staging_buffer.size - vk.staging_buffer.offset < buffer_size ) {
-		// try to flush staging buffer and reset offset
-		vk_flush_staging_buffer( qfalse );
-	}
-
-	if ( vk.staging_buffer.size /* - vk_world.staging_buffer_offset */ < buffer_size ) {
-		// if still not enough - reallocate staging buffer
-		vk_alloc_staging_buffer( buffer_size );
-	}
+	ptr = vk_staging_alloc( buffer_size, 16, &staging_offset );
 
 	for ( n = 0; n < num_regions; n++ ) {
-		regions[n].bufferOffset += vk.staging_buffer.offset;
-	}
-
-	Com_Memcpy( vk.staging_buffer.ptr + vk.staging_buffer.offset, buf, buffer_size );
-
-	if ( vk.staging_buffer.offset == 0 ) {
-		VkCommandBufferBeginInfo begin_info;
-		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begin_info.pNext = NULL;
-		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		begin_info.pInheritanceInfo = NULL;
-		VK_CHECK( qvkBeginCommandBuffer( vk.staging_command_buffer, &begin_info ) );
+		regions[n].bufferOffset += staging_offset;
 	}
 
-	//ri.Printf( PRINT_WARNING, "batch @%6i + %i %s \n", (int)vk_world.staging_buffer_offset, (int)buffer_size, image->imgName );
-	vk.staging_buffer.offset += buffer_size;
+	Com_Memcpy( ptr, buf, buffer_size );
 
-	command_buffer = vk.staging_command_buffer;
+	command_buffer = vk.staging_buffer.slots[ vk.staging_buffer.slot ].cmd;
 
 	if ( update ) {
 		record_image_layout_transition( command_buffer, image->handle, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, 0 );
@@ -5279,6 +5627,7 @@ void vk_destroy_image_resources( VkImage *image, VkImageView *imageView )
 {
 	if ( image != NULL ) {
 		if ( *image != VK_NULL_HANDLE ) {
+			vk_mem_free( (uint64_t)*image );
 			qvkDestroyImage( vk.device, *image, NULL );
 			*image = VK_NULL_HANDLE;
 		}
@@ -6013,6 +6362,8 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 			break;
 
 		default:
+			if ( vk.pipelinePrecompiling )
+				return VK_NULL_HANDLE;
 			ri.Error(ERR_DROP, "create_pipeline: unknown shader type %i\n", def->shader_type);
 			return 0;
 	}
@@ -6490,6 +6841,8 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 			break;
 
 		default:
+			if ( vk.pipelinePrecompiling )
+				return VK_NULL_HANDLE;
 			ri.Error( ERR_DROP, "%s: invalid shader type - %i", __func__, def->shader_type );
 			break;
 	}
@@ -6553,6 +6906,8 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 			rasterization_state.cullMode = (def->mirror ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_FRONT_BIT);
 			break;
 		default:
+			if ( vk.pipelinePrecompiling )
+				return VK_NULL_HANDLE;
 			ri.Error( ERR_DROP, "create_pipeline: invalid face culling mode %i\n", def->face_culling );
 			break;
 	}
@@ -6673,6 +7028,8 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 				attachment_blend_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA_SATURATE;
 				break;
 			default:
+				if ( vk.pipelinePrecompiling )
+					return VK_NULL_HANDLE;
 				ri.Error( ERR_DROP, "create_pipeline: invalid src blend state bits\n" );
 				break;
 		}
@@ -6702,6 +7059,8 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 				attachment_blend_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA;
 				break;
 			default:
+				if ( vk.pipelinePrecompiling )
+					return VK_NULL_HANDLE;
 				ri.Error( ERR_DROP, "create_pipeline: invalid dst blend state bits\n" );
 				break;
 		}
@@ -6768,11 +7127,19 @@ VkPipeline create_pipeline( const Vk_Pipeline_Def *def, renderPass_t renderPassI
 	create_info.basePipelineHandle = VK_NULL_HANDLE;
 	create_info.basePipelineIndex = -1;
 
-	VK_CHECK( qvkCreateGraphicsPipelines( vk.device, vk.pipelineCache, 1, &create_info, NULL, &pipeline ) );
-
-	SET_OBJECT_NAME( pipeline, va( "pipeline def#%i, pass#%i", def_index, renderPassIndex ), VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT );
+	// precompile workers can't raise errors, vk_precompile_pipelines() reports them after the join
+	if ( vk.pipelinePrecompiling ) {
+		if ( qvkCreateGraphicsPipelines( vk.device, vk.pipelineCache, 1, &create_info, NULL, &pipeline ) != VK_SUCCESS )
+			return VK_NULL_HANDLE;
+	} else {
+		VK_CHECK( qvkCreateGraphicsPipelines( vk.device, vk.pipelineCache, 1, &create_info, NULL, &pipeline ) );
+	}
 
-	vk.pipeline_create_count++;
+	// va() and the counter are not thread-safe, vk_precompile_pipelines() accounts for these
+	if ( !vk.pipelinePrecompiling ) {
+		SET_OBJECT_NAME( pipeline, va( "pipeline def#%i, pass#%i", def_index, renderPassIndex ), VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT );
+		vk.pipeline_create_count++;
+	}
 
 	return pipeline;
 }
@@ -6824,13 +7191,169 @@ uint32_t vk_find_pipeline_ext( uint32_t base, const Vk_Pipeline_Def *def, qboole
 	index = vk_alloc_pipeline( def );
 found:
 
-	if ( use )
+	// during a pipeline batch everything is compiled at once by vk_precompile_pipelines()
+	if ( use && !vk.pipelineBatch )
 		vk_gen_pipeline( index );
 
 	return index;
 }
 
 
+/*
+================
+vk_begin_pipeline_batch
+
+Defers pipeline creation requested while loading a map so that the whole
+set can be compiled in parallel by vk_precompile_pipelines()
+================
+*/
+void vk_begin_pipeline_batch( void ) {
+	vk.pipelineBatch = ( r_pipelinePrecompile && r_pipelinePrecompile->integer ) ? qtrue : qfalse;
+	vk.pipelineBatchBase = vk.pipelines_count;
+}
+
+
+typedef struct {
+	uint32_t	first;
+	uint32_t	stride;
+	int			created;
+#ifdef _WIN32
+	HANDLE		thread;
+#else
+	pthread_t	thread;
+#endif
+	qboolean	started;
+} vkPrecompileJob_t;
+
+
+/*
+================
+vk_precompile_range
+================
+*/
+static void vk_precompile_range( vkPrecompileJob_t *job ) {
+	VK_Pipeline_t *pipeline;
+	uint32_t i;
+
+	for ( i = job->first; i < vk.pipelines_count; i += job->stride ) {
+		pipeline = &vk.pipelines[ i ];
+		if ( pipeline->handle[ RENDER_PASS_MAIN ] == VK_NULL_HANDLE ) {
+			pipeline->handle[ RENDER_PASS_MAIN ] = create_pipeline( &pipeline->def, RENDER_PASS_MAIN, i );
+			if ( pipeline->handle[ RENDER_PASS_MAIN ] != VK_NULL_HANDLE )
+				job->created++;
+		}
+	}
+}
+
+
+#ifdef _WIN32
+static unsigned __stdcall vk_precompile_thread( void *arg ) {
+	vk_precompile_range( (vkPrecompileJob_t *) arg );
+	return 0;
+}
+#else
+static void *vk_precompile_thread( void *arg ) {
+	vk_precompile_range( (vkPrecompileJob_t *) arg );
+	return NULL;
+}
+#endif
+
+
+/*
+================
+vk_precompile_pipelines
+
+Compiles every main render pass pipeline referenced since
+vk_begin_pipeline_batch(), including the mirror and fog variants that
+would otherwise be compiled on first draw and cause hitches. Only the
+vkCreateGraphicsPipelines calls run on the workers; the pipeline table is
+not modified while they are running. Workers must not call ri.Error(),
+so a pipeline they fail to create is left empty and created again on
+the calling thread after the join, which reports the error.
+================
+*/
+void vk_precompile_pipelines( void ) {
+	vkPrecompileJob_t jobs[ 16 ];
+	uint32_t first, pending, i;
+	int numThreads, created, start;
+
+	if ( !vk.pipelineBatch ) {
+		return;
+	}
+
+	vk.pipelineBatch = qfalse;
+
+	first = vk.pipelineBatchBase;
+	pending = 0;
+	for ( i = first; i < vk.pipelines_count; i++ ) {
+		if ( vk.pipelines[ i ].handle[ RENDER_PASS_MAIN ] == VK_NULL_HANDLE ) {
+			pending++;
+		}
+	}
+
+	if ( pending == 0 ) {
+		return;
+	}
+
+	numThreads = r_pipelinePrecompile->integer;
+	if ( numThreads > (int)ARRAY_LEN( jobs ) )
+		numThreads = (int)ARRAY_LEN( jobs );
+	if ( numThreads > (int)pending )
+		numThreads = pending;
+
+	start = ri.Milliseconds();
+
+	vk.pipelinePrecompiling = qtrue;
+
+	for ( i = 0; i < (uint32_t)numThreads; i++ ) {
+		jobs[i].first = first + i;
+		jobs[i].stride = numThreads;
+		jobs[i].created = 0;
+#ifdef _WIN32
+		jobs[i].thread = (HANDLE)_beginthreadex( NULL, 0, vk_precompile_thread, &jobs[i], 0, NULL );
+		jobs[i].started = ( jobs[i].thread != NULL ) ? qtrue : qfalse;
+#else
+		jobs[i].started = ( pthread_create( &jobs[i].thread, NULL, vk_precompile_thread, &jobs[i] ) == 0 ) ? qtrue : qfalse;
+#endif
+		if ( !jobs[i].started ) {
+			// do this slice on the calling thread
+			vk_precompile_range( &jobs[i] );
+		}
+	}
+
+	created = 0;
+	for ( i = 0; i < (uint32_t)numThreads; i++ ) {
+		if ( jobs[i].started ) {
+#ifdef _WIN32
+			WaitForSingleObject( jobs[i].thread, INFINITE );
+			CloseHandle( jobs[i].thread );
+#else
+			pthread_join( jobs[i].thread, NULL );
+#endif
+		}
+		created += jobs[i].created;
+	}
+
+	vk.pipelinePrecompiling = qfalse;
+	vk.pipeline_create_count += created;
+
+	// whatever failed on the workers is created again here, where a failure can be reported
+	for ( i = first; i < vk.pipelines_count; i++ ) {
+		if ( vk.pipelines[ i ].handle[ RENDER_PASS_MAIN ] == VK_NULL_HANDLE ) {
+			vk.pipelines[ i ].handle[ RENDER_PASS_MAIN ] = create_pipeline( &vk.pipelines[ i ].def, RENDER_PASS_MAIN, i );
+		}
+	}
+
+	if ( vk.debugMarkers ) {
+		for ( i = first; i < vk.pipelines_count; i++ ) {
+			SET_OBJECT_NAME( vk.pipelines[ i ].handle[ RENDER_PASS_MAIN ], va( "pipeline def#%i, pass#%i", i, RENDER_PASS_MAIN ), VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT );
+		}
+	}
+
+	ri.Printf( PRINT_DEVELOPER, "...precompiled %i pipelines in %i msec using %i threads\n", created, ri.Milliseconds() - start, numThreads );
+}
+
+
 void vk_get_pipeline_def( uint32_t pipeline, Vk_Pipeline_Def *def ) {
 	if ( pipeline >= vk.pipelines_count ) {
 		Com_Memset( def, 0, sizeof( *def ) );
@@ -7034,6 +7557,9 @@ void vk_update_mvp( const float *m ) {
 
 	qvkCmdPushConstants( vk.cmd->command_buffer, vk.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( push_constants ), push_constants );
 
+	// secondary command buffers don't inherit push constants
+	Com_Memcpy( vk.cmd->mvp, push_constants, sizeof( vk.cmd->mvp ) );
+
 	vk.stats.push_size += sizeof( push_constants );
 }
 
@@ -7042,6 +7568,20 @@ static VkBuffer shade_bufs[8];
 static int bind_base;
 static int bind_count;
 
+static void vk_bind_vertex_buffers( uint32_t first, uint32_t count, const VkDeviceSize *offsets )
+{
+	uint32_t i;
+
+	qvkCmdBindVertexBuffers( vk.cmd->command_buffer, first, count, shade_bufs, offsets );
+
+	// secondary command buffers don't inherit vertex buffer bindings
+	for ( i = 0; i < count; i++ ) {
+		vk.cmd->bound_buffer[ first + i ] = shade_bufs[ i ];
+		vk.cmd->bound_offset[ first + i ] = offsets[ i ];
+	}
+}
+
+
 static void vk_bind_index_attr( int index )
 {
 	if ( bind_base == -1 ) {
@@ -7101,6 +7641,55 @@ void vk_draw_indexed( uint32_t indexCount, uint32_t firstIndex )
 {
 	qvkCmdDrawIndexed( vk.cmd->command_buffer, indexCount, 1, firstIndex, 0, 0 );
 }
+
+
+static void vk_record_indexed_items( vk_tess_t *ctx, int firstItem, int numItems, void *data )
+{
+	const VkDrawIndexedIndirectCommand *it = (const VkDrawIndexedIndirectCommand *)data + firstItem;
+	int i;
+
+	for ( i = 0; i < numItems; i++, it++ ) {
+		qvkCmdDrawIndexed( ctx->command_buffer, it->indexCount, 1, it->firstIndex, it->vertexOffset, 0 );
+	}
+}
+
+
+// one draw call per item, long lists are split between the backend workers
+void vk_draw_indexed_items( const VkDrawIndexedIndirectCommand *items, uint32_t count )
+{
+	vk_record_parallel( count, vk_record_indexed_items, (void *)items );
+}
+
+
+uint32_t vk_tess_indirect( const VkDrawIndexedIndirectCommand *cmds, uint32_t count ) {
+	const uint32_t offset = PAD( vk.cmd->vertex_buffer_offset, 4 );
+	const uint32_t size = count * sizeof( cmds[0] );
+
+	if ( offset + size > vk.geometry_buffer_size ) {
+		// schedule geometry buffer resize
+		vk.geometry_buffer_size_new = log2pad( offset + size, 1 );
+		return ~0U;
+	} else {
+		Com_Memcpy( vk.cmd->vertex_buffer_ptr + offset, cmds, size );
+		vk.cmd->vertex_buffer_offset = (VkDeviceSize)offset + size;
+		return offset;
+	}
+}
+
+
+void vk_draw_indexed_indirect( uint32_t offset, uint32_t count )
+{
+	const uint32_t stride = sizeof( VkDrawIndexedIndirectCommand );
+	uint32_t i;
+
+	if ( vk.multiDrawIndirect ) {
+		qvkCmdDrawIndexedIndirect( vk.cmd->command_buffer, vk.cmd->vertex_buffer, offset, count, stride );
+	} else {
+		for ( i = 0; i < count; i++ ) {
+			qvkCmdDrawIndexedIndirect( vk.cmd->command_buffer, vk.cmd->vertex_buffer, offset + i * stride, 1, stride );
+		}
+	}
+}
 #endif
 
 
@@ -7185,7 +7774,7 @@ void vk_bind_geometry( uint32_t flags )
 			vk_bind_index_attr( 7 );
 		}
 
-		qvkCmdBindVertexBuffers( vk.cmd->command_buffer, bind_base, bind_count, shade_bufs, vk.cmd->vbo_offset + bind_base );
+		vk_bind_vertex_buffers( bind_base, bind_count, vk.cmd->vbo_offset + bind_base );
 
 	} else
 #endif // USE_VBO
@@ -7224,7 +7813,7 @@ void vk_bind_geometry( uint32_t flags )
 			vk_bind_attr(7, sizeof( color4ub_t ), tess.svars.colors[2][0].rgba);
 		}
 
-		qvkCmdBindVertexBuffers( vk.cmd->command_buffer, bind_base, bind_count, shade_bufs, vk.cmd->buf_offset + bind_base );
+		vk_bind_vertex_buffers( bind_base, bind_count, vk.cmd->buf_offset + bind_base );
 	}
 }
 
@@ -7243,7 +7832,7 @@ void vk_bind_lighting( int stage, int bundle )
 		vk.cmd->vbo_offset[1] = tess.shader->stages[ stage ]->tex_offset[ bundle ];
 		vk.cmd->vbo_offset[2] = tess.shader->normalOffset;
 
-		qvkCmdBindVertexBuffers( vk.cmd->command_buffer, 0, 3, shade_bufs, vk.cmd->vbo_offset + 0 );
+		vk_bind_vertex_buffers( 0, 3, vk.cmd->vbo_offset + 0 );
 
 	}
 	else
@@ -7255,7 +7844,7 @@ void vk_bind_lighting( int stage, int bundle )
 		vk_bind_attr( 1, sizeof( vec2_t ), tess.svars.texcoordPtr[ bundle ] );
 		vk_bind_attr( 2, sizeof( tess.normal[0] ), tess.normal );
 
-		qvkCmdBindVertexBuffers( vk.cmd->command_buffer, bind_base, bind_count, shade_bufs, vk.cmd->buf_offset + bind_base );
+		vk_bind_vertex_buffers( bind_base, bind_count, vk.cmd->buf_offset + bind_base );
 	}
 }
 
@@ -7344,6 +7933,7 @@ static void vk_update_depth_range( Vk_Depth_Range depth_range )
 
 		get_viewport( &viewport, depth_range );
 		qvkCmdSetViewport( vk.cmd->command_buffer, 0, 1, &viewport );
+		vk.cmd->viewport = viewport;
 	}
 }
 
@@ -7424,10 +8014,13 @@ static void vk_begin_render_pass( VkRenderPass renderPass, VkFramebuffer frameBu
 		render_pass_begin_info.pClearValues = NULL;
 	}
 
-	qvkCmdBeginRenderPass( vk.cmd->command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE );
-
 	vk.cmd->last_pipeline = VK_NULL_HANDLE;
 	vk.cmd->depth_range = DEPTH_RANGE_COUNT;
+
+	// main pass may be recorded into secondary command buffers by the backend workers
+	if ( renderPass != vk.render_pass.main || !vk_begin_secondary_pass( &render_pass_begin_info ) ) {
+		qvkCmdBeginRenderPass( vk.cmd->command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE );
+	}
 }
 
 
@@ -7517,6 +8110,8 @@ static void vk_begin_screenmap_render_pass( void )
 
 void vk_end_render_pass( void )
 {
+	vk_end_secondary_pass();
+
 	qvkCmdEndRenderPass( vk.cmd->command_buffer );
 
 //	vk.renderPassIndex = RENDER_PASS_MAIN;
@@ -7560,6 +8155,13 @@ void vk_begin_frame( void )
 
 #ifdef USE_UPLOAD_QUEUE
 	vk_flush_staging_buffer( qtrue );
+
+	vk.staging_buffer.last_frame_bytes = vk.staging_buffer.frame_bytes;
+	vk.staging_buffer.last_frame_stalls = vk.staging_buffer.frame_stalls;
+	if ( vk.staging_buffer.peak_frame_bytes < vk.staging_buffer.frame_bytes )
+		vk.staging_buffer.peak_frame_bytes = vk.staging_buffer.frame_bytes;
+	vk.staging_buffer.frame_bytes = 0;
+	vk.staging_buffer.frame_stalls = 0;
 #endif
 
 	vk.cmd = &vk.tess[ vk.cmd_index ];
@@ -7579,6 +8181,11 @@ void vk_begin_frame( void )
 		VK_CHECK( qvkResetFences( vk.device, 1, &vk.cmd->rendering_finished_fence ) );
 	}
 
+	// command buffer slot is idle now, recycle its secondary command pools
+	// and release the staging buffers its copies read from
+	vk_backend_begin_frame();
+	vk_mem_release_frame( vk.cmd_index );
+
 	if ( !ri.CL_IsMinimized() && !vk.cmd->swapchain_image_acquired ) {
 		qboolean retry = qfalse;
 _retry:
@@ -7642,6 +8249,7 @@ _retry:
 	vk.cmd->vertex_buffer_offset = 0;
 	Com_Memset( vk.cmd->buf_offset, 0, sizeof( vk.cmd->buf_offset ) );
 	Com_Memset( vk.cmd->vbo_offset, 0, sizeof( vk.cmd->vbo_offset ) );
+	Com_Memset( vk.cmd->bound_buffer, 0, sizeof( vk.cmd->bound_buffer ) );
 	vk.cmd->curr_index_buffer = VK_NULL_HANDLE;
 	vk.cmd->curr_index_offset = 0;
 	vk.cmd->num_indexes = 0;
@@ -7685,7 +8293,8 @@ void vk_end_frame( void )
 {
 #ifdef USE_UPLOAD_QUEUE
 	VkSemaphore waits[2], signals[2];
-	const VkPipelineStageFlags wait_dst_stage_mask[2] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+	// staged buffer uploads may be consumed as vertex input
+	const VkPipelineStageFlags wait_dst_stage_mask[2] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
 #else
 	const VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 #endif
@@ -18,11 +18,13 @@
 #define STAGING_BUFFER_SIZE    (2 * 1024 * 1024)  /* by default */
 #define STAGING_BUFFER_SIZE_HI (24 * 1024 * 1024) /* enough for max.texture size upload with all mip levels at once */
 
-#define IMAGE_CHUNK_SIZE (32 * 1024 * 1024)
-#define MAX_IMAGE_CHUNKS 56
+#define IMAGE_CHUNK_SIZE (32 * 1024 * 1024)	// limits maxTextureSize
 
 #define NUM_COMMAND_BUFFERS 2	// number of command buffers / render semaphores / framebuffer sets
 
+#define NUM_STAGING_SLOTS (NUM_COMMAND_BUFFERS+1)	// staging submissions that may be in flight
+#define MAX_STAGING_COPIES 64	// buffer copy regions batched into a single vkCmdCopyBuffer
+
 #define USE_REVERSED_DEPTH
 
 #define USE_UPLOAD_QUEUE
@@ -262,6 +264,44 @@ void vk_destroy_samplers( void );
 
 // Memory and buffer management
 uint32_t vk_find_memory_type( uint32_t memory_type_bits, VkMemoryPropertyFlags properties );
+
+// vk_memory.c - device memory sub-allocator
+extern PFN_vkGetPhysicalDeviceMemoryProperties	qvkGetPhysicalDeviceMemoryProperties;
+extern PFN_vkAllocateMemory						qvkAllocateMemory;
+extern PFN_vkFreeMemory							qvkFreeMemory;
+extern PFN_vkMapMemory							qvkMapMemory;
+extern PFN_vkUnmapMemory						qvkUnmapMemory;
+extern PFN_vkBindBufferMemory					qvkBindBufferMemory;
+extern PFN_vkBindImageMemory					qvkBindImageMemory;
+extern PFN_vkGetBufferMemoryRequirements		qvkGetBufferMemoryRequirements;
+extern PFN_vkGetImageMemoryRequirements			qvkGetImageMemoryRequirements;
+extern PFN_vkDestroyBuffer						qvkDestroyBuffer;
+extern PFN_vkCmdBindDescriptorSets				qvkCmdBindDescriptorSets;
+extern PFN_vkCmdBindIndexBuffer					qvkCmdBindIndexBuffer;
+extern PFN_vkCmdBindPipeline					qvkCmdBindPipeline;
+extern PFN_vkCmdBindVertexBuffers				qvkCmdBindVertexBuffers;
+extern PFN_vkCmdSetScissor						qvkCmdSetScissor;
+extern PFN_vkCmdSetViewport						qvkCmdSetViewport;
+extern PFN_vkCreateCommandPool					qvkCreateCommandPool;
+extern PFN_vkAllocateCommandBuffers				qvkAllocateCommandBuffers;
+extern PFN_vkCmdBeginRenderPass					qvkCmdBeginRenderPass;
+extern PFN_vkCmdPushConstants					qvkCmdPushConstants;
+extern PFN_vkDestroyCommandPool					qvkDestroyCommandPool;
+extern PFN_vkBeginCommandBuffer					qvkBeginCommandBuffer;
+extern PFN_vkEndCommandBuffer					qvkEndCommandBuffer;
+extern PFN_vkCmdExecuteCommands					qvkCmdExecuteCommands;
+extern PFN_vkResetCommandPool					qvkResetCommandPool;
+
+void vk_mem_init( void );
+void vk_mem_shutdown( void );
+void vk_mem_trim( void );
+VkDeviceMemory vk_mem_bind_buffer( VkBuffer buffer, VkMemoryPropertyFlags properties, qboolean dedicated );
+VkDeviceMemory vk_mem_bind_image( VkImage image, VkMemoryPropertyFlags properties, qboolean dedicated );
+void *vk_mem_mapped( uint64_t handle );
+void vk_mem_free( uint64_t handle );
+void vk_mem_destroy_buffer_deferred( VkBuffer buffer );
+void vk_mem_release_frame( int cmd_index );
+void vk_meminfo_f( void );
 void vk_upload_buffer_data( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, const void *data );
 
 uint32_t vk_find_pipeline_ext( uint32_t base, const Vk_Pipeline_Def *def, qboolean use );
@@ -269,6 +309,8 @@ void vk_get_pipeline_def( uint32_t pipeline, Vk_Pipeline_Def *def );
 
 void vk_create_post_process_pipeline( int program_index, uint32_t width, uint32_t height );
 void vk_create_pipelines( void );
+void vk_begin_pipeline_batch( void );
+void vk_precompile_pipelines( void );
 
 //
 // Rendering setup.
@@ -305,6 +347,9 @@ uint32_t vk_tess_index( uint32_t numIndexes, const void *src );
 void vk_bind_index_buffer( VkBuffer buffer, uint32_t offset );
 #ifdef USE_VBO
 void vk_draw_indexed( uint32_t indexCount, uint32_t firstIndex );
+uint32_t vk_tess_indirect( const VkDrawIndexedIndirectCommand *cmds, uint32_t count );
+void vk_draw_indexed_indirect( uint32_t offset, uint32_t count );
+void vk_draw_indexed_items( const VkDrawIndexedIndirectCommand *items, uint32_t count );
 #endif
 void vk_reset_descriptor( int index );
 void vk_update_descriptor( int index, VkDescriptorSet descriptor );
@@ -338,6 +383,8 @@ typedef struct vk_tess_s {
 	uint32_t		uniform_read_offset;
 	VkDeviceSize	buf_offset[8];
 	VkDeviceSize	vbo_offset[8];
+	VkBuffer		bound_buffer[8];	// most recent vertex buffer bindings,
+	VkDeviceSize	bound_offset[8];	// replayed into secondary command buffers
 
 	VkBuffer		curr_index_buffer;
 	uint32_t		curr_index_offset;
@@ -349,11 +396,14 @@ typedef struct vk_tess_s {
 	} descriptor_set;
 
 	Vk_Depth_Range		depth_range;
+	VkViewport			viewport; // set along with depth_range
 	VkPipeline			last_pipeline;
 
 	uint32_t num_indexes; // value from most recent vk_bind_index() call
 
 	VkRect2D scissor_rect;
+
+	float mvp[16]; // most recent vk_update_mvp() push constants
 } vk_tess_t;
 
 
@@ -376,9 +426,6 @@ typedef struct {
 	//uint32_t swapchain_image_index;
 
 	VkCommandPool command_pool;
-#ifdef USE_UPLOAD_QUEUE
-	VkCommandBuffer staging_command_buffer;
-#endif
 
 	VkDeviceMemory image_memory[ MAX_ATTACHMENTS_IN_POOL ];
 	uint32_t image_memory_count;
@@ -529,6 +576,11 @@ typedef struct {
 	// pipeline statistics
 	int32_t pipeline_create_count;
 
+	// level load pipeline batch, see vk_precompile_pipelines()
+	qboolean pipelineBatch;
+	qboolean pipelinePrecompiling;
+	uint32_t pipelineBatchBase;
+
 	//
 	// Standard pipelines.
 	//
@@ -586,6 +638,7 @@ typedef struct {
 	qboolean samplerAnisotropy;
 	qboolean fragmentStores;
 	qboolean pipelineStatisticsQuery;
+	qboolean multiDrawIndirect;
 	qboolean dedicatedAllocation;
 	qboolean debugMarkers;
 
@@ -623,22 +676,41 @@ typedef struct {
 	uint32_t screenMapHeight;
 	uint32_t screenMapSamples;
 
-	uint32_t image_chunk_size;
-
 	uint32_t maxBoundDescriptorSets;
 
-#ifdef USE_UPLOAD_QUEUE
-	VkFence aux_fence;
-	qboolean aux_fence_wait;
-#endif
-
 	struct staging_buffer_s {
 		VkBuffer handle;
 		VkDeviceMemory memory;
 		VkDeviceSize size;
-		byte *ptr; // pointer to mapped staging buffer
+		byte *ptr; // pointer to persistently mapped staging buffer
 #ifdef USE_UPLOAD_QUEUE
-		VkDeviceSize offset;
+		// ring state, data between tail and head is owned by the GPU
+		VkDeviceSize head;
+		VkDeviceSize tail;
+		qboolean recording;		// slots[slot].cmd is being recorded
+		qboolean unsynced;		// submitted without signalling image_uploaded yet
+		uint32_t slot;			// slot used for recording
+		uint32_t oldest;		// oldest slot in flight
+		uint32_t pending;		// number of slots in flight
+		struct {
+			VkCommandBuffer cmd;
+			VkFence fence;
+			VkDeviceSize end;	// ring position released once the fence is signalled, start of data while recording
+		} slots[ NUM_STAGING_SLOTS ];
+
+		// buffer copies batched per destination buffer
+		VkBuffer copy_dst;
+		VkBufferCopy copies[ MAX_STAGING_COPIES ];
+		uint32_t num_copies;
+
+		// statistics
+		VkDeviceSize frame_bytes;
+		VkDeviceSize last_frame_bytes;
+		VkDeviceSize peak_frame_bytes;
+		uint32_t frame_stalls;
+		uint32_t last_frame_stalls;
+		uint32_t stalls;
+		uint32_t submits;
 #endif
 	} staging_buffer;
 
@@ -657,20 +729,9 @@ typedef struct {
 
 } Vk_Instance;
 
-typedef struct {
-	VkDeviceMemory memory;
-	VkDeviceSize used;
-} ImageChunk;
-
 // Vk_World contains vulkan resources/state requested by the game code.
 // It is reinitialized on a map change.
 typedef struct {
-	//
-	// Memory allocations.
-	//
-	int num_image_chunks;
-	ImageChunk image_chunks[MAX_IMAGE_CHUNKS];
-
 	//
 	// State.
 	//
@@ -694,9 +755,24 @@ uint32_t* R_LoadSPIRV( const char *filename, uint32_t *codeSize );
 
 // Staging buffer management
 void vk_push_staging_buffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, const void *data );
+byte *vk_staging_alloc( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset );
+void vk_staging_copy_buffer( VkBuffer buffer, VkDeviceSize src_offset, VkDeviceSize dst_offset, VkDeviceSize size );
+void vk_staging_info_f( void );
 void vk_begin_command_buffer( VkCommandBuffer commandBuffer );
 void vk_end_command_buffer( VkCommandBuffer commandBuffer );
 
+// Parallel secondary command buffer recording
+// func records items [firstItem, firstItem+numItems) into ctx->command_buffer,
+// it may run on a worker thread so it must not touch tess, backEnd or vk.cmd;
+// ctx starts with everything that was bound when vk_record_parallel was called
+typedef void (*vkRecordFunc_t)( vk_tess_t *ctx, int firstItem, int numItems, void *data );
+
+void vk_backend_begin_frame( void );
+qboolean vk_begin_secondary_pass( const VkRenderPassBeginInfo *beginInfo );
+void vk_end_secondary_pass( void );
+void vk_record_parallel( int numItems, vkRecordFunc_t func, void *data );
+void vk_backend_info_f( void );
+
 // Vulkan error checking macro
 #ifndef VK_CHECK
 #define VK_CHECK( function_call ) { \
@@ -10,7 +10,7 @@ the Free Software Foundation; either version 2 of the License, or
 (at your option) any later version.
 ===========================================================================
 */
-// vk_backend_thread.c - Vulkan backend thread support
+// vk_backend_thread.c - parallel secondary command buffer recording
 
 #include "vk.h"
 
@@ -19,46 +19,308 @@ the Free Software Foundation; either version 2 of the License, or
 #include <process.h>
 #else
 #include <pthread.h>
+#include <time.h>
 #endif
 
+#define MAX_BACKEND_WORKERS     8
+#define MAX_FRAME_SECONDARIES   128     // per worker and command buffer slot
+#define MAX_RECORD_CHUNKS       32
+#define MIN_CHUNK_ITEMS         64      // shorter lists are recorded inline
+
+typedef struct {
+    // one pool per command buffer slot so it can be reset once that frame has retired
+    VkCommandPool   pool[ NUM_COMMAND_BUFFERS ];
+    VkCommandBuffer buffers[ NUM_COMMAND_BUFFERS ][ MAX_FRAME_SECONDARIES ];
+    uint32_t        numAllocated[ NUM_COMMAND_BUFFERS ];
+    uint32_t        numUsed[ NUM_COMMAND_BUFFERS ];
+
+#ifdef _WIN32
+    HANDLE          thread;
+#else
+    pthread_t       thread;
+#endif
+    qboolean        started;
+} backendWorker_t;
+
 typedef struct {
     qboolean initialized;
     qboolean shouldTerminate;
-    qboolean isRunning;
-    
+    qboolean workersTried;      // workers are started by the first parallel record
+
+    // worker threads, slot 0 belongs to the render thread
+    int             numWorkers;
+    backendWorker_t workers[ MAX_BACKEND_WORKERS + 1 ];
+
 #ifdef _WIN32
-    HANDLE thread;
-    HANDLE workSemaphore;
-    HANDLE doneSemaphore;
-    CRITICAL_SECTION commandMutex;
+    CRITICAL_SECTION jobMutex;
+    HANDLE          workSemaphore;
+    HANDLE          doneSemaphore;
 #else
-    pthread_t thread;
-    pthread_mutex_t commandMutex;
-    pthread_cond_t workCond;
-    pthread_cond_t doneCond;
+    pthread_mutex_t jobMutex;
+    pthread_cond_t  workCond;
+    pthread_cond_t  doneCond;
 #endif
-    
-    // Command buffer for backend thread
-    VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
-    VkFence fence;
-    
-    // Work queue
-    void (*workFunction)(void*);
-    void *workData;
-    qboolean hasWork;
+
+    // current job, chunks are handed out under jobMutex
+    vkRecordFunc_t  func;
+    void            *data;
+    vk_tess_t       base;
+    int             numItems;
+    int             chunkItems;
+    int             numChunks;
+    int             nextChunk;
+    int             doneChunks;
+    qboolean        waiting;
+    VkCommandBuffer chunkBuffers[ MAX_RECORD_CHUNKS ];
+
+    // render pass recorded with secondary contents
+    qboolean        passActive;
+    VkCommandBuffer primary;
+    VkCommandBufferInheritanceInfo inheritance;
+    VkCommandBuffer passBuffers[ MAX_FRAME_SECONDARIES ];
+    uint32_t        numPassBuffers;
+
+    // main pass recording time, measured in both modes
+    qboolean        passTimed;
+    int64_t         passStart;
+
+    struct {
+        int64_t     passUsec;
+        int64_t     recordUsec;
+        int         jobs;
+        int         chunks;
+        int         items;
+        int         secondaries;
+    } frame, last;
+    int64_t         peakPassUsec;
 } backendThread_t;
 
 static backendThread_t backendThread;
 
-// Forward declaration
-void vk_shutdown_backend_thread( void );
+static cvar_t *r_backendThreads;
+
+
+/*
+================
+vk_backend_usec
+
+High resolution timer for the record statistics
+================
+*/
+static int64_t vk_backend_usec( void ) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &count );
+
+    return (int64_t)( count.QuadPart * 1000000 / freq.QuadPart );
+#else
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+
+static void vk_job_lock( void ) {
+#ifdef _WIN32
+    EnterCriticalSection( &backendThread.jobMutex );
+#else
+    pthread_mutex_lock( &backendThread.jobMutex );
+#endif
+}
+
+
+static void vk_job_unlock( void ) {
+#ifdef _WIN32
+    LeaveCriticalSection( &backendThread.jobMutex );
+#else
+    pthread_mutex_unlock( &backendThread.jobMutex );
+#endif
+}
+
+
+/*
+================
+vk_alloc_secondary
+
+Returns a secondary command buffer from the worker's pool for the current frame.
+Callers make sure MAX_FRAME_SECONDARIES is not exceeded.
+================
+*/
+static VkCommandBuffer vk_alloc_secondary( backendWorker_t *worker ) {
+    const uint32_t slot = vk.cmd_index;
+
+    if ( worker->numUsed[ slot ] == worker->numAllocated[ slot ] ) {
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = worker->pool[ slot ],
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1
+        };
+
+        VK_CHECK( qvkAllocateCommandBuffers( vk.device, &allocInfo, &worker->buffers[ slot ][ worker->numAllocated[ slot ] ] ) );
+        worker->numAllocated[ slot ]++;
+    }
+
+    return worker->buffers[ slot ][ worker->numUsed[ slot ]++ ];
+}
+
+
+/*
+================
+vk_reset_bind_state
+
+State bound in the primary is undefined after executing secondaries, drop
+cached binds and mark every cached descriptor for rebinding on the next draw
+================
+*/
+static void vk_reset_bind_state( vk_tess_t *ctx ) {
+    uint32_t i;
+
+    ctx->last_pipeline = VK_NULL_HANDLE;
+    ctx->depth_range = DEPTH_RANGE_COUNT;
+    ctx->curr_index_buffer = VK_NULL_HANDLE;
+    ctx->curr_index_offset = 0;
+    Com_Memset( &ctx->scissor_rect, 0, sizeof( ctx->scissor_rect ) );
+    Com_Memset( ctx->bound_buffer, 0, sizeof( ctx->bound_buffer ) );
+
+    ctx->descriptor_set.start = ~0U;
+    ctx->descriptor_set.end = 0;
+    for ( i = 0; i < VK_DESC_COUNT; i++ ) {
+        if ( ctx->descriptor_set.current[ i ] != VK_NULL_HANDLE ) {
+            if ( ctx->descriptor_set.start == ~0U ) {
+                ctx->descriptor_set.start = i;
+            }
+            ctx->descriptor_set.end = i;
+        }
+    }
+}
+
+
+/*
+================
+vk_restore_bind_state
+
+Nothing is inherited by a secondary command buffer, rebind everything the
+cached state says is bound so recording continues as if in the primary
+================
+*/
+static void vk_restore_bind_state( vk_tess_t *ctx ) {
+    const VkCommandBuffer cmd = ctx->command_buffer;
+    uint32_t i;
+
+    if ( ctx->last_pipeline != VK_NULL_HANDLE ) {
+        qvkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->last_pipeline );
+    }
+
+    // depth_range is reset whenever viewport and scissor must be set again
+    if ( ctx->depth_range != DEPTH_RANGE_COUNT ) {
+        qvkCmdSetViewport( cmd, 0, 1, &ctx->viewport );
+        qvkCmdSetScissor( cmd, 0, 1, &ctx->scissor_rect );
+    }
+
+    for ( i = 0; i < VK_DESC_COUNT; i++ ) {
+        if ( ctx->descriptor_set.current[ i ] != VK_NULL_HANDLE ) {
+            if ( i == VK_DESC_UNIFORM ) {
+                qvkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk.pipeline_layout, i, 1, &ctx->descriptor_set.current[ i ], 1, &ctx->descriptor_set.offset[ i ] );
+            } else {
+                qvkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk.pipeline_layout, i, 1, &ctx->descriptor_set.current[ i ], 0, NULL );
+            }
+        }
+    }
+    ctx->descriptor_set.start = ~0U;
+    ctx->descriptor_set.end = 0;
+
+    for ( i = 0; i < ARRAY_LEN( ctx->bound_buffer ); i++ ) {
+        if ( ctx->bound_buffer[ i ] != VK_NULL_HANDLE ) {
+            qvkCmdBindVertexBuffers( cmd, i, 1, &ctx->bound_buffer[ i ], &ctx->bound_offset[ i ] );
+        }
+    }
+
+    if ( ctx->curr_index_buffer != VK_NULL_HANDLE ) {
+        qvkCmdBindIndexBuffer( cmd, ctx->curr_index_buffer, ctx->curr_index_offset, VK_INDEX_TYPE_UINT32 );
+    }
+
+    qvkCmdPushConstants( cmd, vk.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( ctx->mvp ), ctx->mvp );
+}
+
+
+/*
+================
+vk_begin_secondary
+
+Starts a secondary command buffer that continues the current render pass
+================
+*/
+static void vk_begin_secondary( vk_tess_t *ctx, VkCommandBuffer cmd ) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = &backendThread.inheritance
+    };
+
+    VK_CHECK( qvkBeginCommandBuffer( cmd, &beginInfo ) );
+
+    ctx->command_buffer = cmd;
+    vk_restore_bind_state( ctx );
+}
+
+
+/*
+================
+vk_process_chunks
+
+Records chunks of the current job until none are left
+================
+*/
+static void vk_process_chunks( backendWorker_t *worker ) {
+    vk_tess_t ctx;
+    int chunk, first, count;
+
+    for ( ;; ) {
+        vk_job_lock();
+        if ( backendThread.nextChunk >= backendThread.numChunks ) {
+            vk_job_unlock();
+            return;
+        }
+        chunk = backendThread.nextChunk++;
+        vk_job_unlock();
+
+        first = chunk * backendThread.chunkItems;
+        count = backendThread.numItems - first;
+        if ( count > backendThread.chunkItems ) {
+            count = backendThread.chunkItems;
+        }
+
+        ctx = backendThread.base;
+        vk_begin_secondary( &ctx, vk_alloc_secondary( worker ) );
+        backendThread.func( &ctx, first, count, backendThread.data );
+        VK_CHECK( qvkEndCommandBuffer( ctx.command_buffer ) );
+
+        vk_job_lock();
+        backendThread.chunkBuffers[ chunk ] = ctx.command_buffer;
+        if ( ++backendThread.doneChunks == backendThread.numChunks && backendThread.waiting ) {
+            backendThread.waiting = qfalse;
+#ifdef _WIN32
+            ReleaseSemaphore( backendThread.doneSemaphore, 1, NULL );
+#else
+            pthread_cond_signal( &backendThread.doneCond );
+#endif
+        }
+        vk_job_unlock();
+    }
+}
+
 
 /*
 ================
 vk_backend_thread_function
 
-Backend thread main loop
+Worker thread main loop
 ================
 */
 #ifdef _WIN32
@@ -67,52 +329,29 @@ static unsigned __stdcall vk_backend_thread_function( void *arg )
 static void* vk_backend_thread_function( void *arg )
 #endif
 {
-    (void)arg;
-    
-    backendThread.isRunning = qtrue;
-    
-    while ( !backendThread.shouldTerminate ) {
+    backendWorker_t *worker = (backendWorker_t *)arg;
+
+    for ( ;; ) {
 #ifdef _WIN32
-        // Wait for work
+        // stale wakeups just find no chunks left
         WaitForSingleObject( backendThread.workSemaphore, INFINITE );
-        
         if ( backendThread.shouldTerminate ) {
             break;
         }
-        
-        EnterCriticalSection( &backendThread.commandMutex );
 #else
-        pthread_mutex_lock( &backendThread.commandMutex );
-        
-        while ( !backendThread.hasWork && !backendThread.shouldTerminate ) {
-            pthread_cond_wait( &backendThread.workCond, &backendThread.commandMutex );
+        pthread_mutex_lock( &backendThread.jobMutex );
+        while ( backendThread.nextChunk >= backendThread.numChunks && !backendThread.shouldTerminate ) {
+            pthread_cond_wait( &backendThread.workCond, &backendThread.jobMutex );
         }
-        
         if ( backendThread.shouldTerminate ) {
-            pthread_mutex_unlock( &backendThread.commandMutex );
+            pthread_mutex_unlock( &backendThread.jobMutex );
             break;
         }
+        pthread_mutex_unlock( &backendThread.jobMutex );
 #endif
-        
-        // Execute work function if available
-        if ( backendThread.workFunction && backendThread.hasWork ) {
-            backendThread.workFunction( backendThread.workData );
-            backendThread.workFunction = NULL;
-            backendThread.workData = NULL;
-            backendThread.hasWork = qfalse;
-        }
-        
-#ifdef _WIN32
-        LeaveCriticalSection( &backendThread.commandMutex );
-        ReleaseSemaphore( backendThread.doneSemaphore, 1, NULL );
-#else
-        pthread_cond_signal( &backendThread.doneCond );
-        pthread_mutex_unlock( &backendThread.commandMutex );
-#endif
+        vk_process_chunks( worker );
     }
-    
-    backendThread.isRunning = qfalse;
-    
+
 #ifdef _WIN32
     return 0;
 #else
@@ -120,225 +359,405 @@ static void* vk_backend_thread_function( void *arg )
 #endif
 }
 
+
 /*
 ================
-vk_initialize_backend_thread
+vk_stop_workers
 
-Initialize backend thread for Vulkan rendering
+Joins worker threads and releases their command pools
 ================
 */
-void vk_initialize_backend_thread( void ) {
-    VkResult result;
-    
-    if ( backendThread.initialized ) {
-        return;
+static void vk_stop_workers( void ) {
+    int i, j;
+
+    if ( backendThread.numWorkers > 0 ) {
+        vk_job_lock();
+        backendThread.shouldTerminate = qtrue;
+#ifdef _WIN32
+        vk_job_unlock();
+        ReleaseSemaphore( backendThread.workSemaphore, backendThread.numWorkers, NULL );
+#else
+        pthread_cond_broadcast( &backendThread.workCond );
+        vk_job_unlock();
+#endif
+
+        for ( i = 1; i <= backendThread.numWorkers; i++ ) {
+            if ( !backendThread.workers[ i ].started ) {
+                continue;
+            }
+#ifdef _WIN32
+            WaitForSingleObject( backendThread.workers[ i ].thread, INFINITE );
+            CloseHandle( backendThread.workers[ i ].thread );
+#else
+            pthread_join( backendThread.workers[ i ].thread, NULL );
+#endif
+            backendThread.workers[ i ].started = qfalse;
+        }
+
+#ifdef _WIN32
+        CloseHandle( backendThread.workSemaphore );
+        CloseHandle( backendThread.doneSemaphore );
+        DeleteCriticalSection( &backendThread.jobMutex );
+#else
+        pthread_mutex_destroy( &backendThread.jobMutex );
+        pthread_cond_destroy( &backendThread.workCond );
+        pthread_cond_destroy( &backendThread.doneCond );
+#endif
     }
-    
-    Com_Memset( &backendThread, 0, sizeof(backendThread) );
-    
-    // Create command pool for backend thread
+
+    for ( i = 0; i <= MAX_BACKEND_WORKERS; i++ ) {
+        for ( j = 0; j < NUM_COMMAND_BUFFERS; j++ ) {
+            if ( backendThread.workers[ i ].pool[ j ] != VK_NULL_HANDLE ) {
+                qvkDestroyCommandPool( vk.device, backendThread.workers[ i ].pool[ j ], NULL );
+            }
+        }
+    }
+
+    Com_Memset( backendThread.workers, 0, sizeof( backendThread.workers ) );
+    backendThread.numWorkers = 0;
+    backendThread.shouldTerminate = qfalse;
+}
+
+
+/*
+================
+vk_start_workers
+
+Starts r_backendThreads workers that record main pass draw chunks
+================
+*/
+static void vk_start_workers( void ) {
     VkCommandPoolCreateInfo poolInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
         .queueFamilyIndex = vk.queue_family_index
     };
-    
-    result = vkCreateCommandPool( vk.device, &poolInfo, NULL, &backendThread.commandPool );
-    if ( result != VK_SUCCESS ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to create command pool\n" );
-        return;
-    }
-    
-    // Allocate command buffer
-    VkCommandBufferAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = backendThread.commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1
-    };
-    
-    result = vkAllocateCommandBuffers( vk.device, &allocInfo, &backendThread.commandBuffer );
-    if ( result != VK_SUCCESS ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to allocate command buffer\n" );
-        vkDestroyCommandPool( vk.device, backendThread.commandPool, NULL );
-        backendThread.commandPool = VK_NULL_HANDLE;
+    int numWorkers, i, j;
+
+    backendThread.workersTried = qtrue;
+
+    numWorkers = r_backendThreads->integer;
+    if ( numWorkers <= 0 ) {
         return;
     }
-    
-    // Create fence for synchronization
-    VkFenceCreateInfo fenceInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
-    };
-    
-    result = vkCreateFence( vk.device, &fenceInfo, NULL, &backendThread.fence );
-    if ( result != VK_SUCCESS ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to create fence\n" );
-        vkDestroyCommandPool( vk.device, backendThread.commandPool, NULL );
-        backendThread.commandPool = VK_NULL_HANDLE;
-        return;
+
+    for ( i = 0; i <= numWorkers; i++ ) {
+        for ( j = 0; j < NUM_COMMAND_BUFFERS; j++ ) {
+            if ( qvkCreateCommandPool( vk.device, &poolInfo, NULL, &backendThread.workers[ i ].pool[ j ] ) != VK_SUCCESS ) {
+                ri.Printf( PRINT_WARNING, "vk_start_workers: Failed to create command pool\n" );
+                vk_stop_workers();
+                return;
+            }
+        }
     }
-    
+
 #ifdef _WIN32
-    // Initialize Windows synchronization primitives
-    InitializeCriticalSection( &backendThread.commandMutex );
-    backendThread.workSemaphore = CreateSemaphore( NULL, 0, 1, NULL );
+    InitializeCriticalSection( &backendThread.jobMutex );
+    backendThread.workSemaphore = CreateSemaphore( NULL, 0, MAX_BACKEND_WORKERS * MAX_RECORD_CHUNKS, NULL );
     backendThread.doneSemaphore = CreateSemaphore( NULL, 0, 1, NULL );
-    
-    if ( !backendThread.workSemaphore || !backendThread.doneSemaphore ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to create semaphores\n" );
-        vk_shutdown_backend_thread();
-        return;
-    }
-    
-    // Create thread
-    backendThread.thread = (HANDLE)_beginthreadex( NULL, 0, vk_backend_thread_function, NULL, 0, NULL );
-    if ( !backendThread.thread ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to create thread\n" );
-        vk_shutdown_backend_thread();
-        return;
-    }
 #else
-    // Initialize POSIX synchronization primitives
-    pthread_mutex_init( &backendThread.commandMutex, NULL );
+    pthread_mutex_init( &backendThread.jobMutex, NULL );
     pthread_cond_init( &backendThread.workCond, NULL );
     pthread_cond_init( &backendThread.doneCond, NULL );
-    
-    // Create thread
-    if ( pthread_create( &backendThread.thread, NULL, vk_backend_thread_function, NULL ) != 0 ) {
-        ri.Printf( PRINT_WARNING, "vk_initialize_backend_thread: Failed to create thread\n" );
-        vk_shutdown_backend_thread();
+#endif
+    backendThread.numWorkers = numWorkers;
+
+#ifdef _WIN32
+    if ( !backendThread.workSemaphore || !backendThread.doneSemaphore ) {
+        ri.Printf( PRINT_WARNING, "vk_start_workers: Failed to create semaphores\n" );
+        vk_stop_workers();
         return;
     }
 #endif
-    
+
+    for ( i = 1; i <= numWorkers; i++ ) {
+        backendWorker_t *worker = &backendThread.workers[ i ];
+#ifdef _WIN32
+        worker->thread = (HANDLE)_beginthreadex( NULL, 0, vk_backend_thread_function, worker, 0, NULL );
+        worker->started = worker->thread ? qtrue : qfalse;
+#else
+        worker->started = ( pthread_create( &worker->thread, NULL, vk_backend_thread_function, worker ) == 0 ) ? qtrue : qfalse;
+#endif
+        if ( !worker->started ) {
+            ri.Printf( PRINT_WARNING, "vk_start_workers: Failed to create thread\n" );
+            vk_stop_workers();
+            return;
+        }
+    }
+
+    ri.Printf( PRINT_DEVELOPER, "Backend recording with %i worker threads\n", numWorkers );
+}
+
+
+/*
+================
+vk_initialize_backend_thread
+
+Registers the backend cvars. Worker threads are only started by the first
+vk_record_parallel call, so a front-end that doesn't use them pays for
+neither the threads nor secondary command buffers in the main pass.
+================
+*/
+void vk_initialize_backend_thread( void ) {
+    if ( backendThread.initialized ) {
+        return;
+    }
+
+    Com_Memset( &backendThread, 0, sizeof( backendThread ) );
+
+    r_backendThreads = ri.Cvar_Get( "r_backendThreads", "0", CVAR_ARCHIVE_ND | CVAR_LATCH );
+    ri.Cvar_CheckRange( r_backendThreads, "0", "8", CV_INTEGER );
+    ri.Cvar_SetDescription( r_backendThreads, "Number of worker threads recording the main render pass into secondary command buffers, 0 records inline on the render thread." );
+
+    // statistics are collected in inline mode too
     backendThread.initialized = qtrue;
-    ri.Printf( PRINT_DEVELOPER, "Backend thread initialized\n" );
 }
 
+
 /*
 ================
 vk_shutdown_backend_thread
 
-Shutdown backend thread
+Shutdown backend workers
 ================
 */
 void vk_shutdown_backend_thread( void ) {
     if ( !backendThread.initialized ) {
         return;
     }
-    
-    // Signal thread to terminate
-    backendThread.shouldTerminate = qtrue;
-    
-#ifdef _WIN32
-    // Wake up thread and wait for termination
-    if ( backendThread.thread ) {
-        ReleaseSemaphore( backendThread.workSemaphore, 1, NULL );
-        WaitForSingleObject( backendThread.thread, 5000 );
-        CloseHandle( backendThread.thread );
-    }
-    
-    // Cleanup synchronization objects
-    if ( backendThread.workSemaphore ) {
-        CloseHandle( backendThread.workSemaphore );
+
+    vk_stop_workers();
+
+    Com_Memset( &backendThread, 0, sizeof( backendThread ) );
+}
+
+
+/*
+================
+vk_backend_begin_frame
+
+Called once the current command buffer slot has retired.
+Recycles its secondary command buffers and rolls the statistics.
+================
+*/
+void vk_backend_begin_frame( void ) {
+    const uint32_t slot = vk.cmd_index;
+    int i;
+
+    backendThread.last = backendThread.frame;
+    if ( backendThread.peakPassUsec < backendThread.frame.passUsec ) {
+        backendThread.peakPassUsec = backendThread.frame.passUsec;
     }
-    if ( backendThread.doneSemaphore ) {
-        CloseHandle( backendThread.doneSemaphore );
+    Com_Memset( &backendThread.frame, 0, sizeof( backendThread.frame ) );
+
+    if ( backendThread.numWorkers == 0 ) {
+        return;
     }
-    DeleteCriticalSection( &backendThread.commandMutex );
-#else
-    // Wake up thread and wait for termination
-    if ( backendThread.thread ) {
-        pthread_mutex_lock( &backendThread.commandMutex );
-        backendThread.hasWork = qtrue;
-        pthread_cond_signal( &backendThread.workCond );
-        pthread_mutex_unlock( &backendThread.commandMutex );
-        
-        pthread_join( backendThread.thread, NULL );
+
+    for ( i = 0; i <= backendThread.numWorkers; i++ ) {
+        backendWorker_t *worker = &backendThread.workers[ i ];
+        if ( worker->numUsed[ slot ] ) {
+            VK_CHECK( qvkResetCommandPool( vk.device, worker->pool[ slot ], 0 ) );
+            worker->numUsed[ slot ] = 0;
+        }
     }
-    
-    // Cleanup synchronization objects
-    pthread_mutex_destroy( &backendThread.commandMutex );
-    pthread_cond_destroy( &backendThread.workCond );
-    pthread_cond_destroy( &backendThread.doneCond );
-#endif
-    
-    // Cleanup Vulkan resources
-    if ( backendThread.fence != VK_NULL_HANDLE ) {
-        vkDestroyFence( vk.device, backendThread.fence, NULL );
+}
+
+
+/*
+================
+vk_begin_secondary_pass
+
+Begins the render pass with secondary command buffer contents and redirects
+vk.cmd->command_buffer into a render thread secondary, so inline recording
+keeps working. Returns qfalse if the pass should be recorded inline.
+================
+*/
+qboolean vk_begin_secondary_pass( const VkRenderPassBeginInfo *beginInfo ) {
+    backendThread.passTimed = qtrue;
+    backendThread.passStart = vk_backend_usec();
+
+    if ( backendThread.numWorkers == 0 || backendThread.passActive ) {
+        return qfalse;
     }
-    
-    if ( backendThread.commandPool != VK_NULL_HANDLE ) {
-        vkDestroyCommandPool( vk.device, backendThread.commandPool, NULL );
+
+    if ( backendThread.workers[ 0 ].numUsed[ vk.cmd_index ] + 1 >= MAX_FRAME_SECONDARIES ) {
+        return qfalse;
     }
-    
-    Com_Memset( &backendThread, 0, sizeof(backendThread) );
-    ri.Printf( PRINT_DEVELOPER, "Backend thread shutdown\n" );
+
+    Com_Memset( &backendThread.inheritance, 0, sizeof( backendThread.inheritance ) );
+    backendThread.inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    backendThread.inheritance.renderPass = beginInfo->renderPass;
+    backendThread.inheritance.subpass = 0;
+    backendThread.inheritance.framebuffer = beginInfo->framebuffer;
+
+    backendThread.primary = vk.cmd->command_buffer;
+    qvkCmdBeginRenderPass( backendThread.primary, beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+
+    backendThread.passActive = qtrue;
+    backendThread.numPassBuffers = 0;
+
+    vk_begin_secondary( vk.cmd, vk_alloc_secondary( &backendThread.workers[ 0 ] ) );
+
+    return qtrue;
 }
 
+
 /*
 ================
-vk_submit_backend_work
+vk_end_secondary_pass
 
-Submit work to backend thread
+Executes recorded secondaries in order and switches back to the primary
+command buffer, the caller ends the render pass
 ================
 */
-void vk_submit_backend_work( void (*function)(void*), void *data ) {
-    if ( !backendThread.initialized || backendThread.shouldTerminate ) {
-        // Execute synchronously if thread not available
-        if ( function ) {
-            function( data );
-        }
+void vk_end_secondary_pass( void ) {
+    if ( backendThread.passTimed ) {
+        backendThread.frame.passUsec += vk_backend_usec() - backendThread.passStart;
+        backendThread.passTimed = qfalse;
+    }
+
+    if ( !backendThread.passActive ) {
         return;
     }
-    
-#ifdef _WIN32
-    EnterCriticalSection( &backendThread.commandMutex );
-    
-    backendThread.workFunction = function;
-    backendThread.workData = data;
-    backendThread.hasWork = qtrue;
-    
-    LeaveCriticalSection( &backendThread.commandMutex );
-    
-    // Signal thread to start work
-    ReleaseSemaphore( backendThread.workSemaphore, 1, NULL );
-#else
-    pthread_mutex_lock( &backendThread.commandMutex );
-    
-    backendThread.workFunction = function;
-    backendThread.workData = data;
-    backendThread.hasWork = qtrue;
-    
-    pthread_cond_signal( &backendThread.workCond );
-    pthread_mutex_unlock( &backendThread.commandMutex );
-#endif
+
+    VK_CHECK( qvkEndCommandBuffer( vk.cmd->command_buffer ) );
+    backendThread.passBuffers[ backendThread.numPassBuffers++ ] = vk.cmd->command_buffer;
+
+    vk.cmd->command_buffer = backendThread.primary;
+    qvkCmdExecuteCommands( backendThread.primary, backendThread.numPassBuffers, backendThread.passBuffers );
+
+    backendThread.frame.secondaries += backendThread.numPassBuffers;
+    backendThread.numPassBuffers = 0;
+    backendThread.passActive = qfalse;
+
+    // state bound inside the secondaries doesn't carry over
+    vk_reset_bind_state( vk.cmd );
 }
 
+
 /*
 ================
-vk_wait_backend_work
+vk_record_parallel
 
-Wait for backend thread to complete current work
+Splits numItems into chunks recorded by the workers and the render thread,
+each into its own secondary command buffer. Chunks execute in item order,
+after everything recorded so far and before anything recorded later.
+Falls back to a single inline call for short lists or inline passes.
 ================
 */
-void vk_wait_backend_work( void ) {
-    if ( !backendThread.initialized || !backendThread.isRunning ) {
+void vk_record_parallel( int numItems, vkRecordFunc_t func, void *data ) {
+    uint32_t maxUsed;
+    int64_t start;
+    int numChunks, chunkItems, i;
+
+    if ( numItems <= 0 ) {
         return;
     }
-    
+
+    // this pass was begun inline, the workers take part from the next one
+    if ( !backendThread.workersTried && backendThread.initialized ) {
+        vk_start_workers();
+    }
+
+    numChunks = ( numItems + MIN_CHUNK_ITEMS - 1 ) / MIN_CHUNK_ITEMS;
+    // a couple of chunks per thread to even out uneven surfaces
+    if ( numChunks > ( backendThread.numWorkers + 1 ) * 2 ) {
+        numChunks = ( backendThread.numWorkers + 1 ) * 2;
+    }
+    if ( numChunks > MAX_RECORD_CHUNKS ) {
+        numChunks = MAX_RECORD_CHUNKS;
+    }
+
+    maxUsed = 0;
+    for ( i = 0; i <= backendThread.numWorkers; i++ ) {
+        if ( maxUsed < backendThread.workers[ i ].numUsed[ vk.cmd_index ] ) {
+            maxUsed = backendThread.workers[ i ].numUsed[ vk.cmd_index ];
+        }
+    }
+
+    if ( !backendThread.passActive || numChunks < 2
+        || maxUsed + numChunks + 1 > MAX_FRAME_SECONDARIES
+        || backendThread.numPassBuffers + numChunks + 2 > MAX_FRAME_SECONDARIES ) {
+        func( vk.cmd, 0, numItems, data );
+        return;
+    }
+
+    start = vk_backend_usec();
+
+    // close the render thread secondary so the chunks follow everything recorded so far
+    VK_CHECK( qvkEndCommandBuffer( vk.cmd->command_buffer ) );
+    backendThread.passBuffers[ backendThread.numPassBuffers++ ] = vk.cmd->command_buffer;
+
+    chunkItems = ( numItems + numChunks - 1 ) / numChunks;
+    numChunks = ( numItems + chunkItems - 1 ) / chunkItems;
+
+    vk_job_lock();
+    backendThread.func = func;
+    backendThread.data = data;
+    backendThread.base = *vk.cmd;
+    backendThread.numItems = numItems;
+    backendThread.chunkItems = chunkItems;
+    backendThread.numChunks = numChunks;
+    backendThread.nextChunk = 0;
+    backendThread.doneChunks = 0;
+    backendThread.waiting = qfalse;
 #ifdef _WIN32
-    if ( backendThread.hasWork ) {
+    vk_job_unlock();
+    ReleaseSemaphore( backendThread.workSemaphore, backendThread.numWorkers, NULL );
+#else
+    pthread_cond_broadcast( &backendThread.workCond );
+    vk_job_unlock();
+#endif
+
+    // render thread takes chunks as well
+    vk_process_chunks( &backendThread.workers[ 0 ] );
+
+    vk_job_lock();
+    while ( backendThread.doneChunks < backendThread.numChunks ) {
+        backendThread.waiting = qtrue;
+#ifdef _WIN32
+        vk_job_unlock();
         WaitForSingleObject( backendThread.doneSemaphore, INFINITE );
-    }
+        vk_job_lock();
 #else
-    pthread_mutex_lock( &backendThread.commandMutex );
-    while ( backendThread.hasWork ) {
-        pthread_cond_wait( &backendThread.doneCond, &backendThread.commandMutex );
-    }
-    pthread_mutex_unlock( &backendThread.commandMutex );
+        pthread_cond_wait( &backendThread.doneCond, &backendThread.jobMutex );
 #endif
+    }
+    backendThread.func = NULL;
+    backendThread.data = NULL;
+    vk_job_unlock();
+
+    for ( i = 0; i < numChunks; i++ ) {
+        backendThread.passBuffers[ backendThread.numPassBuffers++ ] = backendThread.chunkBuffers[ i ];
+    }
+
+    // continue inline recording after the chunks
+    vk_begin_secondary( vk.cmd, vk_alloc_secondary( &backendThread.workers[ 0 ] ) );
+
+    backendThread.frame.recordUsec += vk_backend_usec() - start;
+    backendThread.frame.jobs++;
+    backendThread.frame.chunks += numChunks;
+    backendThread.frame.items += numItems;
+}
+
+
+/*
+================
+vk_backend_info_f
+
+Prints secondary recording statistics
+================
+*/
+void vk_backend_info_f( void ) {
+    ri.Printf( PRINT_ALL, "backend workers: %i%s\n", backendThread.numWorkers,
+        backendThread.numWorkers ? "" : backendThread.workersTried ? " (inline recording)" : " (not started, no parallel recording yet)" );
+    ri.Printf( PRINT_ALL, "main pass record: %.3f ms last frame, %.3f ms peak\n",
+        backendThread.last.passUsec / 1000.0, backendThread.peakPassUsec / 1000.0 );
+    ri.Printf( PRINT_ALL, "parallel record: %.3f ms, %i jobs, %i chunks, %i items\n",
+        backendThread.last.recordUsec / 1000.0, backendThread.last.jobs,
+        backendThread.last.chunks, backendThread.last.items );
+    ri.Printf( PRINT_ALL, "secondary command buffers: %i\n", backendThread.last.secondaries );
 }
 
 /*
@@ -350,7 +769,7 @@ Find appropriate memory type for allocation
 */
 uint32_t find_memory_type( uint32_t typeFilter, VkMemoryPropertyFlags properties ) {
     VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties( vk.physical_device, &memProperties );
+    qvkGetPhysicalDeviceMemoryProperties( vk.physical_device, &memProperties );
     
     for ( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ ) {
         if ( (typeFilter & (1 << i)) && 
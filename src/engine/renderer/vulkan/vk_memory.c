@@ -0,0 +1,696 @@
+/*
+===========================================================================
+Copyright (C) 2024 Quake3e-HD Project
+
+This file is part of Quake3e-HD.
+
+Quake3e-HD is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+===========================================================================
+*/
+// vk_memory.c - Vulkan device memory sub-allocator
+
+#include "../core/tr_local.h"
+#include "vk.h"
+
+/*
+
+Device memory is requested from the driver in large blocks, one list of
+blocks per memory type and resource kind (linear buffers and optimal images
+never share a block so bufferImageGranularity does not matter). Each block
+is split with a binary buddy allocator: the tree stores, for every node, the
+largest free order available in its subtree, so allocation and release are
+O(log n) and always pick the lowest free address, which keeps blocks dense.
+
+Large resources and render targets get dedicated allocations.
+
+Allocations are looked up by the handle of the resource they are bound to,
+callers release memory with vk_mem_free( handle ) where they used to call
+vkFreeMemory(). Do that before destroying the resource: once it is gone the
+driver may hand the same handle value out again.
+
+*/
+
+#define VK_MEM_BLOCK_SIZE		(64 * 1024 * 1024)
+#define VK_MEM_MIN_SIZE			(4 * 1024)
+#define VK_MEM_MAX_ORDER		14					// VK_MEM_BLOCK_SIZE == VK_MEM_MIN_SIZE << VK_MEM_MAX_ORDER
+#define VK_MEM_TREE_NODES		((2 << VK_MEM_MAX_ORDER) - 1)
+#define VK_MEM_DEDICATED_SIZE	(VK_MEM_BLOCK_SIZE / 2)
+
+#define MAX_VK_MEM_BLOCKS		64
+#define MAX_VK_ALLOCATIONS		4096
+#define VK_MEM_HASH_SIZE		1024
+#define MAX_VK_MEM_DEFERRED		256		// buffers released per command buffer once it completes
+
+typedef struct {
+	VkDeviceMemory	memory;
+	uint32_t		typeIndex;
+	qboolean		linear;
+	byte			*mapped;
+	byte			*tree;		// largest free order + 1 for each node, 0 if none
+	VkDeviceSize	used;
+	int				allocations;
+} vkMemBlock_t;
+
+typedef struct {
+	uint64_t		handle;
+	VkDeviceMemory	memory;
+	VkDeviceSize	offset;
+	VkDeviceSize	size;
+	byte			*mapped;
+	int				block;		// -1 for dedicated allocations
+	int				node;
+	int				hashNext;
+	qboolean		inuse;
+} vkMemAllocation_t;
+
+typedef struct {
+	vkMemBlock_t		blocks[ MAX_VK_MEM_BLOCKS ];
+	vkMemAllocation_t	allocations[ MAX_VK_ALLOCATIONS ];
+	int					hashTable[ VK_MEM_HASH_SIZE ];
+	int					freeAllocation;
+
+	VkPhysicalDeviceMemoryProperties	props;	// queried once in vk_mem_init
+
+	// buffers the recorded command buffers still read from
+	VkBuffer			deferred[ NUM_COMMAND_BUFFERS ][ MAX_VK_MEM_DEFERRED ];
+	int					numDeferred[ NUM_COMMAND_BUFFERS ];
+
+	// statistics
+	int					numDedicated;
+	VkDeviceSize		dedicatedBytes;
+	VkDeviceSize		peakBytes;
+	int					driverAllocations;	// total vkAllocateMemory() calls
+	int					blocksReleased;
+} vkMemState_t;
+
+static vkMemState_t vkMem;
+static qboolean vkMemInitialized;
+
+
+/*
+================
+vk_mem_hash
+================
+*/
+static int vk_mem_hash( uint64_t handle ) {
+	return (int)( ( handle ^ ( handle >> 17 ) ^ ( handle >> 32 ) ) & ( VK_MEM_HASH_SIZE - 1 ) );
+}
+
+
+/*
+================
+vk_mem_init
+================
+*/
+void vk_mem_init( void ) {
+	int i;
+
+	Com_Memset( &vkMem, 0, sizeof( vkMem ) );
+
+	for ( i = 0; i < VK_MEM_HASH_SIZE; i++ ) {
+		vkMem.hashTable[i] = -1;
+	}
+
+	for ( i = 0; i < MAX_VK_ALLOCATIONS; i++ ) {
+		vkMem.allocations[i].hashNext = i + 1;
+	}
+	vkMem.allocations[ MAX_VK_ALLOCATIONS - 1 ].hashNext = -1;
+	vkMem.freeAllocation = 0;
+
+	qvkGetPhysicalDeviceMemoryProperties( vk.physical_device, &vkMem.props );
+
+	vkMemInitialized = qtrue;
+}
+
+
+/*
+================
+vk_mem_release_block
+================
+*/
+static void vk_mem_release_block( vkMemBlock_t *block ) {
+	if ( block->memory != VK_NULL_HANDLE ) {
+		if ( block->mapped ) {
+			qvkUnmapMemory( vk.device, block->memory );
+		}
+		qvkFreeMemory( vk.device, block->memory, NULL );
+	}
+	if ( block->tree ) {
+		ri.Free( block->tree );
+	}
+	Com_Memset( block, 0, sizeof( *block ) );
+}
+
+
+/*
+================
+vk_mem_shutdown
+
+Expects the device to be idle
+================
+*/
+void vk_mem_shutdown( void ) {
+	vkMemAllocation_t *a;
+	int i;
+
+	if ( !vkMemInitialized ) {
+		return;
+	}
+
+	for ( i = 0; i < NUM_COMMAND_BUFFERS; i++ ) {
+		vk_mem_release_frame( i );
+	}
+
+	for ( i = 0; i < MAX_VK_ALLOCATIONS; i++ ) {
+		a = &vkMem.allocations[i];
+		if ( a->inuse && a->block < 0 ) {
+			if ( a->mapped ) {
+				qvkUnmapMemory( vk.device, a->memory );
+			}
+			qvkFreeMemory( vk.device, a->memory, NULL );
+		}
+	}
+
+	for ( i = 0; i < MAX_VK_MEM_BLOCKS; i++ ) {
+		vk_mem_release_block( &vkMem.blocks[i] );
+	}
+
+	Com_Memset( &vkMem, 0, sizeof( vkMem ) );
+	vkMemInitialized = qfalse;
+}
+
+
+/*
+================
+vk_mem_trim
+
+Returns empty blocks to the driver, called on map change once the previous
+map resources are gone so that the next map starts from densely packed blocks
+================
+*/
+void vk_mem_trim( void ) {
+	int i;
+
+	for ( i = 0; i < MAX_VK_MEM_BLOCKS; i++ ) {
+		if ( vkMem.blocks[i].memory != VK_NULL_HANDLE && vkMem.blocks[i].allocations == 0 ) {
+			vk_mem_release_block( &vkMem.blocks[i] );
+			vkMem.blocksReleased++;
+		}
+	}
+}
+
+
+/*
+================
+vk_mem_node_order
+================
+*/
+static int vk_mem_node_order( int node ) {
+	int depth = 0;
+
+	node++;
+	while ( node > 1 ) {
+		node >>= 1;
+		depth++;
+	}
+
+	return VK_MEM_MAX_ORDER - depth;
+}
+
+
+/*
+================
+vk_mem_update_parents
+================
+*/
+static void vk_mem_update_parents( byte *tree, int node, int order ) {
+	int parent, left, right;
+
+	while ( node > 0 ) {
+		parent = ( node - 1 ) >> 1;
+		left = parent * 2 + 1;
+		right = left + 1;
+		order++;
+		if ( tree[left] == order && tree[right] == order ) {
+			// both halves are free - merge buddies
+			tree[parent] = order + 1;
+		} else {
+			tree[parent] = MAX( tree[left], tree[right] );
+		}
+		node = parent;
+	}
+}
+
+
+/*
+================
+vk_mem_buddy_alloc
+
+Returns node index, -1 if block has no free range of requested order
+================
+*/
+static int vk_mem_buddy_alloc( byte *tree, int order ) {
+	int node, nodeOrder;
+
+	if ( tree[0] < order + 1 ) {
+		return -1;
+	}
+
+	node = 0;
+	nodeOrder = VK_MEM_MAX_ORDER;
+	while ( nodeOrder > order ) {
+		node = node * 2 + 1;
+		if ( tree[node] < order + 1 ) {
+			node++; // right sibling
+		}
+		nodeOrder--;
+	}
+
+	tree[node] = 0;
+	vk_mem_update_parents( tree, node, order );
+
+	return node;
+}
+
+
+/*
+================
+vk_mem_buddy_free
+================
+*/
+static void vk_mem_buddy_free( byte *tree, int node ) {
+	const int order = vk_mem_node_order( node );
+
+	tree[node] = order + 1;
+	vk_mem_update_parents( tree, node, order );
+}
+
+
+/*
+================
+vk_mem_node_offset
+================
+*/
+static VkDeviceSize vk_mem_node_offset( int node ) {
+	const int order = vk_mem_node_order( node );
+	const int first = ( 1 << ( VK_MEM_MAX_ORDER - order ) ) - 1;
+
+	return (VkDeviceSize)( node - first ) * ( (VkDeviceSize)VK_MEM_MIN_SIZE << order );
+}
+
+
+/*
+================
+vk_mem_allocate_memory
+================
+*/
+static VkDeviceMemory vk_mem_allocate_memory( VkDeviceSize size, uint32_t typeIndex, VkImage dedicatedImage, VkBuffer dedicatedBuffer ) {
+	VkMemoryDedicatedAllocateInfoKHR dedicated_info;
+	VkMemoryAllocateInfo alloc_info;
+	VkDeviceMemory memory;
+	VkResult res;
+
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.pNext = NULL;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = typeIndex;
+
+	if ( vk.dedicatedAllocation && ( dedicatedImage != VK_NULL_HANDLE || dedicatedBuffer != VK_NULL_HANDLE ) ) {
+		Com_Memset( &dedicated_info, 0, sizeof( dedicated_info ) );
+		dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+		dedicated_info.image = dedicatedImage;
+		dedicated_info.buffer = dedicatedBuffer;
+		alloc_info.pNext = &dedicated_info;
+	}
+
+	res = qvkAllocateMemory( vk.device, &alloc_info, NULL, &memory );
+	if ( res != VK_SUCCESS ) {
+		ri.Error( ERR_FATAL, "Vulkan: failed to allocate %i KB of device memory (type %i)", (int)( size / 1024 ), typeIndex );
+	}
+
+	vkMem.driverAllocations++;
+
+	return memory;
+}
+
+
+/*
+================
+vk_mem_new_allocation
+================
+*/
+static vkMemAllocation_t *vk_mem_new_allocation( uint64_t handle ) {
+	vkMemAllocation_t *a;
+	int index, hash;
+
+	index = vkMem.freeAllocation;
+	if ( index < 0 ) {
+		ri.Error( ERR_FATAL, "Vulkan: MAX_VK_ALLOCATIONS hit" );
+	}
+
+	a = &vkMem.allocations[ index ];
+	vkMem.freeAllocation = a->hashNext;
+
+	Com_Memset( a, 0, sizeof( *a ) );
+	a->handle = handle;
+	a->inuse = qtrue;
+
+	hash = vk_mem_hash( handle );
+	a->hashNext = vkMem.hashTable[ hash ];
+	vkMem.hashTable[ hash ] = index;
+
+	return a;
+}
+
+
+/*
+================
+vk_mem_alloc
+================
+*/
+static vkMemAllocation_t *vk_mem_alloc( uint64_t handle, const VkMemoryRequirements *reqs, VkMemoryPropertyFlags properties,
+	qboolean linear, qboolean dedicated, VkImage dedicatedImage, VkBuffer dedicatedBuffer ) {
+	VkMemoryPropertyFlags typeFlags;
+	VkDeviceSize size, used;
+	vkMemAllocation_t *a;
+	vkMemBlock_t *block;
+	uint32_t typeIndex;
+	int order, node, i, freeSlot;
+	void *data;
+
+	if ( !vkMemInitialized ) {
+		vk_mem_init();
+	}
+
+	typeIndex = vk_find_memory_type( reqs->memoryTypeBits, properties );
+
+	typeFlags = vkMem.props.memoryTypes[ typeIndex ].propertyFlags;
+
+	a = vk_mem_new_allocation( handle );
+	a->size = reqs->size;
+
+	if ( dedicated || reqs->size >= VK_MEM_DEDICATED_SIZE || reqs->alignment > VK_MEM_BLOCK_SIZE ) {
+		a->block = -1;
+		a->memory = vk_mem_allocate_memory( reqs->size, typeIndex, dedicatedImage, dedicatedBuffer );
+		a->offset = 0;
+		if ( typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) {
+			VK_CHECK( qvkMapMemory( vk.device, a->memory, 0, VK_WHOLE_SIZE, 0, &data ) );
+			a->mapped = (byte *)data;
+		}
+		vkMem.numDedicated++;
+		vkMem.dedicatedBytes += reqs->size;
+		goto done;
+	}
+
+	// smallest power-of-two range that satisfies both size and alignment
+	size = MAX( reqs->size, reqs->alignment );
+	order = 0;
+	while ( ( (VkDeviceSize)VK_MEM_MIN_SIZE << order ) < size ) {
+		order++;
+	}
+
+	freeSlot = -1;
+	node = -1;
+	block = NULL;
+	for ( i = 0; i < MAX_VK_MEM_BLOCKS; i++ ) {
+		block = &vkMem.blocks[i];
+		if ( block->memory == VK_NULL_HANDLE ) {
+			if ( freeSlot < 0 ) {
+				freeSlot = i;
+			}
+			continue;
+		}
+		if ( block->typeIndex != typeIndex || block->linear != linear ) {
+			continue;
+		}
+		node = vk_mem_buddy_alloc( block->tree, order );
+		if ( node >= 0 ) {
+			break;
+		}
+	}
+
+	if ( node < 0 ) {
+		if ( freeSlot < 0 ) {
+			ri.Error( ERR_FATAL, "Vulkan: MAX_VK_MEM_BLOCKS hit" );
+		}
+
+		block = &vkMem.blocks[ freeSlot ];
+		block->memory = vk_mem_allocate_memory( VK_MEM_BLOCK_SIZE, typeIndex, VK_NULL_HANDLE, VK_NULL_HANDLE );
+		block->typeIndex = typeIndex;
+		block->linear = linear;
+		block->tree = ri.Malloc( VK_MEM_TREE_NODES );
+		for ( i = 0; i < VK_MEM_TREE_NODES; i++ ) {
+			block->tree[i] = vk_mem_node_order( i ) + 1;
+		}
+		if ( typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) {
+			VK_CHECK( qvkMapMemory( vk.device, block->memory, 0, VK_WHOLE_SIZE, 0, &data ) );
+			block->mapped = (byte *)data;
+		}
+
+		node = vk_mem_buddy_alloc( block->tree, order );
+	}
+
+	a->block = block - vkMem.blocks;
+	a->node = node;
+	a->memory = block->memory;
+	a->offset = vk_mem_node_offset( node );
+	a->mapped = block->mapped ? block->mapped + a->offset : NULL;
+
+	block->used += (VkDeviceSize)VK_MEM_MIN_SIZE << order;
+	block->allocations++;
+
+done:
+	used = vkMem.dedicatedBytes;
+	for ( i = 0; i < MAX_VK_MEM_BLOCKS; i++ ) {
+		used += vkMem.blocks[i].used;
+	}
+	if ( vkMem.peakBytes < used ) {
+		vkMem.peakBytes = used;
+	}
+
+	return a;
+}
+
+
+/*
+================
+vk_mem_find
+================
+*/
+static vkMemAllocation_t *vk_mem_find( uint64_t handle, int **link ) {
+	vkMemAllocation_t *a;
+	int *prev;
+
+	if ( !vkMemInitialized || handle == 0 ) {
+		return NULL;
+	}
+
+	prev = &vkMem.hashTable[ vk_mem_hash( handle ) ];
+	while ( *prev >= 0 ) {
+		a = &vkMem.allocations[ *prev ];
+		if ( a->handle == handle ) {
+			if ( link ) {
+				*link = prev;
+			}
+			return a;
+		}
+		prev = &a->hashNext;
+	}
+
+	return NULL;
+}
+
+
+/*
+================
+vk_mem_bind_buffer
+
+Allocates and binds memory for buffer, returns the backing memory object
+which is shared with other resources and must not be freed by the caller
+================
+*/
+VkDeviceMemory vk_mem_bind_buffer( VkBuffer buffer, VkMemoryPropertyFlags properties, qboolean dedicated ) {
+	VkMemoryRequirements reqs;
+	vkMemAllocation_t *a;
+
+	qvkGetBufferMemoryRequirements( vk.device, buffer, &reqs );
+
+	a = vk_mem_alloc( (uint64_t)buffer, &reqs, properties, qtrue, dedicated, VK_NULL_HANDLE, buffer );
+
+	VK_CHECK( qvkBindBufferMemory( vk.device, buffer, a->memory, a->offset ) );
+
+	return a->memory;
+}
+
+
+/*
+================
+vk_mem_bind_image
+
+Same as vk_mem_bind_buffer() for optimal tiling images,
+render targets should request dedicated memory
+================
+*/
+VkDeviceMemory vk_mem_bind_image( VkImage image, VkMemoryPropertyFlags properties, qboolean dedicated ) {
+	VkMemoryRequirements reqs;
+	vkMemAllocation_t *a;
+
+	qvkGetImageMemoryRequirements( vk.device, image, &reqs );
+
+	a = vk_mem_alloc( (uint64_t)image, &reqs, properties, qfalse, dedicated, image, VK_NULL_HANDLE );
+
+	VK_CHECK( qvkBindImageMemory( vk.device, image, a->memory, a->offset ) );
+
+	return a->memory;
+}
+
+
+/*
+================
+vk_mem_mapped
+
+Persistently mapped pointer to host-visible memory bound to handle
+================
+*/
+void *vk_mem_mapped( uint64_t handle ) {
+	vkMemAllocation_t *a = vk_mem_find( handle, NULL );
+
+	return a ? a->mapped : NULL;
+}
+
+
+/*
+================
+vk_mem_free
+
+Releases memory bound to buffer or image handle, call it before
+destroying the resource, which must no longer be in use by the device
+================
+*/
+void vk_mem_free( uint64_t handle ) {
+	vkMemAllocation_t *a;
+	vkMemBlock_t *block;
+	int *link, index;
+
+	a = vk_mem_find( handle, &link );
+	if ( !a ) {
+		return;
+	}
+
+	if ( a->block < 0 ) {
+		if ( a->mapped ) {
+			qvkUnmapMemory( vk.device, a->memory );
+		}
+		qvkFreeMemory( vk.device, a->memory, NULL );
+		vkMem.numDedicated--;
+		vkMem.dedicatedBytes -= a->size;
+	} else {
+		block = &vkMem.blocks[ a->block ];
+		block->used -= (VkDeviceSize)VK_MEM_MIN_SIZE << vk_mem_node_order( a->node );
+		block->allocations--;
+		vk_mem_buddy_free( block->tree, a->node );
+	}
+
+	// unlink from hash chain and put on the free list
+	index = a - vkMem.allocations;
+	*link = a->hashNext;
+	a->inuse = qfalse;
+	a->handle = 0;
+	a->hashNext = vkMem.freeAllocation;
+	vkMem.freeAllocation = index;
+}
+
+
+/*
+================
+vk_mem_destroy_buffer_deferred
+
+Releases a buffer that commands recorded into the current command buffer
+still use, its memory is freed and the buffer destroyed once that command
+buffer has completed
+================
+*/
+void vk_mem_destroy_buffer_deferred( VkBuffer buffer ) {
+	int *num = &vkMem.numDeferred[ vk.cmd_index ];
+
+	if ( *num >= MAX_VK_MEM_DEFERRED ) {
+		ri.Error( ERR_DROP, "%s: MAX_VK_MEM_DEFERRED reached", __func__ );
+	}
+
+	vkMem.deferred[ vk.cmd_index ][ (*num)++ ] = buffer;
+}
+
+
+/*
+================
+vk_mem_release_frame
+
+Destroys the buffers deferred while recording the given command buffer,
+called once its fence has signaled
+================
+*/
+void vk_mem_release_frame( int cmd_index ) {
+	VkBuffer buffer;
+	int i;
+
+	for ( i = 0; i < vkMem.numDeferred[ cmd_index ]; i++ ) {
+		buffer = vkMem.deferred[ cmd_index ][ i ];
+		vk_mem_free( (uint64_t)buffer );
+		qvkDestroyBuffer( vk.device, buffer, NULL );
+	}
+
+	vkMem.numDeferred[ cmd_index ] = 0;
+}
+
+
+/*
+================
+vk_meminfo_f
+================
+*/
+void vk_meminfo_f( void ) {
+	const VkPhysicalDeviceMemoryProperties *props = &vkMem.props;
+	VkDeviceSize blockBytes, usedBytes;
+	const vkMemBlock_t *block;
+	int i, numBlocks, numAllocations;
+
+	if ( !vkMemInitialized ) {
+		ri.Printf( PRINT_ALL, "Vulkan memory allocator is not initialized\n" );
+		return;
+	}
+
+	ri.Printf( PRINT_ALL, "memory heaps:\n" );
+	for ( i = 0; i < (int)props->memoryHeapCount; i++ ) {
+		ri.Printf( PRINT_ALL, " %i: %6i MB%s\n", i, (int)( props->memoryHeaps[i].size / ( 1024 * 1024 ) ),
+			( props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ) ? " device-local" : "" );
+	}
+
+	ri.Printf( PRINT_ALL, "blocks:\n" );
+	numBlocks = 0;
+	numAllocations = 0;
+	blockBytes = 0;
+	usedBytes = 0;
+	for ( i = 0; i < MAX_VK_MEM_BLOCKS; i++ ) {
+		block = &vkMem.blocks[i];
+		if ( block->memory == VK_NULL_HANDLE ) {
+			continue;
+		}
+		ri.Printf( PRINT_ALL, " %2i: type %2i %-6s %5i KB used, %4i allocations, largest free %5i KB%s\n", i,
+			block->typeIndex, block->linear ? "linear" : "image", (int)( block->used / 1024 ), block->allocations,
+			block->tree[0] ? ( VK_MEM_MIN_SIZE << ( block->tree[0] - 1 ) ) / 1024 : 0,
+			block->mapped ? " mapped" : "" );
+		numBlocks++;
+		numAllocations += block->allocations;
+		blockBytes += VK_MEM_BLOCK_SIZE;
+		usedBytes += block->used;
+	}
+
+	ri.Printf( PRINT_ALL, "%i blocks, %i MB reserved, %i MB used by %i allocations\n", numBlocks,
+		(int)( blockBytes / ( 1024 * 1024 ) ), (int)( usedBytes / ( 1024 * 1024 ) ), numAllocations );
+	ri.Printf( PRINT_ALL, "%i dedicated allocations, %i MB\n", vkMem.numDedicated, (int)( vkMem.dedicatedBytes / ( 1024 * 1024 ) ) );
+	ri.Printf( PRINT_ALL, "peak usage %i MB, %i driver allocations, %i blocks released\n",
+		(int)( vkMem.peakBytes / ( 1024 * 1024 ) ), vkMem.driverAllocations, vkMem.blocksReleased );
+}
@@ -38,10 +38,12 @@ Every static surface gets unique item index which will be added to queue
 instead of tesselation like for regular surfaces. Using items queue also
 eleminates run-time tesselation limits.
 
-When it is time to render - we sort queued items to get longest possible
-index sequence run to check if it is long enough i.e. worth issuing a draw call.
-So long device-local index runs are rendered via multiple draw calls,
-all remaining short index sequences are grouped together into single
+Queued items are tracked as a visibility bitmask rather than a list: since
+items are sorted by shader at load time, scanning the bitmask in order yields
+the longest possible index sequence runs without any per-frame sorting.
+Long device-local index runs are turned into indirect draw commands which are
+uploaded once per shader and issued via single multi-draw indirect call
+per stage, all remaining short index sequences are grouped together into single
 host-visible index buffer which is finally rendered via single draw call.
 
 */
@@ -60,11 +62,6 @@ typedef struct vbo_item_s {
 	int			num_vertexes;
 } vbo_item_t;
 
-typedef struct ibo_item_s {
-	int offset;
-	int length;
-} ibo_item_t;
-
 typedef struct vbo_s {
 	byte *vbo_buffer;
 	int vbo_offset;
@@ -77,14 +74,16 @@ typedef struct vbo_s {
 	uint32_t soft_buffer_indexes;
 	uint32_t soft_buffer_offset;
 
-	ibo_item_t *ibo_items;
+	VkDrawIndexedIndirectCommand *ibo_items;
 	int ibo_items_count;
+	uint32_t ibo_items_offset;	// host-visible copy of ibo_items, ~0U if not uploaded
 
 	vbo_item_t *items;
 	int items_count;
 
-	int *items_queue;
-	int items_queue_count;
+	uint32_t *items_visible;	// one bit per item
+	int items_visible_min;
+	int items_visible_max;
 
 } vbo_t;
 
@@ -561,9 +560,10 @@ void R_BuildWorldVBO( msurface_t *surf, int surfCount )
 	vbo->items = ri.Hunk_Alloc( ( numStaticSurfaces + 1 ) * sizeof( vbo_item_t ), h_low );
 	vbo->items_count = numStaticSurfaces;
 
-	// last item will be used for run length termination
-	vbo->items_queue = ri.Hunk_Alloc( ( numStaticSurfaces + 1 ) * sizeof( int ), h_low );
-	vbo->items_queue_count = 0;
+	// visibility bitmask, 0 item is unused
+	vbo->items_visible = ri.Hunk_Alloc( ( ( numStaticSurfaces + 1 + 31 ) >> 5 ) * sizeof( uint32_t ), h_low );
+	vbo->items_visible_min = numStaticSurfaces + 1;
+	vbo->items_visible_max = 0;
 
 	ri.Printf( PRINT_ALL, "...found %i VBO surfaces (%i vertexes, %i indexes)\n",
 		numStaticSurfaces, numStaticVertexes, numStaticIndexes );
@@ -583,7 +583,7 @@ void R_BuildWorldVBO( msurface_t *surf, int surfCount )
 	vbo->ibo_size = ibo_size;
 
 	// ibo runs buffer
-	vbo->ibo_items = ri.Hunk_Alloc( ( (numStaticIndexes / MIN_IBO_RUN) + 1 ) * sizeof( ibo_item_t ), h_low );
+	vbo->ibo_items = ri.Hunk_Alloc( ( (numStaticIndexes / MIN_IBO_RUN) + 1 ) * sizeof( VkDrawIndexedIndirectCommand ), h_low );
 	vbo->ibo_items_count = 0;
 
 	surfList = ri.Hunk_AllocateTempMemory( numStaticSurfaces * sizeof( msurface_t* ) );
@@ -711,83 +711,38 @@ void VBO_Cleanup( void )
 }
 
 
-/*
-=============
-qsort_int
-=============
-*/
-static void qsort_int( int *a, const int n ) {
-	int temp, m;
-	int i, j;
-
-	if ( n < 32 ) { // CUTOFF
-		for ( i = 1 ; i < n + 1 ; i++ ) {
-			j = i;
-			while ( j > 0 && a[j] < a[j-1] ) {
-				temp = a[j];
-				a[j] = a[j-1];
-				a[j-1] = temp;
-				j--;
-			}
-		}
-		return;
-	}
-
-	i = 0;
-	j = n;
-	m = a[ n>>1 ];
-
-	do {
-		while ( a[i] < m ) i++;
-		while ( a[j] > m ) j--;
-		if ( i <= j ) {
-			temp = a[i];
-			a[i] = a[j];
-			a[j] = temp;
-			i++;
-			j--;
-		}
-	} while ( i <= j );
-
-	if ( j > 0 ) qsort_int( a, j );
-	if ( n > i ) qsort_int( a+i, n-i );
-}
-
-
-static int run_length( const int *a, int from, int to, int *count )
-{
-	vbo_t *vbo = &world_vbo;
-	int i, n, cnt;
-	for ( cnt = 0, n = 1, i = from; i < to; i++, n++ )
-	{
-		cnt += vbo->items[a[i]].num_indexes;
-		if ( a[i]+1 != a[i+1] )
-			break;
-	}
-	*count = cnt;
-	return n;
-}
-
-
 void VBO_QueueItem( int itemIndex )
 {
 	vbo_t *vbo = &world_vbo;
 
-	if ( vbo->items_queue_count < vbo->items_count )
-	{
-		vbo->items_queue[vbo->items_queue_count++] = itemIndex;
-	}
-	else
+	if ( itemIndex <= 0 || itemIndex > vbo->items_count )
 	{
 		ri.Error( ERR_DROP, "VBO queue overflow" );
 	}
+
+	vbo->items_visible[ itemIndex >> 5 ] |= 1U << ( itemIndex & 31 );
+
+	if ( itemIndex < vbo->items_visible_min )
+		vbo->items_visible_min = itemIndex;
+	if ( itemIndex > vbo->items_visible_max )
+		vbo->items_visible_max = itemIndex;
 }
 
 
 void VBO_ClearQueue( void )
 {
 	vbo_t *vbo = &world_vbo;
-	vbo->items_queue_count = 0;
+	int i;
+
+	// only touch words used by the previous shader's item range
+	if ( vbo->items_visible_max > 0 && vbo->items_visible_max >= vbo->items_visible_min )
+	{
+		for ( i = vbo->items_visible_min >> 5; i <= vbo->items_visible_max >> 5; i++ )
+			vbo->items_visible[ i ] = 0;
+	}
+
+	vbo->items_visible_min = vbo->items_count + 1;
+	vbo->items_visible_max = 0;
 }
 
 
@@ -819,31 +774,56 @@ static void VBO_AddItemDataToSoftBuffer( int itemIndex )
 }
 
 
-static void VBO_AddItemRangeToIBOBuffer( int offset, int length )
+static void VBO_AddItemRangeToIBOBuffer( int first, int last )
 {
 	vbo_t *vbo = &world_vbo;
-	ibo_item_t *it;
+	const vbo_item_t *start = vbo->items + first;
+	const vbo_item_t *end = vbo->items + last;
+	VkDrawIndexedIndirectCommand *it;
 
 	it = vbo->ibo_items + vbo->ibo_items_count++;
 
-	it->offset = offset;
-	it->length = length;
+	it->indexCount = (end->index_offset - start->index_offset) + end->num_indexes;
+	it->instanceCount = 1;
+	it->firstIndex = start->index_offset;
+	it->vertexOffset = 0;
+	it->firstInstance = 0;
+}
+
+
+static void VBO_AddItemRange( int first, int last, int index_run )
+{
+	int n;
+
+	if ( index_run < MIN_IBO_RUN )
+	{
+		for ( n = first; n <= last; n++ )
+			VBO_AddItemDataToSoftBuffer( n );
+	}
+	else
+	{
+		VBO_AddItemRangeToIBOBuffer( first, last );
+	}
 }
 
 
 void VBO_RenderIBOItems( void )
 {
 	const vbo_t *vbo = &world_vbo;
-	int i;
 
 	// from device-local memory
 	if ( vbo->ibo_items_count )
 	{
 		vk_bind_index_buffer( vk.vbo.vertex_buffer, tess.shader->iboOffset );
 
-		for ( i = 0; i < vbo->ibo_items_count; i++ )
+		if ( vbo->ibo_items_offset != ~0U )
+		{
+			vk_draw_indexed_indirect( vbo->ibo_items_offset, vbo->ibo_items_count );
+		}
+		else
 		{
-			vk_draw_indexed( vbo->ibo_items[ i ].length, vbo->ibo_items[ i ].offset );
+			// one draw per item, may be recorded by the backend workers
+			vk_draw_indexed_items( vbo->ibo_items, vbo->ibo_items_count );
 		}
 	}
 
@@ -860,36 +840,60 @@ void VBO_RenderIBOItems( void )
 void VBO_PrepareQueues( void )
 {
 	vbo_t *vbo = &world_vbo;
-	int i, item_run, index_run, n;
-	const int *a;
-
-	vbo->items_queue[ vbo->items_queue_count ] = 0; // terminate run
-
-	// sort items so we can scan for longest runs
-	if ( vbo->items_queue_count > 1 )
-		qsort_int( vbo->items_queue, vbo->items_queue_count-1 );
+	int first, index_run;
+	int i, n, last;
+	uint32_t mask;
 
 	vbo->soft_buffer_indexes = 0;
 	vbo->ibo_items_count = 0;
+	vbo->ibo_items_offset = ~0U;
+
+	first = -1;
+	index_run = 0;
+	last = vbo->items_visible_max;
 
-	a = vbo->items_queue;
-	i = 0;
-	while ( i < vbo->items_queue_count )
+	// walk the visibility bitmask in item order, merging adjacent items into runs
+	for ( i = vbo->items_visible_min; i <= last; )
 	{
-		item_run = run_length( a, i, vbo->items_queue_count, &index_run );
-		if ( index_run < MIN_IBO_RUN )
+		mask = vbo->items_visible[ i >> 5 ] >> ( i & 31 );
+		if ( mask == 0 )
 		{
-			for ( n = 0; n < item_run; n++ )
-				VBO_AddItemDataToSoftBuffer( a[ i + n ] );
+			// skip the rest of an empty word
+			if ( first >= 0 )
+			{
+				VBO_AddItemRange( first, i - 1, index_run );
+				first = -1;
+			}
+			i = ( i | 31 ) + 1;
+			continue;
 		}
-		else
+		for ( n = i; ( mask & 1 ) == 0; mask >>= 1, n++ )
+			;
+		if ( n != i && first >= 0 )
 		{
-			vbo_item_t *start = vbo->items + a[ i ];
-			vbo_item_t *end = vbo->items + a[ i + item_run - 1 ];
-			n = (end->index_offset - start->index_offset) + end->num_indexes;
-			VBO_AddItemRangeToIBOBuffer( start->index_offset, n );
+			// run interrupted by invisible items
+			VBO_AddItemRange( first, i - 1, index_run );
+			first = -1;
 		}
-		i += item_run;
+		if ( first < 0 )
+		{
+			first = n;
+			index_run = 0;
+		}
+		index_run += vbo->items[ n ].num_indexes;
+		i = n + 1;
+	}
+
+	if ( first >= 0 )
+	{
+		VBO_AddItemRange( first, last, index_run );
+	}
+
+	// commands are shared by all stages so upload them just once,
+	// without multiDrawIndirect they are drawn one by one from ibo_items
+	if ( vbo->ibo_items_count && vk.multiDrawIndirect )
+	{
+		vbo->ibo_items_offset = vk_tess_indirect( vbo->ibo_items, vbo->ibo_items_count );
 	}
 }
 
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // tr_map.c
 
 #include "../core/tr_local.h"
+#include "tr_occlusion.h"
 #ifdef USE_VULKAN
 #include "../vulkan/vk.h"
 #endif
@@ -2341,6 +2342,9 @@ void RE_LoadWorldMap( const char *name ) {
 		}
 	}
 
+	// map shader pipelines are compiled in one parallel batch below
+	vk_begin_pipeline_batch();
+
 	// load into heap
 	R_LoadLightmaps( &header->lumps[LUMP_LIGHTMAPS] );
 	R_PreLoadFogs( &header->lumps[LUMP_FOGS] );
@@ -2359,6 +2363,10 @@ void RE_LoadWorldMap( const char *name ) {
 	R_BuildWorldVBO( s_worldData.surfaces, s_worldData.numsurfaces );
 #endif
 
+	R_BuildOcclusionOccluders( &s_worldData );
+
+	vk_precompile_pipelines();
+
 	tr.mapLoading = qfalse;
 
 	s_worldData.dataSize = (byte *)ri.Hunk_Alloc(0, h_low) - startMarker;
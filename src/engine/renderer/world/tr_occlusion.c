@@ -0,0 +1,840 @@
+/*
+===========================================================================
+Copyright (C) 2024 Quake3e-HD Project
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_occlusion.c - CPU software occlusion culling
+
+#include "tr_occlusion.h"
+
+#if idx64
+#include <emmintrin.h>
+#endif
+
+/*
+
+The depth buffer stores 1/z (view space distance along the forward axis),
+so larger values are nearer and a cleared buffer (0) is infinitely far away.
+1/z is linear in screen space which lets occluder triangles interpolate it
+directly from their edge functions.
+
+Occluders are rasterized inner-conservatively: a pixel is written only when
+the whole pixel square lies inside the triangle, and it gets the farthest
+depth the triangle reaches over that square. Boxes are tested outer-
+conservatively: every pixel their screen rectangle touches must hold an
+occluder nearer than the nearest corner of the box. Together that never
+hides anything visible through a partly covered pixel at a silhouette, at
+the cost of a thin uncovered seam along occluder edges.
+
+*/
+
+#define OCC_NEAR			4.0f
+#define OCC_DEPTH_BIAS		1.01f		// required separation between box and occluder
+#define OCC_MAX_CLIPPED		4			// triangle clipped against the near plane
+
+typedef struct {
+	const msurface_t	*surf;
+	const mnode_t		*leaf;			// first leaf referencing the face
+	vec3_t				origin;
+	float				area;
+} occluder_t;
+
+typedef struct {
+	float			score;
+	int				index;
+} occluderSort_t;
+
+typedef struct {
+	float			x, y, z;			// screen position and 1/z
+} occVert_t;
+
+typedef struct {
+	qboolean		initialized;
+	qboolean		active;				// depth buffer is valid for the current view
+
+	const world_t	*world;
+	occluder_t		*occluders;
+	int				numOccluders;
+
+	vec3_t			origin;
+	vec3_t			axis[3];
+	float			scaleX, scaleY;
+
+	occlusionStats_t	frame;
+	occlusionStats_t	total;
+	int				frames;
+} occlusionState_t;
+
+static occlusionState_t occ;
+
+#if defined( _MSC_VER )
+static __declspec( align( 16 ) ) float occDepth[OCC_HEIGHT][OCC_WIDTH];
+#else
+static float occDepth[OCC_HEIGHT][OCC_WIDTH] __attribute__(( aligned( 16 ) ));
+#endif
+
+static cvar_t *r_occlusionCull;
+static cvar_t *r_occlusionMaxOccluders;
+static cvar_t *r_occlusionMinArea;
+
+
+/*
+================
+R_OcclusionInfo_f
+
+Print occlusion statistics for the last frame and the running average
+================
+*/
+static void R_OcclusionInfo_f( void ) {
+	const occlusionStats_t *f = &occ.frame;
+	const occlusionStats_t *t = &occ.total;
+	int n = occ.frames ? occ.frames : 1;
+
+	ri.Printf( PRINT_ALL, "software occlusion: %s, %i candidate occluders\n",
+		r_occlusionCull->integer ? "enabled" : "disabled", occ.numOccluders );
+	ri.Printf( PRINT_ALL, "last frame: %i occluders (%i tris), %i/%i bounds culled, %i surfaces culled, %i+%i usec\n",
+		f->occluders, f->triangles, f->culled, f->tested, f->surfacesCulled,
+		(int)f->rasterUsec, (int)f->testUsec );
+	ri.Printf( PRINT_ALL, "average over %i frames: %i occluders, %i/%i bounds culled, %i surfaces culled, %i+%i usec\n",
+		occ.frames, t->occluders / n, t->culled / n, t->tested / n, t->surfacesCulled / n,
+		(int)( t->rasterUsec / n ), (int)( t->testUsec / n ) );
+}
+
+
+/*
+================
+R_OcclusionResetStats_f
+================
+*/
+static void R_OcclusionResetStats_f( void ) {
+	Com_Memset( &occ.total, 0, sizeof( occ.total ) );
+	occ.frames = 0;
+}
+
+
+/*
+================
+R_InitOcclusionCulling
+================
+*/
+void R_InitOcclusionCulling( void ) {
+
+	if ( occ.initialized ) {
+		return;
+	}
+
+	r_occlusionCull = ri.Cvar_Get( "r_occlusionCull", "0", CVAR_ARCHIVE_ND );
+	ri.Cvar_SetDescription( r_occlusionCull, "Cull world leaves and brush models hidden behind large opaque faces using a CPU-rasterized depth buffer." );
+
+	r_occlusionMaxOccluders = ri.Cvar_Get( "r_occlusionMaxOccluders", "64", CVAR_ARCHIVE_ND );
+	ri.Cvar_CheckRange( r_occlusionMaxOccluders, "0", va( "%i", OCC_MAX_OCCLUDERS ), CV_INTEGER );
+	ri.Cvar_SetDescription( r_occlusionMaxOccluders, "Maximum number of occluder faces rasterized per view." );
+
+	r_occlusionMinArea = ri.Cvar_Get( "r_occlusionMinArea", "16384", CVAR_ARCHIVE_ND );
+	ri.Cvar_CheckRange( r_occlusionMinArea, "256", NULL, CV_FLOAT );
+	ri.Cvar_SetDescription( r_occlusionMinArea, "Minimum area in square units for a world face to be used as an occluder." );
+
+	ri.Cmd_AddCommand( "occlusioninfo", R_OcclusionInfo_f );
+	ri.Cmd_AddCommand( "occlusionresetstats", R_OcclusionResetStats_f );
+
+	occ.initialized = qtrue;
+}
+
+
+/*
+================
+R_ShutdownOcclusionCulling
+================
+*/
+void R_ShutdownOcclusionCulling( void ) {
+
+	if ( !occ.initialized ) {
+		return;
+	}
+
+	ri.Cmd_RemoveCommand( "occlusioninfo" );
+	ri.Cmd_RemoveCommand( "occlusionresetstats" );
+
+	Com_Memset( &occ, 0, sizeof( occ ) );
+}
+
+
+/*
+================
+R_IsOccluderShader
+
+Only fully opaque, non-deforming faces may hide what is behind them
+================
+*/
+static qboolean R_IsOccluderShader( const shader_t *shader ) {
+	int i;
+
+	if ( shader->isSky || shader->polygonOffset || shader->numDeforms ) {
+		return qfalse;
+	}
+
+	if ( shader->surfaceFlags & ( SURF_SKY | SURF_NODRAW ) ) {
+		return qfalse;
+	}
+
+	if ( shader->sort < SS_OPAQUE || shader->sort >= SS_DECAL ) {
+		return qfalse;
+	}
+
+	for ( i = 0; i < MAX_SHADER_STAGES; i++ ) {
+		const shaderStage_t *stage = shader->stages[ i ];
+		if ( !stage || !stage->active ) {
+			break;
+		}
+		if ( stage->stateBits & GLS_ATEST_BITS ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+
+/*
+================
+R_FaceArea
+================
+*/
+static float R_FaceArea( const srfSurfaceFace_t *face, vec3_t center ) {
+	const int *indices = (const int *)( (const byte *)face + face->ofsIndices );
+	vec3_t ba, ca, cross;
+	float area;
+	int i;
+
+	area = 0.0f;
+	for ( i = 0; i + 2 < face->numIndices; i += 3 ) {
+		VectorSubtract( face->points[ indices[i+1] ], face->points[ indices[i] ], ba );
+		VectorSubtract( face->points[ indices[i+2] ], face->points[ indices[i] ], ca );
+		CrossProduct( ba, ca, cross );
+		area += VectorLength( cross ) * 0.5f;
+	}
+
+	VectorClear( center );
+	for ( i = 0; i < face->numPoints; i++ ) {
+		VectorAdd( center, face->points[i], center );
+	}
+	if ( face->numPoints ) {
+		VectorScale( center, 1.0f / face->numPoints, center );
+	}
+
+	return area;
+}
+
+
+/*
+================
+R_BuildOcclusionOccluders
+
+Collect occluder candidates once per map, each face is bound to the first leaf
+that references it so PVS visibility can be checked cheaply every frame
+================
+*/
+void R_BuildOcclusionOccluders( world_t *world ) {
+	const mnode_t *leaf;
+	occluder_t *list;
+	msurface_t *surf, **mark;
+	byte *seen;
+	vec3_t center;
+	float area;
+	int i, c, n;
+
+	R_InitOcclusionCulling();
+
+	occ.world = NULL;
+	occ.occluders = NULL;
+	occ.numOccluders = 0;
+	occ.active = qfalse;
+
+	if ( !world->numsurfaces ) {
+		return;
+	}
+
+	seen = ri.Hunk_AllocateTempMemory( world->numsurfaces );
+	list = ri.Hunk_AllocateTempMemory( world->numsurfaces * sizeof( occluder_t ) );
+	Com_Memset( seen, 0, world->numsurfaces );
+
+	n = 0;
+	for ( i = 0, leaf = world->nodes; i < world->numnodes; i++, leaf++ ) {
+		if ( leaf->contents == CONTENTS_NODE ) {
+			continue;
+		}
+		mark = leaf->firstmarksurface;
+		for ( c = 0; c < leaf->nummarksurfaces; c++ ) {
+			surf = mark[c];
+			if ( seen[ surf - world->surfaces ] ) {
+				continue;
+			}
+			seen[ surf - world->surfaces ] = 1;
+			if ( *surf->data != SF_FACE || !R_IsOccluderShader( surf->shader ) ) {
+				continue;
+			}
+			area = R_FaceArea( (srfSurfaceFace_t *)surf->data, center );
+			if ( area < r_occlusionMinArea->value ) {
+				continue;
+			}
+			list[n].surf = surf;
+			list[n].leaf = leaf;
+			list[n].area = area;
+			VectorCopy( center, list[n].origin );
+			n++;
+		}
+	}
+
+	if ( n ) {
+		// keep the candidates on the map hunk
+		occ.occluders = ri.Hunk_Alloc( n * sizeof( occluder_t ), h_low );
+		Com_Memcpy( occ.occluders, list, n * sizeof( occluder_t ) );
+		occ.numOccluders = n;
+	}
+
+	ri.Hunk_FreeTempMemory( list );
+	ri.Hunk_FreeTempMemory( seen );
+
+	occ.world = world;
+
+	ri.Printf( PRINT_ALL, "...%i occluder faces for software occlusion\n", occ.numOccluders );
+}
+
+
+/*
+================
+R_OcclusionTransform
+
+Returns view space depth, screen position is only valid for depth >= OCC_NEAR
+================
+*/
+static float R_OcclusionTransform( const vec3_t p, occVert_t *out ) {
+	vec3_t d;
+	float fwd;
+
+	VectorSubtract( p, occ.origin, d );
+	fwd = DotProduct( d, occ.axis[0] );
+
+	if ( fwd >= OCC_NEAR ) {
+		out->z = 1.0f / fwd;
+		out->x = ( 1.0f - DotProduct( d, occ.axis[1] ) * out->z * occ.scaleX ) * ( OCC_WIDTH * 0.5f );
+		out->y = ( 1.0f - DotProduct( d, occ.axis[2] ) * out->z * occ.scaleY ) * ( OCC_HEIGHT * 0.5f );
+	}
+
+	return fwd;
+}
+
+
+/*
+================
+R_OcclusionRasterTriangle
+
+Half-space rasterizer writing the farthest 1/z of every pixel that lies
+completely inside the triangle
+================
+*/
+static void R_OcclusionRasterTriangle( const occVert_t *v0, const occVert_t *v1, const occVert_t *v2 ) {
+	float area, inv;
+	float a0, b0, c0, a1, b1, c1, a2, b2, c2;
+	float za, zb, zc;
+	int minx, maxx, miny, maxy;
+	int x, y;
+
+	area = ( v1->x - v0->x ) * ( v2->y - v0->y ) - ( v2->x - v0->x ) * ( v1->y - v0->y );
+	if ( fabsf( area ) < 1e-6f ) {
+		return;
+	}
+
+	minx = (int)floorf( MIN( v0->x, MIN( v1->x, v2->x ) ) );
+	maxx = (int)ceilf( MAX( v0->x, MAX( v1->x, v2->x ) ) );
+	miny = (int)floorf( MIN( v0->y, MIN( v1->y, v2->y ) ) );
+	maxy = (int)ceilf( MAX( v0->y, MAX( v1->y, v2->y ) ) );
+
+	if ( minx < 0 ) minx = 0;
+	if ( miny < 0 ) miny = 0;
+	if ( maxx > OCC_WIDTH ) maxx = OCC_WIDTH;
+	if ( maxy > OCC_HEIGHT ) maxy = OCC_HEIGHT;
+
+	if ( minx >= maxx || miny >= maxy ) {
+		return;
+	}
+
+	// edge functions normalized by the signed area give barycentric weights
+	// directly, so both windings rasterize the same way
+	inv = 1.0f / area;
+
+	a0 = ( v1->y - v2->y ) * inv; b0 = ( v2->x - v1->x ) * inv; c0 = ( v1->x * v2->y - v2->x * v1->y ) * inv;
+	a1 = ( v2->y - v0->y ) * inv; b1 = ( v0->x - v2->x ) * inv; c1 = ( v2->x * v0->y - v0->x * v2->y ) * inv;
+	a2 = ( v0->y - v1->y ) * inv; b2 = ( v1->x - v0->x ) * inv; c2 = ( v0->x * v1->y - v1->x * v0->y ) * inv;
+
+	// 1/z as a plane equation in screen space
+	za = a0 * v0->z + a1 * v1->z + a2 * v2->z;
+	zb = b0 * v0->z + b1 * v1->z + b2 * v2->z;
+	zc = c0 * v0->z + c1 * v1->z + c2 * v2->z;
+
+	// evaluated at pixel centers, move every edge half a pixel inwards so
+	// only fully covered pixels pass, and take the farthest 1/z over the pixel
+	c0 -= 0.5f * ( fabsf( a0 ) + fabsf( b0 ) );
+	c1 -= 0.5f * ( fabsf( a1 ) + fabsf( b1 ) );
+	c2 -= 0.5f * ( fabsf( a2 ) + fabsf( b2 ) );
+	zc -= 0.5f * ( fabsf( za ) + fabsf( zb ) );
+
+	for ( y = miny; y < maxy; y++ ) {
+		const float py = y + 0.5f;
+		const float r0 = b0 * py + c0;
+		const float r1 = b1 * py + c1;
+		const float r2 = b2 * py + c2;
+		const float rz = zb * py + zc;
+		float *row = occDepth[y];
+
+		x = minx;
+#if idx64
+		{
+			const __m128 step = _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f );
+			const __m128 va0 = _mm_set1_ps( a0 ), vr0 = _mm_set1_ps( r0 );
+			const __m128 va1 = _mm_set1_ps( a1 ), vr1 = _mm_set1_ps( r1 );
+			const __m128 va2 = _mm_set1_ps( a2 ), vr2 = _mm_set1_ps( r2 );
+			const __m128 vza = _mm_set1_ps( za ), vrz = _mm_set1_ps( rz );
+			const __m128 zero = _mm_setzero_ps();
+
+			for ( ; x + 4 <= maxx; x += 4 ) {
+				const __m128 px = _mm_add_ps( _mm_set1_ps( (float)x ), step );
+				const __m128 w0 = _mm_add_ps( _mm_mul_ps( va0, px ), vr0 );
+				const __m128 w1 = _mm_add_ps( _mm_mul_ps( va1, px ), vr1 );
+				const __m128 w2 = _mm_add_ps( _mm_mul_ps( va2, px ), vr2 );
+				const __m128 inside = _mm_and_ps( _mm_cmpge_ps( w0, zero ),
+					_mm_and_ps( _mm_cmpge_ps( w1, zero ), _mm_cmpge_ps( w2, zero ) ) );
+				__m128 z, d;
+
+				if ( _mm_movemask_ps( inside ) == 0 ) {
+					continue;
+				}
+
+				z = _mm_add_ps( _mm_mul_ps( vza, px ), vrz );
+				d = _mm_loadu_ps( row + x );
+				z = _mm_max_ps( d, z );
+				_mm_storeu_ps( row + x, _mm_or_ps( _mm_and_ps( inside, z ), _mm_andnot_ps( inside, d ) ) );
+			}
+		}
+#endif
+		for ( ; x < maxx; x++ ) {
+			const float px = x + 0.5f;
+			const float w0 = a0 * px + r0;
+			const float w1 = a1 * px + r1;
+			const float w2 = a2 * px + r2;
+			float z;
+
+			if ( w0 < 0.0f || w1 < 0.0f || w2 < 0.0f ) {
+				continue;
+			}
+
+			z = za * px + rz;
+			if ( z > row[x] ) {
+				row[x] = z;
+			}
+		}
+	}
+
+	occ.frame.triangles++;
+}
+
+
+/*
+================
+R_OcclusionClipTriangle
+
+Clip a world space triangle against the near plane and rasterize the result
+================
+*/
+static void R_OcclusionClipTriangle( const float *p0, const float *p1, const float *p2 ) {
+	const float *in[3];
+	float dist[3];
+	occVert_t v[3];
+	occVert_t out[OCC_MAX_CLIPPED];
+	vec3_t clip;
+	int i, n;
+
+	in[0] = p0; in[1] = p1; in[2] = p2;
+
+	n = 0;
+	for ( i = 0; i < 3; i++ ) {
+		dist[i] = R_OcclusionTransform( in[i], &v[i] );
+		if ( dist[i] >= OCC_NEAR ) {
+			n++;
+		}
+	}
+
+	if ( n == 0 ) {
+		return;
+	}
+
+	if ( n == 3 ) {
+		R_OcclusionRasterTriangle( &v[0], &v[1], &v[2] );
+		return;
+	}
+
+	// Sutherland-Hodgman against a single plane yields at most four vertexes
+	n = 0;
+	for ( i = 0; i < 3; i++ ) {
+		const int j = ( i + 1 ) % 3;
+		if ( dist[i] >= OCC_NEAR ) {
+			out[n++] = v[i];
+		}
+		if ( ( dist[i] >= OCC_NEAR ) != ( dist[j] >= OCC_NEAR ) ) {
+			const float f = ( OCC_NEAR - dist[i] ) / ( dist[j] - dist[i] );
+			VectorSubtract( in[j], in[i], clip );
+			VectorMA( in[i], f, clip, clip );
+			R_OcclusionTransform( clip, &out[n++] );
+		}
+	}
+
+	for ( i = 2; i < n; i++ ) {
+		R_OcclusionRasterTriangle( &out[0], &out[i-1], &out[i] );
+	}
+}
+
+
+/*
+================
+R_OcclusionRasterFace
+================
+*/
+static void R_OcclusionRasterFace( const msurface_t *surf ) {
+	const srfSurfaceFace_t *face = (const srfSurfaceFace_t *)surf->data;
+	const int *indices = (const int *)( (const byte *)face + face->ofsIndices );
+	int i;
+
+	// one-sided faces do not hide anything when seen from behind
+	if ( surf->shader->cullType != CT_TWO_SIDED ) {
+		float d = DotProduct( occ.origin, face->plane.normal ) - face->plane.dist;
+		if ( surf->shader->cullType == CT_FRONT_SIDED ? d < 0.0f : d > 0.0f ) {
+			return;
+		}
+	}
+
+	for ( i = 0; i + 2 < face->numIndices; i += 3 ) {
+		R_OcclusionClipTriangle( face->points[ indices[i] ], face->points[ indices[i+1] ], face->points[ indices[i+2] ] );
+	}
+
+	occ.frame.occluders++;
+}
+
+
+/*
+================
+R_OccluderSortFunc
+
+Largest projected area first, ties broken by index for a stable order
+================
+*/
+static int R_OccluderSortFunc( const void *a, const void *b ) {
+	const occluderSort_t *sa = (const occluderSort_t *)a;
+	const occluderSort_t *sb = (const occluderSort_t *)b;
+
+	if ( sa->score > sb->score ) {
+		return -1;
+	}
+	if ( sa->score < sb->score ) {
+		return 1;
+	}
+	return sa->index - sb->index;
+}
+
+
+/*
+================
+R_OcclusionActive
+================
+*/
+qboolean R_OcclusionActive( void ) {
+	return occ.active;
+}
+
+
+/*
+================
+R_OcclusionEndView
+
+Accumulate the statistics of the previous view and invalidate its depth
+buffer, must be called for every view before anything is culled
+================
+*/
+void R_OcclusionEndView( void ) {
+	if ( occ.active ) {
+		// accumulate the previous view
+		occ.total.occluders += occ.frame.occluders;
+		occ.total.triangles += occ.frame.triangles;
+		occ.total.tested += occ.frame.tested;
+		occ.total.culled += occ.frame.culled;
+		occ.total.surfacesCulled += occ.frame.surfacesCulled;
+		occ.total.rasterUsec += occ.frame.rasterUsec;
+		occ.total.testUsec += occ.frame.testUsec;
+		occ.frames++;
+	}
+
+	occ.active = qfalse;
+}
+
+
+/*
+================
+R_OcclusionBeginFrame
+
+Select the best visible occluders for this view and rasterize them,
+must be called after the leaves have been marked for the current view
+================
+*/
+void R_OcclusionBeginFrame( void ) {
+	occluderSort_t *sorted;
+	int64_t start;
+	vec3_t d;
+	int i, n, maxOccluders;
+
+	R_OcclusionEndView();
+
+	if ( !occ.initialized || !r_occlusionCull->integer || r_nocull->integer ) {
+		return;
+	}
+
+	if ( occ.world != tr.world || !occ.numOccluders ) {
+		return;
+	}
+
+	// portal and mirror views clip geometry in front of the portal plane
+	// which the depth buffer knows nothing about
+	if ( tr.viewParms.portalView != PV_NONE ) {
+		return;
+	}
+
+	maxOccluders = r_occlusionMaxOccluders->integer;
+	if ( maxOccluders <= 0 ) {
+		return;
+	}
+
+	start = ri.Microseconds();
+
+	Com_Memset( &occ.frame, 0, sizeof( occ.frame ) );
+
+	VectorCopy( tr.viewParms.or.origin, occ.origin );
+	AxisCopy( tr.viewParms.or.axis, occ.axis );
+	occ.scaleX = 1.0f / tanf( DEG2RAD( tr.viewParms.fovX * 0.5f ) );
+	occ.scaleY = 1.0f / tanf( DEG2RAD( tr.viewParms.fovY * 0.5f ) );
+
+	sorted = ri.Hunk_AllocateTempMemory( occ.numOccluders * sizeof( occluderSort_t ) );
+
+	for ( i = 0, n = 0; i < occ.numOccluders; i++ ) {
+		const occluder_t *o = &occ.occluders[i];
+		float dist;
+
+		if ( o->leaf->visframe != tr.visCount ) {
+			continue;
+		}
+
+		VectorSubtract( o->origin, occ.origin, d );
+		if ( DotProduct( d, occ.axis[0] ) < -sqrtf( o->area ) ) {
+			continue; // well behind the viewer
+		}
+
+		dist = DotProduct( d, d ) + 1.0f;
+		sorted[n].score = o->area / dist;
+		sorted[n].index = i;
+		n++;
+	}
+
+	qsort( sorted, n, sizeof( sorted[0] ), R_OccluderSortFunc );
+
+	if ( n > maxOccluders ) {
+		n = maxOccluders;
+	}
+
+	Com_Memset( occDepth, 0, sizeof( occDepth ) );
+
+	for ( i = 0; i < n; i++ ) {
+		R_OcclusionRasterFace( occ.occluders[ sorted[i].index ].surf );
+	}
+
+	ri.Hunk_FreeTempMemory( sorted );
+
+	occ.frame.rasterUsec = ri.Microseconds() - start;
+	occ.active = ( occ.frame.triangles != 0 );
+}
+
+
+/*
+================
+R_OcclusionTestRect
+
+Returns qtrue if every pixel in [x0,x1)x[y0,y1) is nearer than z
+================
+*/
+static qboolean R_OcclusionTestRect( int x0, int y0, int x1, int y1, float z ) {
+	int x, y;
+
+	for ( y = y0; y < y1; y++ ) {
+		const float *row = occDepth[y];
+		x = x0;
+#if idx64
+		{
+			const __m128 vz = _mm_set1_ps( z );
+			for ( ; x + 4 <= x1; x += 4 ) {
+				if ( _mm_movemask_ps( _mm_cmple_ps( _mm_loadu_ps( row + x ), vz ) ) ) {
+					return qfalse;
+				}
+			}
+		}
+#endif
+		for ( ; x < x1; x++ ) {
+			if ( row[x] <= z ) {
+				return qfalse;
+			}
+		}
+	}
+
+	return qtrue;
+}
+
+
+/*
+================
+R_OcclusionTestCorners
+
+Returns qtrue if the box spanned by the corners is completely hidden
+================
+*/
+static qboolean R_OcclusionTestCorners( vec3_t corners[8] ) {
+	float minx, maxx, miny, maxy, maxz;
+	occVert_t v;
+	int64_t start;
+	qboolean culled;
+	int i;
+
+	start = ri.Microseconds();
+
+	occ.frame.tested++;
+
+	minx = miny = 1e30f;
+	maxx = maxy = -1e30f;
+	maxz = 0.0f;
+
+	for ( i = 0; i < 8; i++ ) {
+		// anything reaching the near plane is treated as visible
+		if ( R_OcclusionTransform( corners[i], &v ) < OCC_NEAR ) {
+			occ.frame.testUsec += ri.Microseconds() - start;
+			return qfalse;
+		}
+
+		if ( v.x < minx ) minx = v.x;
+		if ( v.x > maxx ) maxx = v.x;
+		if ( v.y < miny ) miny = v.y;
+		if ( v.y > maxy ) maxy = v.y;
+		if ( v.z > maxz ) maxz = v.z;
+	}
+
+	// fully off-screen boxes are left to the frustum
+	culled = qfalse;
+	if ( maxx > 0.0f && maxy > 0.0f && minx < OCC_WIDTH && miny < OCC_HEIGHT ) {
+		int x0 = (int)floorf( minx );
+		int y0 = (int)floorf( miny );
+		int x1 = (int)ceilf( maxx );
+		int y1 = (int)ceilf( maxy );
+
+		if ( x0 < 0 ) x0 = 0;
+		if ( y0 < 0 ) y0 = 0;
+		if ( x1 > OCC_WIDTH ) x1 = OCC_WIDTH;
+		if ( y1 > OCC_HEIGHT ) y1 = OCC_HEIGHT;
+
+		culled = R_OcclusionTestRect( x0, y0, x1, y1, maxz * OCC_DEPTH_BIAS );
+	}
+
+	if ( culled ) {
+		occ.frame.culled++;
+	}
+
+	occ.frame.testUsec += ri.Microseconds() - start;
+
+	return culled;
+}
+
+
+/*
+================
+R_OcclusionCullBounds
+
+Returns qtrue if the world space box is completely hidden by occluders
+================
+*/
+qboolean R_OcclusionCullBounds( const vec3_t mins, const vec3_t maxs ) {
+	vec3_t corners[8];
+	int i;
+
+	if ( !occ.active ) {
+		return qfalse;
+	}
+
+	for ( i = 0; i < 8; i++ ) {
+		corners[i][0] = ( i & 1 ) ? maxs[0] : mins[0];
+		corners[i][1] = ( i & 2 ) ? maxs[1] : mins[1];
+		corners[i][2] = ( i & 4 ) ? maxs[2] : mins[2];
+	}
+
+	return R_OcclusionTestCorners( corners );
+}
+
+
+/*
+================
+R_OcclusionCullLocalBounds
+
+Same as R_OcclusionCullBounds for a box in the space of the current entity (tr.or)
+================
+*/
+qboolean R_OcclusionCullLocalBounds( const vec3_t bounds[2] ) {
+	vec3_t corners[8];
+	int i;
+
+	if ( !occ.active ) {
+		return qfalse;
+	}
+
+	for ( i = 0; i < 8; i++ ) {
+		VectorCopy( tr.or.origin, corners[i] );
+		VectorMA( corners[i], bounds[ ( i >> 0 ) & 1 ][0], tr.or.axis[0], corners[i] );
+		VectorMA( corners[i], bounds[ ( i >> 1 ) & 1 ][1], tr.or.axis[1], corners[i] );
+		VectorMA( corners[i], bounds[ ( i >> 2 ) & 1 ][2], tr.or.axis[2], corners[i] );
+	}
+
+	return R_OcclusionTestCorners( corners );
+}
+
+
+/*
+================
+R_OcclusionCullLeaf
+================
+*/
+qboolean R_OcclusionCullLeaf( const mnode_t *leaf ) {
+
+	if ( !R_OcclusionCullBounds( leaf->mins, leaf->maxs ) ) {
+		return qfalse;
+	}
+
+	occ.frame.surfacesCulled += leaf->nummarksurfaces;
+
+	return qtrue;
+}
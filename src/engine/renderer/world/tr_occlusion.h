@@ -0,0 +1,66 @@
+/*
+===========================================================================
+Copyright (C) 2024 Quake3e-HD Project
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_occlusion.h - CPU software occlusion culling
+
+#ifndef TR_OCCLUSION_H
+#define TR_OCCLUSION_H
+
+#include "../core/tr_local.h"
+
+/*
+================================================================================
+Software occlusion culling
+
+Large opaque world faces from PVS-visible leaves are rasterized into a small
+CPU depth buffer before the world walk. Leaf and entity bounds are then tested
+against it, so geometry hidden behind walls never reaches the draw list.
+Results only depend on the view and the map, so culling is deterministic.
+================================================================================
+*/
+
+#define OCC_WIDTH			256
+#define OCC_HEIGHT			128
+#define OCC_MAX_OCCLUDERS	1024
+
+typedef struct {
+	int			occluders;			// faces rasterized this frame
+	int			triangles;
+	int			tested;				// bounds tested against the depth buffer
+	int			culled;				// bounds rejected
+	int			surfacesCulled;		// mark surfaces skipped inside rejected leaves
+	int64_t		rasterUsec;
+	int64_t		testUsec;
+} occlusionStats_t;
+
+void		R_InitOcclusionCulling( void );
+void		R_ShutdownOcclusionCulling( void );
+
+void		R_BuildOcclusionOccluders( world_t *world );
+
+void		R_OcclusionEndView( void );
+void		R_OcclusionBeginFrame( void );
+qboolean	R_OcclusionCullBounds( const vec3_t mins, const vec3_t maxs );
+qboolean	R_OcclusionCullLocalBounds( const vec3_t bounds[2] );
+qboolean	R_OcclusionCullLeaf( const mnode_t *leaf );
+qboolean	R_OcclusionActive( void );
+
+#endif // TR_OCCLUSION_H
@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 #include "../core/tr_local.h"
+#include "tr_occlusion.h"
 
 
 
@@ -534,6 +535,10 @@ void R_AddBrushModelSurfaces ( trRefEntity_t *ent ) {
 		return;
 	}
 
+	if ( R_OcclusionCullLocalBounds( bmodel->bounds ) ) {
+		return;
+	}
+
 #ifdef USE_PMLIGHT
 #ifdef USE_LEGACY_DLIGHTS
 	if ( r_dlightMode->integer ) 
@@ -698,6 +703,11 @@ static void R_RecursiveWorldNode( mnode_t *node, unsigned int planeBits, unsigne
 		int			c;
 		msurface_t	*surf, **mark;
 
+		// hidden behind large occluders
+		if ( R_OcclusionCullLeaf( node ) ) {
+			return;
+		}
+
 		tr.pc.c_leafs++;
 
 		// add to z buffer bounds
@@ -934,6 +944,9 @@ void R_AddWorldSurfaces_Original( void ) {
 	int i;
 #endif
 
+	// never cull this view against the depth buffer of a previous one
+	R_OcclusionEndView();
+
 	if ( !r_drawworld->integer ) {
 		return;
 	}
@@ -951,6 +964,9 @@ void R_AddWorldSurfaces_Original( void ) {
 	// clear out the visible min/max
 	ClearBounds( tr.viewParms.visBounds[0], tr.viewParms.visBounds[1] );
 
+	// rasterize occluders from the marked leaves
+	R_OcclusionBeginFrame();
+
 	// perform frustum culling and add all the potentially visible surfaces
 	if ( tr.refdef.num_dlights > MAX_DLIGHTS ) {
 		tr.refdef.num_dlights = MAX_DLIGHTS;
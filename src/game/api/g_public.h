@@ -398,6 +398,7 @@ typedef enum {
 
 	// engine extensions
 	G_CVAR_SETDESCRIPTION,
+	BOTLIB_AAS_ENTITIES_IN_RADIUS,	// ( vec3_t origin, float radius, int type, int *entities, int maxentities );
 	G_TRAP_GETVALUE = COM_TRAP_GETVALUE
 
 } gameImport_t;
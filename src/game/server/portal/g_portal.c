@@ -505,56 +505,109 @@ void G_PortalProjectileImpact(gentity_t *projectile, trace_t *trace, portalType_
     }
 }
 
-qboolean G_TraceThroughPortals(vec3_t start, vec3_t end, trace_t *trace, int passEntityNum) {
-    int i;
-    portalInfo_t *portal, *linkedPortal;
-    vec3_t portalIntersect, relativePos, transformedEnd;
-    trace_t portalTrace;
+static portalInfo_t *G_LinkedActivePortal(const portalInfo_t *portal) {
+    gentity_t *linkedEnt;
+    int linkedSlot;
     
-    trap_Trace(trace, start, NULL, NULL, end, passEntityNum, MASK_SHOT);
+    if (!portal->inUse || portal->state != PORTAL_STATE_ACTIVE) {
+        return NULL;
+    }
     
-    if (trace->fraction >= 1.0f) {
-        return qfalse;
+    if (portal->linkedPortalNum < 0) {
+        return NULL;
     }
     
-    for (i = 0; i < MAX_PORTAL_PAIRS * 2; i++) {
-        portal = &g_portals[i];
-        if (!portal->inUse || portal->state != PORTAL_STATE_ACTIVE) {
-            continue;
-        }
-        
-        if (portal->linkedPortalNum < 0) {
-            continue;
-        }
-        
-        gentity_t *linkedEnt = &g_entities[portal->linkedPortalNum];
-        if (!linkedEnt->inuse) {
-            continue;
-        }
+    linkedEnt = &g_entities[portal->linkedPortalNum];
+    if (!linkedEnt->inuse) {
+        return NULL;
+    }
+    
+    linkedSlot = linkedEnt->genericValue1;
+    if (linkedSlot < 0 || linkedSlot >= MAX_PORTAL_PAIRS * 2) {
+        return NULL;
+    }
+    
+    return &g_portals[linkedSlot];
+}
+
+// Returns the fraction of start + delta where the segment enters the portal
+// disc from the front, or -1 if it misses the disc.
+static float G_PortalSegmentFraction(const portalInfo_t *portal, const vec3_t start, const vec3_t delta) {
+    vec3_t relativePos;
+    float denom, frac;
+    
+    denom = DotProduct(delta, portal->surfaceNormal);
+    if (denom >= 0.0f) {
+        return -1.0f;
+    }
+    
+    VectorSubtract(start, portal->origin, relativePos);
+    frac = -DotProduct(relativePos, portal->surfaceNormal) / denom;
+    if (frac < 0.0f || frac > 1.0f) {
+        return -1.0f;
+    }
+    
+    VectorMA(relativePos, frac, delta, relativePos);
+    if (DotProduct(relativePos, relativePos) >= portal->radius * portal->radius) {
+        return -1.0f;
+    }
+    
+    return frac;
+}
+
+// Traces a hitscan shot and follows it through up to PORTAL_MAX_TRACE_HOPS
+// portals. Portals are picked with a ray/disc test against the active set, so
+// only the segments the shot travels are traced. A shot entering a portal
+// leaves the linked portal's origin with the segment rotated between the two
+// portal normals. Returns qtrue if the shot went through a portal; trace then
+// holds the last segment.
+qboolean G_TraceThroughPortals(vec3_t start, vec3_t end, trace_t *trace, int passEntityNum) {
+    int i, hops;
+    portalInfo_t *portal, *linkedPortal, *enterPortal, *exitPortal;
+    vec3_t segmentStart, segmentEnd, delta;
+    float frac, bestFrac;
+    
+    VectorCopy(start, segmentStart);
+    VectorCopy(end, segmentEnd);
+    
+    for (hops = 0; ; hops++) {
+        trap_Trace(trace, segmentStart, NULL, NULL, segmentEnd, passEntityNum, MASK_SHOT);
         
-        int linkedSlot = linkedEnt->genericValue1;
-        if (linkedSlot < 0 || linkedSlot >= MAX_PORTAL_PAIRS * 2) {
-            continue;
+        if (hops >= PORTAL_MAX_TRACE_HOPS) {
+            break;
         }
         
-        linkedPortal = &g_portals[linkedSlot];
+        // the nearest portal entered before the shot hits something
+        VectorSubtract(segmentEnd, segmentStart, delta);
+        enterPortal = NULL;
+        exitPortal = NULL;
+        bestFrac = trace->fraction;
         
-        trap_Trace(&portalTrace, start, NULL, NULL, portal->origin, passEntityNum, MASK_SHOT);
-        
-        if (portalTrace.fraction < trace->fraction) {
-            VectorSubtract(portalTrace.endpos, portal->origin, relativePos);
-            float dist = DotProduct(relativePos, portal->portalForward);
+        for (i = 0; i < MAX_PORTAL_PAIRS * 2; i++) {
+            portal = &g_portals[i];
+            linkedPortal = G_LinkedActivePortal(portal);
+            if (!linkedPortal) {
+                continue;
+            }
             
-            if (fabs(dist) < 10.0f && VectorLength(relativePos) < portal->radius) {
-                VectorSubtract(end, start, relativePos);
-                G_TransformVelocityThroughPortal(relativePos, portal->surfaceNormal, linkedPortal->surfaceNormal);
-                VectorAdd(linkedPortal->origin, relativePos, transformedEnd);
-                
-                trap_Trace(trace, linkedPortal->origin, NULL, NULL, transformedEnd, passEntityNum, MASK_SHOT);
-                return qtrue;
+            frac = G_PortalSegmentFraction(portal, segmentStart, delta);
+            if (frac < 0.0f || frac > bestFrac) {
+                continue;
             }
+            
+            bestFrac = frac;
+            enterPortal = portal;
+            exitPortal = linkedPortal;
         }
+        
+        if (!enterPortal) {
+            break;
+        }
+        
+        G_TransformVelocityThroughPortal(delta, enterPortal->surfaceNormal, exitPortal->surfaceNormal);
+        VectorCopy(exitPortal->origin, segmentStart);
+        VectorAdd(exitPortal->origin, delta, segmentEnd);
     }
     
-    return qfalse;
-}
\ No newline at end of file
+    return hops > 0 ? qtrue : qfalse;
+}
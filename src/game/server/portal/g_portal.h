@@ -15,6 +15,7 @@ Portal-style gameplay implementation
 #define PORTAL_ACTIVATION_TIME 500
 #define PORTAL_CLOSE_TIME 300
 #define FALL_DAMAGE_IMMUNITY_TIME 5000
+#define PORTAL_MAX_TRACE_HOPS 4
 
 typedef enum {
     PORTAL_ORANGE = 0,
@@ -353,6 +353,12 @@ static qboolean SV_GetValue( char* value, int valueSize, const char* key )
 		return qtrue;
 	}
 
+	if ( !Q_stricmp( key, "trap_AAS_EntitiesInRadius_Q3E" ) )
+	{
+		Com_sprintf( value, valueSize, "%i", BOTLIB_AAS_ENTITIES_IN_RADIUS );
+		return qtrue;
+	}
+
 	return qfalse;
 }
 
@@ -581,6 +587,9 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AAS_ENTITY_INFO:
 		botlib_export->aas.AAS_EntityInfo( args[1], VMA(2) );
 		return 0;
+	case BOTLIB_AAS_ENTITIES_IN_RADIUS:
+		VM_CHECKBOUNDS( gvm, args[4], args[5] * sizeof( int ) );
+		return botlib_export->aas.AAS_EntitiesInRadius( VMA(1), VMF(2), args[3], VMA(4), args[5] );
 
 	case BOTLIB_AAS_INITIALIZED:
 		return botlib_export->aas.AAS_Initialized();
@@ -1301,8 +1301,9 @@ void SV_Frame( int msec ) {
 		if ( com_dedicated->integer )
 		{
 			// Block indefinitely until something interesting happens
-			// on STDIN.
-			Sys_Sleep( -1 );
+			// on STDIN, journal replays never read the network.
+			if ( !Com_JournalWait() )
+				Sys_Sleep( -1 );
 		}
 		return;
 	}
@@ -246,200 +246,352 @@ void SV_UpdateServerCommandsToClient( client_t *client, msg_t *msg ) {
 
 Build a client snapshot structure
 
+Entities that pass the area and PVS tests only depend on the cluster and
+area of the viewpoint, so the candidates are found once per common snapshot
+for every cluster/area pair and shared by all viewers and portal cameras in
+it. The leafs of the portal cameras are also found once per common snapshot.
+
+A client snapshot is the union of the candidates of the client's viewpoint
+and of every portal camera it can see. The union is kept as a bitset over
+the sorted common snapshot so it never needs sorting, and the per-client
+filters are applied when the union is turned into the entity list.
+
 =============================================================================
 */
 
+#define MAX_SNAPSHOT_VISSETS	128
+
+typedef struct {
+	int		cluster;
+	int		area;
+	uint32_t	bits[ MAX_GENTITIES / 32 ];	// indexes into svs.currFrame->ents
+} snapshotVisSet_t;
+
+typedef struct {
+	int		index;						// into svs.currFrame->ents
+	int		cluster;					// of the camera position
+	int		area;
+} snapshotPortal_t;
 
-typedef int entityNum_t;
 typedef struct {
-	int		numSnapshotEntities;
-	entityNum_t	snapshotEntities[ MAX_SNAPSHOT_ENTITIES ];
-	qboolean unordered;
-} snapshotEntityNumbers_t;
+	uint32_t	bits[ MAX_GENTITIES / 32 ];		// union of the candidates of all views
+	uint32_t	reached[ MAX_GENTITIES / 32 ];	// portals that were already seen
+	qboolean	selfPortalMerged;
+} snapshotViews_t;
+
+static snapshotVisSet_t	visSets[ MAX_SNAPSHOT_VISSETS ];
+static int				numVisSets;
+
+static snapshotPortal_t	snapPortals[ MAX_GENTITIES ];
+static int				numSnapPortals = -1;	// -1 when not found yet
 
 
 /*
-=============
-SV_SortEntityNumbers
+===============
+SV_ClearVisSets
 
-Insertion sort is about 10 times faster than quicksort for our task
-=============
+The game can't move entities or change area portal states while the
+snapshots of one common snapshot are built, so the sets stay valid
+until the next common snapshot
+===============
 */
-static void SV_SortEntityNumbers( entityNum_t *num, const int size ) {
-	entityNum_t tmp;
-	int i, d;
-	for ( i = 1 ; i < size; i++ ) {
-		d = i;
-		while ( d > 0 && num[d] < num[d-1] ) {
-			tmp = num[d];
-			num[d] = num[d-1];
-			num[d-1] = tmp;
-			d--;
-		}
-	}
-#ifdef _DEBUG
-	// consistency check for delta encoding
-	for ( i = 1 ; i < size; i++ ) {
-		if ( num[i-1] >= num[i] ) {
-			Com_Error( ERR_DROP, "%s: invalid entity number %i", __func__, num[ i ] );
-		}
-	}
-#endif
+static void SV_ClearVisSets( void ) {
+	numVisSets = 0;
+	numSnapPortals = -1;
 }
 
 
 /*
 ===============
-SV_AddIndexToSnapshot
+SV_EntityVisibleFromCluster
 ===============
 */
-static void SV_AddIndexToSnapshot( svEntity_t *svEnt, int index, snapshotEntityNumbers_t *eNums ) {
+static qboolean SV_EntityVisibleFromCluster( const svEntity_t *svEnt, int clientarea, const byte *clientpvs ) {
+	int		i, l;
+
+	// ignore if not touching a PV leaf
+	// check area
+	if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+		// doors can legally straddle two areas, so
+		// we may need to check another one
+		if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+			return qfalse;		// blocked by a door
+		}
+	}
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	// check individual leafs
+	if ( !svEnt->numClusters ) {
+		return qfalse;
+	}
+	l = 0;
+	for ( i=0 ; i < svEnt->numClusters ; i++ ) {
+		l = svEnt->clusternums[i];
+		if ( clientpvs[l >> 3] & (1 << (l&7) ) ) {
+			return qtrue;
+		}
+	}
 
-	// if we are full, silently discard entities
-	if ( eNums->numSnapshotEntities >= MAX_SNAPSHOT_ENTITIES ) {
-		return;
+	// if we haven't found it to be visible,
+	// check overflow clusters that couldn't be stored
+	if ( svEnt->lastCluster ) {
+		for ( ; l <= svEnt->lastCluster ; l++ ) {
+			if ( clientpvs[l >> 3] & (1 << (l&7) ) ) {
+				break;
+			}
+		}
+		if ( l == svEnt->lastCluster ) {
+			return qfalse;	// not visible
+		}
+		return qtrue;
 	}
 
-	eNums->snapshotEntities[ eNums->numSnapshotEntities ] = index;
-	eNums->numSnapshotEntities++;
+	return qfalse;
 }
 
 
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_GetVisSet
+
+Returns the entities of the current common snapshot that are broadcast
+or pass the area and PVS tests from the given cluster and area, the set
+is built in scratch when there is no room left to keep it
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_t *frame,
-									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+static const snapshotVisSet_t *SV_GetVisSet( int clientcluster, int clientarea, snapshotVisSet_t *scratch ) {
+	snapshotVisSet_t *set;
+	const sharedEntity_t *ent;
+	const svEntity_t *svEnt;
+	const entityState_t *es;
+	const byte *clientpvs;
 	int		e, i;
-	sharedEntity_t *ent;
-	svEntity_t	*svEnt;
-	entityState_t  *es;
-	int		l;
-	int		clientarea, clientcluster;
-	int		leafnum;
-	byte	*clientpvs;
-	byte	*bitvector;
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specifically check for it
-	if ( sv.state == SS_DEAD ) {
-		return;
+	for ( i = 0; i < numVisSets; i++ ) {
+		if ( visSets[ i ].cluster == clientcluster && visSets[ i ].area == clientarea ) {
+			return &visSets[ i ];
+		}
 	}
 
-	leafnum = CM_PointLeafnum (origin);
-	clientarea = CM_LeafArea (leafnum);
-	clientcluster = CM_LeafCluster (leafnum);
+	if ( numVisSets < MAX_SNAPSHOT_VISSETS ) {
+		set = &visSets[ numVisSets++ ];
+	} else {
+		set = scratch;
+	}
 
-	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+	set->cluster = clientcluster;
+	set->area = clientarea;
+	Com_Memset( set->bits, 0, sizeof( set->bits ) );
 
-	clientpvs = CM_ClusterPVS (clientcluster);
+	clientpvs = CM_ClusterPVS( clientcluster );
 
 	for ( e = 0 ; e < svs.currFrame->count; e++ ) {
 		es = svs.currFrame->ents[ e ];
 		ent = SV_GentityNum( es->number );
+		svEnt = &sv.svEntities[ es->number ];
 
-		// entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
-			if ( ent->r.singleClient != frame->ps.clientNum ) {
-				continue;
-			}
+		// broadcast entities are always sent
+		if ( ent->r.svFlags & SVF_BROADCAST || SV_EntityVisibleFromCluster( svEnt, clientarea, clientpvs ) ) {
+			set->bits[ e >> 5 ] |= 1U << ( e & 31 );
 		}
-		// entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
-			if ( ent->r.singleClient == frame->ps.clientNum ) {
-				continue;
-			}
+	}
+
+	return set;
+}
+
+
+/*
+===============
+SV_FindSnapshotPortals
+
+Finds the portals of the current common snapshot and the leafs of their cameras
+===============
+*/
+static void SV_FindSnapshotPortals( void ) {
+	const sharedEntity_t *ent;
+	snapshotPortal_t *p;
+	int		e, leafnum;
+
+	numSnapPortals = 0;
+
+	for ( e = 0 ; e < svs.currFrame->count; e++ ) {
+		ent = SV_GentityNum( svs.currFrame->ents[ e ]->number );
+		// broadcast entities don't merge portal views
+		if ( ( ent->r.svFlags & ( SVF_PORTAL | SVF_BROADCAST ) ) != SVF_PORTAL ) {
+			continue;
 		}
-		// entities can be flagged to be sent to a given mask of clients
-		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
-			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
-				continue;
+		p = &snapPortals[ numSnapPortals++ ];
+		p->index = e;
+		leafnum = CM_PointLeafnum( ent->s.origin2 );
+		p->area = CM_LeafArea( leafnum );
+		p->cluster = CM_LeafCluster( leafnum );
+	}
+}
+
+
+/*
+===============
+SV_ClientFiltersEntity
+
+Returns qtrue if the entity is flagged to not be sent to the client
+===============
+*/
+static qboolean SV_ClientFiltersEntity( const sharedEntity_t *ent, int clientNum ) {
+
+	// entities can be flagged to be sent to only one client
+	if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
+		if ( ent->r.singleClient != clientNum ) {
+			return qtrue;
 		}
+	}
+	// entities can be flagged to be sent to everyone but one client
+	if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
+		if ( ent->r.singleClient == clientNum ) {
+			return qtrue;
+		}
+	}
+	// entities can be flagged to be sent to a given mask of clients
+	if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+		if (clientNum >= 32)
+			Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+		if (~ent->r.singleClient & (1 << clientNum))
+			return qtrue;
+	}
 
-		svEnt = &sv.svEntities[ es->number ];
+	return qfalse;
+}
+
+
+/*
+===============
+SV_AddViewFromPoint
+
+Merges the candidates visible from the point into the views and follows the
+portals seen from it. Portals are followed in entity order and only the first
+time they are seen, which visits the same cameras as adding the entities one
+by one and recursing at each new portal does.
+===============
+*/
+static void SV_AddViewFromPoint( const vec3_t origin, int cluster, int area, clientSnapshot_t *frame,
+									snapshotViews_t *views, qboolean portal ) {
+	const snapshotVisSet_t *set;
+	snapshotVisSet_t scratch;
+	const snapshotPortal_t *p;
+	sharedEntity_t *ent;
+	int		i, e, words, leafnum;
 
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	// calculate the visible areas
+	frame->areabytes = CM_WriteAreaBits( frame->areabits, area );
+
+	set = SV_GetVisSet( cluster, area, &scratch );
+
+	words = ( svs.currFrame->count + 31 ) >> 5;
+	for ( i = 0; i < words; i++ ) {
+		views->bits[ i ] |= set->bits[ i ];
+	}
+
+	for ( i = 0; i < numSnapPortals; i++ ) {
+		p = &snapPortals[ i ];
+		e = p->index;
+		if ( !( set->bits[ e >> 5 ] & ( 1U << ( e & 31 ) ) ) ) {
 			continue;
 		}
-
-		// broadcast entities are always sent
-		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddIndexToSnapshot( svEnt, e, eNums );
+		// don't follow a portal twice
+		if ( views->reached[ e >> 5 ] & ( 1U << ( e & 31 ) ) ) {
+			continue;
+		}
+		// never send client's own entity
+		if ( svs.currFrame->ents[ e ]->number == frame->ps.clientNum ) {
 			continue;
 		}
+		ent = SV_GentityNum( svs.currFrame->ents[ e ]->number );
+		if ( SV_ClientFiltersEntity( ent, frame->ps.clientNum ) ) {
+			continue;
+		}
+		views->reached[ e >> 5 ] |= 1U << ( e & 31 );
 
-		// ignore if not touching a PV leaf
-		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
-			// doors can legally straddle two areas, so
-			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
-				continue;		// blocked by a door
+		// add everything visible from its camera position
+		if ( portal ) {
+			continue;
+		}
+		if ( ent->s.generic1 ) {
+			vec3_t dir;
+			VectorSubtract(ent->s.origin, origin, dir);
+			if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
+				continue;
 			}
 		}
+		SV_AddViewFromPoint( ent->s.origin2, p->cluster, p->area, frame, views, portal );
+	}
 
-		bitvector = clientpvs;
+	ent = SV_GentityNum( frame->ps.clientNum );
+	// extension: merge second PVS at ent->r.s.origin2
+	if ( ent->r.svFlags & SVF_SELF_PORTAL2 && !portal && !views->selfPortalMerged ) {
+		views->selfPortalMerged = qtrue;
+		leafnum = CM_PointLeafnum( ent->r.s.origin2 );
+		SV_AddViewFromPoint( ent->r.s.origin2, CM_LeafCluster( leafnum ), CM_LeafArea( leafnum ), frame, views, qtrue );
+	}
+}
+
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_t *frame ) {
+	snapshotViews_t views;
+	sharedEntity_t *ent;
+	entityState_t  *es;
+	int		e, leafnum;
 
-		// check individual leafs
-		if ( !svEnt->numClusters ) {
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specifically check for it
+	if ( sv.state == SS_DEAD ) {
+		return;
+	}
+
+	if ( numSnapPortals < 0 ) {
+		SV_FindSnapshotPortals();
+	}
+
+	Com_Memset( views.bits, 0, ( ( svs.currFrame->count + 31 ) >> 5 ) * sizeof( uint32_t ) );
+	Com_Memset( views.reached, 0, ( ( svs.currFrame->count + 31 ) >> 5 ) * sizeof( uint32_t ) );
+	views.selfPortalMerged = qfalse;
+
+	leafnum = CM_PointLeafnum (origin);
+	SV_AddViewFromPoint( origin, CM_LeafCluster( leafnum ), CM_LeafArea( leafnum ), frame, &views, qfalse );
+
+	// the common snapshot is sorted by entity number so the list is sorted too
+	for ( e = 0 ; e < svs.currFrame->count; e++ ) {
+		// skip whole words of entities that can't be visible
+		if ( !views.bits[ e >> 5 ] ) {
+			e |= 31;
 			continue;
 		}
-		l = 0;
-		for ( i=0 ; i < svEnt->numClusters ; i++ ) {
-			l = svEnt->clusternums[i];
-			if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-				break;
-			}
+		if ( !( views.bits[ e >> 5 ] & ( 1U << ( e & 31 ) ) ) ) {
+			continue;
 		}
 
-		// if we haven't found it to be visible,
-		// check overflow clusters that couldn't be stored
-		if ( i == svEnt->numClusters ) {
-			if ( svEnt->lastCluster ) {
-				for ( ; l <= svEnt->lastCluster ; l++ ) {
-					if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-						break;
-					}
-				}
-				if ( l == svEnt->lastCluster ) {
-					continue;	// not visible
-				}
-			} else {
-				continue;
-			}
+		es = svs.currFrame->ents[ e ];
+
+		// never send client's own entity, because it can
+		// be regenerated from the playerstate
+		if ( es->number == frame->ps.clientNum ) {
+			continue;
 		}
 
-		// add it
-		SV_AddIndexToSnapshot( svEnt, e, eNums );
-
-		// if it's a portal entity, add everything visible from its camera position
-		if ( ent->r.svFlags & SVF_PORTAL && !portal ) {
-			if ( ent->s.generic1 ) {
-				vec3_t dir;
-				VectorSubtract(ent->s.origin, origin, dir);
-				if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
-					continue;
-				}
-			}
-			eNums->unordered = qtrue;
-			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, portal );
+		ent = SV_GentityNum( es->number );
+		if ( SV_ClientFiltersEntity( ent, frame->ps.clientNum ) ) {
+			continue;
 		}
-	}
 
-	ent = SV_GentityNum( frame->ps.clientNum );
-	// extension: merge second PVS at ent->r.s.origin2
-	if ( ent->r.svFlags & SVF_SELF_PORTAL2 && !portal ) {
-		SV_AddEntitiesVisibleFromPoint( ent->r.s.origin2, frame, eNums, qtrue );
-		eNums->unordered = qtrue;
+		// if we are full, silently discard entities
+		if ( frame->num_entities >= MAX_SNAPSHOT_ENTITIES ) {
+			break;
+		}
+
+		frame->ents[ frame->num_entities++ ] = es;
 	}
 }
 
@@ -474,6 +626,7 @@ This should be called before any new client snaphot built
 void SV_IssueNewSnapshot( void ) 
 {
 	svs.currFrame = NULL;
+	SV_ClearVisSets();
 	
 	// value that clients can use even for their empty frames
 	// as it will not increment on new snapshot built
@@ -524,12 +677,9 @@ static void SV_BuildCommonSnapshot( void )
 			}
 
 			list[ count++ ] = ent;
-			sv.svEntities[ num ].snapshotCounter = -1;
 		}
 	}
 
-	sv.snapshotCounter = -1;
-
 	sf = &svs.snapFrames[ svs.snapshotFrame % NUM_SNAPSHOT_FRAMES ];
 	
 	// track last valid frame
@@ -565,6 +715,7 @@ static void SV_BuildCommonSnapshot( void )
 	svs.snapshotFrame++;
 
 	svs.currFrame = sf; // clients can refer to this
+	SV_ClearVisSets();
 
 	// setup start index
 	index = sf->start;
@@ -592,9 +743,7 @@ For viewing through other player's eyes, clent can be something other than clien
 static void SV_BuildClientSnapshot( client_t *client ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i, cl;
-	svEntity_t					*svEnt;
 	int							clientNum;
 	playerState_t				*ps;
 
@@ -634,48 +783,21 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		SV_BuildCommonSnapshot();
 	}
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
-	// empty entities before visibility check
-	entityNumbers.numSnapshotEntities = 0;
-
 	frame->frameNum = svs.currFrame->frameNum;
 
-	// never send client's own entity, because it can
-	// be regenerated from the playerstate
-	svEnt = &sv.svEntities[ clientNum ];
-	svEnt->snapshotCounter = sv.snapshotCounter;
-
 	// find the client's viewpoint
 	VectorCopy( ps->origin, org );
 	org[2] += ps->viewheight;
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	entityNumbers.unordered = qfalse;
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
-
-	// if there were portals visible, there may be out of order entities
-	// in the list which will need to be resorted for the delta compression
-	// to work correctly.  This also catches the error condition
-	// of an entity being included twice.
-	if ( entityNumbers.unordered ) {
-		SV_SortEntityNumbers( &entityNumbers.snapshotEntities[0], 
-			entityNumbers.numSnapshotEntities );
-	}
+	SV_AddEntitiesVisibleFromPoint( org, frame );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
 	for ( i = 0; i < MAX_MAP_AREA_BYTES/sizeof(int); i++ ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
-
-	frame->num_entities = entityNumbers.numSnapshotEntities;
-	// get pointers from common snapshot
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ )	{
-		frame->ents[ i ] = svs.currFrame->ents[ entityNumbers.snapshotEntities[ i ] ];
-	}
 }
 
 
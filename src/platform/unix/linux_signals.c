@@ -67,6 +67,7 @@ static void signal_handler( int sig )
 #endif
 	SV_Shutdown( msg );
 	VM_Forced_Unload_Done();
+	Com_LogFlush();
 	Sys_Exit( 0 ); // send a 0 to avoid DOUBLE SIGNAL FAULT
 }
 
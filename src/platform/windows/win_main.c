@@ -92,6 +92,8 @@ void NORETURN FORMAT_PRINTF(1, 2) QDECL Sys_Error( const char *error, ... ) {
 	CL_Shutdown( text, qtrue );
 #endif
 
+	Com_LogFlush();
+
 	Conbuf_AppendText( text );
 	Conbuf_AppendText( "\n" );
 